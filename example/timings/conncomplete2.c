@@ -0,0 +1,161 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Usage: p4est_conncomplete [-b <brick size>] [-f <inp file>]
+ *                           [-r <repetitions>]
+ *
+ * Benchmark for the completion of a connectivity from its vertices.
+ * The connectivity is a brick of <brick size> trees in each direction,
+ * or it is read from an Abaqus .inp file.  It is completed once by
+ * p4est_connectivity_complete on every process and once cooperatively
+ * by p4est_connectivity_complete_parallel.  Both results must agree.
+ */
+
+#ifndef P4_TO_P8
+#include <p4est_connectivity.h>
+#else
+#include <p8est_connectivity.h>
+#endif
+#include <sc_flops.h>
+#include <sc_statistics.h>
+#include <sc_options.h>
+
+enum
+{
+  COMPLETE_SERIAL,
+  COMPLETE_PARALLEL,
+  COMPLETE_NUM_STATS
+};
+
+static p4est_connectivity_t *
+run_complete (sc_MPI_Comm mpicomm, sc_array_t * buffer, int parallel,
+              int repetitions, sc_statinfo_t * stats)
+{
+  int                 r;
+  p4est_connectivity_t *conn = NULL;
+  sc_flopinfo_t       fi, snapshot;
+
+  sc_flops_start (&fi);
+  for (r = 0; r < repetitions; ++r) {
+    if (conn != NULL) {
+      p4est_connectivity_destroy (conn);
+    }
+    conn = p4est_connectivity_inflate (buffer);
+
+    sc_MPI_Barrier (mpicomm);
+    sc_flops_snap (&fi, &snapshot);
+    if (parallel) {
+      p4est_connectivity_complete_parallel (conn, mpicomm);
+    }
+    else {
+      p4est_connectivity_complete (conn);
+    }
+    sc_flops_shot (&fi, &snapshot);
+    sc_stats_accumulate (&stats[parallel ? COMPLETE_PARALLEL :
+                                COMPLETE_SERIAL], snapshot.iwtime);
+  }
+  return conn;
+}
+
+int
+main (int argc, char **argv)
+{
+  sc_MPI_Comm         mpicomm;
+  int                 mpiret, retval;
+  int                 brick, repetitions;
+  const char         *inpfile;
+  sc_array_t         *buffer;
+  sc_statinfo_t       stats[COMPLETE_NUM_STATS];
+  sc_options_t       *opt;
+  p4est_connectivity_t *connectivity, *serial, *parallel;
+
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+  opt = sc_options_new (argv[0]);
+#ifndef P4_TO_P8
+  sc_options_add_int (opt, 'b', "brick", &brick, 1024,
+                      "Number of brick trees in each direction");
+#else
+  sc_options_add_int (opt, 'b', "brick", &brick, 96,
+                      "Number of brick trees in each direction");
+#endif
+  sc_options_add_string (opt, 'f', "inp-file", &inpfile, NULL,
+                         "Read the connectivity from an .inp file");
+  sc_options_add_int (opt, 'r', "repetitions", &repetitions, 3,
+                      "Number of completions of each algorithm");
+  retval = sc_options_parse (p4est_package_id, SC_LP_ERROR, opt, argc, argv);
+  if (retval == -1 || retval < argc || brick < 1 || repetitions < 1) {
+    sc_options_print_usage (p4est_package_id, SC_LP_PRODUCTION, opt, NULL);
+    sc_abort_collective ("Usage error");
+  }
+
+  if (inpfile != NULL) {
+    connectivity = p4est_connectivity_read_inp (inpfile);
+    SC_CHECK_ABORTF (connectivity != NULL, "Failed to read %s", inpfile);
+  }
+  else {
+#ifndef P4_TO_P8
+    connectivity = p4est_connectivity_new_brick (brick, brick, 0, 0);
+#else
+    connectivity = p8est_connectivity_new_brick (brick, brick, brick,
+                                                 0, 0, 0);
+#endif
+  }
+  buffer = p4est_connectivity_deflate (connectivity, P4EST_CONN_ENCODE_NONE);
+  P4EST_GLOBAL_PRODUCTIONF ("Completion benchmark with %lld trees"
+                            " and %lld vertices\n",
+                            (long long) connectivity->num_trees,
+                            (long long) connectivity->num_vertices);
+  p4est_connectivity_destroy (connectivity);
+
+  sc_stats_init (&stats[COMPLETE_SERIAL], "Serial");
+  sc_stats_init (&stats[COMPLETE_PARALLEL], "Parallel");
+  serial = run_complete (mpicomm, buffer, 0, repetitions, stats);
+  parallel = run_complete (mpicomm, buffer, 1, repetitions, stats);
+  SC_CHECK_ABORT (p4est_connectivity_is_equal (serial, parallel),
+                  "Parallel completion differs");
+  P4EST_GLOBAL_PRODUCTIONF ("Completed connectivity with %lld corners\n",
+                            (long long) parallel->num_corners);
+
+  sc_stats_compute (mpicomm, COMPLETE_NUM_STATS, stats);
+  sc_stats_print (p4est_package_id, SC_LP_ESSENTIAL,
+                  COMPLETE_NUM_STATS, stats, 1, 1);
+
+  p4est_connectivity_destroy (serial);
+  p4est_connectivity_destroy (parallel);
+  sc_array_destroy (buffer);
+  sc_options_destroy (opt);
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
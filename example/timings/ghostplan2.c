@@ -0,0 +1,245 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Usage: p4est_ghostplan [-b <brick size>] [-l <level>] [-d <doubles>]
+ *                        [-r <repetitions>]
+ *
+ * Time repeated ghost exchanges on a uniform forest over a brick of
+ * <brick size> trees in each direction.  Every quadrant carries <doubles>
+ * values.  The exchange is repeated with p4est_ghost_exchange_custom and
+ * with a persistent plan from p4est_ghost_plan_new, whose creation time is
+ * reported separately.  Last, the values are stored as one array per value
+ * and exchanged without copies by a plan from p4est_ghost_plan_new_layout.
+ * All results are checked to agree.
+ */
+
+#ifndef P4_TO_P8
+#include <p4est_extended.h>
+#include <p4est_ghost.h>
+#else
+#include <p8est_extended.h>
+#include <p8est_ghost.h>
+#endif
+#include <sc_flops.h>
+#include <sc_options.h>
+#include <sc_statistics.h>
+
+enum
+{
+  TIMINGS_CUSTOM,
+  TIMINGS_PLAN_NEW,
+  TIMINGS_PLAN,
+  TIMINGS_LAYOUT_NEW,
+  TIMINGS_LAYOUT,
+  TIMINGS_NUM_STATS
+};
+
+int
+main (int argc, char **argv)
+{
+  sc_MPI_Comm         mpicomm;
+  int                 mpiret, retval;
+  int                 brick, level, doubles, reps;
+  int                 i, k;
+  size_t              zz, data_size, num_local, num_ghosts;
+  size_t             *local_offsets, *ghost_offsets, *field_sizes;
+  double             *mirror_values, *ghost_custom, *ghost_plan;
+  double             *local_fields, *ghost_fields;
+  p4est_locidx_t      lnum;
+  p4est_quadrant_t   *mirror;
+  p4est_ghost_layout_t local_layout, ghost_layout;
+  void              **mirror_data;
+  sc_flopinfo_t       fi, snapshot;
+  sc_statinfo_t       stats[TIMINGS_NUM_STATS];
+  sc_options_t       *opt;
+  p4est_connectivity_t *connectivity;
+  p4est_t            *p4est;
+  p4est_ghost_t      *ghost;
+  p4est_ghost_plan_t *plan, *plan_layout;
+
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+  opt = sc_options_new (argv[0]);
+  sc_options_add_int (opt, 'b', "brick", &brick, 4,
+                      "Number of brick trees in each direction");
+  sc_options_add_int (opt, 'l', "level", &level, 4,
+                      "Level of the uniform forest");
+  sc_options_add_int (opt, 'd', "doubles", &doubles, 4,
+                      "Number of doubles exchanged per quadrant");
+  sc_options_add_int (opt, 'r', "repetitions", &reps, 100,
+                      "Number of exchanges to time");
+  retval = sc_options_parse (p4est_package_id, SC_LP_ERROR, opt, argc, argv);
+  if (retval == -1 || retval < argc || brick < 1 || level < 0 ||
+      level > P4EST_QMAXLEVEL || doubles < 1 || reps < 1) {
+    sc_options_print_usage (p4est_package_id, SC_LP_PRODUCTION, opt, NULL);
+    sc_abort_collective ("Usage error");
+  }
+
+#ifndef P4_TO_P8
+  connectivity = p4est_connectivity_new_brick (brick, brick, 0, 0);
+#else
+  connectivity = p8est_connectivity_new_brick (brick, brick, brick, 0, 0, 0);
+#endif
+  p4est = p4est_new_ext (mpicomm, connectivity, 0, level, 1, 0, NULL, NULL);
+  ghost = p4est_ghost_new (p4est, P4EST_CONNECT_FULL);
+  P4EST_GLOBAL_PRODUCTIONF ("Ghost exchange of %d doubles for %lld"
+                            " quadrants %d times\n", doubles,
+                            (long long) p4est->global_num_quadrants, reps);
+
+  /* the mirror values are changed before every exchange */
+  data_size = doubles * sizeof (double);
+  num_ghosts = ghost->ghosts.elem_count;
+  mirror_values = P4EST_ALLOC (double, doubles * ghost->mirrors.elem_count);
+  mirror_data = P4EST_ALLOC (void *, ghost->mirrors.elem_count);
+  for (zz = 0; zz < ghost->mirrors.elem_count; ++zz) {
+    mirror_data[zz] = mirror_values + doubles * zz;
+  }
+  ghost_custom = P4EST_ALLOC (double, doubles * num_ghosts);
+  ghost_plan = P4EST_ALLOC (double, doubles * num_ghosts);
+
+  /* repeat the exchange with transient messages */
+  mpiret = sc_MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+  sc_flops_start (&fi);
+  sc_flops_snap (&fi, &snapshot);
+  for (i = 0; i < reps; ++i) {
+    for (zz = 0; zz < doubles * ghost->mirrors.elem_count; ++zz) {
+      mirror_values[zz] = (double) (i + zz);
+    }
+    p4est_ghost_exchange_custom (p4est, ghost, data_size,
+                                 mirror_data, ghost_custom);
+  }
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[TIMINGS_CUSTOM], snapshot.iwtime, "Custom");
+
+  /* create a persistent plan once */
+  mpiret = sc_MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+  sc_flops_snap (&fi, &snapshot);
+  plan = p4est_ghost_plan_new (p4est, ghost, data_size, ghost_plan);
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[TIMINGS_PLAN_NEW], snapshot.iwtime, "Plan new");
+
+  /* repeat the exchange with the plan */
+  mpiret = sc_MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+  sc_flops_snap (&fi, &snapshot);
+  for (i = 0; i < reps; ++i) {
+    for (zz = 0; zz < doubles * ghost->mirrors.elem_count; ++zz) {
+      mirror_values[zz] = (double) (i + zz);
+    }
+    p4est_ghost_plan_exchange (plan, mirror_data);
+  }
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[TIMINGS_PLAN], snapshot.iwtime, "Plan");
+
+  /* store each value in its own array over the local quadrants */
+  num_local = (size_t) p4est->local_num_quadrants;
+  local_fields = P4EST_ALLOC (double, doubles * num_local);
+  ghost_fields = P4EST_ALLOC (double, doubles * num_ghosts);
+  local_offsets = P4EST_ALLOC (size_t, doubles);
+  ghost_offsets = P4EST_ALLOC (size_t, doubles);
+  field_sizes = P4EST_ALLOC (size_t, doubles);
+  for (k = 0; k < doubles; ++k) {
+    local_offsets[k] = k * num_local * sizeof (double);
+    ghost_offsets[k] = k * num_ghosts * sizeof (double);
+    field_sizes[k] = sizeof (double);
+  }
+  local_layout.base = local_fields;
+  local_layout.stride = sizeof (double);
+  local_layout.num_fields = doubles;
+  local_layout.field_offsets = local_offsets;
+  local_layout.field_sizes = field_sizes;
+  ghost_layout = local_layout;
+  ghost_layout.base = ghost_fields;
+  ghost_layout.field_offsets = ghost_offsets;
+
+  /* create a plan with datatypes once */
+  mpiret = sc_MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+  sc_flops_snap (&fi, &snapshot);
+  plan_layout = p4est_ghost_plan_new_layout (p4est, ghost, &local_layout,
+                                             &ghost_layout);
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[TIMINGS_LAYOUT_NEW], snapshot.iwtime, "Layout new");
+
+  /* repeat the exchange without copies */
+  mpiret = sc_MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+  sc_flops_snap (&fi, &snapshot);
+  for (i = 0; i < reps; ++i) {
+    for (zz = 0; zz < ghost->mirrors.elem_count; ++zz) {
+      mirror = p4est_quadrant_array_index (&ghost->mirrors, zz);
+      lnum = mirror->p.piggy3.local_num;
+      for (k = 0; k < doubles; ++k) {
+        local_fields[k * num_local + lnum] = (double) (i + doubles * zz + k);
+      }
+    }
+    p4est_ghost_plan_exchange (plan_layout, NULL);
+  }
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[TIMINGS_LAYOUT], snapshot.iwtime, "Layout");
+
+  /* the last exchanges must agree */
+  for (zz = 0; zz < doubles * num_ghosts; ++zz) {
+    SC_CHECK_ABORT (ghost_custom[zz] == ghost_plan[zz],
+                    "Ghost plan mismatch");
+    SC_CHECK_ABORT (ghost_custom[zz] == ghost_fields[(zz % doubles) *
+                                                     num_ghosts +
+                                                     zz / doubles],
+                    "Ghost layout mismatch");
+  }
+
+  sc_stats_compute (mpicomm, TIMINGS_NUM_STATS, stats);
+  sc_stats_print (p4est_package_id, SC_LP_ESSENTIAL,
+                  TIMINGS_NUM_STATS, stats, 1, 1);
+
+  p4est_ghost_plan_destroy (plan_layout);
+  P4EST_FREE (field_sizes);
+  P4EST_FREE (ghost_offsets);
+  P4EST_FREE (local_offsets);
+  P4EST_FREE (ghost_fields);
+  P4EST_FREE (local_fields);
+  p4est_ghost_plan_destroy (plan);
+  P4EST_FREE (ghost_plan);
+  P4EST_FREE (ghost_custom);
+  P4EST_FREE (mirror_data);
+  P4EST_FREE (mirror_values);
+  p4est_ghost_destroy (ghost);
+  p4est_destroy (p4est);
+  p4est_connectivity_destroy (connectivity);
+  sc_options_destroy (opt);
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
@@ -0,0 +1,392 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Usage: p4est_morton [-l <level>] [-n <count>] [-r <repetitions>]
+ *
+ * Micro-benchmark for the Morton encoding and decoding functions
+ * p4est_quadrant_linear_id, p4est_quadrant_set_morton and their 128-bit
+ * variants.  Each is timed against a bit-by-bit reference loop, and the
+ * results of both are verified to match.  The library functions use the
+ * PDEP/PEXT instructions if p4est was compiled with BMI2 enabled
+ * (for example -mbmi2 or -march=native) and magic-number masks otherwise.
+ */
+
+#ifndef P4_TO_P8
+#include <p4est_bits.h>
+#include <p4est_extended.h>
+#else
+#include <p8est_bits.h>
+#include <p8est_extended.h>
+#endif
+#include <sc_flops.h>
+#include <sc_statistics.h>
+#include <sc_options.h>
+
+enum
+{
+  MORTON_LINEAR_ID_LOOP,
+  MORTON_LINEAR_ID,
+  MORTON_SET_MORTON_LOOP,
+  MORTON_SET_MORTON,
+  MORTON_LINEAR_ID_EXT128_LOOP,
+  MORTON_LINEAR_ID_EXT128,
+  MORTON_SET_MORTON_EXT128_LOOP,
+  MORTON_SET_MORTON_EXT128,
+  MORTON_NUM_STATS
+};
+
+/* the previous bit-by-bit implementation of p4est_quadrant_linear_id */
+static              uint64_t
+morton_linear_id_loop (const p4est_quadrant_t * quadrant, int level)
+{
+  int                 i;
+  uint64_t            id;
+  uint64_t            x, y;
+#ifdef P4_TO_P8
+  uint64_t            z;
+#endif
+
+  x = quadrant->x >> (P4EST_MAXLEVEL - level);
+  y = quadrant->y >> (P4EST_MAXLEVEL - level);
+#ifdef P4_TO_P8
+  z = quadrant->z >> (P4EST_MAXLEVEL - level);
+#endif
+
+  id = 0;
+  for (i = 0; i < level + 2; ++i) {
+    id |= ((x & ((uint64_t) 1 << i)) << ((P4EST_DIM - 1) * i));
+    id |= ((y & ((uint64_t) 1 << i)) << ((P4EST_DIM - 1) * i + 1));
+#ifdef P4_TO_P8
+    id |= ((z & ((uint64_t) 1 << i)) << ((P4EST_DIM - 1) * i + 2));
+#endif
+  }
+
+  return id;
+}
+
+/* the previous bit-by-bit implementation of p4est_quadrant_set_morton */
+static void
+morton_set_morton_loop (p4est_quadrant_t * quadrant, int level, uint64_t id)
+{
+  int                 i;
+
+  quadrant->level = (int8_t) level;
+  quadrant->x = 0;
+  quadrant->y = 0;
+#ifdef P4_TO_P8
+  quadrant->z = 0;
+#endif
+
+  for (i = 0; i < level + 2; ++i) {
+    quadrant->x |= (p4est_qcoord_t) ((id & (1ULL << (P4EST_DIM * i)))
+                                     >> ((P4EST_DIM - 1) * i));
+    quadrant->y |= (p4est_qcoord_t) ((id & (1ULL << (P4EST_DIM * i + 1)))
+                                     >> ((P4EST_DIM - 1) * i + 1));
+#ifdef P4_TO_P8
+    quadrant->z |= (p4est_qcoord_t) ((id & (1ULL << (P4EST_DIM * i + 2)))
+                                     >> ((P4EST_DIM - 1) * i + 2));
+#endif
+  }
+
+  quadrant->x <<= (P4EST_MAXLEVEL - level);
+  quadrant->y <<= (P4EST_MAXLEVEL - level);
+#ifdef P4_TO_P8
+  quadrant->z <<= (P4EST_MAXLEVEL - level);
+#endif
+}
+
+/* the previous bit-by-bit implementation of the 128-bit linear id */
+static void
+morton_linear_id_ext128_loop (const p4est_quadrant_t * quadrant,
+                              int level, p4est_lid_t * id)
+{
+  int                 i;
+  uint64_t            x, y;
+#ifdef P4_TO_P8
+  uint64_t            z;
+#endif
+
+  x = quadrant->x >> (P4EST_MAXLEVEL - level);
+  y = quadrant->y >> (P4EST_MAXLEVEL - level);
+#ifdef P4_TO_P8
+  z = quadrant->z >> (P4EST_MAXLEVEL - level);
+#endif
+
+  p4est_lid_set_zero (id);
+  for (i = 0; i < level + 2; ++i) {
+    if (x & ((uint64_t) 1 << i))
+      p4est_lid_set_bit (id, P4EST_DIM * i);
+    if (y & ((uint64_t) 1 << i))
+      p4est_lid_set_bit (id, P4EST_DIM * i + 1);
+#ifdef P4_TO_P8
+    if (z & ((uint64_t) 1 << i))
+      p4est_lid_set_bit (id, P4EST_DIM * i + 2);
+#endif
+  }
+}
+
+/* the previous bit-by-bit implementation of the 128-bit set_morton */
+static void
+morton_set_morton_ext128_loop (p4est_quadrant_t * quadrant, int level,
+                               const p4est_lid_t * id)
+{
+  int                 i;
+
+  quadrant->level = (int8_t) level;
+  quadrant->x = 0;
+  quadrant->y = 0;
+#ifdef P4_TO_P8
+  quadrant->z = 0;
+#endif
+
+  for (i = 0; i < level + 2; ++i) {
+    if (p4est_lid_chk_bit (id, P4EST_DIM * i))
+      quadrant->x |= (p4est_qcoord_t) 1 << i;
+    if (p4est_lid_chk_bit (id, P4EST_DIM * i + 1))
+      quadrant->y |= (p4est_qcoord_t) 1 << i;
+#ifdef P4_TO_P8
+    if (p4est_lid_chk_bit (id, P4EST_DIM * i + 2))
+      quadrant->z |= (p4est_qcoord_t) 1 << i;
+#endif
+  }
+
+  quadrant->x <<= (P4EST_MAXLEVEL - level);
+  quadrant->y <<= (P4EST_MAXLEVEL - level);
+#ifdef P4_TO_P8
+  quadrant->z <<= (P4EST_MAXLEVEL - level);
+#endif
+}
+
+/* simple linear congruential generator for reproducible test input */
+static              uint64_t
+morton_random (uint64_t * state)
+{
+  *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return *state >> 11;
+}
+
+static void
+morton_check_quadrant (const p4est_quadrant_t * a, const p4est_quadrant_t * b)
+{
+  SC_CHECK_ABORT (p4est_quadrant_is_equal (a, b) && a->level == b->level,
+                  "Morton quadrant mismatch");
+}
+
+static void
+run_morton (int level, size_t count, int repetitions, sc_statinfo_t * stats)
+{
+  int                 r;
+  int                 deep;
+  size_t              zz;
+  uint64_t            state, mask, sum;
+  uint64_t           *ids;
+  p4est_lid_t        *lids;
+  p4est_quadrant_t   *quads, *deepq, q;
+  sc_flopinfo_t       fi, snapshot;
+
+  /* the 64-bit functions are limited to the old maximum level */
+  P4EST_ASSERT (0 <= level && level <= P4EST_OLD_QMAXLEVEL);
+  deep = P4EST_QMAXLEVEL;
+
+  ids = P4EST_ALLOC (uint64_t, count);
+  lids = P4EST_ALLOC (p4est_lid_t, count);
+  quads = P4EST_ALLOC_ZERO (p4est_quadrant_t, count);
+  deepq = P4EST_ALLOC_ZERO (p4est_quadrant_t, count);
+
+  /* create random ids on the given level and on the deepest level */
+  state = 1;
+  mask = ((uint64_t) 1 << (P4EST_DIM * level)) - 1;
+  for (zz = 0; zz < count; ++zz) {
+    ids[zz] = morton_random (&state) & mask;
+#ifndef P4_TO_P8
+    lids[zz] = ((morton_random (&state) << 11) ^ morton_random (&state)) &
+      ((((p4est_lid_t) 1) << (P4EST_DIM * deep)) - 1);
+#else
+    p4est_lid_init (&lids[zz],
+                    morton_random (&state) &
+                    ((((uint64_t) 1) << (P4EST_DIM * deep - 64)) - 1),
+                    (morton_random (&state) << 11) ^ morton_random (&state));
+#endif
+    morton_set_morton_loop (&quads[zz], level, ids[zz]);
+    morton_set_morton_ext128_loop (&deepq[zz], deep, &lids[zz]);
+  }
+
+  /* verify that the library functions agree with the reference loops */
+  for (zz = 0; zz < count; ++zz) {
+    p4est_lid_t         lid;
+
+    SC_CHECK_ABORT (p4est_quadrant_linear_id (&quads[zz], level) ==
+                    morton_linear_id_loop (&quads[zz], level),
+                    "Linear id mismatch");
+    p4est_quadrant_set_morton (&q, level, ids[zz]);
+    morton_check_quadrant (&q, &quads[zz]);
+
+    p4est_quadrant_linear_id_ext128 (&deepq[zz], deep, &lid);
+    SC_CHECK_ABORT (p4est_lid_is_equal (&lid, &lids[zz]),
+                    "Linear id ext128 mismatch");
+    p4est_quadrant_set_morton_ext128 (&q, deep, &lids[zz]);
+    morton_check_quadrant (&q, &deepq[zz]);
+  }
+
+  /* time the 64-bit versions */
+  sc_flops_start (&fi);
+  sum = 0;
+  sc_flops_snap (&fi, &snapshot);
+  for (r = 0; r < repetitions; ++r) {
+    for (zz = 0; zz < count; ++zz) {
+      sum += morton_linear_id_loop (&quads[zz], level);
+    }
+  }
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[MORTON_LINEAR_ID_LOOP], snapshot.iwtime,
+                 "Linear id loop");
+
+  sc_flops_snap (&fi, &snapshot);
+  for (r = 0; r < repetitions; ++r) {
+    for (zz = 0; zz < count; ++zz) {
+      sum -= p4est_quadrant_linear_id (&quads[zz], level);
+    }
+  }
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[MORTON_LINEAR_ID], snapshot.iwtime, "Linear id");
+  SC_CHECK_ABORT (sum == 0, "Linear id checksum");
+
+  sc_flops_snap (&fi, &snapshot);
+  for (r = 0; r < repetitions; ++r) {
+    for (zz = 0; zz < count; ++zz) {
+      morton_set_morton_loop (&q, level, ids[zz]);
+      sum += (uint64_t) q.x;
+    }
+  }
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[MORTON_SET_MORTON_LOOP], snapshot.iwtime,
+                 "Set Morton loop");
+
+  sc_flops_snap (&fi, &snapshot);
+  for (r = 0; r < repetitions; ++r) {
+    for (zz = 0; zz < count; ++zz) {
+      p4est_quadrant_set_morton (&q, level, ids[zz]);
+      sum -= (uint64_t) q.x;
+    }
+  }
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[MORTON_SET_MORTON], snapshot.iwtime, "Set Morton");
+  SC_CHECK_ABORT (sum == 0, "Set Morton checksum");
+
+  /* time the 128-bit versions */
+  sc_flops_snap (&fi, &snapshot);
+  for (r = 0; r < repetitions; ++r) {
+    for (zz = 0; zz < count; ++zz) {
+      morton_linear_id_ext128_loop (&deepq[zz], deep, &lids[zz]);
+    }
+  }
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[MORTON_LINEAR_ID_EXT128_LOOP], snapshot.iwtime,
+                 "Linear id ext128 loop");
+
+  sc_flops_snap (&fi, &snapshot);
+  for (r = 0; r < repetitions; ++r) {
+    for (zz = 0; zz < count; ++zz) {
+      p4est_quadrant_linear_id_ext128 (&deepq[zz], deep, &lids[zz]);
+    }
+  }
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[MORTON_LINEAR_ID_EXT128], snapshot.iwtime,
+                 "Linear id ext128");
+
+  sc_flops_snap (&fi, &snapshot);
+  for (r = 0; r < repetitions; ++r) {
+    for (zz = 0; zz < count; ++zz) {
+      morton_set_morton_ext128_loop (&deepq[zz], deep, &lids[zz]);
+    }
+  }
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[MORTON_SET_MORTON_EXT128_LOOP], snapshot.iwtime,
+                 "Set Morton ext128 loop");
+
+  sc_flops_snap (&fi, &snapshot);
+  for (r = 0; r < repetitions; ++r) {
+    for (zz = 0; zz < count; ++zz) {
+      p4est_quadrant_set_morton_ext128 (&deepq[zz], deep, &lids[zz]);
+    }
+  }
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[MORTON_SET_MORTON_EXT128], snapshot.iwtime,
+                 "Set Morton ext128");
+
+  P4EST_FREE (ids);
+  P4EST_FREE (lids);
+  P4EST_FREE (quads);
+  P4EST_FREE (deepq);
+}
+
+int
+main (int argc, char **argv)
+{
+  sc_MPI_Comm         mpicomm;
+  int                 mpiret, retval;
+  int                 level, repetitions;
+  size_t              count;
+  sc_statinfo_t       stats[MORTON_NUM_STATS];
+  sc_options_t       *opt;
+
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+  opt = sc_options_new (argv[0]);
+  sc_options_add_int (opt, 'l', "level", &level, P4EST_OLD_QMAXLEVEL,
+                      "Level of the 64-bit Morton indices");
+  sc_options_add_size_t (opt, 'n', "count", &count, 1 << 20,
+                         "Number of random Morton indices");
+  sc_options_add_int (opt, 'r', "repetitions", &repetitions, 10,
+                      "Number of passes over the indices");
+  retval = sc_options_parse (p4est_package_id, SC_LP_ERROR, opt, argc, argv);
+  if (retval == -1 || retval < argc || level < 0 ||
+      level > P4EST_OLD_QMAXLEVEL || repetitions < 1) {
+    sc_options_print_usage (p4est_package_id, SC_LP_PRODUCTION, opt, NULL);
+    sc_abort_collective ("Usage error");
+  }
+
+  P4EST_GLOBAL_PRODUCTIONF ("Morton benchmark level %d count %lld"
+                            " repetitions %d\n", level, (long long) count,
+                            repetitions);
+  run_morton (level, count, repetitions, stats);
+
+  sc_stats_compute (mpicomm, MORTON_NUM_STATS, stats);
+  sc_stats_print (p4est_package_id, SC_LP_ESSENTIAL,
+                  MORTON_NUM_STATS, stats, 1, 1);
+
+  sc_options_destroy (opt);
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
@@ -0,0 +1,219 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Usage: p4est_refine [-l <level>] [-L <levels>] [-d <data size>]
+ *                     [-r <repetitions>] [-t <threads>]
+ *
+ * Benchmark for the refinement algorithms of p4est_refine_ext.
+ * A uniform forest is refined recursively and irregularly by up to
+ * <levels> more levels, once with the default quadrant list, once with
+ * the depth-first stack and once with the stack on <threads>
+ * threads, which requires libsc to be configured with pthread support.
+ * We report the time per refined quadrant and the memory allocated from
+ * the quadrant pool, which the stack algorithm does not touch.
+ * All variants are verified to produce the same forest.
+ */
+
+#ifndef P4_TO_P8
+#include <p4est_bits.h>
+#include <p4est_extended.h>
+#else
+#include <p8est_bits.h>
+#include <p8est_extended.h>
+#endif
+#include <sc_flops.h>
+#include <sc_statistics.h>
+#include <sc_options.h>
+
+enum
+{
+  REFINE_LIST,
+  REFINE_LIST_PER_QUADRANT,
+  REFINE_LIST_POOL,
+  REFINE_STACK,
+  REFINE_STACK_PER_QUADRANT,
+  REFINE_STACK_POOL,
+  REFINE_THREADS,
+  REFINE_THREADS_PER_QUADRANT,
+  REFINE_THREADS_POOL,
+  REFINE_NUM_STATS
+};
+
+static int          refine_max_level;
+
+/* refine about half of the quadrants, chosen by their position */
+static int
+refine_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+           p4est_quadrant_t * quadrant)
+{
+  uint64_t            hash;
+
+  if ((int) quadrant->level >= refine_max_level) {
+    return 0;
+  }
+  hash = (uint64_t) quadrant->x * 0x9E3779B97F4A7C15ULL ^
+    (uint64_t) quadrant->y * 0xC2B2AE3D27D4EB4FULL ^
+#ifdef P4_TO_P8
+    (uint64_t) quadrant->z * 0x165667B19E3779F9ULL ^
+#endif
+    (uint64_t) (quadrant->level + which_tree);
+  return (int) ((hash >> 32) & 1);
+}
+
+static void
+init_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+         p4est_quadrant_t * quadrant)
+{
+  *(int *) quadrant->p.user_data = (int) quadrant->level;
+}
+
+static unsigned
+run_refine (p4est_t * base, int stat, int use_stack, int num_threads,
+            int repetitions, sc_statinfo_t * stats)
+{
+  int                 r;
+  unsigned            crc = 0;
+  double              refined;
+  p4est_t            *p4est;
+  p4est_inspect_t     inspect;
+  sc_flopinfo_t       fi, snapshot;
+
+  memset (&inspect, 0, sizeof (inspect));
+  inspect.use_refine_stack = use_stack;
+  inspect.refine_num_threads = num_threads;
+
+  sc_flops_start (&fi);
+  for (r = 0; r < repetitions; ++r) {
+    p4est = p4est_copy (base, 1);
+    p4est->inspect = &inspect;
+
+    sc_MPI_Barrier (p4est->mpicomm);
+    sc_flops_snap (&fi, &snapshot);
+    p4est_refine_ext (p4est, 1, -1, refine_fn, init_fn, NULL);
+    sc_flops_shot (&fi, &snapshot);
+
+    refined = (double) (p4est->local_num_quadrants -
+                        base->local_num_quadrants) / (P4EST_CHILDREN - 1);
+    sc_stats_accumulate (&stats[stat], snapshot.iwtime);
+    sc_stats_accumulate (&stats[stat + 1],
+                         snapshot.iwtime / SC_MAX (refined, 1.));
+    sc_stats_accumulate (&stats[stat + 2], (double)
+                         sc_mempool_memory_used (p4est->quadrant_pool));
+
+    crc = p4est_checksum (p4est);
+    p4est->inspect = NULL;
+    p4est_destroy (p4est);
+  }
+  return crc;
+}
+
+int
+main (int argc, char **argv)
+{
+  sc_MPI_Comm         mpicomm;
+  int                 mpiret, retval;
+  int                 level, levels, data_size;
+  int                 repetitions, num_threads;
+  unsigned            crc;
+  sc_statinfo_t       stats[REFINE_NUM_STATS];
+  sc_options_t       *opt;
+  p4est_connectivity_t *connectivity;
+  p4est_t            *p4est;
+
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+  opt = sc_options_new (argv[0]);
+  sc_options_add_int (opt, 'l', "level", &level, 4,
+                      "Level of the uniform initial forest");
+  sc_options_add_int (opt, 'L', "levels", &levels, 4,
+                      "Maximum number of levels to refine");
+  sc_options_add_int (opt, 'd', "data-size", &data_size, (int) sizeof (int),
+                      "Size of the quadrant user data");
+  sc_options_add_int (opt, 'r', "repetitions", &repetitions, 5,
+                      "Number of refinements of each algorithm");
+  sc_options_add_int (opt, 't', "threads", &num_threads, 4,
+                      "Number of threads for the threaded algorithm");
+  retval = sc_options_parse (p4est_package_id, SC_LP_ERROR, opt, argc, argv);
+  if (retval == -1 || retval < argc || level < 0 || levels < 0 ||
+      level + levels > P4EST_QMAXLEVEL || data_size < (int) sizeof (int) ||
+      repetitions < 1 || num_threads < 1) {
+    sc_options_print_usage (p4est_package_id, SC_LP_PRODUCTION, opt, NULL);
+    sc_abort_collective ("Usage error");
+  }
+  refine_max_level = level + levels;
+
+#ifndef P4_TO_P8
+  connectivity = p4est_connectivity_new_moebius ();
+#else
+  connectivity = p8est_connectivity_new_rotcubes ();
+#endif
+  p4est = p4est_new_ext (mpicomm, connectivity, 0, level, 1,
+                         (size_t) data_size, init_fn, NULL);
+
+  P4EST_GLOBAL_PRODUCTIONF ("Refine benchmark from level %d by %d levels"
+                            " with %lld quadrants\n", level, levels,
+                            (long long) p4est->global_num_quadrants);
+  sc_stats_init (&stats[REFINE_LIST], "List");
+  sc_stats_init (&stats[REFINE_LIST_PER_QUADRANT],
+                 "List per refined quadrant");
+  sc_stats_init (&stats[REFINE_LIST_POOL], "List quadrant pool bytes");
+  sc_stats_init (&stats[REFINE_STACK], "Stack");
+  sc_stats_init (&stats[REFINE_STACK_PER_QUADRANT],
+                 "Stack per refined quadrant");
+  sc_stats_init (&stats[REFINE_STACK_POOL], "Stack quadrant pool bytes");
+  sc_stats_init (&stats[REFINE_THREADS], "Threads");
+  sc_stats_init (&stats[REFINE_THREADS_PER_QUADRANT],
+                 "Threads per refined quadrant");
+  sc_stats_init (&stats[REFINE_THREADS_POOL], "Threads quadrant pool bytes");
+
+  /* the list algorithm provides the reference forest */
+  crc = run_refine (p4est, REFINE_LIST, 0, 0, repetitions, stats);
+  SC_CHECK_ABORT (crc == run_refine (p4est, REFINE_STACK, 1, 0,
+                                     repetitions, stats),
+                  "Stack refinement differs");
+  SC_CHECK_ABORT (crc == run_refine (p4est, REFINE_THREADS, 1, num_threads,
+                                     repetitions, stats),
+                  "Threaded refinement differs");
+  P4EST_GLOBAL_PRODUCTIONF ("Refined forest checksum 0x%08x\n", crc);
+
+  sc_stats_compute (mpicomm, REFINE_NUM_STATS, stats);
+  sc_stats_print (p4est_package_id, SC_LP_ESSENTIAL,
+                  REFINE_NUM_STATS, stats, 1, 1);
+
+  p4est_destroy (p4est);
+  p4est_connectivity_destroy (connectivity);
+  sc_options_destroy (opt);
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
@@ -257,6 +257,7 @@ main (int argc, char **argv)
   int                 borders;
   int                 max_ranges;
   int                 use_ranges, use_ranges_notify, use_balance_verify;
+  int                 use_balance_flat;
   int                 oldschool, generate;
   int                 first_argc;
   int                 test_multiple_orders;
@@ -298,6 +299,8 @@ main (int argc, char **argv)
                          "use both ranges and notify");
   sc_options_add_switch (opt, 'y', "balance-verify", &use_balance_verify,
                          "use verifications in balance");
+  sc_options_add_switch (opt, 0, "balance-flat", &use_balance_flat,
+                         "use open addressing tables in balance");
   sc_options_add_int (opt, 'l', "level", &refine_level, 0,
                       "initial refine level");
 #ifndef P4_TO_P8
@@ -504,6 +507,7 @@ main (int argc, char **argv)
   p4est->inspect->use_balance_ranges = use_ranges;
   p4est->inspect->use_balance_ranges_notify = use_ranges_notify;
   p4est->inspect->use_balance_verify = use_balance_verify;
+  p4est->inspect->use_balance_flat = use_balance_flat;
   p4est->inspect->balance_max_ranges = max_ranges;
   P4EST_GLOBAL_STATISTICSF
     ("Balance: new overlap %d new subtree %d borders %d\n", overlap,
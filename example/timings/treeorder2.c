@@ -0,0 +1,181 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Usage: p4est_treeorder [-b <brick size>] [-f <inp file>] [-l <level>]
+ *                        [-s]
+ *
+ * Report the ghost layer size of a uniform forest for different orders
+ * of the trees of its connectivity.  The connectivity is a brick of
+ * <brick size> trees in each direction or it is read from an Abaqus .inp
+ * file.  With -s its trees are shuffled first to emulate a mesh
+ * generator that produces trees in poor order.  The original order is compared to
+ * the Morton, Hilbert and reverse Cuthill-McKee orders computed by
+ * p4est_connectivity_sort_trees.
+ */
+
+#ifndef P4_TO_P8
+#include <p4est_extended.h>
+#include <p4est_ghost.h>
+#else
+#include <p8est_extended.h>
+#include <p8est_ghost.h>
+#endif
+#include <sc_flops.h>
+#include <sc_options.h>
+
+/** Permute the trees by a reproducible pseudo-random sequence. */
+static void
+shuffle_trees (p4est_connectivity_t * conn, unsigned long seed)
+{
+  size_t              zz, zj, swap;
+  size_t             *perm;
+  unsigned long       state = seed;
+  sc_array_t         *newid;
+
+  /* Fisher-Yates shuffle with a linear congruential generator */
+  newid = sc_array_new_count (sizeof (size_t), (size_t) conn->num_trees);
+  perm = (size_t *) newid->array;
+  for (zz = 0; zz < newid->elem_count; ++zz) {
+    perm[zz] = zz;
+  }
+  for (zz = newid->elem_count; zz > 1; --zz) {
+    state = (state * 1103515245UL + 12345UL) & 0x7fffffffUL;
+    zj = (size_t) (state % zz);
+    swap = perm[zz - 1];
+    perm[zz - 1] = perm[zj];
+    perm[zj] = swap;
+  }
+  p4est_connectivity_permute (conn, newid, 1);
+  sc_array_destroy (newid);
+}
+
+static void
+report_order (sc_MPI_Comm mpicomm, sc_array_t * buffer, int order,
+              int level, const char *name)
+{
+  int                 mpiret;
+  long long           local[2], global[2];
+  double              seconds;
+  sc_flopinfo_t       fi, snapshot;
+  p4est_connectivity_t *conn;
+  p4est_t            *p4est;
+  p4est_ghost_t      *ghost;
+
+  conn = p4est_connectivity_inflate (buffer);
+  sc_flops_start (&fi);
+  sc_flops_snap (&fi, &snapshot);
+  if (order >= 0) {
+    p4est_connectivity_sort_trees (conn, (p4est_connectivity_order_t) order,
+                                   P4EST_CONNECT_FULL, NULL);
+  }
+  sc_flops_shot (&fi, &snapshot);
+  seconds = snapshot.iwtime;
+
+  p4est = p4est_new_ext (mpicomm, conn, 0, level, 1, 0, NULL, NULL);
+  ghost = p4est_ghost_new (p4est, P4EST_CONNECT_FULL);
+  local[0] = (long long) ghost->ghosts.elem_count;
+  local[1] = (long long) ghost->mirrors.elem_count;
+  mpiret = sc_MPI_Allreduce (local, global, 2, sc_MPI_LONG_LONG_INT,
+                             sc_MPI_SUM, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_GLOBAL_PRODUCTIONF ("Order %-8s ghosts %lld mirrors %lld"
+                            " of %lld quadrants in %g seconds\n", name,
+                            global[0], global[1],
+                            (long long) p4est->global_num_quadrants,
+                            seconds);
+
+  p4est_ghost_destroy (ghost);
+  p4est_destroy (p4est);
+  p4est_connectivity_destroy (conn);
+}
+
+int
+main (int argc, char **argv)
+{
+  sc_MPI_Comm         mpicomm;
+  int                 mpiret, retval;
+  int                 brick, level, shuffle;
+  const char         *inpfile;
+  sc_array_t         *buffer;
+  sc_options_t       *opt;
+  p4est_connectivity_t *connectivity;
+
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+  opt = sc_options_new (argv[0]);
+  sc_options_add_int (opt, 'b', "brick", &brick, 32,
+                      "Number of brick trees in each direction");
+  sc_options_add_string (opt, 'f', "inp-file", &inpfile, NULL,
+                         "Read the connectivity from an .inp file");
+  sc_options_add_int (opt, 'l', "level", &level, 2,
+                      "Level of the uniform forest");
+  sc_options_add_switch (opt, 's', "shuffle", &shuffle,
+                         "Shuffle the trees before ordering them");
+  retval = sc_options_parse (p4est_package_id, SC_LP_ERROR, opt, argc, argv);
+  if (retval == -1 || retval < argc || brick < 1 || level < 0 ||
+      level > P4EST_QMAXLEVEL) {
+    sc_options_print_usage (p4est_package_id, SC_LP_PRODUCTION, opt, NULL);
+    sc_abort_collective ("Usage error");
+  }
+
+  if (inpfile != NULL) {
+    connectivity = p4est_connectivity_read_inp (inpfile);
+    SC_CHECK_ABORTF (connectivity != NULL, "Failed to read %s", inpfile);
+  }
+  else {
+#ifndef P4_TO_P8
+    connectivity = p4est_connectivity_new_brick (brick, brick, 0, 0);
+#else
+    connectivity = p8est_connectivity_new_brick (brick, brick, brick,
+                                                 0, 0, 0);
+#endif
+  }
+  if (shuffle) {
+    shuffle_trees (connectivity, 1234567);
+  }
+  buffer = p4est_connectivity_deflate (connectivity, P4EST_CONN_ENCODE_NONE);
+  P4EST_GLOBAL_PRODUCTIONF ("Tree order report with %lld trees\n",
+                            (long long) connectivity->num_trees);
+  p4est_connectivity_destroy (connectivity);
+
+  report_order (mpicomm, buffer, -1, level, "original");
+  report_order (mpicomm, buffer, P4EST_CONN_ORDER_MORTON, level, "Morton");
+  report_order (mpicomm, buffer, P4EST_CONN_ORDER_HILBERT, level, "Hilbert");
+  report_order (mpicomm, buffer, P4EST_CONN_ORDER_RCM, level, "RCM");
+
+  sc_array_destroy (buffer);
+  sc_options_destroy (opt);
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
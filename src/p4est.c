@@ -54,6 +54,9 @@
 #ifdef P4EST_HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#ifdef SC_ENABLE_PTHREAD
+#include <pthread.h>
+#endif
 
 typedef struct
 {
@@ -77,6 +80,8 @@ void               *P4EST_DATA_UNINITIALIZED = &p4est_uninitialized_key;
 static const size_t number_toread_quadrants = 32;
 static const int8_t fully_owned_flag = 0x01;
 static const int8_t any_face_flag = 0x02;
+static const int8_t changed_flag = 0x04;
+static const int8_t received_flag = 0x08;
 
 void
 p4est_qcoord_to_vertex (p4est_connectivity_t * connectivity,
@@ -161,8 +166,15 @@ p4est_memory_used (p4est_t * p4est)
   P4EST_ASSERT (p4est->trees != NULL);
 
   mpisize = p4est->mpisize;
-  size = sizeof (p4est_t) +
-    (mpisize + 1) * (sizeof (p4est_gloidx_t) + sizeof (p4est_quadrant_t));
+  size = sizeof (p4est_t);
+  if (p4est->shared != NULL) {
+    /* the partition arrays are counted once per compute node */
+    size += p4est_shared_memory_used (p4est->shared);
+  }
+  else {
+    size += (mpisize + 1) *
+      (sizeof (p4est_gloidx_t) + sizeof (p4est_quadrant_t));
+  }
 
   size += sc_array_memory_used (p4est->trees, 1);
   for (nt = 0; nt < p4est->connectivity->num_trees; ++nt) {
@@ -487,6 +499,10 @@ p4est_new_ext (sc_MPI_Comm mpicomm, p4est_connectivity_t * connectivity,
   }
   p4est->global_first_position = global_first_position;
 
+  /* optionally keep read-only global data once per compute node */
+  p4est_connectivity_share (connectivity, mpicomm);
+  p4est_comm_share (p4est);
+
   /* print more statistics */
   P4EST_VERBOSEF ("total local quadrants %lld\n",
                   (long long) p4est->local_num_quadrants);
@@ -530,8 +546,13 @@ p4est_destroy (p4est_t * p4est)
   sc_mempool_destroy (p4est->quadrant_pool);
 
   p4est_comm_parallel_env_release (p4est);
-  P4EST_FREE (p4est->global_first_quadrant);
-  P4EST_FREE (p4est->global_first_position);
+  if (p4est->shared != NULL) {
+    p4est_shared_destroy (p4est->shared);
+  }
+  else {
+    P4EST_FREE (p4est->global_first_quadrant);
+    P4EST_FREE (p4est->global_first_position);
+  }
   P4EST_FREE (p4est);
 }
 
@@ -560,6 +581,7 @@ p4est_copy_ext (p4est_t * input, int copy_data, int duplicate_mpicomm)
   memcpy (p4est, input, sizeof (p4est_t));
   p4est->global_first_quadrant = NULL;
   p4est->global_first_position = NULL;
+  p4est->shared = NULL;
   p4est->trees = NULL;
   p4est->user_data_pool = NULL;
   p4est->quadrant_pool = NULL;
@@ -619,6 +641,7 @@ p4est_copy_ext (p4est_t * input, int copy_data, int duplicate_mpicomm)
                                               p4est->mpisize + 1);
   memcpy (p4est->global_first_position, input->global_first_position,
           (p4est->mpisize + 1) * sizeof (p4est_quadrant_t));
+  p4est_comm_share (p4est);
 
   /* the copy starts with a revision count of zero */
   p4est->revision = 0;
@@ -677,6 +700,391 @@ p4est_reset_data (p4est_t * p4est, size_t data_size,
   }
 }
 
+/** A contiguous range of input quadrants in one local tree.
+ * Each range is refined independently into its own array. */
+typedef struct p4est_refine_item
+{
+  p4est_topidx_t      which_tree;
+  size_t              begin, end;       /**< range in the tree array */
+  int                 refined;          /**< true if \a out is used */
+  int                 maxlevel;
+  size_t              count;            /**< quadrants written to \a out */
+  sc_array_t          out;              /**< refined quadrants of range */
+  p4est_locidx_t      quadrants_per_level[P4EST_MAXLEVEL + 1];
+}
+p4est_refine_item_t;
+
+/** Context of the depth-first refinement of quadrant ranges. */
+typedef struct p4est_refine_stack
+{
+  p4est_t            *p4est;
+  int                 refine_recursive;
+  int                 allowed_level;
+  p4est_refine_t      refine_fn;
+  p4est_init_t        init_fn;
+  p4est_replace_t     replace_fn;
+  int                 mark;             /**< set pad8 of new quadrants */
+  int                 num_threads;
+  sc_array_t          items;
+#ifdef SC_ENABLE_PTHREAD
+  size_t              next_item;        /**< protected by mutex */
+  pthread_mutex_t     mutex;            /**< also guards user_data_pool */
+#endif
+}
+p4est_refine_stack_t;
+
+static void
+p4est_refine_stack_lock (p4est_refine_stack_t * rs)
+{
+#ifdef SC_ENABLE_PTHREAD
+  if (rs->num_threads > 1) {
+    pthread_mutex_lock (&rs->mutex);
+  }
+#endif
+}
+
+static void
+p4est_refine_stack_unlock (p4est_refine_stack_t * rs)
+{
+#ifdef SC_ENABLE_PTHREAD
+  if (rs->num_threads > 1) {
+    pthread_mutex_unlock (&rs->mutex);
+  }
+#endif
+}
+
+/** Allocate the user data of a family of children under one lock.
+ * The parent's data is freed as well unless it is needed for replace_fn.
+ */
+static void
+p4est_refine_stack_family_data (p4est_refine_stack_t * rs,
+                                p4est_quadrant_t * parent,
+                                p4est_quadrant_t children[])
+{
+  int                 k;
+  p4est_t            *p4est = rs->p4est;
+
+  if (p4est->data_size > 0) {
+    p4est_refine_stack_lock (rs);
+    if (rs->replace_fn == NULL) {
+      sc_mempool_free (p4est->user_data_pool, parent->p.user_data);
+      parent->p.user_data = NULL;
+    }
+    for (k = 0; k < P4EST_CHILDREN; ++k) {
+      children[k].p.user_data = sc_mempool_alloc (p4est->user_data_pool);
+    }
+    p4est_refine_stack_unlock (rs);
+  }
+  else {
+    parent->p.user_data = NULL;
+    for (k = 0; k < P4EST_CHILDREN; ++k) {
+      children[k].p.user_data = NULL;
+    }
+  }
+}
+
+static void
+p4est_refine_stack_free_data (p4est_refine_stack_t * rs,
+                              p4est_quadrant_t * quad)
+{
+  p4est_t            *p4est = rs->p4est;
+
+  if (p4est->data_size > 0) {
+    p4est_refine_stack_lock (rs);
+    sc_mempool_free (p4est->user_data_pool, quad->p.user_data);
+    p4est_refine_stack_unlock (rs);
+  }
+  quad->p.user_data = NULL;
+}
+
+static void
+p4est_refine_stack_store (p4est_refine_item_t * item,
+                          const p4est_quadrant_t * q)
+{
+  if (item->count == item->out.elem_count) {
+    /* refinement exceeds the current size of the output */
+    sc_array_resize (&item->out, 2 * item->out.elem_count);
+  }
+  *p4est_quadrant_array_index (&item->out, item->count++) = *q;
+  item->maxlevel = SC_MAX (item->maxlevel, (int) q->level);
+  ++item->quadrants_per_level[q->level];
+}
+
+/** Refine one range of quadrants into the item's output array.
+ * The quadrants are visited in order and refined depth-first, using a
+ * stack in place of the quadrant list of the serial code.  The callbacks
+ * are called in the same order as by the serial code.  The output array
+ * is only created once the first quadrant of the range is refined.
+ */
+static void
+p4est_refine_stack_item (p4est_refine_stack_t * rs,
+                         p4est_refine_item_t * item)
+{
+  const p4est_topidx_t nt = item->which_tree;
+  p4est_t            *p4est = rs->p4est;
+  int                 k, isroot;
+  size_t              iz, sp, num_in, first;
+  sc_array_t         *tquadrants;
+  p4est_quadrant_t   *q, parent, *pp = &parent;
+  p4est_quadrant_t    children[P4EST_CHILDREN];
+  p4est_quadrant_t   *family[P4EST_CHILDREN];
+  p4est_quadrant_t    stack[P4EST_QMAXLEVEL * (P4EST_CHILDREN - 1) + 1];
+
+  tquadrants = &p4est_tree_array_index (p4est->trees, nt)->quadrants;
+  for (k = 0; k < P4EST_CHILDREN; ++k) {
+    family[k] = &children[k];
+  }
+
+  /* run through the range to find the first quadrant to be refined */
+  num_in = item->end - item->begin;
+  q = NULL;
+  for (iz = 0; iz < num_in; ++iz) {
+    q = p4est_quadrant_array_index (tquadrants, item->begin + iz);
+    if (rs->refine_fn (p4est, nt, q) && (int) q->level < rs->allowed_level) {
+      break;
+    }
+    if (rs->mark) {
+      q->pad8 = 0;
+    }
+    item->maxlevel = SC_MAX (item->maxlevel, (int) q->level);
+    ++item->quadrants_per_level[q->level];
+  }
+  if (iz == num_in) {
+    /* no refinement occurs in this range */
+    return;
+  }
+  P4EST_ASSERT (q != NULL);
+
+  /* copy the unrefined quadrants in front and reserve a family more */
+  item->refined = 1;
+  sc_array_resize (&item->out, num_in + P4EST_CHILDREN - 1);
+  memcpy (item->out.array, sc_array_index (tquadrants, item->begin),
+          iz * sizeof (p4est_quadrant_t));
+  item->count = iz;
+
+  /* the quadrant at first is known to be refined */
+  for (first = iz; iz < num_in; ++iz) {
+    q = p4est_quadrant_array_index (tquadrants, item->begin + iz);
+    if (iz > first &&
+        !(rs->refine_fn (p4est, nt, q) &&
+          (int) q->level < rs->allowed_level)) {
+      if (rs->mark) {
+        q->pad8 = 0;
+      }
+      p4est_refine_stack_store (item, q);
+      continue;
+    }
+
+    /* refine depth-first with the first child on top of the stack */
+    stack[0] = *q;
+    sp = 1;
+    isroot = 1;
+    while (sp > 0) {
+      q = &stack[--sp];
+      if (!isroot &&
+          !(rs->refine_recursive && rs->refine_fn (p4est, nt, q) &&
+            (int) q->level < rs->allowed_level)) {
+        p4est_refine_stack_store (item, q);
+        continue;
+      }
+      isroot = 0;
+      parent = *q;
+      p4est_quadrant_childrenv (&parent, children);
+      p4est_refine_stack_family_data (rs, &parent, children);
+      for (k = 0; k < P4EST_CHILDREN; ++k) {
+        children[k].pad8 = 1;
+        if (rs->init_fn != NULL) {
+          rs->init_fn (p4est, nt, &children[k]);
+        }
+      }
+      if (rs->replace_fn != NULL) {
+        rs->replace_fn (p4est, nt, 1, &pp, P4EST_CHILDREN, family);
+        p4est_refine_stack_free_data (rs, &parent);
+      }
+      for (k = 0; k < P4EST_CHILDREN; ++k) {
+        P4EST_ASSERT (sp < sizeof (stack) / sizeof (stack[0]));
+        stack[sp++] = children[P4EST_CHILDREN - 1 - k];
+      }
+    }
+  }
+  sc_array_resize (&item->out, item->count);
+}
+
+#ifdef SC_ENABLE_PTHREAD
+
+static void        *
+p4est_refine_stack_run (void *v)
+{
+  p4est_refine_stack_t *rs = (p4est_refine_stack_t *) v;
+  size_t              iz;
+
+  for (;;) {
+    pthread_mutex_lock (&rs->mutex);
+    iz = rs->next_item++;
+    pthread_mutex_unlock (&rs->mutex);
+    if (iz >= rs->items.elem_count) {
+      return NULL;
+    }
+    p4est_refine_stack_item (rs, (p4est_refine_item_t *)
+                             sc_array_index (&rs->items, iz));
+  }
+}
+
+#endif /* SC_ENABLE_PTHREAD */
+
+/** Refine the local trees without the quadrant list.
+ * Each tree array is split into ranges, one per tree if running on a
+ * single thread, that are refined into new arrays and spliced in order.
+ * Only the tree arrays, their level counts and maxlevel are updated;
+ * the caller takes care of the offsets.  If \a mark is true, the pad8
+ * field is set to 1 for new quadrants and to 0 for all others.
+ */
+static void
+p4est_refine_stack (p4est_t * p4est, int num_threads,
+                    int refine_recursive, int allowed_level,
+                    p4est_refine_t refine_fn, p4est_init_t init_fn,
+                    p4est_replace_t replace_fn, int mark)
+{
+  int                 i;
+  size_t              iz, jz, chunk, count, offset, first_item;
+  p4est_topidx_t      nt;
+  p4est_tree_t       *tree;
+  p4est_refine_item_t *item;
+  p4est_refine_stack_t rs;
+  sc_array_t          newquads;
+#ifdef SC_ENABLE_PTHREAD
+  int                 retval;
+  pthread_t          *threads;
+#else
+  num_threads = 1;
+#endif
+
+  rs.p4est = p4est;
+  rs.refine_recursive = refine_recursive;
+  rs.allowed_level = allowed_level;
+  rs.refine_fn = refine_fn;
+  rs.init_fn = init_fn;
+  rs.replace_fn = replace_fn;
+  rs.mark = mark;
+  rs.num_threads = SC_MAX (num_threads, 1);
+
+  /* with threads, a few ranges per thread balance the uneven refinement */
+  chunk = (size_t) p4est->local_num_quadrants;
+  if (rs.num_threads > 1) {
+    chunk = SC_MAX (chunk / (size_t) (4 * rs.num_threads), (size_t) 64);
+  }
+  sc_array_init (&rs.items, sizeof (p4est_refine_item_t));
+  for (nt = p4est->first_local_tree; nt <= p4est->last_local_tree; ++nt) {
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    count = tree->quadrants.elem_count;
+    for (offset = 0; offset < count; offset += chunk) {
+      item = (p4est_refine_item_t *) sc_array_push (&rs.items);
+      memset (item, 0, sizeof (*item));
+      item->which_tree = nt;
+      item->begin = offset;
+      item->end = SC_MIN (offset + chunk, count);
+      sc_array_init (&item->out, sizeof (p4est_quadrant_t));
+    }
+  }
+
+#ifdef SC_ENABLE_PTHREAD
+  if (rs.num_threads > 1) {
+    rs.next_item = 0;
+    retval = pthread_mutex_init (&rs.mutex, NULL);
+    SC_CHECK_ABORT (retval == 0, "pthread_mutex_init");
+
+    /* the calling thread works as well */
+    threads = P4EST_ALLOC (pthread_t, rs.num_threads - 1);
+    for (i = 0; i < rs.num_threads - 1; ++i) {
+      retval = pthread_create (&threads[i], NULL,
+                               p4est_refine_stack_run, &rs);
+      SC_CHECK_ABORT (retval == 0, "pthread_create");
+    }
+    (void) p4est_refine_stack_run (&rs);
+    for (i = 0; i < rs.num_threads - 1; ++i) {
+      retval = pthread_join (threads[i], NULL);
+      SC_CHECK_ABORT (retval == 0, "pthread_join");
+    }
+    P4EST_FREE (threads);
+    retval = pthread_mutex_destroy (&rs.mutex);
+    SC_CHECK_ABORT (retval == 0, "pthread_mutex_destroy");
+  }
+  else
+#endif
+  {
+    for (iz = 0; iz < rs.items.elem_count; ++iz) {
+      p4est_refine_stack_item (&rs, (p4est_refine_item_t *)
+                               sc_array_index (&rs.items, iz));
+    }
+  }
+
+  /* splice the ranges of each tree in order */
+  for (iz = 0; iz < rs.items.elem_count; iz = jz) {
+    item = (p4est_refine_item_t *) sc_array_index (&rs.items, iz);
+    nt = item->which_tree;
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    tree->maxlevel = 0;
+    for (i = 0; i <= P4EST_QMAXLEVEL; ++i) {
+      tree->quadrants_per_level[i] = 0;
+    }
+    count = 0;
+    first_item = iz;
+    for (jz = iz; jz < rs.items.elem_count; ++jz) {
+      item = (p4est_refine_item_t *) sc_array_index (&rs.items, jz);
+      if (item->which_tree != nt) {
+        break;
+      }
+      for (i = 0; i <= P4EST_QMAXLEVEL; ++i) {
+        tree->quadrants_per_level[i] += item->quadrants_per_level[i];
+      }
+      tree->maxlevel = (int8_t) SC_MAX (tree->maxlevel, item->maxlevel);
+      count += item->refined ? item->count : item->end - item->begin;
+    }
+    if (count == tree->quadrants.elem_count) {
+      /* no refinement occurs in this tree */
+      continue;
+    }
+
+    item = (p4est_refine_item_t *) sc_array_index (&rs.items, first_item);
+    if (jz == first_item + 1) {
+      /* the only range of this tree becomes the tree array */
+      P4EST_ASSERT (item->refined);
+      newquads = item->out;
+      sc_array_init (&item->out, sizeof (p4est_quadrant_t));
+    }
+    else {
+      sc_array_init_size (&newquads, sizeof (p4est_quadrant_t), count);
+      for (offset = 0, iz = first_item; iz < jz; ++iz) {
+        item = (p4est_refine_item_t *) sc_array_index (&rs.items, iz);
+        if (item->refined) {
+          memcpy (sc_array_index (&newquads, offset), item->out.array,
+                  item->count * sizeof (p4est_quadrant_t));
+          offset += item->count;
+        }
+        else {
+          memcpy (sc_array_index (&newquads, offset),
+                  sc_array_index (&tree->quadrants, item->begin),
+                  (item->end - item->begin) * sizeof (p4est_quadrant_t));
+          offset += item->end - item->begin;
+        }
+      }
+      P4EST_ASSERT (offset == count);
+    }
+    sc_array_reset (&tree->quadrants);
+    tree->quadrants = newquads;
+
+    P4EST_ASSERT (p4est_tree_is_sorted (tree));
+    P4EST_ASSERT (p4est_tree_is_complete (tree));
+    P4EST_VERBOSEF ("Done refine tree %lld now %llu\n", (long long) nt,
+                    (unsigned long long) count);
+  }
+  for (iz = 0; iz < rs.items.elem_count; ++iz) {
+    item = (p4est_refine_item_t *) sc_array_index (&rs.items, iz);
+    sc_array_reset (&item->out);
+  }
+  sc_array_reset (&rs.items);
+}
+
 void
 p4est_refine (p4est_t * p4est, int refine_recursive,
               p4est_refine_t refine_fn, p4est_init_t init_fn)
@@ -684,15 +1092,22 @@ p4est_refine (p4est_t * p4est, int refine_recursive,
   p4est_refine_ext (p4est, refine_recursive, -1, refine_fn, init_fn, NULL);
 }
 
-void
-p4est_refine_ext (p4est_t * p4est, int refine_recursive, int allowed_level,
-                  p4est_refine_t refine_fn, p4est_init_t init_fn,
-                  p4est_replace_t replace_fn)
+/** Refine the forest as in \ref p4est_refine_ext.
+ * \param [in] count       If false, do not update the global quadrant
+ *                         counts and the revision.  The caller does so.
+ *                         The pad8 field is then set to 1 for the new
+ *                         quadrants and to 0 for all others.
+ */
+static void
+p4est_refine_internal (p4est_t * p4est, int refine_recursive,
+                       int allowed_level, p4est_refine_t refine_fn,
+                       p4est_init_t init_fn, p4est_replace_t replace_fn,
+                       int count)
 {
 #ifdef P4EST_ENABLE_DEBUG
   size_t              quadrant_pool_size, data_pool_size;
 #endif
-  int                 firsttime;
+  int                 firsttime, stacked;
   int                 i, maxlevel;
   p4est_topidx_t      nt;
   p4est_gloidx_t      old_gnq;
@@ -733,6 +1148,14 @@ p4est_refine_ext (p4est_t * p4est, int refine_recursive, int allowed_level,
      The quadrant->pad8 field of list quadrants is interpreted as boolean
      and set to true for quadrants that have already been refined.
    */
+  stacked = 0;
+  if (p4est->inspect != NULL && (p4est->inspect->use_refine_stack ||
+                                 p4est->inspect->refine_num_threads > 1)) {
+    p4est_refine_stack (p4est, p4est->inspect->refine_num_threads,
+                        refine_recursive, allowed_level,
+                        refine_fn, init_fn, replace_fn, !count);
+    stacked = 1;
+  }
   list = sc_list_new (NULL);
   p4est->local_num_quadrants = 0;
 
@@ -741,6 +1164,11 @@ p4est_refine_ext (p4est_t * p4est, int refine_recursive, int allowed_level,
     tree = p4est_tree_array_index (p4est->trees, nt);
     tree->quadrants_offset = p4est->local_num_quadrants;
     tquadrants = &tree->quadrants;
+    if (stacked) {
+      /* this tree has been refined without the list already */
+      p4est->local_num_quadrants += tquadrants->elem_count;
+      continue;
+    }
 #ifdef P4EST_ENABLE_DEBUG
     quadrant_pool_size = p4est->quadrant_pool->elem_count;
     data_pool_size = 0;
@@ -767,6 +1195,9 @@ p4est_refine_ext (p4est_t * p4est, int refine_recursive, int allowed_level,
       if (refine_fn (p4est, nt, q) && (int) q->level < allowed_level) {
         break;
       }
+      if (!count) {
+        q->pad8 = 0;
+      }
       maxlevel = SC_MAX (maxlevel, (int) q->level);
       ++tree->quadrants_per_level[q->level];
     }
@@ -917,6 +1348,14 @@ p4est_refine_ext (p4est_t * p4est, int refine_recursive, int allowed_level,
 
   sc_list_destroy (list);
 
+  if (!count) {
+    /* the global counts are left to the caller */
+    P4EST_ASSERT (p4est_is_valid (p4est));
+    p4est_log_indent_pop ();
+    P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_refine uncounted\n");
+    return;
+  }
+
   /* compute global number of quadrants */
   p4est_comm_count_quadrants (p4est);
   P4EST_ASSERT (p4est->global_num_quadrants >= old_gnq);
@@ -931,6 +1370,15 @@ p4est_refine_ext (p4est_t * p4est, int refine_recursive, int allowed_level,
                             (long long) p4est->global_num_quadrants);
 }
 
+void
+p4est_refine_ext (p4est_t * p4est, int refine_recursive, int allowed_level,
+                  p4est_refine_t refine_fn, p4est_init_t init_fn,
+                  p4est_replace_t replace_fn)
+{
+  p4est_refine_internal (p4est, refine_recursive, allowed_level,
+                         refine_fn, init_fn, replace_fn, 1);
+}
+
 void
 p4est_coarsen (p4est_t * p4est, int coarsen_recursive,
                p4est_coarsen_t coarsen_fn, p4est_init_t init_fn)
@@ -938,11 +1386,17 @@ p4est_coarsen (p4est_t * p4est, int coarsen_recursive,
   p4est_coarsen_ext (p4est, coarsen_recursive, 0, coarsen_fn, init_fn, NULL);
 }
 
-void
-p4est_coarsen_ext (p4est_t * p4est,
-                   int coarsen_recursive, int callback_orphans,
-                   p4est_coarsen_t coarsen_fn, p4est_init_t init_fn,
-                   p4est_replace_t replace_fn)
+/** Coarsen the forest as in \ref p4est_coarsen_ext.
+ * \param [in] count       If false, do not update the global quadrant
+ *                         counts and the revision.  The caller does so.
+ *                         The pad8 field of the new parents is then set
+ *                         to 1; the other quadrants keep theirs.
+ */
+static void
+p4est_coarsen_internal (p4est_t * p4est,
+                        int coarsen_recursive, int callback_orphans,
+                        p4est_coarsen_t coarsen_fn, p4est_init_t init_fn,
+                        p4est_replace_t replace_fn, int count)
 {
 #ifdef P4EST_ENABLE_DEBUG
   size_t              data_pool_size;
@@ -1036,6 +1490,9 @@ p4est_coarsen_ext (p4est_t * p4est,
         }
         p4est_quadrant_parent (c[0], cfirst);
         p4est_quadrant_init_data (p4est, jt, cfirst, init_fn);
+        if (!count) {
+          cfirst->pad8 = 1;
+        }
         tree->quadrants_per_level[cfirst->level] += 1;
         p4est->local_num_quadrants -= P4EST_CHILDREN - 1;
         removed += P4EST_CHILDREN - 1;
@@ -1122,6 +1579,14 @@ p4est_coarsen_ext (p4est_t * p4est,
     }
   }
 
+  if (!count) {
+    /* the global counts are left to the caller */
+    P4EST_ASSERT (p4est_is_valid (p4est));
+    p4est_log_indent_pop ();
+    P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_coarsen uncounted\n");
+    return;
+  }
+
   /* compute global number of quadrants */
   p4est_comm_count_quadrants (p4est);
   P4EST_ASSERT (p4est->global_num_quadrants <= old_gnq);
@@ -1136,6 +1601,211 @@ p4est_coarsen_ext (p4est_t * p4est,
                             (long long) p4est->global_num_quadrants);
 }
 
+void
+p4est_coarsen_ext (p4est_t * p4est,
+                   int coarsen_recursive, int callback_orphans,
+                   p4est_coarsen_t coarsen_fn, p4est_init_t init_fn,
+                   p4est_replace_t replace_fn)
+{
+  p4est_coarsen_internal (p4est, coarsen_recursive, callback_orphans,
+                          coarsen_fn, init_fn, replace_fn, 1);
+}
+
+/** Refine and coarsen the local quadrants by markers in one linear pass.
+ * Positive markers are ignored unless \a do_refine is true,
+ * negative markers are ignored unless \a do_coarsen is true.
+ */
+static void
+p4est_adapt_flags_internal (p4est_t * p4est, const char *name,
+                            int do_refine, int do_coarsen, int8_t * flags,
+                            p4est_init_t init_fn,
+                            p4est_locidx_t * old_to_new)
+{
+  int                 i, k, maxlevel, isfamily;
+  int                 changed, gchanged, tree_changed, mpiret;
+  size_t              zz, jz, incount, outcount;
+  p4est_locidx_t      lin, lout;
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q, *r, *c[P4EST_CHILDREN];
+  sc_array_t         *tquadrants, newquads;
+
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING
+                            "_%s with %lld total quadrants\n", name,
+                            (long long) p4est->global_num_quadrants);
+  p4est_log_indent_push ();
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (flags != NULL || p4est->local_num_quadrants == 0);
+
+  /* loop over all local trees */
+  changed = 0;
+  lin = lout = 0;
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tquadrants = &tree->quadrants;
+    tree->quadrants_offset = lout;
+    incount = tquadrants->elem_count;
+
+    /* first pass: decide on the flags and count the output */
+    tree_changed = 0;
+    outcount = 0;
+    for (zz = 0; zz < incount;) {
+      q = p4est_quadrant_array_index (tquadrants, zz);
+      if (do_refine && flags[lin + zz] > 0 &&
+          (int) q->level < P4EST_QMAXLEVEL) {
+        flags[lin + zz] = 1;
+        outcount += P4EST_CHILDREN;
+        tree_changed = 1;
+        ++zz;
+        continue;
+      }
+      isfamily = 0;
+      if (do_coarsen && flags[lin + zz] < 0 &&
+          zz + P4EST_CHILDREN <= incount) {
+        isfamily = 1;
+        for (k = 0; k < P4EST_CHILDREN; ++k) {
+          c[k] = q + k;
+          if (flags[lin + zz + k] >= 0) {
+            isfamily = 0;
+          }
+        }
+        isfamily = isfamily && p4est_quadrant_is_familypv (c);
+      }
+      if (isfamily) {
+        for (k = 0; k < P4EST_CHILDREN; ++k) {
+          flags[lin + zz + k] = -1;
+        }
+        ++outcount;
+        tree_changed = 1;
+        zz += P4EST_CHILDREN;
+        continue;
+      }
+      flags[lin + zz] = 0;
+      ++outcount;
+      ++zz;
+    }
+    if (!tree_changed) {
+      if (old_to_new != NULL) {
+        for (zz = 0; zz < incount; ++zz) {
+          old_to_new[lin + zz] = lout + (p4est_locidx_t) zz;
+        }
+      }
+      lin += (p4est_locidx_t) incount;
+      lout += (p4est_locidx_t) incount;
+      continue;
+    }
+    changed = 1;
+
+    /* second pass: write the new quadrants into a fresh array */
+    sc_array_init_size (&newquads, sizeof (p4est_quadrant_t), outcount);
+    for (zz = 0, jz = 0; zz < incount;) {
+      q = p4est_quadrant_array_index (tquadrants, zz);
+      r = p4est_quadrant_array_index (&newquads, jz);
+      if (flags[lin + zz] > 0) {
+        if (old_to_new != NULL) {
+          old_to_new[lin + zz] = lout + (p4est_locidx_t) jz;
+        }
+        p4est_quadrant_childrenv (q, r);
+        p4est_quadrant_free_data (p4est, q);
+        for (k = 0; k < P4EST_CHILDREN; ++k) {
+          p4est_quadrant_init_data (p4est, jt, r + k, init_fn);
+        }
+        jz += P4EST_CHILDREN;
+        ++zz;
+      }
+      else if (flags[lin + zz] < 0) {
+        p4est_quadrant_parent (q, r);
+        for (k = 0; k < P4EST_CHILDREN; ++k) {
+          if (old_to_new != NULL) {
+            old_to_new[lin + zz + k] = lout + (p4est_locidx_t) jz;
+          }
+          p4est_quadrant_free_data (p4est, q + k);
+        }
+        p4est_quadrant_init_data (p4est, jt, r, init_fn);
+        ++jz;
+        zz += P4EST_CHILDREN;
+      }
+      else {
+        if (old_to_new != NULL) {
+          old_to_new[lin + zz] = lout + (p4est_locidx_t) jz;
+        }
+        *r = *q;
+        ++jz;
+        ++zz;
+      }
+    }
+    P4EST_ASSERT (jz == outcount);
+    sc_array_reset (tquadrants);
+    *tquadrants = newquads;
+
+    /* update level counters */
+    maxlevel = 0;
+    for (i = 0; i <= P4EST_QMAXLEVEL; ++i) {
+      tree->quadrants_per_level[i] = 0;
+    }
+    for (zz = 0; zz < outcount; ++zz) {
+      q = p4est_quadrant_array_index (tquadrants, zz);
+      ++tree->quadrants_per_level[q->level];
+      maxlevel = SC_MAX (maxlevel, (int) q->level);
+    }
+    tree->maxlevel = (int8_t) maxlevel;
+
+    P4EST_ASSERT (p4est_tree_is_sorted (tree));
+    P4EST_ASSERT (p4est_tree_is_complete (tree));
+    P4EST_VERBOSEF ("Done %s tree %lld now %llu\n", name, (long long) jt,
+                    (unsigned long long) outcount);
+    lin += (p4est_locidx_t) incount;
+    lout += (p4est_locidx_t) outcount;
+  }
+  P4EST_ASSERT (lin == p4est->local_num_quadrants);
+  p4est->local_num_quadrants = lout;
+  if (p4est->last_local_tree >= 0) {
+    for (; jt < p4est->connectivity->num_trees; ++jt) {
+      tree = p4est_tree_array_index (p4est->trees, jt);
+      tree->quadrants_offset = p4est->local_num_quadrants;
+    }
+  }
+
+  /* compute global number of quadrants */
+  p4est_comm_count_quadrants (p4est);
+  mpiret = sc_MPI_Allreduce (&changed, &gchanged, 1, sc_MPI_INT,
+                             sc_MPI_MAX, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  if (gchanged) {
+    ++p4est->revision;
+  }
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING
+                            "_%s with %lld total quadrants\n", name,
+                            (long long) p4est->global_num_quadrants);
+}
+
+void
+p4est_refine_flags (p4est_t * p4est, int8_t * flags,
+                    p4est_init_t init_fn, p4est_locidx_t * old_to_new)
+{
+  p4est_adapt_flags_internal (p4est, "refine_flags", 1, 0,
+                              flags, init_fn, old_to_new);
+}
+
+void
+p4est_coarsen_flags (p4est_t * p4est, int8_t * flags,
+                     p4est_init_t init_fn, p4est_locidx_t * old_to_new)
+{
+  p4est_adapt_flags_internal (p4est, "coarsen_flags", 0, 1,
+                              flags, init_fn, old_to_new);
+}
+
+void
+p4est_adapt_flags (p4est_t * p4est, int8_t * flags,
+                   p4est_init_t init_fn, p4est_locidx_t * old_to_new)
+{
+  p4est_adapt_flags_internal (p4est, "adapt_flags", 1, 1,
+                              flags, init_fn, old_to_new);
+}
+
 /** Check if the insulation layer of a quadrant overlaps anybody.
  * If yes, the quadrant itself is scheduled for sending.
  * Both quadrants are in the receiving tree's coordinates.
@@ -1143,6 +1813,8 @@ p4est_coarsen_ext (p4est_t * p4est,
  * \param [in]  inter_tree  Boolean flag to specify inter-tree communication.
  * \param [in]  q           The quadrant to be sent if there is overlap.
  * \param [in]  insul       An insulation quadrant of \a q.
+ * \param [in]  peer_changed    If not NULL, \a q is only sent to the
+ *                              processes for which this flag is set.
  * \param [in,out]  first_peer  Lowest peer, will be updated.
  * \param [in,out]  last_peer   Highest peer, will be updated.
  */
@@ -1151,6 +1823,7 @@ p4est_balance_schedule (p4est_t * p4est, p4est_balance_peer_t * peers,
                         p4est_topidx_t qtree, int inter_tree,
                         const p4est_quadrant_t * q,
                         const p4est_quadrant_t * insul,
+                        const int8_t * peer_changed,
                         int *first_peer, int *last_peer)
 {
   const int           rank = p4est->mpirank;
@@ -1179,6 +1852,10 @@ p4est_balance_schedule (p4est_t * p4est, p4est_balance_peer_t * peers,
       /* do not send to empty processors */
       continue;
     }
+    if (peer_changed != NULL && !peer_changed[owner]) {
+      /* an unchanged quadrant cannot affect an unchanged processor */
+      continue;
+    }
     peer = peers + owner;
     /* avoid duplicates in the send array */
     found = 0;
@@ -1245,9 +1922,59 @@ p4est_balance (p4est_t * p4est, p4est_connect_type_t btype,
   p4est_balance_ext (p4est, btype, init_fn, NULL);
 }
 
-void
-p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
-                   p4est_init_t init_fn, p4est_replace_t replace_fn)
+/** Mark the quadrants of a tree that are not in the old forest.
+ * \param [in] quadrants   The quadrants of the tree after local balance.
+ * \param [in] before      The quadrants of the tree before local balance,
+ *                         empty if the tree has not been changed.
+ *                         The local balance has only refined them.
+ * \param [in] changed     The change mask for the quadrants in \a before.
+ * \param [out] flags      For each of \a quadrants, 1 if it is new since the
+ *                         old forest and 0 otherwise.
+ */
+static void
+p4est_balance_changed_flags (sc_array_t * quadrants, sc_array_t * before,
+                             const int8_t * changed, int8_t * flags)
+{
+  size_t              zz, iz;
+  p4est_quadrant_t   *q, *o;
+
+  if (before->elem_count == 0) {
+    /* the tree has not been changed */
+    memset (flags, 0, quadrants->elem_count * sizeof (int8_t));
+    return;
+  }
+
+  iz = 0;
+  for (zz = 0; zz < quadrants->elem_count; ++zz) {
+    q = p4est_quadrant_array_index (quadrants, zz);
+    P4EST_ASSERT (iz < before->elem_count);
+    o = p4est_quadrant_array_index (before, iz);
+    while (!p4est_quadrant_is_equal (o, q) &&
+           !p4est_quadrant_is_ancestor (o, q)) {
+      ++iz;
+      P4EST_ASSERT (iz < before->elem_count);
+      o = p4est_quadrant_array_index (before, iz);
+    }
+    if (p4est_quadrant_is_equal (o, q)) {
+      flags[zz] = (int8_t) (changed[iz] != 0);
+      ++iz;
+    }
+    else {
+      /* this quadrant has been created by the local balance */
+      flags[zz] = 1;
+    }
+  }
+}
+
+/** Balance the forest as in \ref p4est_balance_changed.
+ * \param [in] counted     If false, the global quadrant counts are out of
+ *                         date after local refinement and coarsening and
+ *                         \a changed must not be NULL.
+ */
+static void
+p4est_balance_internal (p4est_t * p4est, p4est_connect_type_t btype,
+                        const int8_t * changed, int counted,
+                        p4est_init_t init_fn, p4est_replace_t replace_fn)
 {
   const int           rank = p4est->mpirank;
   const int           num_procs = p4est->mpisize;
@@ -1257,7 +1984,12 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
   int                 quad_contact[P4EST_FACES];
   int                 any_face, tree_contact[P4EST_FACES];
   int                 tree_fully_owned, full_tree[2];
+  int                 num_threads;
+  int                 mpiret;
   int8_t             *tree_flags;
+  int8_t              local_changed, any_changed;
+  int8_t             *peer_changed, *qflags;
+  const int8_t       *qpeers;
   size_t              zz, treecount, ctree;
   size_t              localcount;
   size_t              qcount, qbytes;
@@ -1275,7 +2007,8 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
   p4est_quadrant_t   *q, *s;
   p4est_connectivity_t *conn = p4est->connectivity;
   sc_array_t         *qarray, *tquadrants;
-  sc_array_t         *borders;
+  sc_array_t         *borders, *which_trees, *snapshots;
+  p4est_locidx_t      il;
 #ifdef P4EST_ENABLE_DEBUG
   size_t              data_pool_size;
 #endif
@@ -1301,7 +2034,7 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
   p4est_gloidx_t      ltotal[2], gtotal[2];
 #endif /* P4EST_ENABLE_DEBUG */
   int                 i;
-  int                 mpiret, rcount;
+  int                 rcount;
   int                 first_bound;
   int                 request_first_count, request_second_count, outcount;
   int                 request_send_count, total_send_count, total_recv_count;
@@ -1340,8 +2073,46 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
 #endif
 
   /* remember input quadrant count; it will not decrease */
+  P4EST_ASSERT (counted || changed != NULL);
   old_gnq = p4est->global_num_quadrants;
 
+  /* with a change mask, find out which processes have changed quadrants;
+   * without counts the caller saves collectives, so we skip this one and
+   * send the unchanged border quadrants to all peers */
+  peer_changed = NULL;
+  if (changed != NULL && counted) {
+    local_changed = 0;
+    for (il = 0; il < p4est->local_num_quadrants; ++il) {
+      if (changed[il]) {
+        local_changed = 1;
+        break;
+      }
+    }
+    peer_changed = P4EST_ALLOC (int8_t, num_procs);
+    mpiret = sc_MPI_Allgather (&local_changed, 1, sc_MPI_BYTE,
+                               peer_changed, 1, sc_MPI_BYTE, p4est->mpicomm);
+    SC_CHECK_MPI (mpiret);
+    any_changed = 0;
+    for (j = 0; j < num_procs; ++j) {
+      any_changed = any_changed || peer_changed[j];
+    }
+    if (!any_changed) {
+      /* the forest is still balanced */
+      P4EST_FREE (peer_changed);
+      if (p4est->inspect != NULL) {
+        p4est->inspect->balance_A = 0.;
+        p4est->inspect->balance_comm = 0.;
+        p4est->inspect->balance_B = 0.;
+        p4est->inspect->use_B = 0;
+      }
+      P4EST_ASSERT (p4est_is_balanced (p4est, btype));
+      p4est_log_indent_pop ();
+      P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING
+                               "_balance without changes\n");
+      return;
+    }
+  }
+
 #ifdef P4EST_ENABLE_DEBUG
   data_pool_size = 0;
   if (p4est->user_data_pool != NULL) {
@@ -1369,6 +2140,25 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
     sc_array_init (qarray, sizeof (p4est_quadrant_t));
   }
 
+  /* remember the quadrants of the changed trees before local balance */
+  snapshots = NULL;
+  if (changed != NULL) {
+    snapshots = sc_array_new_size (sizeof (sc_array_t), localcount);
+    for (zz = 0; zz < localcount; zz++) {
+      qarray = (sc_array_t *) sc_array_index (snapshots, zz);
+      sc_array_init (qarray, sizeof (p4est_quadrant_t));
+      nt = p4est->first_local_tree + (p4est_topidx_t) zz;
+      tree = p4est_tree_array_index (p4est->trees, nt);
+      for (ctree = 0; ctree < tree->quadrants.elem_count; ++ctree) {
+        if (changed[tree->quadrants_offset + (p4est_locidx_t) ctree]) {
+          tree_flags[nt] |= changed_flag;
+          sc_array_copy (qarray, &tree->quadrants);
+          break;
+        }
+      }
+    }
+  }
+
 #ifdef P4EST_ENABLE_MPI
   requests_first = P4EST_ALLOC (MPI_Request, 6 * num_procs);
   requests_second = requests_first + 1 * num_procs;
@@ -1427,19 +2217,39 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
   nextlow.level = P4EST_QMAXLEVEL;
 
   /* start balance_A timing */
+  num_threads = 1;
   if (p4est->inspect != NULL) {
     p4est->inspect->balance_A = -sc_MPI_Wtime ();
     p4est->inspect->balance_A_count_in = 0;
     p4est->inspect->balance_A_count_out = 0;
+    p4est->inspect->balance_A_local = 0.;
+    p4est->inspect->balance_B_local = 0.;
     p4est->inspect->use_B = 0;
+    num_threads = SC_MAX (p4est->inspect->balance_num_threads, 1);
   }
 
-  /* loop over all local trees to assemble first send list */
+  /* the local balance of the trees may run on threads up front */
   first_tree = p4est->first_local_tree;
   last_tree = p4est->last_local_tree;
+  which_trees = sc_array_new (sizeof (p4est_topidx_t));
+  all_incount = 0;
+  if (num_threads > 1) {
+    for (nt = first_tree; nt <= last_tree; ++nt) {
+      tree = p4est_tree_array_index (p4est->trees, nt);
+      all_incount += tree->quadrants.elem_count;
+      if (changed == NULL || (tree_flags[nt] & changed_flag)) {
+        *(p4est_topidx_t *) sc_array_push (which_trees) = nt;
+      }
+    }
+    p4est->inspect->balance_A_local = -sc_MPI_Wtime ();
+    p4est_balance_trees (p4est, btype, num_threads, which_trees,
+                         init_fn, replace_fn, NULL);
+    p4est->inspect->balance_A_local += sc_MPI_Wtime ();
+  }
+
+  /* loop over all local trees to assemble first send list */
   first_peer = num_procs;
   last_peer = -1;
-  all_incount = 0;
   skipped = 0;
   for (nt = first_tree; nt <= last_tree; ++nt) {
     p4est_comm_tree_info (p4est, nt, full_tree, tree_contact, NULL, NULL);
@@ -1453,14 +2263,23 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
     }
     tree = p4est_tree_array_index (p4est->trees, nt);
     tquadrants = &tree->quadrants;
-    all_incount += tquadrants->elem_count;
 
-    /* initial log message for this tree */
-    P4EST_VERBOSEF ("Into balance tree %lld with %llu\n", (long long) nt,
-                    (unsigned long long) tquadrants->elem_count);
-
-    /* local balance first pass */
-    p4est_balance_subtree_ext (p4est, btype, nt, init_fn, replace_fn);
+    /* local balance first pass; an unchanged tree is still balanced */
+    if (num_threads == 1) {
+      all_incount += tquadrants->elem_count;
+    }
+    if (num_threads == 1 &&
+        (changed == NULL || (tree_flags[nt] & changed_flag))) {
+      P4EST_VERBOSEF ("Into balance tree %lld with %llu\n", (long long) nt,
+                      (unsigned long long) tquadrants->elem_count);
+      if (p4est->inspect != NULL) {
+        p4est->inspect->balance_A_local -= sc_MPI_Wtime ();
+      }
+      p4est_balance_subtree_ext (p4est, btype, nt, init_fn, replace_fn);
+      if (p4est->inspect != NULL) {
+        p4est->inspect->balance_A_local += sc_MPI_Wtime ();
+      }
+    }
     treecount = tquadrants->elem_count;
     P4EST_VERBOSEF ("Balance tree %lld A %llu\n",
                     (long long) nt, (unsigned long long) treecount);
@@ -1483,6 +2302,16 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
       qarray = NULL;
     }
 
+    /* unchanged quadrants only need to go to processors with changes */
+    qflags = NULL;
+    if (changed != NULL) {
+      qflags = P4EST_ALLOC (int8_t, treecount);
+      p4est_balance_changed_flags
+        (tquadrants, (sc_array_t *) sc_array_index (snapshots, (size_t)
+                                                    (nt - first_tree)),
+         changed + tree->quadrants_offset, qflags);
+    }
+
     /* identify boundary quadrants and prepare them to be sent */
     for (zz = 0; zz < treecount; ++zz) {
       /* this quadrant may be on the boundary with a range of processors */
@@ -1494,6 +2323,7 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
         ++skipped;
         continue;
       }
+      qpeers = (qflags == NULL || qflags[zz]) ? NULL : peer_changed;
 
       if (qarray != NULL) {
         (void) p4est_quadrant_array_push_copy (qarray, q);
@@ -1582,7 +2412,7 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
                 tosend.pad16 = face;
                 p4est_quadrant_transform_face (&insulq, &tempq, ftransform);
                 p4est_balance_schedule (p4est, peers, qtree, 1,
-                                        &tosend, &tempq,
+                                        &tosend, &tempq, qpeers,
                                         &first_peer, &last_peer);
               }
               else {
@@ -1603,7 +2433,7 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
                 tosend.pad16 = edge;
                 p8est_quadrant_transform_edge (&insulq, &tempq, &ei, et, 1);
                 p4est_balance_schedule (p4est, peers, et->ntree, 1,
-                                        &tosend, &tempq,
+                                        &tosend, &tempq, qpeers,
                                         &first_peer, &last_peer);
               }
             }
@@ -1631,7 +2461,8 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
                 p4est_quadrant_transform_corner (&tempq, (int) ct->ncorner,
                                                  1);
                 p4est_balance_schedule (p4est, peers, ct->ntree, 1,
-                                        &tosend, &tempq, &first_peer,
+                                        &tosend, &tempq, qpeers,
+                                        &first_peer,
                                         &last_peer);
               }
             }
@@ -1642,7 +2473,7 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
             tosend.p.piggy2.from_tree = nt;
             tosend.pad16 = -1;
             p4est_balance_schedule (p4est, peers, nt, 0,
-                                    &tosend, &insulq, &first_peer,
+                                    &tosend, &insulq, qpeers, &first_peer,
                                     &last_peer);
           }
         }
@@ -1654,6 +2485,7 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
       }
 #endif
     }
+    P4EST_FREE (qflags);
     tquadrants = NULL;          /* safeguard */
   }
 
@@ -1966,7 +2798,7 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
 
     /* sort and send the actual quadrants and post receive for reply */
     if (qcount > 0) {
-      sc_array_sort (&peer->send_first, p4est_quadrant_compare_piggy);
+      p4est_quadrant_array_sort_piggy (&peer->send_first);
 
 #ifdef P4EST_ENABLE_DEBUG
       checksum = p4est_quadrant_checksum (&peer->send_first, &checkarray, 0);
@@ -2126,7 +2958,7 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
 
   /* simulate send and receive with myself across tree boundaries */
   peer = peers + rank;
-  sc_array_sort (&peer->send_first, p4est_quadrant_compare_piggy);
+  p4est_quadrant_array_sort_piggy (&peer->send_first);
   qcount = peer->send_first.elem_count;
   peer->recv_first_count = peer->send_first_count = (int) qcount;
   qbytes = qcount * sizeof (p4est_quadrant_t);
@@ -2288,6 +3120,7 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
         /* this is a corner/edge quadrant from the second pass of balance */
         continue;
       }
+      tree_flags[qtree] |= received_flag;
       if (borders == NULL) {
         tree = p4est_tree_array_index (p4est->trees, qtree);
         q = p4est_quadrant_array_push_copy (&tree->quadrants, s);
@@ -2305,23 +3138,33 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
   }
 
   /* rebalance and clamp result back to original tree boundaries */
+  sc_array_resize (which_trees, 0);
+  for (nt = first_tree; nt <= last_tree; ++nt) {
+    if ((!(tree_flags[nt] & fully_owned_flag) ||
+         (tree_flags[nt] & any_face_flag)) &&
+        (changed == NULL || (tree_flags[nt] & received_flag))) {
+      /* we have most probably received quadrants, run sort and balance */
+      *(p4est_topidx_t *) sc_array_push (which_trees) = nt;
+    }
+  }
+  if (p4est->inspect != NULL) {
+    p4est->inspect->balance_B_local = -sc_MPI_Wtime ();
+  }
+  /* balance the border, add it back into the tree, and linearize */
+  p4est_balance_trees (p4est, btype, num_threads, which_trees,
+                       init_fn, replace_fn, borders);
+  if (p4est->inspect != NULL) {
+    p4est->inspect->balance_B_local += sc_MPI_Wtime ();
+  }
+  sc_array_destroy (which_trees);
   p4est->local_num_quadrants = 0;
   for (nt = first_tree; nt <= last_tree; ++nt) {
-    /* check if we are the only processor in an isolated tree */
     tree = p4est_tree_array_index (p4est->trees, nt);
     tree->quadrants_offset = p4est->local_num_quadrants;
     tquadrants = &tree->quadrants;
-    treecount = tquadrants->elem_count;
-    if (!(tree_flags[nt] & fully_owned_flag) ||
-        (tree_flags[nt] & any_face_flag)) {
-      /* we have most probably received quadrants, run sort and balance */
-      /* balance the border, add it back into the tree, and linearize */
-      p4est_balance_border (p4est, btype, nt, init_fn, replace_fn, borders);
-      P4EST_VERBOSEF ("Balance tree %lld B %llu to %llu\n",
-                      (long long) nt,
-                      (unsigned long long) treecount,
-                      (unsigned long long) tquadrants->elem_count);
-    }
+    P4EST_VERBOSEF ("Balance tree %lld B now %llu\n",
+                    (long long) nt,
+                    (unsigned long long) tquadrants->elem_count);
     p4est->local_num_quadrants += tquadrants->elem_count;
     tquadrants = NULL;          /* safeguard */
   }
@@ -2370,62 +3213,489 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
                     (unsigned long long) tree->quadrants.elem_count);
   }
 
-  /* cleanup temporary storage */
-  P4EST_FREE (tree_flags);
-  for (j = 0; j < num_procs; ++j) {
-    peer = peers + j;
-    sc_array_reset (&peer->send_first);
-    sc_array_reset (&peer->send_second);
-    sc_array_reset (&peer->recv_first);
-    sc_array_reset (&peer->recv_second);
+  /* cleanup temporary storage */
+  P4EST_FREE (tree_flags);
+  for (j = 0; j < num_procs; ++j) {
+    peer = peers + j;
+    sc_array_reset (&peer->send_first);
+    sc_array_reset (&peer->send_second);
+    sc_array_reset (&peer->recv_first);
+    sc_array_reset (&peer->recv_second);
+  }
+  P4EST_FREE (peers);
+
+  if (borders != NULL) {
+    for (zz = 0; zz < localcount; zz++) {
+      qarray = (sc_array_t *) sc_array_index (borders, zz);
+      sc_array_reset (qarray);
+    }
+    sc_array_destroy (borders);
+  }
+  if (snapshots != NULL) {
+    for (zz = 0; zz < localcount; zz++) {
+      qarray = (sc_array_t *) sc_array_index (snapshots, zz);
+      sc_array_reset (qarray);
+    }
+    sc_array_destroy (snapshots);
+  }
+  P4EST_FREE (peer_changed);
+
+#ifdef P4_TO_P8
+  sc_array_reset (eta);
+#endif
+  sc_array_reset (cta);
+
+#ifdef P4EST_ENABLE_MPI
+  P4EST_FREE (requests_first);  /* includes allocation for requests_second */
+  P4EST_FREE (recv_statuses);
+  P4EST_FREE (wait_indices);
+#ifdef P4EST_ENABLE_DEBUG
+  sc_array_reset (&checkarray);
+#endif /* P4EST_ENABLE_DEBUG */
+#endif /* P4EST_ENABLE_MPI */
+
+  /* compute global number of quadrants */
+  p4est_comm_count_quadrants (p4est);
+  if (counted) {
+    P4EST_ASSERT (p4est->global_num_quadrants >= old_gnq);
+    if (old_gnq != p4est->global_num_quadrants) {
+      ++p4est->revision;
+    }
+  }
+  else {
+    /* the forest has been changed by the caller */
+    ++p4est->revision;
+  }
+
+  /* some sanity checks */
+  P4EST_ASSERT ((p4est_locidx_t) all_outcount == p4est->local_num_quadrants);
+  P4EST_ASSERT (all_outcount >= all_incount);
+  if (p4est->user_data_pool != NULL) {
+    P4EST_ASSERT (data_pool_size + all_outcount - all_incount ==
+                  p4est->user_data_pool->elem_count);
+  }
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (p4est_is_balanced (p4est, btype));
+  P4EST_VERBOSEF ("Balance skipped %lld\n", (long long) skipped);
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING
+                            "_balance with %lld total quadrants\n",
+                            (long long) p4est->global_num_quadrants);
+}
+
+void
+p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
+                   p4est_init_t init_fn, p4est_replace_t replace_fn)
+{
+  p4est_balance_internal (p4est, btype, NULL, 1, init_fn, replace_fn);
+}
+
+void
+p4est_balance_changed (p4est_t * p4est, p4est_connect_type_t btype,
+                       const int8_t * changed,
+                       p4est_init_t init_fn, p4est_replace_t replace_fn)
+{
+  p4est_balance_internal (p4est, btype, changed, 1, init_fn, replace_fn);
+}
+
+p4est_gloidx_t
+p4est_adapt (p4est_t * p4est, int refine_recursive, int allowed_level,
+             p4est_refine_t refine_fn, int coarsen_recursive,
+             p4est_coarsen_t coarsen_fn, p4est_connect_type_t btype,
+             int partition_for_coarsening, p4est_weight_t weight_fn,
+             p4est_init_t init_fn, p4est_replace_t replace_fn)
+{
+  size_t              zz;
+  int8_t             *changed;
+  p4est_locidx_t      il;
+  p4est_topidx_t      jt;
+  p4est_gloidx_t      global_shipped;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+  p4est_inspect_t    *inspect = p4est->inspect;
+
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING
+                            "_adapt with %lld total quadrants\n",
+                            (long long) p4est->global_num_quadrants);
+  p4est_log_indent_push ();
+  P4EST_ASSERT (p4est_is_balanced (p4est, btype));
+
+  /* refine and coarsen locally without counting the quadrants in between;
+   * this preserves the partition boundaries and empty processes.
+   * Both mark the quadrants they create in the pad8 field */
+  if (inspect != NULL) {
+    inspect->adapt_refine = -sc_MPI_Wtime ();
+  }
+  if (refine_fn != NULL) {
+    p4est_refine_internal (p4est, refine_recursive, allowed_level,
+                           refine_fn, init_fn, replace_fn, 0);
+  }
+  else {
+    /* refinement would have cleared the marks */
+    for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+      tree = p4est_tree_array_index (p4est->trees, jt);
+      for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+        p4est_quadrant_array_index (&tree->quadrants, zz)->pad8 = 0;
+      }
+    }
+  }
+  if (inspect != NULL) {
+    inspect->adapt_refine += sc_MPI_Wtime ();
+    inspect->adapt_coarsen = -sc_MPI_Wtime ();
+  }
+  if (coarsen_fn != NULL) {
+    p4est_coarsen_internal (p4est, coarsen_recursive, 0,
+                            coarsen_fn, init_fn, replace_fn, 0);
+  }
+  if (inspect != NULL) {
+    inspect->adapt_coarsen += sc_MPI_Wtime ();
+    inspect->adapt_balance = -sc_MPI_Wtime ();
+  }
+
+  /* collect and clear the marks and balance; this counts the quadrants */
+  changed = P4EST_ALLOC (int8_t, p4est->local_num_quadrants);
+  il = 0;
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz, ++il) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      changed[il] = q->pad8;
+      q->pad8 = 0;
+    }
+  }
+  P4EST_ASSERT (il == p4est->local_num_quadrants);
+  p4est_balance_internal (p4est, btype, changed, 0, init_fn, replace_fn);
+  P4EST_FREE (changed);
+  if (inspect != NULL) {
+    inspect->adapt_balance += sc_MPI_Wtime ();
+    inspect->adapt_partition = -sc_MPI_Wtime ();
+  }
+
+  /* partition with the counts computed by balance */
+  global_shipped = p4est_partition_ext (p4est, partition_for_coarsening,
+                                        weight_fn);
+  if (inspect != NULL) {
+    inspect->adapt_partition += sc_MPI_Wtime ();
+  }
+
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING
+                            "_adapt with %lld total quadrants\n",
+                            (long long) p4est->global_num_quadrants);
+  return global_shipped;
+}
+
+/** Convert nondecreasing cuts along the space filling curve into counts.
+ * \param [in] cuts    The first global quadrant of each process and the
+ *                      global number of quadrants, mpisize + 1 entries.
+ */
+static void
+p4est_partition_cut_counts (int num_procs, const p4est_gloidx_t * cuts,
+                            p4est_locidx_t * num_quadrants_in_proc)
+{
+  int                 p;
+  p4est_gloidx_t      qcount;
+
+  for (p = 0; p < num_procs; ++p) {
+    qcount = cuts[p + 1] - cuts[p];
+    P4EST_ASSERT (0 <= qcount && qcount <= (p4est_gloidx_t) P4EST_LOCIDX_MAX);
+    num_quadrants_in_proc[p] = (p4est_locidx_t) qcount;
+  }
+}
+
+/** Compute the prefix weights of the local quadrants across all processes.
+ * If \a weights_fn is not NULL, each quadrant carries \a num_weights weights
+ * and the arrays hold one row of that many prefixes per entry.  Otherwise
+ * there is one weight, taken from \a weights if not NULL, which holds one
+ * entry per local quadrant, else by \a weight_fn, or 1 if that is NULL.
+ * \param [out] local_weights   Allocated, local_num_quadrants + 1 rows.
+ * \param [out] global_weight_sums      Allocated, the prefix weight at each
+ *                              process boundary in mpisize + 1 rows.
+ */
+static void
+p4est_partition_prefix_weights (p4est_t * p4est, p4est_weight_t weight_fn,
+                                const int *weights, int num_weights,
+                                p4est_multi_weight_t weights_fn,
+                                int64_t ** local_weights,
+                                int64_t ** global_weight_sums)
+{
+  const int           k = weights_fn == NULL ? 1 : num_weights;
+  const int           num_procs = p4est->mpisize;
+  const p4est_locidx_t local_num_quadrants = p4est->local_num_quadrants;
+  int                 mpiret;
+  int                 c, p;
+  int                *qweights;
+  size_t              lz;
+  p4est_topidx_t      nt;
+  p4est_locidx_t      kl;
+  int64_t             weight;
+  int64_t            *lw, *gws, *wrow;
+  p4est_quadrant_t   *q;
+  p4est_tree_t       *tree;
+
+  P4EST_ASSERT (k >= 1);
+
+  /* linearly sum weights across all trees */
+  lw = *local_weights =
+    P4EST_ALLOC_ZERO (int64_t, ((size_t) local_num_quadrants + 1) * k);
+  qweights = weights_fn == NULL ? NULL : P4EST_ALLOC (int, k);
+  kl = 0;
+  for (nt = p4est->first_local_tree; nt <= p4est->last_local_tree; ++nt) {
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    for (lz = 0; lz < tree->quadrants.elem_count; ++lz, ++kl) {
+      q = p4est_quadrant_array_index (&tree->quadrants, lz);
+      wrow = lw + (size_t) kl * k;
+      if (weights_fn == NULL) {
+        weight = weights != NULL ? (int64_t) weights[kl] :
+          weight_fn == NULL ? 1 : (int64_t) weight_fn (p4est, nt, q);
+        P4EST_ASSERT (weight >= 0);
+        wrow[1] = wrow[0] + weight;
+        continue;
+      }
+      memset (qweights, 0, sizeof (int) * k);
+      weights_fn (p4est, nt, q, qweights);
+      for (c = 0; c < k; ++c) {
+        P4EST_ASSERT (qweights[c] >= 0);
+        wrow[k + c] = wrow[c] + (int64_t) qweights[c];
+      }
+    }
+  }
+  P4EST_ASSERT (kl == local_num_quadrants);
+  P4EST_FREE (qweights);
+
+  /* distribute local weight sums */
+  gws = *global_weight_sums =
+    P4EST_ALLOC_ZERO (int64_t, ((size_t) num_procs + 1) * k);
+  mpiret = sc_MPI_Allgather (lw + (size_t) local_num_quadrants * k, k,
+                             sc_MPI_LONG_LONG_INT, gws + k,
+                             k, sc_MPI_LONG_LONG_INT, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  /* adjust all arrays to reflect the global weight */
+  for (p = 0; p < num_procs; ++p) {
+    for (c = 0; c < k; ++c) {
+      gws[(size_t) (p + 1) * k + c] += gws[(size_t) p * k + c];
+    }
+  }
+  wrow = gws + (size_t) p4est->mpirank * k;
+  for (kl = 0; kl <= local_num_quadrants; ++kl) {
+    for (c = 0; c < k; ++c) {
+      lw[(size_t) kl * k + c] += wrow[c];
+    }
+  }
+}
+
+#ifdef P4EST_ENABLE_MPI
+
+/** Compute the deviation of a cut candidate from the ideal cut.
+ * \param [in] w        Global prefix weights at the candidate, \a k entries.
+ * \param [in] totals   Global weight sums, \a k entries.
+ * \return              Maximum over all weights with nonzero sum of the
+ *                      distance to the ideal cut relative to the sum.
+ */
+static double
+p4est_partition_multi_deviation (const int64_t * w, const int64_t * totals,
+                                 int k, int p, int num_procs)
+{
+  int                 c;
+  int64_t             target;
+  double              dev, maxdev;
+
+  maxdev = 0.;
+  for (c = 0; c < k; ++c) {
+    if (totals[c] > 0) {
+      target = p4est_partition_cut_uint64 (totals[c], p, num_procs);
+      dev = fabs ((double) (w[c] - target)) / (double) totals[c];
+      maxdev = SC_MAX (maxdev, dev);
+    }
+  }
+  return maxdev;
+}
+
+/** Determine the quadrant counts of a multi-constraint partition.
+ * Each cut minimizes the largest relative deviation of any weight from
+ * its ideal prefix.  The function of the global quadrant index to be
+ * minimized is non-increasing before and non-decreasing after the window
+ * spanned by the ideal cuts of the individual weights; every process
+ * evaluates its local part of this window including both boundaries.
+ * \return          False if all weights are zero, true otherwise.
+ */
+static int
+p4est_partition_multi_counts (p4est_t * p4est, int num_weights,
+                              p4est_multi_weight_t weights_fn,
+                              p4est_locidx_t * num_quadrants_in_proc)
+{
+  const int           k = num_weights;
+  const int           num_procs = p4est->mpisize;
+  const int           rank = p4est->mpirank;
+  const p4est_locidx_t local_num_quadrants = p4est->local_num_quadrants;
+  const p4est_gloidx_t global_num_quadrants = p4est->global_num_quadrants;
+  const p4est_gloidx_t gbegin = p4est->global_first_quadrant[rank];
+  int                 mpiret;
+  int                 c, p, p_lo;
+  int                 any_lower, any_upper;
+  p4est_locidx_t      kl;
+  p4est_gloidx_t     *best_index, *cuts;
+  int64_t            *local_weights;    /* cumulative weights by quadrant */
+  int64_t            *global_weight_sums;
+  int64_t            *totals, *wrow;
+  double              dev;
+  double             *best_local, *best_global;
+
+  P4EST_ASSERT (k >= 1);
+  P4EST_ASSERT (weights_fn != NULL);
+
+  p4est_partition_prefix_weights (p4est, NULL, NULL, k, weights_fn,
+                                  &local_weights, &global_weight_sums);
+  totals = global_weight_sums + (size_t) num_procs * k;
+  for (c = 0; c < k; ++c) {
+    P4EST_GLOBAL_VERBOSEF ("Global weight sum [%d] %lld\n",
+                           c, (long long) totals[c]);
+    if (totals[c] > 0) {
+      break;
+    }
+  }
+  if (c == k) {
+    /* if all quadrants have zero weight we do nothing */
+    P4EST_FREE (local_weights);
+    P4EST_FREE (global_weight_sums);
+    return 0;
+  }
+
+  /* find the local candidate with the smallest deviation for each cut */
+  best_local = P4EST_ALLOC (double, 2 * num_procs);
+  best_global = best_local + num_procs;
+  best_index = P4EST_ALLOC (p4est_gloidx_t, num_procs);
+  for (p = 0; p < num_procs; ++p) {
+    best_local[p] = 2.;
+    best_index[p] = global_num_quadrants;
+  }
+  p_lo = 1;
+  for (kl = 0; kl <= local_num_quadrants; ++kl) {
+    wrow = local_weights + (size_t) kl * k;
+
+    /* skip cuts whose window lies entirely below this index */
+    for (; kl > 0 && p_lo < num_procs; ++p_lo) {
+      for (any_upper = 0, c = 0; c < k; ++c) {
+        if (totals[c] > 0 && wrow[c - k] <
+            (int64_t) p4est_partition_cut_uint64 (totals[c], p_lo,
+                                                  num_procs)) {
+          any_upper = 1;
+          break;
+        }
+      }
+      if (any_upper) {
+        break;
+      }
+    }
+
+    /* evaluate all cuts whose window contains this index */
+    for (p = p_lo; p < num_procs; ++p) {
+      if (kl < local_num_quadrants) {
+        for (any_lower = 0, c = 0; c < k; ++c) {
+          if (totals[c] > 0 && wrow[k + c] >
+              (int64_t) p4est_partition_cut_uint64 (totals[c], p,
+                                                    num_procs)) {
+            any_lower = 1;
+            break;
+          }
+        }
+        if (!any_lower) {
+          break;
+        }
+      }
+      dev = p4est_partition_multi_deviation (wrow, totals, k, p, num_procs);
+      if (dev < best_local[p]) {
+        best_local[p] = dev;
+        best_index[p] = gbegin + kl;
+      }
+    }
   }
-  P4EST_FREE (peers);
 
-  if (borders != NULL) {
-    for (zz = 0; zz < localcount; zz++) {
-      qarray = (sc_array_t *) sc_array_index (borders, zz);
-      sc_array_reset (qarray);
+  /* the smallest deviation wins and ties go to the lowest index */
+  mpiret = MPI_Allreduce (best_local + 1, best_global + 1, num_procs - 1,
+                          MPI_DOUBLE, MPI_MIN, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  for (p = 1; p < num_procs; ++p) {
+    P4EST_ASSERT (best_global[p] <= 1.);
+    if (best_local[p] != best_global[p]) {
+      best_index[p] = global_num_quadrants;
     }
-    sc_array_destroy (borders);
   }
+  cuts = P4EST_ALLOC (p4est_gloidx_t, num_procs + 1);
+  mpiret = MPI_Allreduce (best_index + 1, cuts + 1, num_procs - 1,
+                          P4EST_MPI_GLOIDX, MPI_MIN, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (best_local);
+  P4EST_FREE (best_index);
+
+  /* the cuts are nondecreasing up to ties between overlapping windows */
+  cuts[0] = 0;
+  cuts[num_procs] = global_num_quadrants;
+  for (p = 1; p < num_procs; ++p) {
+    cuts[p] = SC_MAX (cuts[p], cuts[p - 1]);
+  }
+  p4est_partition_cut_counts (num_procs, cuts, num_quadrants_in_proc);
 
-#ifdef P4_TO_P8
-  sc_array_reset (eta);
-#endif
-  sc_array_reset (cta);
+  P4EST_FREE (cuts);
+  P4EST_FREE (local_weights);
+  P4EST_FREE (global_weight_sums);
+  return 1;
+}
 
-#ifdef P4EST_ENABLE_MPI
-  P4EST_FREE (requests_first);  /* includes allocation for requests_second */
-  P4EST_FREE (recv_statuses);
-  P4EST_FREE (wait_indices);
-#ifdef P4EST_ENABLE_DEBUG
-  sc_array_reset (&checkarray);
-#endif /* P4EST_ENABLE_DEBUG */
-#endif /* P4EST_ENABLE_MPI */
+/** Compute the ratio of the maximum to the average process weight.
+ * The weights are evaluated on the local quadrants of the current
+ * partition.  The ratio is 1 for weights with zero sum.
+ */
+static void
+p4est_partition_multi_imbalance (p4est_t * p4est, int num_weights,
+                                 p4est_multi_weight_t weights_fn,
+                                 double *imbalance)
+{
+  const int           k = num_weights;
+  int                 mpiret;
+  int                 c;
+  int                *qweights;
+  size_t              lz;
+  p4est_topidx_t      nt;
+  int64_t            *sums, *maxw, *totals;
+  p4est_quadrant_t   *q;
+  p4est_tree_t       *tree;
 
-  /* compute global number of quadrants */
-  p4est_comm_count_quadrants (p4est);
-  P4EST_ASSERT (p4est->global_num_quadrants >= old_gnq);
-  if (old_gnq != p4est->global_num_quadrants) {
-    ++p4est->revision;
+  sums = P4EST_ALLOC_ZERO (int64_t, 3 * k);
+  maxw = sums + k;
+  totals = maxw + k;
+  qweights = P4EST_ALLOC (int, k);
+  for (nt = p4est->first_local_tree; nt <= p4est->last_local_tree; ++nt) {
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    for (lz = 0; lz < tree->quadrants.elem_count; ++lz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, lz);
+      memset (qweights, 0, sizeof (int) * k);
+      weights_fn (p4est, nt, q, qweights);
+      for (c = 0; c < k; ++c) {
+        sums[c] += (int64_t) qweights[c];
+      }
+    }
   }
+  P4EST_FREE (qweights);
 
-  /* some sanity checks */
-  P4EST_ASSERT ((p4est_locidx_t) all_outcount == p4est->local_num_quadrants);
-  P4EST_ASSERT (all_outcount >= all_incount);
-  if (p4est->user_data_pool != NULL) {
-    P4EST_ASSERT (data_pool_size + all_outcount - all_incount ==
-                  p4est->user_data_pool->elem_count);
+  mpiret = MPI_Allreduce (sums, maxw, k, MPI_LONG_LONG_INT, MPI_MAX,
+                          p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Allreduce (sums, totals, k, MPI_LONG_LONG_INT, MPI_SUM,
+                          p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  for (c = 0; c < k; ++c) {
+    imbalance[c] = totals[c] > 0 ?
+      (double) maxw[c] * p4est->mpisize / (double) totals[c] : 1.;
+    P4EST_GLOBAL_INFOF ("Multi-constraint imbalance [%d] %g\n",
+                        c, imbalance[c]);
   }
-  P4EST_ASSERT (p4est_is_valid (p4est));
-  P4EST_ASSERT (p4est_is_balanced (p4est, btype));
-  P4EST_VERBOSEF ("Balance skipped %lld\n", (long long) skipped);
-  p4est_log_indent_pop ();
-  P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING
-                            "_balance with %lld total quadrants\n",
-                            (long long) p4est->global_num_quadrants);
+  P4EST_FREE (sums);
 }
 
+#endif /* P4EST_ENABLE_MPI */
+
 void
 p4est_partition (p4est_t * p4est, int allow_for_coarsening,
                  p4est_weight_t weight_fn)
@@ -2433,10 +3703,67 @@ p4est_partition (p4est_t * p4est, int allow_for_coarsening,
   (void) p4est_partition_ext (p4est, allow_for_coarsening, weight_fn);
 }
 
-p4est_gloidx_t
-p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
-                     p4est_weight_t weight_fn)
+/** Ship the quadrants of a partition given by its process counts.
+ * The counts are corrected first if \a partition_for_coarsening is true.
+ * If \a pc is not NULL, the messages are posted and the forest is left
+ * unchanged until \ref p4est_partition_end is called.
+ * \return             The global number of shipped quadrants.
+ */
+static p4est_gloidx_t
+p4est_partition_apply (p4est_t * p4est, int partition_for_coarsening,
+                       p4est_locidx_t * num_quadrants_in_proc,
+                       p4est_partition_context_t * pc)
+{
+  int                 i;
+  p4est_gloidx_t      global_shipped, num_corrected;
+
+  /* correct partition */
+  if (partition_for_coarsening) {
+    num_corrected =
+      p4est_partition_for_coarsening (p4est, num_quadrants_in_proc);
+    P4EST_GLOBAL_INFOF
+      ("Designated partition for coarsening %lld quadrants moved\n",
+       (long long) num_corrected);
+  }
+
+  /* run the partition algorithm with proper quadrant counts */
+  if (pc == NULL) {
+    global_shipped = p4est_partition_given (p4est, num_quadrants_in_proc);
+    if (global_shipped) {
+      /* the partition of the forest has changed somewhere */
+      ++p4est->revision;
+    }
+  }
+  else {
+    /* the shipped quadrants are those not kept by their old owner */
+    global_shipped = p4est->global_num_quadrants;
+    for (i = 0; i < p4est->mpisize; ++i) {
+      pc->dest_gfq[i + 1] = pc->dest_gfq[i] + num_quadrants_in_proc[i];
+      global_shipped -= SC_MAX (0, SC_MIN (pc->src_gfq[i + 1],
+                                           pc->dest_gfq[i + 1]) -
+                                SC_MAX (pc->src_gfq[i], pc->dest_gfq[i]));
+    }
+    P4EST_ASSERT (pc->dest_gfq[p4est->mpisize] ==
+                  p4est->global_num_quadrants);
+
+    /* post the messages and leave the forest unchanged for now */
+    pc->given = p4est_partition_given_begin (p4est, num_quadrants_in_proc);
+  }
+  return global_shipped;
+}
+
+/** Partition by a single weight, several weights, or quadrant count.
+ * A single weight is taken from \a weights if not NULL, else by \a weight_fn.
+ * If \a pc is not NULL, the messages are posted and the forest is left
+ * unchanged until \ref p4est_partition_end is called.
+ */
+static p4est_gloidx_t
+p4est_partition_internal (p4est_t * p4est, int partition_for_coarsening,
+                          p4est_weight_t weight_fn, const int *weights,
+                          int num_weights, p4est_multi_weight_t weights_fn,
+                          double *imbalance, p4est_partition_context_t * pc)
 {
+  int                 c;
   p4est_gloidx_t      global_shipped = 0;
   const p4est_gloidx_t global_num_quadrants = p4est->global_num_quadrants;
 #ifdef P4EST_ENABLE_MPI
@@ -2444,32 +3771,28 @@ p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
   int                 low_source, high_source;
   const int           num_procs = p4est->mpisize;
   const int           rank = p4est->mpirank;
-  const p4est_topidx_t first_tree = p4est->first_local_tree;
-  const p4est_topidx_t last_tree = p4est->last_local_tree;
   const p4est_locidx_t local_num_quadrants = p4est->local_num_quadrants;
   int                 i, p;
   int                 send_lowest, send_highest;
   int                 num_sends, rcount, base_index;
-  size_t              lz;
   ssize_t             lowers;
-  p4est_topidx_t      nt;
-  p4est_locidx_t      kl, qlocal;
+  p4est_locidx_t      qlocal;
   p4est_locidx_t     *num_quadrants_in_proc;
   p4est_gloidx_t      prev_quadrant, next_quadrant;
   p4est_gloidx_t      send_index, recv_low, recv_high, qcount;
   p4est_gloidx_t     *send_array;
-  int64_t             weight, weight_sum;
+  int64_t             weight_sum;
   int64_t             cut, my_lowcut, my_highcut;
   int64_t            *local_weights;    /* cumulative weights by quadrant */
   int64_t            *global_weight_sums;
-  p4est_quadrant_t   *q;
-  p4est_tree_t       *tree;
   MPI_Request        *send_requests, recv_requests[2];
   MPI_Status          recv_statuses[2];
-  p4est_gloidx_t      num_corrected;
 #endif /* P4EST_ENABLE_MPI */
 
   P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (weight_fn == NULL || weights_fn == NULL);
+  P4EST_ASSERT (weights == NULL ||
+                (weight_fn == NULL && weights_fn == NULL));
   P4EST_GLOBAL_PRODUCTIONF
     ("Into " P4EST_STRING
      "_partition with %lld total quadrants\n",
@@ -2477,6 +3800,11 @@ p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
 
   /* this function does nothing in a serial setup */
   if (p4est->mpisize == 1) {
+    if (imbalance != NULL) {
+      for (c = 0; c < num_weights; ++c) {
+        imbalance[c] = 1.;
+      }
+    }
     P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_partition no shipping\n");
 
     /* in particular, there is no need to bump the revision counter */
@@ -2490,7 +3818,26 @@ p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
   /* allocate new quadrant distribution counts */
   num_quadrants_in_proc = P4EST_ALLOC (p4est_locidx_t, num_procs);
 
-  if (weight_fn == NULL) {
+  if (weights_fn != NULL) {
+    /* do a multi-constraint partition */
+    if (!p4est_partition_multi_counts (p4est, num_weights, weights_fn,
+                                       num_quadrants_in_proc)) {
+      if (imbalance != NULL) {
+        for (c = 0; c < num_weights; ++c) {
+          imbalance[c] = 1.;
+        }
+      }
+      P4EST_FREE (num_quadrants_in_proc);
+      p4est_log_indent_pop ();
+      P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING
+                               "_partition no shipping\n");
+
+      /* in particular, there is no need to bump the revision counter */
+      P4EST_ASSERT (global_shipped == 0);
+      return global_shipped;
+    }
+  }
+  else if (weight_fn == NULL && weights == NULL) {
     /* Divide up the quadrants equally */
     for (p = 0, next_quadrant = 0; p < num_procs; ++p) {
       prev_quadrant = next_quadrant;
@@ -2504,47 +3851,13 @@ p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
   }
   else {
     /* do a weighted partition */
-    local_weights = P4EST_ALLOC (int64_t, local_num_quadrants + 1);
-    global_weight_sums = P4EST_ALLOC (int64_t, num_procs + 1);
     P4EST_VERBOSEF ("local quadrant count %lld\n",
                     (long long) local_num_quadrants);
-
-    /* linearly sum weights across all trees */
-    kl = 0;
-    local_weights[0] = 0;
-    for (nt = first_tree; nt <= last_tree; ++nt) {
-      tree = p4est_tree_array_index (p4est->trees, nt);
-      for (lz = 0; lz < tree->quadrants.elem_count; ++lz, ++kl) {
-        q = p4est_quadrant_array_index (&tree->quadrants, lz);
-        weight = (int64_t) weight_fn (p4est, nt, q);
-        P4EST_ASSERT (weight >= 0);
-        local_weights[kl + 1] = local_weights[kl] + weight;
-      }
-    }
-    P4EST_ASSERT (kl == local_num_quadrants);
-    weight_sum = local_weights[local_num_quadrants];
-    P4EST_VERBOSEF ("local weight sum %lld\n", (long long) weight_sum);
-
-    /* distribute local weight sums */
-    global_weight_sums[0] = 0;
-    mpiret = MPI_Allgather (&weight_sum, 1, MPI_LONG_LONG_INT,
-                            &global_weight_sums[1], 1, MPI_LONG_LONG_INT,
-                            p4est->mpicomm);
-    SC_CHECK_MPI (mpiret);
-
-    /* adjust all arrays to reflect the global weight */
-    for (i = 0; i < num_procs; ++i) {
-      global_weight_sums[i + 1] += global_weight_sums[i];
-    }
-    if (rank > 0) {
-      weight_sum = global_weight_sums[rank];
-      for (kl = 0; kl <= local_num_quadrants; ++kl) {
-        local_weights[kl] += weight_sum;
-      }
-    }
-    P4EST_ASSERT (local_weights[0] == global_weight_sums[rank]);
-    P4EST_ASSERT (local_weights[local_num_quadrants] ==
-                  global_weight_sums[rank + 1]);
+    p4est_partition_prefix_weights (p4est, weight_fn, weights, 1, NULL,
+                                    &local_weights, &global_weight_sums);
+    P4EST_VERBOSEF ("local weight sum %lld\n",
+                    (long long) (local_weights[local_num_quadrants] -
+                                 local_weights[0]));
     weight_sum = global_weight_sums[num_procs];
 
     if (rank == 0) {
@@ -2758,22 +4071,17 @@ p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
 #endif
   }
 
-  /* correct partition */
-  if (partition_for_coarsening) {
-    num_corrected =
-      p4est_partition_for_coarsening (p4est, num_quadrants_in_proc);
-    P4EST_GLOBAL_INFOF
-      ("Designated partition for coarsening %lld quadrants moved\n",
-       (long long) num_corrected);
-  }
+  /* ship the quadrants or post the messages to do so */
+  global_shipped = p4est_partition_apply (p4est, partition_for_coarsening,
+                                          num_quadrants_in_proc, pc);
+  P4EST_FREE (num_quadrants_in_proc);
 
-  /* run the partition algorithm with proper quadrant counts */
-  global_shipped = p4est_partition_given (p4est, num_quadrants_in_proc);
-  if (global_shipped) {
-    /* the partition of the forest has changed somewhere */
-    ++p4est->revision;
+  /* report the imbalance of the final partition */
+  if (weights_fn != NULL && imbalance != NULL) {
+    P4EST_ASSERT (pc == NULL);
+    p4est_partition_multi_imbalance (p4est, num_weights, weights_fn,
+                                     imbalance);
   }
-  P4EST_FREE (num_quadrants_in_proc);
 
   /* check validity of the p4est */
   P4EST_ASSERT (p4est_is_valid (p4est));
@@ -2788,6 +4096,345 @@ p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
   return global_shipped;
 }
 
+p4est_gloidx_t
+p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
+                     p4est_weight_t weight_fn)
+{
+  return p4est_partition_internal (p4est, partition_for_coarsening,
+                                   weight_fn, NULL, 0, NULL, NULL, NULL);
+}
+
+p4est_gloidx_t
+p4est_partition_weights (p4est_t * p4est, int partition_for_coarsening,
+                         const int *weights)
+{
+  P4EST_ASSERT (weights != NULL);
+
+  return p4est_partition_internal (p4est, partition_for_coarsening,
+                                   NULL, weights, 0, NULL, NULL, NULL);
+}
+
+p4est_gloidx_t
+p4est_partition_multi (p4est_t * p4est, int partition_for_coarsening,
+                       int num_weights, p4est_multi_weight_t weights_fn,
+                       double *imbalance)
+{
+  P4EST_ASSERT (num_weights >= 1);
+  P4EST_ASSERT (weights_fn != NULL);
+
+  return p4est_partition_internal (p4est, partition_for_coarsening,
+                                   NULL, NULL, num_weights, weights_fn,
+                                   imbalance, NULL);
+}
+
+p4est_partition_context_t *
+p4est_partition_begin (p4est_t * p4est, int partition_for_coarsening,
+                       p4est_weight_t weight_fn)
+{
+  const size_t        gfq_size =
+    (size_t) (p4est->mpisize + 1) * sizeof (p4est_gloidx_t);
+  p4est_partition_context_t *pc;
+
+  pc = P4EST_ALLOC_ZERO (p4est_partition_context_t, 1);
+  pc->p4est = p4est;
+  pc->src_gfq = P4EST_ALLOC (p4est_gloidx_t, p4est->mpisize + 1);
+  memcpy (pc->src_gfq, p4est->global_first_quadrant, gfq_size);
+  pc->dest_gfq = P4EST_ALLOC (p4est_gloidx_t, p4est->mpisize + 1);
+  memcpy (pc->dest_gfq, p4est->global_first_quadrant, gfq_size);
+  pc->transfers = sc_array_new (sizeof (p4est_transfer_context_t *));
+
+  /* if nothing is to be shipped, the given state remains NULL */
+  pc->global_shipped =
+    p4est_partition_internal (p4est, partition_for_coarsening,
+                              weight_fn, NULL, 0, NULL, NULL, pc);
+
+  return pc;
+}
+
+void
+p4est_partition_transfer_fixed (p4est_partition_context_t * pc, int tag,
+                                void *dest_data, const void *src_data,
+                                size_t data_size)
+{
+  P4EST_ASSERT (pc != NULL && pc->transfers != NULL);
+  P4EST_ASSERT (tag != P4EST_COMM_PARTITION_GIVEN);
+
+  *(p4est_transfer_context_t **) sc_array_push (pc->transfers) =
+    p4est_transfer_fixed_begin (pc->dest_gfq, pc->src_gfq,
+                                pc->p4est->mpicomm, tag,
+                                dest_data, src_data, data_size);
+}
+
+p4est_gloidx_t
+p4est_partition_end (p4est_partition_context_t * pc)
+{
+  size_t              zz;
+  p4est_gloidx_t      global_shipped = 0;
+  p4est_t            *p4est;
+
+  P4EST_ASSERT (pc != NULL && pc->transfers != NULL);
+  p4est = pc->p4est;
+
+  /* rebuild the forest while the transfers may still progress */
+  if (pc->given != NULL) {
+    global_shipped = p4est_partition_given_end (pc->given);
+    P4EST_ASSERT (global_shipped == pc->global_shipped);
+    if (global_shipped) {
+      /* the partition of the forest has changed somewhere */
+      ++p4est->revision;
+    }
+    P4EST_ASSERT (p4est_is_valid (p4est));
+  }
+  P4EST_ASSERT (!memcmp (p4est->global_first_quadrant, pc->dest_gfq,
+                         (p4est->mpisize + 1) * sizeof (p4est_gloidx_t)));
+
+  for (zz = 0; zz < pc->transfers->elem_count; ++zz) {
+    p4est_transfer_fixed_end (*(p4est_transfer_context_t **)
+                              sc_array_index (pc->transfers, zz));
+  }
+
+  sc_array_destroy (pc->transfers);
+  P4EST_FREE (pc->src_gfq);
+  P4EST_FREE (pc->dest_gfq);
+  P4EST_FREE (pc);
+
+  return global_shipped;
+}
+
+/** Find the smallest global quadrant index whose prefix weight reaches
+ * each target.  Each is determined by the process owning it.
+ * Nonpositive targets yield 0 and targets beyond the total weight yield
+ * the global number of quadrants.  This function is collective.
+ */
+static void
+p4est_partition_lower_bounds (p4est_t * p4est, const int64_t * local_weights,
+                              const int64_t * global_weight_sums,
+                              int num_targets, const int64_t * targets,
+                              p4est_gloidx_t * bounds)
+{
+  const int           rank = p4est->mpirank;
+  const p4est_locidx_t local_num_quadrants = p4est->local_num_quadrants;
+  int                 mpiret;
+  int                 i;
+  ssize_t             found;
+  p4est_gloidx_t     *found_bounds;
+
+  found_bounds = P4EST_ALLOC_ZERO (p4est_gloidx_t, num_targets);
+  for (i = 0; i < num_targets; ++i) {
+    if (targets[i] > global_weight_sums[p4est->mpisize]) {
+      found_bounds[i] = p4est->global_num_quadrants;
+    }
+    else if (global_weight_sums[rank] < targets[i] &&
+             targets[i] <= global_weight_sums[rank + 1]) {
+      /* the smallest index with at least this prefix weight */
+      found = sc_search_lower_bound64 (targets[i], local_weights,
+                                       (size_t) local_num_quadrants + 1, 0);
+      P4EST_ASSERT (found > 0);
+      found_bounds[i] = p4est->global_first_quadrant[rank] +
+        (p4est_gloidx_t) found;
+    }
+  }
+
+  /* exactly one process has determined each bound, or all the same */
+  mpiret = sc_MPI_Allreduce (found_bounds, bounds, num_targets,
+                             P4EST_MPI_GLOIDX, sc_MPI_MAX, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (found_bounds);
+}
+
+p4est_gloidx_t
+p4est_partition_plan (p4est_t * p4est, p4est_weight_t weight_fn,
+                      double tolerance,
+                      p4est_locidx_t * num_quadrants_in_proc,
+                      uint64_t * bytes_shipped)
+{
+  const int           num_procs = p4est->mpisize;
+  const p4est_gloidx_t *gfq = p4est->global_first_quadrant;
+  int                 p;
+  p4est_gloidx_t      qcount, kept, global_shipped;
+  p4est_gloidx_t     *cuts, *bounds;
+  int64_t             weight_sum, share, target;
+  int64_t            *targets;
+  int64_t            *local_weights;    /* cumulative weights by quadrant */
+  int64_t            *global_weight_sums;
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (tolerance >= 0.);
+  P4EST_ASSERT (num_quadrants_in_proc != NULL);
+
+  p4est_partition_prefix_weights (p4est, weight_fn, NULL, 1, NULL,
+                                  &local_weights, &global_weight_sums);
+  weight_sum = global_weight_sums[num_procs];
+
+  cuts = P4EST_ALLOC (p4est_gloidx_t, num_procs + 1);
+  memcpy (cuts, gfq, (num_procs + 1) * sizeof (p4est_gloidx_t));
+  if (weight_sum > 0) {
+    /* find the index window of each cut on the process owning its ends */
+    targets = P4EST_ALLOC (int64_t, 2 * (num_procs - 1));
+    bounds = P4EST_ALLOC (p4est_gloidx_t, 2 * (num_procs - 1));
+    share = (int64_t) (tolerance * weight_sum / num_procs);
+    for (p = 1; p < num_procs; ++p) {
+      target = (int64_t) p4est_partition_cut_uint64 (weight_sum, p,
+                                                     num_procs);
+      targets[2 * (p - 1)] = target - share;
+      targets[2 * (p - 1) + 1] = target + share;
+    }
+    p4est_partition_lower_bounds (p4est, local_weights, global_weight_sums,
+                                  2 * (num_procs - 1), targets, bounds);
+
+    /* each cut moves only to the nearest end of its window */
+    for (p = 1; p < num_procs; ++p) {
+      cuts[p] = SC_MAX (cuts[p], bounds[2 * (p - 1)]);
+      cuts[p] = SC_MIN (cuts[p], bounds[2 * (p - 1) + 1]);
+    }
+    P4EST_FREE (targets);
+    P4EST_FREE (bounds);
+  }
+  P4EST_FREE (local_weights);
+  P4EST_FREE (global_weight_sums);
+
+  /* clamping nondecreasing cuts into nondecreasing windows keeps order */
+  kept = 0;
+  for (p = 0; p < num_procs; ++p) {
+    qcount = cuts[p + 1] - cuts[p];
+    P4EST_ASSERT (0 <= qcount && qcount <= (p4est_gloidx_t) P4EST_LOCIDX_MAX);
+    num_quadrants_in_proc[p] = (p4est_locidx_t) qcount;
+    kept += SC_MAX (SC_MIN (cuts[p + 1], gfq[p + 1]) -
+                    SC_MAX (cuts[p], gfq[p]), 0);
+  }
+  global_shipped = p4est->global_num_quadrants - kept;
+  P4EST_FREE (cuts);
+
+  if (bytes_shipped != NULL) {
+    *bytes_shipped = (uint64_t) global_shipped *
+      (sizeof (p4est_quadrant_t) + p4est->data_size);
+  }
+  P4EST_GLOBAL_INFOF ("Partition plan with tolerance %g ships %lld"
+                      " quadrants\n", tolerance, (long long) global_shipped);
+  return global_shipped;
+}
+
+p4est_gloidx_t
+p4est_partition_node (p4est_t * p4est, int partition_for_coarsening,
+                      p4est_weight_t weight_fn, double tolerance)
+{
+  const int           num_procs = p4est->mpisize;
+  const p4est_gloidx_t *gfq = p4est->global_first_quadrant;
+  int                 k, p, num_nodes;
+  int                *node_first, *node_kept;
+  p4est_locidx_t     *num_quadrants_in_proc;
+  p4est_gloidx_t      global_shipped;
+  p4est_gloidx_t     *cuts;
+  int64_t             weight_sum, share, target;
+  int64_t             ideal_low, ideal_high;
+  int64_t            *node_targets, *targets;
+  int64_t            *local_weights;    /* cumulative weights by quadrant */
+  int64_t            *global_weight_sums;
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (tolerance >= 0.);
+
+  /* without several nodes the hierarchy makes no difference */
+  node_first = P4EST_ALLOC (int, num_procs + 1);
+  num_nodes = num_procs > 1 ? p4est_comm_node_first (p4est, node_first) : 0;
+  if (num_nodes <= 1) {
+    P4EST_FREE (node_first);
+    P4EST_GLOBAL_INFO ("Partition by nodes not applicable\n");
+    return p4est_partition_ext (p4est, partition_for_coarsening, weight_fn);
+  }
+
+  P4EST_GLOBAL_PRODUCTIONF
+    ("Into " P4EST_STRING "_partition_node with %lld total quadrants"
+     " on %d nodes\n", (long long) p4est->global_num_quadrants, num_nodes);
+  p4est_log_indent_push ();
+
+  p4est_partition_prefix_weights (p4est, weight_fn, NULL, 1, NULL,
+                                  &local_weights, &global_weight_sums);
+  weight_sum = global_weight_sums[num_procs];
+
+  cuts = P4EST_ALLOC (p4est_gloidx_t, num_procs + 1);
+  memcpy (cuts, gfq, (num_procs + 1) * sizeof (p4est_gloidx_t));
+  if (weight_sum > 0) {
+    /* move each cut between nodes at most to the end of its window */
+    node_targets = P4EST_ALLOC (int64_t, num_nodes + 1);
+    node_kept = P4EST_ALLOC_ZERO (int, num_nodes + 1);
+    node_targets[0] = 0;
+    node_targets[num_nodes] = weight_sum;
+    share = (int64_t) (tolerance * weight_sum / num_nodes);
+    for (k = 1; k < num_nodes; ++k) {
+      p = node_first[k];
+      target = (int64_t) p4est_partition_cut_uint64 (weight_sum, p,
+                                                     num_procs);
+      node_targets[k] = SC_MIN (SC_MAX (global_weight_sums[p],
+                                        target - share), target + share);
+      node_kept[k] = share > 0 && node_targets[k] == global_weight_sums[p];
+    }
+
+    /* split the weight of each node evenly among its processes */
+    targets = P4EST_ALLOC (int64_t, num_procs - 1);
+    for (k = 0; k < num_nodes; ++k) {
+      ideal_low = (int64_t) p4est_partition_cut_uint64
+        (weight_sum, node_first[k], num_procs);
+      ideal_high = (int64_t) p4est_partition_cut_uint64
+        (weight_sum, node_first[k + 1], num_procs);
+      for (p = SC_MAX (node_first[k], 1); p < node_first[k + 1]; ++p) {
+        if (p == node_first[k]) {
+          targets[p - 1] = node_targets[k];
+          continue;
+        }
+        target = (int64_t) p4est_partition_cut_uint64 (weight_sum, p,
+                                                       num_procs);
+        if (node_targets[k] != ideal_low ||
+            node_targets[k + 1] != ideal_high) {
+          /* map the ideal cut into the weight range of the node */
+          target = ideal_high == ideal_low ? node_targets[k] :
+            node_targets[k] + (int64_t) ((double) (target - ideal_low) *
+                                         (node_targets[k + 1] -
+                                          node_targets[k]) /
+                                         (ideal_high - ideal_low));
+        }
+        targets[p - 1] = target;
+      }
+    }
+    p4est_partition_lower_bounds (p4est, local_weights, global_weight_sums,
+                                  num_procs - 1, targets, cuts + 1);
+    for (k = 1; k < num_nodes; ++k) {
+      if (node_kept[k]) {
+        cuts[node_first[k]] = gfq[node_first[k]];
+      }
+    }
+
+    /* a kept cut may lie behind the bound of the next zero weight target */
+    for (p = 1; p < num_procs; ++p) {
+      cuts[p] = SC_MAX (cuts[p], cuts[p - 1]);
+    }
+    P4EST_FREE (node_targets);
+    P4EST_FREE (node_kept);
+    P4EST_FREE (targets);
+  }
+  P4EST_FREE (local_weights);
+  P4EST_FREE (global_weight_sums);
+  P4EST_FREE (node_first);
+
+  num_quadrants_in_proc = P4EST_ALLOC (p4est_locidx_t, num_procs);
+  p4est_partition_cut_counts (num_procs, cuts, num_quadrants_in_proc);
+  P4EST_FREE (cuts);
+  global_shipped = p4est_partition_apply (p4est, partition_for_coarsening,
+                                          num_quadrants_in_proc, NULL);
+  P4EST_FREE (num_quadrants_in_proc);
+
+  /* check validity of the p4est */
+  P4EST_ASSERT (p4est_is_valid (p4est));
+
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF
+    ("Done " P4EST_STRING "_partition_node shipped %lld quadrants %.3g%%\n",
+     (long long) global_shipped,
+     global_shipped * 100. / p4est->global_num_quadrants);
+
+  return global_shipped;
+}
+
 p4est_gloidx_t
 p4est_partition_for_coarsening (p4est_t * p4est,
                                 p4est_locidx_t * num_quadrants_in_proc)
@@ -4028,6 +5675,10 @@ p4est_load_ext (const char *filename, sc_MPI_Comm mpicomm, size_t data_size,
   SC_CHECK_ABORT (!retval, "source destroy");
 #endif
 
+  /* optionally keep read-only global data once per compute node */
+  p4est_connectivity_share (*connectivity, mpicomm);
+  p4est_comm_share (p4est);
+
   p4est_log_indent_pop ();
   P4EST_GLOBAL_PRODUCTIONF
     ("Done " P4EST_STRING "_load with %lld total quadrants\n",
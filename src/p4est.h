@@ -183,6 +183,9 @@ typedef struct p4est
   sc_mempool_t       *quadrant_pool;  /**< memory allocator for temporary
                                            quadrants */
   p4est_inspect_t    *inspect;        /**< algorithmic switches */
+  p4est_shared_t     *shared;         /**< if not NULL, the global
+                                           quadrant and position arrays
+                                           are node-shared memory */
 }
 p4est_t;
 
@@ -285,6 +288,8 @@ void                p4est_qcoord_to_vertex (p4est_connectivity_t *
  *
  * \note The connectivity structure must not be destroyed
  *       during the lifetime of this forest.
+ * \note The connectivity may be moved into node-shared memory,
+ *       see \ref p4est_new_ext.
  */
 p4est_t            *p4est_new (sc_MPI_Comm mpicomm,
                                p4est_connectivity_t * connectivity,
@@ -294,6 +299,8 @@ p4est_t            *p4est_new (sc_MPI_Comm mpicomm,
 /** Destroy a p4est.
  *
  * \note The connectivity structure is not destroyed with the p4est.
+ * \note If the partition arrays are node-shared, see \ref p4est_comm_share,
+ *       this function is collective over the processes of each node.
  */
 void                p4est_destroy (p4est_t * p4est);
 
@@ -47,6 +47,9 @@
 #define WIN32_LEAN_AND_MEAN     /* make sure Winsock.h is never included */
 #include <winsock2.h>
 #endif
+#ifdef SC_ENABLE_PTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef P4_TO_P8
 
@@ -1210,7 +1213,7 @@ p4est_tree_uniqify_overlap (sc_array_t * out)
   }
 
   /* sort array and remove duplicates */
-  sc_array_sort (out, p4est_quadrant_compare_piggy);
+  p4est_quadrant_array_sort_piggy (out);
   dupcount = olcount = 0;
   iz = 0;                       /* read counter */
   jz = 0;                       /* write counter */
@@ -1532,6 +1535,114 @@ p4est_quadrant_disjoint_parent (const void *a, const void *b)
   return 0;
 }
 
+/** Open addressing table over the quadrants of one level.
+ * The quadrants live by value in an array and are found by coordinates.
+ */
+typedef struct p4est_balance_table
+{
+  sc_array_t         *quads;    /**< quadrants of one level by value */
+  size_t             *slots;    /**< index into quads plus one, 0 is empty */
+  size_t              mask;     /**< number of slots minus one */
+}
+p4est_balance_table_t;
+
+static void
+p4est_balance_table_init (p4est_balance_table_t * table, sc_array_t * quads)
+{
+  P4EST_ASSERT (quads->elem_size == sizeof (p4est_quadrant_t));
+  P4EST_ASSERT (quads->elem_count == 0);
+
+  table->quads = quads;
+  table->mask = 63;
+  table->slots = P4EST_ALLOC_ZERO (size_t, table->mask + 1);
+}
+
+static void
+p4est_balance_table_reset (p4est_balance_table_t * table)
+{
+  P4EST_FREE (table->slots);
+  table->slots = NULL;
+  table->quads = NULL;
+}
+
+static              size_t
+p4est_balance_table_hash (const p4est_balance_table_t * table,
+                          const p4est_quadrant_t * q)
+{
+  const int           shift = P4EST_MAXLEVEL - (int) q->level;
+  uint64_t            h;
+
+  /* multiplicative hashing of the integer coordinates on the level;
+   * unlike the Morton index this works up to P4EST_QMAXLEVEL */
+  P4EST_ASSERT (q->x >= 0 && q->y >= 0);
+  h = (uint64_t) (q->x >> shift) * (uint64_t) 0x9E3779B97F4A7C15ULL;
+  h ^= (h >> 29) ^ (uint64_t) (q->y >> shift) *
+    (uint64_t) 0xC2B2AE3D27D4EB4FULL;
+#ifdef P4_TO_P8
+  P4EST_ASSERT (q->z >= 0);
+  h ^= (h >> 29) ^ (uint64_t) (q->z >> shift) *
+    (uint64_t) 0x165667B19E3779F9ULL;
+#endif
+  return (size_t) (h ^ (h >> 32)) & table->mask;
+}
+
+/** Look up a quadrant of the table's level.
+ * \param [out] slot    If the quadrant is not found, the free slot that
+ *                      \ref p4est_balance_table_insert expects.
+ * \return              The quadrant in the table or NULL.
+ */
+static p4est_quadrant_t *
+p4est_balance_table_lookup (p4est_balance_table_t * table,
+                            const p4est_quadrant_t * q, size_t *slot)
+{
+  size_t              s, iz, nslots;
+  p4est_quadrant_t   *r;
+
+  nslots = table->mask + 1;
+  if (2 * (table->quads->elem_count + 1) > nslots) {
+    /* keep the load factor below one half */
+    P4EST_FREE (table->slots);
+    nslots *= 2;
+    table->mask = nslots - 1;
+    table->slots = P4EST_ALLOC_ZERO (size_t, nslots);
+    for (iz = 0; iz < table->quads->elem_count; ++iz) {
+      r = p4est_quadrant_array_index (table->quads, iz);
+      s = p4est_balance_table_hash (table, r);
+      while (table->slots[s] != 0) {
+        s = (s + 1) & table->mask;
+      }
+      table->slots[s] = iz + 1;
+    }
+  }
+
+  s = p4est_balance_table_hash (table, q);
+  while (table->slots[s] != 0) {
+    r = p4est_quadrant_array_index (table->quads, table->slots[s] - 1);
+    P4EST_ASSERT (r->level == q->level);
+    if (r->x == q->x && r->y == q->y
+#ifdef P4_TO_P8
+        && r->z == q->z
+#endif
+      ) {
+      return r;
+    }
+    s = (s + 1) & table->mask;
+  }
+  *slot = s;
+  return NULL;
+}
+
+/** Copy a quadrant into the table at the slot found by the lookup. */
+static void
+p4est_balance_table_insert (p4est_balance_table_t * table,
+                            const p4est_quadrant_t * q, size_t slot)
+{
+  P4EST_ASSERT (slot <= table->mask && table->slots[slot] == 0);
+
+  (void) p4est_quadrant_array_push_copy (table->quads, q);
+  table->slots[slot] = table->quads->elem_count;
+}
+
 /** Complete/balance a region of an tree.
  *
  * \param [in] inlist             List of quadrants to consider: should be
@@ -1548,6 +1659,10 @@ p4est_quadrant_disjoint_parent (const void *a, const void *b)
  *                                bound = 2**P4EST_DIM - 1 : edge balance
  * \param [in/out] qpool          quadrant pool for temporary quadrants
  * \param [in/out] list_alloc     list mempool for hash tables
+ * \param [in]     flat           If true, keep the new quadrants of each
+ *                                level by value in a \ref
+ *                                p4est_balance_table_t instead of hash
+ *                                tables and \a qpool.
  * \param [in/out] out            the sorted, complete, balance quadrants in
  *                                the region will be appended to out
  * \param [in]     first_desc     the first quadrant defining the start of the
@@ -1576,7 +1691,7 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
                                   p4est_quadrant_t * dom,
                                   int bound,
                                   sc_mempool_t * qpool,
-                                  sc_mempool_t * list_alloc,
+                                  sc_mempool_t * list_alloc, int flat,
                                   sc_array_t * out,
                                   p4est_quadrant_t * first_desc,
                                   p4est_quadrant_t * last_desc,
@@ -1594,6 +1709,7 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
 #endif
   size_t              count_already_inlist, count_already_outlist;
   size_t              count_ancestor_inlist;
+  size_t              slot;
   p4est_quadrant_t   *q, *p, *r;
   int                 minlevel = dom->level + 1, maxlevel;
   int                 sid, pid;
@@ -1604,10 +1720,11 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
   ssize_t             srindex, si;
   p4est_qcoord_t      ph;
   p4est_quadrant_t   *qalloc, *qlookup, **qpointer;
-  p4est_quadrant_t    par, tempq, tempp, fd, ld;
+  p4est_quadrant_t    par, tempq, tempp, fd, ld, qflat;
   sc_array_t         *olist;
   sc_hash_t          *hash[P4EST_MAXLEVEL + 1];
   sc_array_t          outlist[P4EST_MAXLEVEL + 1];
+  p4est_balance_table_t table[P4EST_MAXLEVEL + 1];
 
   P4EST_QUADRANT_INIT (&par);
   par.p.user_int = 0;
@@ -1622,6 +1739,7 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
 
   count_already_inlist = count_already_outlist = 0;
   count_ancestor_inlist = 0;
+  slot = 0;
 
 #ifdef P4EST_ENABLE_DEBUG
   /* to increment linear id */
@@ -1720,6 +1838,13 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
       memset (&outlist[l], -1, sizeof (sc_array_t));
     }
     for (; l < maxlevel; ++l) {
+      if (flat) {
+        /* the quadrants of this level are stored by value */
+        hash[l] = NULL;
+        sc_array_init (&outlist[l], sizeof (p4est_quadrant_t));
+        p4est_balance_table_init (&table[l], &outlist[l]);
+        continue;
+      }
       hash[l] = sc_hash_new (p4est_quadrant_hash_fn, p4est_quadrant_equal_fn,
                              NULL, list_alloc);
       sc_array_init (&outlist[l], sizeof (p4est_quadrant_t *));
@@ -1735,7 +1860,14 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
     /* walk through the input tree bottom-up */
     ph = 0;
     pid = -1;
-    qalloc = p4est_quadrant_mempool_alloc (qpool);
+    if (flat) {
+      /* new quadrants are copied into the table, no allocation needed */
+      P4EST_QUADRANT_INIT (&qflat);
+      qalloc = &qflat;
+    }
+    else {
+      qalloc = p4est_quadrant_mempool_alloc (qpool);
+    }
     qalloc->p.user_int = 0;
 
     /* we don't need to run for minlevel + 1, because all of the quads that
@@ -1751,6 +1883,11 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
             continue;
           }
         }
+        else if (flat) {
+          /* outlist[l] is not modified while we are reading it */
+          q = p4est_quadrant_array_index (&outlist[l], jz - incount);
+          P4EST_ASSERT ((int) q->level == l);
+        }
         else {
           qpointer =
             (p4est_quadrant_t **) sc_array_index (&outlist[l], jz - incount);
@@ -1830,13 +1967,20 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
           }
 
           /* make sure that qalloc is not included more than once */
-          inserted = sc_hash_insert_unique (hash[l - 1], qalloc, &vlookup);
+          if (flat) {
+            qlookup = p4est_balance_table_lookup (&table[l - 1], qalloc,
+                                                  &slot);
+            inserted = (qlookup == NULL);
+          }
+          else {
+            inserted = sc_hash_insert_unique (hash[l - 1], qalloc, &vlookup);
+            qlookup = inserted ? NULL : (p4est_quadrant_t *) * vlookup;
+          }
           if (!inserted) {
             /* qalloc is already included in output list, this catches most */
             ++count_already_outlist;
             if (!sid) {
               /* we need to relay the fact that this octant is precluded */
-              qlookup = (p4est_quadrant_t *) * vlookup;
               qlookup->p.user_int = precluded;
             }
             continue;
@@ -1876,6 +2020,12 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
             }
           }
 
+          if (flat) {
+            /* the table stores a copy and we reuse qalloc */
+            p4est_balance_table_insert (&table[l - 1], qalloc, slot);
+            qalloc->p.user_int = 0;
+            continue;
+          }
           qpointer = (p4est_quadrant_t **) sc_array_push (olist);
           *qpointer = qalloc;
           /* we need a new quadrant now, the old one is stored away */
@@ -1884,7 +2034,9 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
         }
       }
     }
-    sc_mempool_free (qpool, qalloc);
+    if (!flat) {
+      sc_mempool_free (qpool, qalloc);
+    }
 
     /* remove unneeded octants */
     jz = 0;
@@ -1904,6 +2056,28 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
     incount = jz;
 
     for (l = minlevel + 1; l < maxlevel; ++l) {
+      if (flat) {
+        /* the quadrants are stored by value and need not be freed */
+        p4est_balance_table_reset (&table[l]);
+        ocount = outlist[l].elem_count;
+        for (jz = 0; jz < ocount; ++jz) {
+          qalloc = p4est_quadrant_array_index (&outlist[l], jz);
+          P4EST_ASSERT ((int) qalloc->level == l);
+          P4EST_ASSERT (p4est_quadrant_is_ancestor (dom, qalloc));
+          P4EST_ASSERT (p4est_quadrant_child_id (qalloc) == 0);
+          if (qalloc->p.user_int == precluded ||
+              (first_desc != NULL &&
+               p4est_quadrant_compare (qalloc, &fd) < 0) ||
+              (last_desc != NULL &&
+               p4est_quadrant_compare (qalloc, last_desc) > 0)) {
+            continue;
+          }
+          (void) p4est_quadrant_array_push_copy (inlist, qalloc);
+        }
+        sc_array_reset (&outlist[l]);
+        continue;
+      }
+
       /* print statistics and free hash tables */
 #ifdef P4EST_ENABLE_DEBUG
       sc_hash_print_statistics (p4est_package_id, SC_LP_DEBUG, hash[l]);
@@ -1941,7 +2115,7 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
 
     /* sort inlist */
     if (inlist->elem_count > incount) {
-      sc_array_sort (inlist, p4est_quadrant_compare);
+      p4est_quadrant_array_sort (inlist);
     }
   }
 
@@ -2111,9 +2285,92 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
 
 }
 
+/** Shared context of balancing several local trees on threads. */
+typedef struct p4est_balance_threads
+{
+  p4est_t            *p4est;
+  p4est_connect_type_t btype;
+  p4est_init_t        init_fn;
+  p4est_replace_t     replace_fn;
+  sc_array_t         *which_trees;
+  sc_array_t         *borders;
+  int                 num_threads;
+  size_t              next_tree;        /**< protected by mutex */
+#ifdef SC_ENABLE_PTHREAD
+  pthread_mutex_t     mutex;            /**< also guards user_data_pool */
+#endif
+}
+p4est_balance_threads_t;
+
+/** Work context of one thread.  NULL is used by the serial functions. */
+typedef struct p4est_balance_work
+{
+  p4est_balance_threads_t *bt;
+  sc_mempool_t       *qpool;            /**< quadrant pool of this thread */
+  size_t              count_in, count_out;
+}
+p4est_balance_work_t;
+
+static void
+p4est_balance_work_lock (p4est_balance_work_t * w)
+{
+#ifdef SC_ENABLE_PTHREAD
+  if (w != NULL && w->bt->num_threads > 1) {
+    pthread_mutex_lock (&w->bt->mutex);
+  }
+#endif
+}
+
+static void
+p4est_balance_work_unlock (p4est_balance_work_t * w)
+{
+#ifdef SC_ENABLE_PTHREAD
+  if (w != NULL && w->bt->num_threads > 1) {
+    pthread_mutex_unlock (&w->bt->mutex);
+  }
+#endif
+}
+
+/** Thread-safe variant of \ref p4est_quadrant_init_data. */
+static void
+p4est_balance_init_data (p4est_t * p4est, p4est_balance_work_t * w,
+                         p4est_topidx_t which_tree, p4est_quadrant_t * quad,
+                         p4est_init_t init_fn)
+{
+  P4EST_ASSERT (p4est_quadrant_is_extended (quad));
+
+  if (p4est->data_size > 0) {
+    p4est_balance_work_lock (w);
+    quad->p.user_data = sc_mempool_alloc (p4est->user_data_pool);
+    p4est_balance_work_unlock (w);
+  }
+  else {
+    quad->p.user_data = NULL;
+  }
+  if (init_fn != NULL && p4est_quadrant_is_inside_root (quad)) {
+    init_fn (p4est, which_tree, quad);
+  }
+}
+
+/** Thread-safe variant of \ref p4est_quadrant_free_data. */
+static void
+p4est_balance_free_data (p4est_t * p4est, p4est_balance_work_t * w,
+                         p4est_quadrant_t * quad)
+{
+  P4EST_ASSERT (p4est_quadrant_is_extended (quad));
+
+  if (p4est->data_size > 0) {
+    p4est_balance_work_lock (w);
+    sc_mempool_free (p4est->user_data_pool, quad->p.user_data);
+    p4est_balance_work_unlock (w);
+  }
+  quad->p.user_data = NULL;
+}
+
 static void
-p4est_balance_replace_recursive (p4est_t * p4est, p4est_topidx_t nt,
-                                 sc_array_t * array, size_t start, size_t end,
+p4est_balance_replace_recursive (p4est_t * p4est, p4est_balance_work_t * w,
+                                 p4est_topidx_t nt, sc_array_t * array,
+                                 size_t start, size_t end,
                                  p4est_quadrant_t * parent,
                                  p4est_init_t init_fn,
                                  p4est_replace_t replace_fn)
@@ -2130,7 +2387,7 @@ p4est_balance_replace_recursive (p4est_t * p4est, p4est_topidx_t nt,
     }
     P4EST_ASSERT (p4est_quadrant_is_familypv (famp));
     replace_fn (p4est, nt, 1, &parent, P4EST_CHILDREN, famp);
-    p4est_quadrant_free_data (p4est, parent);
+    p4est_balance_free_data (p4est, w, parent);
     return;
   }
   sc_array_init_view (&view, array, start, end - start);
@@ -2147,15 +2404,15 @@ p4est_balance_replace_recursive (p4est_t * p4est, p4est_topidx_t nt,
       famp[jz] = &fam[jz];
       famp[jz]->level++;
       p4est_quadrant_sibling (famp[jz], famp[jz], (int) jz);
-      p4est_quadrant_init_data (p4est, nt, famp[jz], init_fn);
+      p4est_balance_init_data (p4est, w, nt, famp[jz], init_fn);
     }
   }
   replace_fn (p4est, nt, 1, &parent, P4EST_CHILDREN, famp);
-  p4est_quadrant_free_data (p4est, parent);
+  p4est_balance_free_data (p4est, w, parent);
 
   for (jz = 0; jz < P4EST_CHILDREN; jz++) {
     if (famp[jz] == &fam[jz]) {
-      p4est_balance_replace_recursive (p4est, nt, array, start + iz[jz],
+      p4est_balance_replace_recursive (p4est, w, nt, array, start + iz[jz],
                                        start + iz[jz + 1], famp[jz],
                                        init_fn, replace_fn);
     }
@@ -2163,7 +2420,8 @@ p4est_balance_replace_recursive (p4est_t * p4est, p4est_topidx_t nt,
 }
 
 static void
-p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
+p4est_complete_or_balance (p4est_t * p4est, p4est_balance_work_t * w,
+                           p4est_topidx_t which_tree,
                            p4est_init_t init_fn, p4est_replace_t replace_fn,
                            int btype)
 {
@@ -2214,7 +2472,7 @@ p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
     SC_ABORT_NOT_REACHED ();
   }
 
-  qpool = p4est->quadrant_pool;
+  qpool = w != NULL ? w->qpool : p4est->quadrant_pool;
 
 #ifdef P4EST_ENABLE_DEBUG
   data_pool_size = 0;
@@ -2271,7 +2529,10 @@ p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
 
   /* balance */
   p4est_complete_or_balance_kernel (inlist, &root, bound, qpool,
-                                    list_alloc, outlist,
+                                    list_alloc,
+                                    p4est->inspect != NULL
+                                    && p4est->inspect->use_balance_flat,
+                                    outlist,
                                     &(tree->first_desc),
                                     &(tree->last_desc),
                                     &count_already_inlist,
@@ -2294,7 +2555,7 @@ p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
       P4EST_ASSERT (!p4est_quadrant_is_ancestor (p, q));
       maxlevel = SC_MAX (maxlevel, p->level);
       ++tree->quadrants_per_level[p->level];
-      p4est_quadrant_init_data (p4est, which_tree, p, init_fn);
+      p4est_balance_init_data (p4est, w, which_tree, p, init_fn);
       jz++;
       P4EST_ASSERT (jz < ocount);
       p = p4est_quadrant_array_index (outlist, jz);
@@ -2306,7 +2567,7 @@ p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
       /* reset q */
       --tree->quadrants_per_level[q->level];
       if (replace_fn == NULL) {
-        p4est_quadrant_free_data (p4est, q);
+        p4est_balance_free_data (p4est, w, q);
       }
       else {
         tempq = *q;
@@ -2315,14 +2576,14 @@ p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
       while (jz < ocount && p4est_quadrant_is_ancestor (q, p)) {
         maxlevel = SC_MAX (maxlevel, p->level);
         ++tree->quadrants_per_level[p->level];
-        p4est_quadrant_init_data (p4est, which_tree, p, init_fn);
+        p4est_balance_init_data (p4est, w, which_tree, p, init_fn);
         if (++jz < ocount) {
           p = p4est_quadrant_array_index (outlist, jz);
         }
       }
       if (replace_fn != NULL) {
         jzend = jz;
-        p4est_balance_replace_recursive (p4est, which_tree,
+        p4est_balance_replace_recursive (p4est, w, which_tree,
                                          outlist, jzstart, jzend, &tempq,
                                          init_fn, replace_fn);
       }
@@ -2343,7 +2604,7 @@ p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
     p = p4est_quadrant_array_index (outlist, jz);
     maxlevel = SC_MAX (maxlevel, p->level);
     ++tree->quadrants_per_level[p->level];
-    p4est_quadrant_init_data (p4est, which_tree, p, init_fn);
+    p4est_balance_init_data (p4est, w, which_tree, p, init_fn);
   }
 
   /* resize tquadrants and copy */
@@ -2352,7 +2613,8 @@ p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
   tree->maxlevel = maxlevel;
 
   /* sanity check */
-  if (p4est->user_data_pool != NULL) {
+  if (p4est->user_data_pool != NULL &&
+      (w == NULL || w->bt->num_threads == 1)) {
     P4EST_ASSERT (data_pool_size + (ocount - tcount) ==
                   p4est->user_data_pool->elem_count);
   }
@@ -2368,7 +2630,11 @@ p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
   sc_array_destroy (outlist);
   sc_mempool_destroy (list_alloc);
 
-  if (p4est->inspect) {
+  if (w != NULL) {
+    w->count_in += count_already_inlist + count_ancestor_inlist;
+    w->count_out += count_already_outlist;
+  }
+  else if (p4est->inspect) {
     if (!p4est->inspect->use_B) {
       p4est->inspect->balance_A_count_in += count_already_inlist;
       p4est->inspect->balance_A_count_in += count_ancestor_inlist;
@@ -2382,10 +2648,11 @@ p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
   }
 }
 
-void
-p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
-                      p4est_topidx_t which_tree, p4est_init_t init_fn,
-                      p4est_replace_t replace_fn, sc_array_t * borders)
+static void
+p4est_balance_border_work (p4est_t * p4est, p4est_balance_work_t * w,
+                           p4est_connect_type_t btype,
+                           p4est_topidx_t which_tree, p4est_init_t init_fn,
+                           p4est_replace_t replace_fn, sc_array_t * borders)
 {
   size_t              iz, jz, kz;
   size_t              incount;
@@ -2442,7 +2709,7 @@ p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
   sc_array_init_view (&tqview, tquadrants, tqoffset,
                       tquadrants->elem_count - tqoffset);
 
-  qpool = p4est->quadrant_pool;
+  qpool = w != NULL ? w->qpool : p4est->quadrant_pool;
 
   count_already_inlist = count_already_outlist = 0;
   count_ancestor_inlist = 0;
@@ -2455,7 +2722,7 @@ p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
   flist = sc_array_new (sizeof (p4est_quadrant_t));
 
   /* sort the border and remove duplicates */
-  sc_array_sort (qarray, p4est_quadrant_compare);
+  p4est_quadrant_array_sort (qarray);
   jz = 1;                       /* number included */
   kz = 0;                       /* number skipped */
   p = p4est_quadrant_array_index (qarray, 0);
@@ -2538,7 +2805,7 @@ p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
     P4EST_ASSERT (p4est_quadrant_is_equal (q, p));
     /* reset the data, decrement level count */
     if (replace_fn == NULL) {
-      p4est_quadrant_free_data (p4est, q);
+      p4est_balance_free_data (p4est, w, q);
     }
     else {
       tempp = *q;
@@ -2569,6 +2836,8 @@ p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
 
     /* balance them within the containing quad */
     p4est_complete_or_balance_kernel (inlist, p, bound, qpool, list_alloc,
+                                      p4est->inspect != NULL
+                                      && p4est->inspect->use_balance_flat,
                                       flist, NULL, NULL,
                                       &count_already_inlist,
                                       &count_already_outlist,
@@ -2584,10 +2853,10 @@ p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
       P4EST_ASSERT (p4est_quadrant_is_ancestor (p, q));
       ++tree->quadrants_per_level[q->level];
       tree->maxlevel = (int8_t) SC_MAX (tree->maxlevel, q->level);
-      p4est_quadrant_init_data (p4est, which_tree, q, init_fn);
+      p4est_balance_init_data (p4est, w, which_tree, q, init_fn);
     }
     if (replace_fn != NULL) {
-      p4est_balance_replace_recursive (p4est, which_tree,
+      p4est_balance_replace_recursive (p4est, w, which_tree,
                                        flist, fcount, flist->elem_count,
                                        &tempp, init_fn, replace_fn);
     }
@@ -2625,25 +2894,38 @@ p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
 
   P4EST_ASSERT (p4est_tree_is_complete (tree));
 
-  if (p4est->inspect) {
+  if (w != NULL) {
+    w->count_in += count_already_inlist + count_ancestor_inlist;
+    w->count_out += count_already_outlist;
+  }
+  else if (p4est->inspect) {
     p4est->inspect->balance_B_count_in += count_already_inlist;
     p4est->inspect->balance_B_count_in += count_ancestor_inlist;
     p4est->inspect->balance_B_count_out += count_already_outlist;
   }
 }
 
+void
+p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
+                      p4est_topidx_t which_tree, p4est_init_t init_fn,
+                      p4est_replace_t replace_fn, sc_array_t * borders)
+{
+  p4est_balance_border_work (p4est, NULL, btype, which_tree,
+                             init_fn, replace_fn, borders);
+}
+
 void
 p4est_complete_subtree (p4est_t * p4est,
                         p4est_topidx_t which_tree, p4est_init_t init_fn)
 {
-  p4est_complete_or_balance (p4est, which_tree, init_fn, NULL, 0);
+  p4est_complete_or_balance (p4est, NULL, which_tree, init_fn, NULL, 0);
 }
 
 void
 p4est_balance_subtree (p4est_t * p4est, p4est_connect_type_t btype,
                        p4est_topidx_t which_tree, p4est_init_t init_fn)
 {
-  p4est_complete_or_balance (p4est, which_tree, init_fn, NULL,
+  p4est_complete_or_balance (p4est, NULL, which_tree, init_fn, NULL,
                              p4est_connect_type_int (btype));
 }
 
@@ -2652,10 +2934,125 @@ p4est_balance_subtree_ext (p4est_t * p4est, p4est_connect_type_t btype,
                            p4est_topidx_t which_tree, p4est_init_t init_fn,
                            p4est_replace_t replace_fn)
 {
-  p4est_complete_or_balance (p4est, which_tree, init_fn, replace_fn,
+  p4est_complete_or_balance (p4est, NULL, which_tree, init_fn, replace_fn,
                              p4est_connect_type_int (btype));
 }
 
+/** Balance the trees handed out by the shared context until none is left.
+ * With threads, each one uses its own quadrant pool for the balance kernel.
+ */
+static void
+p4est_balance_trees_work (p4est_balance_threads_t * bt)
+{
+  p4est_t            *p4est = bt->p4est;
+  size_t              iz;
+  p4est_topidx_t      nt;
+  p4est_balance_work_t work, *w = &work;
+
+  w->bt = bt;
+  w->qpool = bt->num_threads > 1 ?
+    sc_mempool_new (sizeof (p4est_quadrant_t)) : p4est->quadrant_pool;
+  w->count_in = w->count_out = 0;
+
+  for (;;) {
+    p4est_balance_work_lock (w);
+    iz = bt->next_tree++;
+    p4est_balance_work_unlock (w);
+    if (iz >= bt->which_trees->elem_count) {
+      break;
+    }
+    nt = *(p4est_topidx_t *) sc_array_index (bt->which_trees, iz);
+    if (bt->borders == NULL) {
+      p4est_complete_or_balance (p4est, w, nt, bt->init_fn, bt->replace_fn,
+                                 p4est_connect_type_int (bt->btype));
+    }
+    else {
+      p4est_balance_border_work (p4est, w, bt->btype, nt, bt->init_fn,
+                                 bt->replace_fn, bt->borders);
+    }
+  }
+  if (bt->num_threads > 1) {
+    sc_mempool_destroy (w->qpool);
+  }
+
+  /* add the statistics of this thread */
+  if (p4est->inspect != NULL) {
+    p4est_balance_work_lock (w);
+    if (bt->borders == NULL && !p4est->inspect->use_B) {
+      p4est->inspect->balance_A_count_in += w->count_in;
+      p4est->inspect->balance_A_count_out += w->count_out;
+    }
+    else {
+      p4est->inspect->balance_B_count_in += w->count_in;
+      p4est->inspect->balance_B_count_out += w->count_out;
+    }
+    p4est_balance_work_unlock (w);
+  }
+}
+
+#ifdef SC_ENABLE_PTHREAD
+
+static void        *
+p4est_balance_trees_run (void *v)
+{
+  p4est_balance_trees_work ((p4est_balance_threads_t *) v);
+  return NULL;
+}
+
+#endif /* SC_ENABLE_PTHREAD */
+
+void
+p4est_balance_trees (p4est_t * p4est, p4est_connect_type_t btype,
+                     int num_threads, sc_array_t * which_trees,
+                     p4est_init_t init_fn, p4est_replace_t replace_fn,
+                     sc_array_t * borders)
+{
+  p4est_balance_threads_t bt;
+#ifdef SC_ENABLE_PTHREAD
+  int                 i, retval;
+  pthread_t          *threads;
+#else
+  num_threads = 1;
+#endif
+
+  P4EST_ASSERT (which_trees->elem_size == sizeof (p4est_topidx_t));
+
+  bt.p4est = p4est;
+  bt.btype = btype;
+  bt.init_fn = init_fn;
+  bt.replace_fn = replace_fn;
+  bt.which_trees = which_trees;
+  bt.borders = borders;
+  bt.num_threads = SC_MAX (1, SC_MIN (num_threads,
+                                      (int) which_trees->elem_count));
+  bt.next_tree = 0;
+
+#ifdef SC_ENABLE_PTHREAD
+  if (bt.num_threads > 1) {
+    retval = pthread_mutex_init (&bt.mutex, NULL);
+    SC_CHECK_ABORT (retval == 0, "pthread_mutex_init");
+
+    /* the calling thread works as well */
+    threads = P4EST_ALLOC (pthread_t, bt.num_threads - 1);
+    for (i = 0; i < bt.num_threads - 1; ++i) {
+      retval = pthread_create (&threads[i], NULL,
+                               p4est_balance_trees_run, &bt);
+      SC_CHECK_ABORT (retval == 0, "pthread_create");
+    }
+    p4est_balance_trees_work (&bt);
+    for (i = 0; i < bt.num_threads - 1; ++i) {
+      retval = pthread_join (threads[i], NULL);
+      SC_CHECK_ABORT (retval == 0, "pthread_join");
+    }
+    P4EST_FREE (threads);
+    retval = pthread_mutex_destroy (&bt.mutex);
+    SC_CHECK_ABORT (retval == 0, "pthread_mutex_destroy");
+    return;
+  }
+#endif
+  p4est_balance_trees_work (&bt);
+}
+
 size_t
 p4est_linearize_tree (p4est_t * p4est, p4est_tree_t * tree)
 {
@@ -2804,9 +3201,41 @@ p4est_next_nonempty_process (int rank, int num_procs,
   return rank;
 }
 
+/** State of a partition between the begin and end of communication. */
+struct p4est_partition_given
+{
+  p4est_t            *p4est;
+  int                 num_proc_recv_from, num_proc_send_to;
+  char              **recv_buf, **send_buf;
+  p4est_locidx_t     *num_recv_from, *num_send_to;
+  p4est_locidx_t     *num_per_tree_local;
+  p4est_gloidx_t     *begin_send_to;
+  p4est_gloidx_t      from_begin_global_quad, from_end_global_quad;
+  p4est_gloidx_t      to_begin_global_quad, to_end_global_quad;
+  p4est_gloidx_t     *global_last_quad_index;
+  p4est_gloidx_t     *new_global_last_quad_index;
+  p4est_gloidx_t     *local_tree_last_quad_index;
+  p4est_gloidx_t      total_quadrants_shipped;
+#ifdef P4EST_ENABLE_MPI
+  MPI_Request        *recv_request, *send_request;
+#endif
+#ifdef P4EST_ENABLE_DEBUG
+  int                 send_to_empty;
+  unsigned            crc;
+#endif
+};
+
 p4est_gloidx_t
 p4est_partition_given (p4est_t * p4est,
                        const p4est_locidx_t * new_num_quadrants_in_proc)
+{
+  return p4est_partition_given_end
+    (p4est_partition_given_begin (p4est, new_num_quadrants_in_proc));
+}
+
+p4est_partition_given_t *
+p4est_partition_given_begin (p4est_t * p4est,
+                             const p4est_locidx_t * new_num_quadrants_in_proc)
 {
   const int           num_procs = p4est->mpisize;
   const int           rank = p4est->mpirank;
@@ -2825,27 +3254,18 @@ p4est_partition_given (p4est_t * p4est,
 
   int                 i;
   int                 from_proc, to_proc;
+  int                *intranode;
   int                 num_proc_recv_from, num_proc_send_to;
   char               *user_data_send_buf;
-  char               *user_data_recv_buf;
   char              **recv_buf, **send_buf;
-  size_t              recv_size, send_size, zz, zoffset;
-  p4est_topidx_t      it;
+  size_t              recv_size, send_size;
   p4est_topidx_t      which_tree;
-  p4est_topidx_t      first_tree, last_tree;
   p4est_topidx_t      num_recv_trees;
-  p4est_topidx_t      new_first_local_tree, new_last_local_tree;
-  p4est_topidx_t      first_from_tree, last_from_tree, from_tree;
   p4est_locidx_t      il;
   p4est_locidx_t      num_copy;
-  p4est_locidx_t      num_quadrants;
-  p4est_locidx_t      new_local_num_quadrants;
   p4est_locidx_t     *num_recv_from, *num_send_to;
-  p4est_locidx_t     *new_local_tree_elem_count;
-  p4est_locidx_t     *new_local_tree_elem_count_before;
   p4est_locidx_t     *num_per_tree_local;
   p4est_locidx_t     *num_per_tree_send_buf;
-  p4est_locidx_t     *num_per_tree_recv_buf;
   p4est_gloidx_t     *begin_send_to;
   p4est_gloidx_t      tree_from_begin, tree_from_end, num_copy_global;
   p4est_gloidx_t      from_begin, from_end, lower_bound,
@@ -2857,11 +3277,9 @@ p4est_partition_given (p4est_t * p4est,
   p4est_gloidx_t     *new_global_last_quad_index;
   p4est_gloidx_t     *local_tree_last_quad_index;
   p4est_gloidx_t      diff64, total_quadrants_shipped;
-  sc_array_t         *quadrants;
   p4est_quadrant_t   *quad_send_buf;
-  p4est_quadrant_t   *quad_recv_buf;
-  p4est_quadrant_t   *quad;
   p4est_tree_t       *tree;
+  p4est_partition_given_t *pg;
 #ifdef P4EST_ENABLE_MPI
   int                 sk;
   int                 mpiret;
@@ -2871,7 +3289,6 @@ p4est_partition_given (p4est_t * p4est,
 #ifdef P4EST_ENABLE_DEBUG
   int                 send_to_empty;
   unsigned            crc;
-  p4est_gloidx_t      my_begin_comp, my_end_comp;
   p4est_gloidx_t      total_requested_quadrants = 0;
 #endif
 
@@ -3221,6 +3638,22 @@ p4est_partition_given (p4est_t * p4est,
     }
   }
 
+  intranode = NULL;
+  if (p4est->inspect != NULL) {
+    p4est->inspect->partition_bytes_intranode = 0;
+    p4est->inspect->partition_bytes_internode = 0;
+
+    /* look up the node of all receivers at once */
+    if (to_begin_global_quad <= to_end_global_quad) {
+      intranode = P4EST_ALLOC (int, to_end_global_quad -
+                               to_begin_global_quad + 1);
+      p4est_comm_intranode_ranks (p4est, (int) to_begin_global_quad,
+                                  (int) (to_end_global_quad -
+                                         to_begin_global_quad + 1),
+                                  intranode);
+    }
+  }
+
   /* Allocate space for receiving quadrants and user data */
   for (to_proc = to_begin_global_quad
 #ifdef P4EST_ENABLE_MPI
@@ -3232,6 +3665,14 @@ p4est_partition_given (p4est_t * p4est,
         + quad_plus_data_size * num_send_to[to_proc];
 
       send_buf[to_proc] = P4EST_ALLOC (char, send_size);
+      if (intranode != NULL) {
+        if (intranode[to_proc - to_begin_global_quad] == 1) {
+          p4est->inspect->partition_bytes_intranode += send_size;
+        }
+        else if (intranode[to_proc - to_begin_global_quad] == 0) {
+          p4est->inspect->partition_bytes_internode += send_size;
+        }
+      }
 
       num_per_tree_send_buf = (p4est_locidx_t *) send_buf[to_proc];
       memset (num_per_tree_send_buf, 0,
@@ -3304,11 +3745,110 @@ p4est_partition_given (p4est_t * p4est,
 #endif
     }
   }
+  P4EST_FREE (intranode);
 #ifdef P4EST_ENABLE_MPI
   for (; sk < num_proc_send_to; ++sk) {
     send_request[sk] = MPI_REQUEST_NULL;
   }
+#endif
 
+  /* Save the state needed to complete the partition */
+  pg = P4EST_ALLOC (p4est_partition_given_t, 1);
+  pg->p4est = p4est;
+  pg->num_proc_recv_from = num_proc_recv_from;
+  pg->num_proc_send_to = num_proc_send_to;
+  pg->recv_buf = recv_buf;
+  pg->send_buf = send_buf;
+  pg->num_recv_from = num_recv_from;
+  pg->num_send_to = num_send_to;
+  pg->num_per_tree_local = num_per_tree_local;
+  pg->begin_send_to = begin_send_to;
+  pg->from_begin_global_quad = from_begin_global_quad;
+  pg->from_end_global_quad = from_end_global_quad;
+  pg->to_begin_global_quad = to_begin_global_quad;
+  pg->to_end_global_quad = to_end_global_quad;
+  pg->global_last_quad_index = global_last_quad_index;
+  pg->new_global_last_quad_index = new_global_last_quad_index;
+  pg->local_tree_last_quad_index = local_tree_last_quad_index;
+  pg->total_quadrants_shipped = total_quadrants_shipped;
+#ifdef P4EST_ENABLE_MPI
+  pg->recv_request = recv_request;
+  pg->send_request = send_request;
+#endif
+#ifdef P4EST_ENABLE_DEBUG
+  pg->send_to_empty = send_to_empty;
+  pg->crc = crc;
+#endif
+
+  return pg;
+}
+
+p4est_gloidx_t
+p4est_partition_given_end (p4est_partition_given_t * pg)
+{
+  p4est_t            *p4est = pg->p4est;
+  const int           num_procs = p4est->mpisize;
+  const int           rank = p4est->mpirank;
+  const p4est_topidx_t first_local_tree = p4est->first_local_tree;
+  const p4est_topidx_t last_local_tree = p4est->last_local_tree;
+  const size_t        data_size = p4est->data_size;
+  sc_array_t         *trees = p4est->trees;
+  const int           num_proc_recv_from = pg->num_proc_recv_from;
+  const int           num_proc_send_to = pg->num_proc_send_to;
+  char              **recv_buf = pg->recv_buf;
+  char              **send_buf = pg->send_buf;
+  p4est_locidx_t     *num_recv_from = pg->num_recv_from;
+  p4est_locidx_t     *num_send_to = pg->num_send_to;
+  p4est_locidx_t     *num_per_tree_local = pg->num_per_tree_local;
+  p4est_gloidx_t     *begin_send_to = pg->begin_send_to;
+  const p4est_gloidx_t from_begin_global_quad = pg->from_begin_global_quad;
+  const p4est_gloidx_t from_end_global_quad = pg->from_end_global_quad;
+  const p4est_gloidx_t to_begin_global_quad = pg->to_begin_global_quad;
+  const p4est_gloidx_t to_end_global_quad = pg->to_end_global_quad;
+  p4est_gloidx_t     *global_last_quad_index = pg->global_last_quad_index;
+  p4est_gloidx_t     *new_global_last_quad_index =
+    pg->new_global_last_quad_index;
+  p4est_gloidx_t     *local_tree_last_quad_index =
+    pg->local_tree_last_quad_index;
+  const p4est_gloidx_t total_quadrants_shipped = pg->total_quadrants_shipped;
+
+  int                 i;
+  int                 from_proc;
+  char               *user_data_recv_buf;
+  size_t              zz, zoffset;
+  p4est_topidx_t      it;
+  p4est_topidx_t      which_tree;
+  p4est_topidx_t      first_tree, last_tree;
+  p4est_topidx_t      num_recv_trees;
+  p4est_topidx_t      new_first_local_tree, new_last_local_tree;
+  p4est_topidx_t      first_from_tree, last_from_tree, from_tree;
+  p4est_locidx_t      num_copy;
+  p4est_locidx_t      num_quadrants;
+  p4est_locidx_t      new_local_num_quadrants;
+  p4est_locidx_t     *new_local_tree_elem_count;
+  p4est_locidx_t     *new_local_tree_elem_count_before;
+  p4est_locidx_t     *num_per_tree_recv_buf;
+  p4est_gloidx_t      tree_from_begin, tree_from_end;
+  p4est_gloidx_t      from_begin, from_end;
+  p4est_gloidx_t      my_base, my_begin, my_end;
+  sc_array_t         *quadrants;
+  p4est_quadrant_t   *quad_recv_buf;
+  p4est_quadrant_t   *quad;
+  p4est_tree_t       *tree;
+#ifdef P4EST_ENABLE_MPI
+  int                 mpiret;
+  MPI_Request        *recv_request = pg->recv_request;
+  MPI_Request        *send_request = pg->send_request;
+#endif
+#ifdef P4EST_ENABLE_DEBUG
+  const int           send_to_empty = pg->send_to_empty;
+  const unsigned      crc = pg->crc;
+  p4est_gloidx_t      my_begin_comp, my_end_comp;
+#endif
+
+  P4EST_FREE (pg);
+
+#ifdef P4EST_ENABLE_MPI
   /* Fill in forest */
   mpiret =
     sc_MPI_Waitall (num_proc_recv_from, recv_request, MPI_STATUSES_IGNORE);
@@ -3601,8 +4141,13 @@ p4est_partition_given (p4est_t * p4est,
   P4EST_ASSERT (p4est->global_num_quadrants ==
                 new_global_last_quad_index[num_procs - 1] + 1);
   P4EST_ASSERT (p4est->global_first_quadrant[0] == 0);
-  for (i = 0; i < num_procs; ++i) {
-    p4est->global_first_quadrant[i + 1] = global_last_quad_index[i] + 1;
+  if (p4est->shared == NULL || p4est_shared_write_begin (p4est->shared)) {
+    for (i = 0; i < num_procs; ++i) {
+      p4est->global_first_quadrant[i + 1] = global_last_quad_index[i] + 1;
+    }
+  }
+  if (p4est->shared != NULL) {
+    p4est_shared_write_end (p4est->shared);
   }
   P4EST_FREE (new_global_last_quad_index);
   global_last_quad_index = new_global_last_quad_index = NULL;
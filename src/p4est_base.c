@@ -163,3 +163,312 @@ p4est_version_minor (void)
   /* In rare cases SC_VERSION_MAJOR may be a non-numerical string */
   return sc_atoi (SC_TOSTRING (P4EST_VERSION_MINOR));
 }
+
+#if defined P4EST_ENABLE_MPIWINSHARED && defined P4EST_ENABLE_MPICOMMSHARED
+#define P4EST_SHARED_WINDOW
+#endif
+
+struct p4est_shared
+{
+  size_t              size;     /**< bytes in the array */
+  void               *array;    /**< the array in this process's memory */
+  int                 writer;   /**< first process of its node? */
+#ifdef P4EST_SHARED_WINDOW
+  MPI_Win             win;      /**< shared window on the node */
+  MPI_Comm            intranode;        /**< duplicate of node communicator */
+  MPI_Comm            internode;        /**< writers of all nodes or NULL */
+  int                 node;     /**< index of this process's node */
+  int                 num_nodes;        /**< number of compute nodes */
+  int                *node_first;       /**< first process of every node */
+#endif
+};
+
+#ifdef P4EST_SHARED_WINDOW
+
+/** Communicator attribute that allows node-shared memory. */
+static int          p4est_shared_keyval = MPI_KEYVAL_INVALID;
+
+/** Attribute of MPI_COMM_SELF whose deletion frees the keyvals. */
+static int          p4est_shared_final_keyval = MPI_KEYVAL_INVALID;
+
+/** Called at the beginning of MPI_Finalize, when the attributes of
+ * MPI_COMM_SELF are deleted, to release the keyvals created here. */
+static int
+p4est_shared_finalize (MPI_Comm comm, int keyval, void *attr, void *extra)
+{
+  int                 mpiret;
+
+  mpiret = MPI_Comm_free_keyval (&p4est_shared_keyval);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_free_keyval (&p4est_shared_final_keyval);
+  SC_CHECK_MPI (mpiret);
+
+  return MPI_SUCCESS;
+}
+
+#endif
+
+void
+p4est_shared_set_enabled (sc_MPI_Comm mpicomm, int enabled)
+{
+#ifdef P4EST_SHARED_WINDOW
+  int                 mpiret;
+
+  if (p4est_shared_keyval == MPI_KEYVAL_INVALID) {
+    /* the attribute carries no value and is copied on duplication */
+    mpiret = MPI_Comm_create_keyval (MPI_COMM_DUP_FN, MPI_COMM_NULL_DELETE_FN,
+                                     &p4est_shared_keyval, NULL);
+    SC_CHECK_MPI (mpiret);
+
+    /* free the keyval when MPI is finalized */
+    mpiret = MPI_Comm_create_keyval (MPI_COMM_NULL_COPY_FN,
+                                     p4est_shared_finalize,
+                                     &p4est_shared_final_keyval, NULL);
+    SC_CHECK_MPI (mpiret);
+    mpiret = MPI_Comm_set_attr (MPI_COMM_SELF, p4est_shared_final_keyval,
+                                NULL);
+    SC_CHECK_MPI (mpiret);
+  }
+  if (enabled) {
+    mpiret = MPI_Comm_set_attr (mpicomm, p4est_shared_keyval,
+                                &p4est_shared_keyval);
+  }
+  else {
+    mpiret = MPI_Comm_delete_attr (mpicomm, p4est_shared_keyval);
+  }
+  SC_CHECK_MPI (mpiret);
+#endif
+}
+
+int
+p4est_shared_is_enabled (sc_MPI_Comm mpicomm)
+{
+#ifdef P4EST_SHARED_WINDOW
+  int                 mpiret, flag;
+  void               *value;
+
+  if (p4est_shared_keyval == MPI_KEYVAL_INVALID ||
+      mpicomm == MPI_COMM_NULL) {
+    return 0;
+  }
+  mpiret = MPI_Comm_get_attr (mpicomm, p4est_shared_keyval, &value, &flag);
+  SC_CHECK_MPI (mpiret);
+  return flag;
+#else
+  return 0;
+#endif
+}
+
+p4est_shared_t     *
+p4est_shared_new (sc_MPI_Comm mpicomm, size_t size)
+{
+#ifdef P4EST_SHARED_WINDOW
+  int                 mpiret;
+  int                 mpisize, mpirank, intrarank;
+  int                 p, leader, contiguous;
+  int                *leaders;
+  int                 disp_unit;
+  MPI_Aint            win_size;
+  MPI_Comm            intranode, internode;
+  p4est_shared_t     *shared;
+
+  if (!p4est_shared_is_enabled (mpicomm)) {
+    return NULL;
+  }
+  sc_mpi_comm_get_node_comms (mpicomm, &intranode, &internode);
+  if (intranode == MPI_COMM_NULL) {
+    return NULL;
+  }
+  mpiret = MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (intranode, &intrarank);
+  SC_CHECK_MPI (mpiret);
+
+  /* gathering by nodes requires the processes of each node in sequence */
+  mpiret = MPI_Allreduce (&mpirank, &leader, 1, MPI_INT, MPI_MIN, intranode);
+  SC_CHECK_MPI (mpiret);
+  leaders = P4EST_ALLOC (int, mpisize);
+  mpiret = MPI_Allgather (&leader, 1, MPI_INT, leaders, 1, MPI_INT, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  contiguous = 1;
+  for (p = 0; p < mpisize; ++p) {
+    if (leaders[p] != p && (p == 0 || leaders[p] != leaders[p - 1])) {
+      contiguous = 0;
+      break;
+    }
+  }
+  if (!contiguous || mpisize == 1) {
+    P4EST_FREE (leaders);
+    return NULL;
+  }
+  P4EST_ASSERT (leader == mpirank - intrarank);
+
+  /* remember the node layout */
+  shared = P4EST_ALLOC_ZERO (p4est_shared_t, 1);
+  shared->size = size;
+  shared->writer = (intrarank == 0);
+  shared->node_first = P4EST_ALLOC (int, mpisize + 1);
+  for (p = 0; p < mpisize; ++p) {
+    if (leaders[p] == p) {
+      if (p == leader) {
+        shared->node = shared->num_nodes;
+      }
+      shared->node_first[shared->num_nodes++] = p;
+    }
+  }
+  shared->node_first[shared->num_nodes] = mpisize;
+  shared->node_first = P4EST_REALLOC (shared->node_first, int,
+                                      shared->num_nodes + 1);
+  P4EST_FREE (leaders);
+
+  /* keep the node communicators valid even if mpicomm is freed */
+  mpiret = MPI_Comm_dup (intranode, &shared->intranode);
+  SC_CHECK_MPI (mpiret);
+  shared->internode = MPI_COMM_NULL;
+  if (shared->writer) {
+    mpiret = MPI_Comm_dup (internode, &shared->internode);
+    SC_CHECK_MPI (mpiret);
+  }
+
+  /* the writer allocates the memory and every process maps it */
+  mpiret = MPI_Win_allocate_shared ((MPI_Aint) (shared->writer ? size : 0),
+                                    1, MPI_INFO_NULL, shared->intranode,
+                                    &shared->array, &shared->win);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Win_shared_query (shared->win, 0, &win_size, &disp_unit,
+                                 &shared->array);
+  SC_CHECK_MPI (mpiret);
+  P4EST_ASSERT ((size_t) win_size == size);
+  mpiret = MPI_Win_lock_all (MPI_MODE_NOCHECK, shared->win);
+  SC_CHECK_MPI (mpiret);
+
+  return shared;
+#else
+  return NULL;
+#endif
+}
+
+void
+p4est_shared_destroy (p4est_shared_t * shared)
+{
+#ifdef P4EST_SHARED_WINDOW
+  int                 mpiret;
+
+  P4EST_ASSERT (shared != NULL);
+
+  mpiret = MPI_Win_unlock_all (shared->win);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Win_free (&shared->win);
+  SC_CHECK_MPI (mpiret);
+  if (shared->internode != MPI_COMM_NULL) {
+    mpiret = MPI_Comm_free (&shared->internode);
+    SC_CHECK_MPI (mpiret);
+  }
+  mpiret = MPI_Comm_free (&shared->intranode);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (shared->node_first);
+#endif
+  P4EST_FREE (shared);
+}
+
+void               *
+p4est_shared_array (p4est_shared_t * shared)
+{
+  P4EST_ASSERT (shared != NULL);
+
+  return shared->array;
+}
+
+size_t
+p4est_shared_memory_used (p4est_shared_t * shared)
+{
+  size_t              size;
+
+  P4EST_ASSERT (shared != NULL);
+
+  size = sizeof (p4est_shared_t);
+#ifdef P4EST_SHARED_WINDOW
+  size += (shared->num_nodes + 1) * sizeof (int);
+#endif
+  if (shared->writer) {
+    size += shared->size;
+  }
+  return size;
+}
+
+int
+p4est_shared_write_begin (p4est_shared_t * shared)
+{
+#ifdef P4EST_SHARED_WINDOW
+  int                 mpiret;
+
+  P4EST_ASSERT (shared != NULL);
+
+  /* wait until all processes of the node are done reading */
+  mpiret = MPI_Barrier (shared->intranode);
+  SC_CHECK_MPI (mpiret);
+#endif
+
+  return shared->writer;
+}
+
+void
+p4est_shared_write_end (p4est_shared_t * shared)
+{
+#ifdef P4EST_SHARED_WINDOW
+  int                 mpiret;
+
+  P4EST_ASSERT (shared != NULL);
+
+  /* publish the writer's stores to the other processes of the node */
+  mpiret = MPI_Win_sync (shared->win);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Barrier (shared->intranode);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Win_sync (shared->win);
+  SC_CHECK_MPI (mpiret);
+#endif
+}
+
+void
+p4est_shared_allgather (p4est_shared_t * shared, const void *item,
+                        size_t item_size, size_t offset)
+{
+#ifdef P4EST_SHARED_WINDOW
+  int                 mpiret;
+  int                 k;
+  int                *counts, *displs;
+  char               *dest;
+
+  P4EST_ASSERT (shared != NULL);
+  P4EST_ASSERT (offset + shared->node_first[shared->num_nodes] * item_size
+                <= shared->size);
+  P4EST_ASSERT (shared->node_first[shared->num_nodes] * item_size
+                <= (size_t) INT_MAX);
+
+  /* the writer collects the items of its node in rank order */
+  dest = (char *) shared->array + offset;
+  mpiret = MPI_Gather ((void *) item, (int) item_size, MPI_BYTE,
+                       shared->writer ?
+                       dest + shared->node_first[shared->node] * item_size :
+                       NULL, (int) item_size, MPI_BYTE, 0, shared->intranode);
+  SC_CHECK_MPI (mpiret);
+
+  /* the writers exchange the items of their nodes */
+  if (shared->writer && shared->num_nodes > 1) {
+    counts = P4EST_ALLOC (int, 2 * shared->num_nodes);
+    displs = counts + shared->num_nodes;
+    for (k = 0; k < shared->num_nodes; ++k) {
+      counts[k] = (int) ((shared->node_first[k + 1] - shared->node_first[k])
+                         * item_size);
+      displs[k] = (int) (shared->node_first[k] * item_size);
+    }
+    mpiret = MPI_Allgatherv (MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, dest,
+                             counts, displs, MPI_BYTE, shared->internode);
+    SC_CHECK_MPI (mpiret);
+    P4EST_FREE (counts);
+  }
+#endif
+}
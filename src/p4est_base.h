@@ -154,6 +154,7 @@ typedef enum p4est_comm_tag
   P4EST_COMM_LNODES_PASS,
   P4EST_COMM_LNODES_OWNED,
   P4EST_COMM_LNODES_ALL,
+  P4EST_COMM_GHOST_PLAN,
   P4EST_COMM_TAG_LAST
 }
 p4est_comm_tag_t;
@@ -568,6 +569,88 @@ int                 p4est_version_major (void);
  */
 int                 p4est_version_minor (void);
 
+/** Opaque handle to an array held once per compute node.
+ * The array lives in an MPI-3 shared memory window on the node
+ * communicator attached by sc_mpi_comm_attach_node_comms.
+ * The first process of each node writes it and all processes read it.
+ */
+typedef struct p4est_shared p4est_shared_t;
+
+/** Allow or forbid node-shared memory for objects created on a communicator.
+ * When allowed, \ref p4est_new_ext and \ref p4est_load_ext place the
+ * connectivity and the global partition arrays into one shared window per
+ * compute node, and \ref p4est_copy_ext does so for the partition arrays.
+ * The keyval of the attribute is freed when MPI is finalized.
+ * The setting is cached as an attribute of the communicator and inherited
+ * by its duplicates.  It has no effect without MPI-3 shared windows.
+ * This function must be called by all processes of \a mpicomm.
+ * \param [in] mpicomm  The communicator to configure.
+ * \param [in] enabled  Boolean to allow node-shared memory.
+ */
+void                p4est_shared_set_enabled (sc_MPI_Comm mpicomm,
+                                              int enabled);
+
+/** Query whether node-shared memory is allowed on a communicator.
+ * \param [in] mpicomm  The communicator to query.
+ * \return              True if \ref p4est_shared_set_enabled allowed it
+ *                      and MPI-3 shared windows are available.
+ */
+int                 p4est_shared_is_enabled (sc_MPI_Comm mpicomm);
+
+/** Allocate an array shared by the processes of each compute node.
+ * This function is collective over \a mpicomm.
+ * \param [in] mpicomm  Communicator with node communicators attached.
+ *                      The processes of each node must be consecutive.
+ * \param [in] size     Number of bytes of the array.
+ * \return              The handle, or NULL on all processes if shared
+ *                      memory is not enabled or not available.
+ */
+p4est_shared_t     *p4est_shared_new (sc_MPI_Comm mpicomm, size_t size);
+
+/** Free a node-shared array.
+ * This function is collective over the processes of the node.
+ * \param [in] shared   Handle from \ref p4est_shared_new.
+ */
+void                p4est_shared_destroy (p4est_shared_t * shared);
+
+/** Return the address of the node-shared array in this process. */
+void               *p4est_shared_array (p4est_shared_t * shared);
+
+/** Return the number of bytes this process accounts for.
+ * The array is counted on the writing process of each node only,
+ * such that the sum over all processes is the memory actually used.
+ */
+size_t              p4est_shared_memory_used (p4est_shared_t * shared);
+
+/** Begin to modify a node-shared array.
+ * This function is collective over the processes of the node.
+ * It waits until no process reads the array anymore.
+ * Between this call and \ref p4est_shared_write_end only the
+ * writing process may access the array.
+ * \param [in] shared   Handle from \ref p4est_shared_new.
+ * \return              True if this process is the writer of its node.
+ */
+int                 p4est_shared_write_begin (p4est_shared_t * shared);
+
+/** Finish modifying a node-shared array and make it visible to all.
+ * This function is collective over the processes of the node.
+ */
+void                p4est_shared_write_end (p4est_shared_t * shared);
+
+/** Gather an item from every process into a node-shared array.
+ * Item p goes to byte offset \a offset + p * \a item_size of the array.
+ * This function is collective over the communicator of \a shared
+ * and must be called between \ref p4est_shared_write_begin and
+ * \ref p4est_shared_write_end.
+ * \param [in] shared     Handle from \ref p4est_shared_new.
+ * \param [in] item       This process's contribution.
+ * \param [in] item_size  Bytes per item, the same on all processes.
+ * \param [in] offset     Byte offset of the gathered items in the array.
+ */
+void                p4est_shared_allgather (p4est_shared_t * shared,
+                                            const void *item,
+                                            size_t item_size, size_t offset);
+
 SC_EXTERN_C_END;
 
 #endif /* !P4EST_BASE_H */
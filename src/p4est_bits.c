@@ -30,6 +30,15 @@
 #include <p4est_extended.h>
 #endif /* !P4_TO_P8 */
 
+/* With BMI2 available at compile time (for example by -mbmi2 or
+ * -march=native), bit interleaving uses the PDEP/PEXT instructions.
+ * Otherwise we fall back to a branch-free sequence of magic masks.
+ * Define P4EST_MORTON_NO_BMI2 to force the portable variant. */
+#if defined (__BMI2__) && !defined (P4EST_MORTON_NO_BMI2)
+#include <immintrin.h>
+#define P4EST_MORTON_BMI2
+#endif
+
 /* Function declarations for 128 bit unsigned integers
  * are in p{4,8}est_extended.h. */
 int
@@ -273,14 +282,6 @@ p4est_lid_bitwise_and_inplace (p4est_lid_t * a, const p4est_lid_t * b)
 #endif
 }
 
-static void
-p4est_qcoord_set_bit (p4est_qcoord_t * input, int bit_number)
-{
-  P4EST_ASSERT (input != NULL);
-  P4EST_ASSERT (bit_number >= 0 && bit_number < P4EST_QCOORD_BITS);
-  *input |= ((p4est_qcoord_t) 1) << bit_number;
-}
-
 void
 p4est_quadrant_pad (p4est_quadrant_t * q)
 {
@@ -2343,11 +2344,73 @@ p4est_quadrant_shift_corner (const p4est_quadrant_t * q,
   P4EST_ASSERT (p4est_quadrant_touches_corner (r, corner, 1));
 }
 
+/* Every P4EST_DIM-th bit of a 64-bit Morton word belongs to one coordinate.
+ * A single word holds P4EST_MORTON_BITS bits per coordinate. */
+#ifndef P4_TO_P8
+#define P4EST_MORTON_MASK ((uint64_t) 0x5555555555555555ULL)
+#define P4EST_MORTON_BITS 32
+#else
+#define P4EST_MORTON_MASK ((uint64_t) 0x1249249249249249ULL)
+#define P4EST_MORTON_BITS 21
+#endif
+
+/** Spread the low P4EST_MORTON_BITS bits of a coordinate
+ * such that bit i is moved to bit P4EST_DIM * i of the result. */
+static inline uint64_t
+p4est_morton_spread (uint64_t c)
+{
+#ifdef P4EST_MORTON_BMI2
+  return _pdep_u64 (c, P4EST_MORTON_MASK);
+#else
+#ifndef P4_TO_P8
+  c &= (uint64_t) 0x00000000FFFFFFFFULL;
+  c = (c | (c << 16)) & (uint64_t) 0x0000FFFF0000FFFFULL;
+  c = (c | (c << 8)) & (uint64_t) 0x00FF00FF00FF00FFULL;
+  c = (c | (c << 4)) & (uint64_t) 0x0F0F0F0F0F0F0F0FULL;
+  c = (c | (c << 2)) & (uint64_t) 0x3333333333333333ULL;
+  c = (c | (c << 1)) & P4EST_MORTON_MASK;
+#else
+  c &= (uint64_t) 0x00000000001FFFFFULL;
+  c = (c | (c << 32)) & (uint64_t) 0x001F00000000FFFFULL;
+  c = (c | (c << 16)) & (uint64_t) 0x001F0000FF0000FFULL;
+  c = (c | (c << 8)) & (uint64_t) 0x100F00F00F00F00FULL;
+  c = (c | (c << 4)) & (uint64_t) 0x10C30C30C30C30C3ULL;
+  c = (c | (c << 2)) & P4EST_MORTON_MASK;
+#endif
+  return c;
+#endif
+}
+
+/** Inverse of \ref p4est_morton_spread: gather every P4EST_DIM-th bit
+ * of a Morton word, beginning with bit 0, into a contiguous integer. */
+static inline uint64_t
+p4est_morton_compact (uint64_t m)
+{
+#ifdef P4EST_MORTON_BMI2
+  return _pext_u64 (m, P4EST_MORTON_MASK);
+#else
+  m &= P4EST_MORTON_MASK;
+#ifndef P4_TO_P8
+  m = (m | (m >> 1)) & (uint64_t) 0x3333333333333333ULL;
+  m = (m | (m >> 2)) & (uint64_t) 0x0F0F0F0F0F0F0F0FULL;
+  m = (m | (m >> 4)) & (uint64_t) 0x00FF00FF00FF00FFULL;
+  m = (m | (m >> 8)) & (uint64_t) 0x0000FFFF0000FFFFULL;
+  m = (m | (m >> 16)) & (uint64_t) 0x00000000FFFFFFFFULL;
+#else
+  m = (m | (m >> 2)) & (uint64_t) 0x10C30C30C30C30C3ULL;
+  m = (m | (m >> 4)) & (uint64_t) 0x100F00F00F00F00FULL;
+  m = (m | (m >> 8)) & (uint64_t) 0x001F0000FF0000FFULL;
+  m = (m | (m >> 16)) & (uint64_t) 0x001F00000000FFFFULL;
+  m = (m | (m >> 32)) & (uint64_t) 0x00000000001FFFFFULL;
+#endif
+  return m;
+#endif
+}
+
 uint64_t
 p4est_quadrant_linear_id (const p4est_quadrant_t * quadrant, int level)
 {
-  int                 i;
-  uint64_t            id;
+  uint64_t            id, mask;
   uint64_t            x, y;
 #ifdef P4_TO_P8
   uint64_t            z;
@@ -2355,22 +2418,20 @@ p4est_quadrant_linear_id (const p4est_quadrant_t * quadrant, int level)
 
   P4EST_ASSERT (p4est_quadrant_is_extended (quadrant));
   P4EST_ASSERT (0 <= level && level <= P4EST_OLD_MAXLEVEL);
+  P4EST_ASSERT (level + 2 <= P4EST_MORTON_BITS);
 
   /* this preserves the high bits from negative numbers */
-  x = quadrant->x >> (P4EST_MAXLEVEL - level);
-  y = quadrant->y >> (P4EST_MAXLEVEL - level);
+  mask = ((uint64_t) 1 << (level + 2)) - 1;
+  x = (uint64_t) (quadrant->x >> (P4EST_MAXLEVEL - level)) & mask;
+  y = (uint64_t) (quadrant->y >> (P4EST_MAXLEVEL - level)) & mask;
 #ifdef P4_TO_P8
-  z = quadrant->z >> (P4EST_MAXLEVEL - level);
+  z = (uint64_t) (quadrant->z >> (P4EST_MAXLEVEL - level)) & mask;
 #endif
 
-  id = 0;
-  for (i = 0; i < level + 2; ++i) {
-    id |= ((x & ((uint64_t) 1 << i)) << ((P4EST_DIM - 1) * i));
-    id |= ((y & ((uint64_t) 1 << i)) << ((P4EST_DIM - 1) * i + 1));
+  id = p4est_morton_spread (x) | (p4est_morton_spread (y) << 1);
 #ifdef P4_TO_P8
-    id |= ((z & ((uint64_t) 1 << i)) << ((P4EST_DIM - 1) * i + 2));
+  id |= p4est_morton_spread (z) << 2;
 #endif
-  }
 
   return id;
 }
@@ -2379,62 +2440,58 @@ void
 p4est_quadrant_linear_id_ext128 (const p4est_quadrant_t *
                                  quadrant, int level, p4est_lid_t * id)
 {
-  int                 i;
+  uint64_t            mask;
   uint64_t            x, y;
 #ifdef P4_TO_P8
   uint64_t            z;
+  uint64_t            low, high;
 #endif
 
   P4EST_ASSERT (p4est_quadrant_is_extended (quadrant));
   P4EST_ASSERT (0 <= level && level <= P4EST_MAXLEVEL);
 
   /* this preserves the high bits from negative numbers */
-  x = quadrant->x >> (P4EST_MAXLEVEL - level);
-  y = quadrant->y >> (P4EST_MAXLEVEL - level);
+  mask = ((uint64_t) 1 << (level + 2)) - 1;
+  x = (uint64_t) (quadrant->x >> (P4EST_MAXLEVEL - level)) & mask;
+  y = (uint64_t) (quadrant->y >> (P4EST_MAXLEVEL - level)) & mask;
 #ifdef P4_TO_P8
-  z = quadrant->z >> (P4EST_MAXLEVEL - level);
+  z = (uint64_t) (quadrant->z >> (P4EST_MAXLEVEL - level)) & mask;
 #endif
 
-  p4est_lid_set_zero (id);
-  for (i = 0; i < level + 2; ++i) {
-    if (x & ((uint64_t) 1 << i))
-      p4est_lid_set_bit (id, P4EST_DIM * i);
-    if (y & ((uint64_t) 1 << i))
-      p4est_lid_set_bit (id, P4EST_DIM * i + 1);
-#ifdef P4_TO_P8
-    if (z & ((uint64_t) 1 << i))
-      p4est_lid_set_bit (id, P4EST_DIM * i + 2);
+#ifndef P4_TO_P8
+  P4EST_ASSERT (level + 2 <= P4EST_MORTON_BITS);
+  *id = p4est_morton_spread (x) | (p4est_morton_spread (y) << 1);
+#else
+  /* the low P4EST_MORTON_BITS bits of each coordinate fill bits 0..62 */
+  low = p4est_morton_spread (x) | (p4est_morton_spread (y) << 1) |
+    (p4est_morton_spread (z) << 2);
+
+  /* the remaining coordinate bits are interleaved starting at bit 63 */
+  x >>= P4EST_MORTON_BITS;
+  y >>= P4EST_MORTON_BITS;
+  z >>= P4EST_MORTON_BITS;
+  high = p4est_morton_spread (x) | (p4est_morton_spread (y) << 1) |
+    (p4est_morton_spread (z) << 2);
+
+  p4est_lid_init (id, high >> 1, low | (high << 63));
 #endif
-  }
 }
 
 void
 p4est_quadrant_set_morton (p4est_quadrant_t * quadrant,
                            int level, uint64_t id)
 {
-  int                 i;
-
   P4EST_ASSERT (0 <= level && level <= P4EST_OLD_QMAXLEVEL);
   P4EST_ASSERT (id < ((uint64_t) 1 << P4EST_DIM * (level + 2)));
 
   quadrant->level = (int8_t) level;
-  quadrant->x = 0;
-  quadrant->y = 0;
-#ifdef P4_TO_P8
-  quadrant->z = 0;
-#endif
 
   /* this may set the sign bit to create negative numbers */
-  for (i = 0; i < level + 2; ++i) {
-    quadrant->x |= (p4est_qcoord_t) ((id & (1ULL << (P4EST_DIM * i)))
-                                     >> ((P4EST_DIM - 1) * i));
-    quadrant->y |= (p4est_qcoord_t) ((id & (1ULL << (P4EST_DIM * i + 1)))
-                                     >> ((P4EST_DIM - 1) * i + 1));
+  quadrant->x = (p4est_qcoord_t) p4est_morton_compact (id);
+  quadrant->y = (p4est_qcoord_t) p4est_morton_compact (id >> 1);
 #ifdef P4_TO_P8
-    quadrant->z |= (p4est_qcoord_t) ((id & (1ULL << (P4EST_DIM * i + 2)))
-                                     >> ((P4EST_DIM - 1) * i + 2));
+  quadrant->z = (p4est_qcoord_t) p4est_morton_compact (id >> 2);
 #endif
-  }
 
   quadrant->x <<= (P4EST_MAXLEVEL - level);
   quadrant->y <<= (P4EST_MAXLEVEL - level);
@@ -2460,7 +2517,9 @@ void
 p4est_quadrant_set_morton_ext128 (p4est_quadrant_t * quadrant,
                                   int level, const p4est_lid_t * id)
 {
-  int                 i;
+#ifdef P4_TO_P8
+  uint64_t            low, high;
+#endif
 #ifdef P4EST_ENABLE_DEBUG
   p4est_lid_t         one, temp_lid;
 #endif
@@ -2474,25 +2533,26 @@ p4est_quadrant_set_morton_ext128 (p4est_quadrant_t * quadrant,
 #endif
 
   quadrant->level = (int8_t) level;
-  quadrant->x = 0;
-  quadrant->y = 0;
-#ifdef P4_TO_P8
-  quadrant->z = 0;
-#endif
 
   /* this may set the sign bit to create negative numbers */
-  for (i = 0; i < level + 2; ++i) {
-    if (p4est_lid_chk_bit (id, P4EST_DIM * i))
-      p4est_qcoord_set_bit (&quadrant->x, i);
-
-    if (p4est_lid_chk_bit (id, P4EST_DIM * i + 1))
-      p4est_qcoord_set_bit (&quadrant->y, i);
-
-#ifdef P4_TO_P8
-    if (p4est_lid_chk_bit (id, P4EST_DIM * i + 2))
-      p4est_qcoord_set_bit (&quadrant->z, i);
+#ifndef P4_TO_P8
+  P4EST_ASSERT (level + 2 <= P4EST_MORTON_BITS);
+  quadrant->x = (p4est_qcoord_t) p4est_morton_compact (*id);
+  quadrant->y = (p4est_qcoord_t) p4est_morton_compact (*id >> 1);
+#else
+  /* bits 0..62 hold the low P4EST_MORTON_BITS bits of each coordinate */
+  low = id->low_bits & (((uint64_t) 1 << 63) - 1);
+  high = (id->low_bits >> 63) | (id->high_bits << 1);
+  quadrant->x = (p4est_qcoord_t)
+    (p4est_morton_compact (low) |
+     (p4est_morton_compact (high) << P4EST_MORTON_BITS));
+  quadrant->y = (p4est_qcoord_t)
+    (p4est_morton_compact (low >> 1) |
+     (p4est_morton_compact (high >> 1) << P4EST_MORTON_BITS));
+  quadrant->z = (p4est_qcoord_t)
+    (p4est_morton_compact (low >> 2) |
+     (p4est_morton_compact (high >> 2) << P4EST_MORTON_BITS));
 #endif
-  }
 
   quadrant->x <<= (P4EST_MAXLEVEL - level);
   quadrant->y <<= (P4EST_MAXLEVEL - level);
@@ -2514,6 +2574,146 @@ p4est_quadrant_set_morton_ext128 (p4est_quadrant_t * quadrant,
   P4EST_ASSERT (p4est_quadrant_is_extended (quadrant));
 }
 
+/** Sort key of one quadrant for \ref p4est_quadrant_array_sort.
+ * The Morton index of the full 32-bit coordinates is stored in \a low
+ * and \a high, with the tree number above it if trees are compared. */
+typedef struct p4est_quadrant_sortkey
+{
+  uint64_t            low, high;
+  size_t              index;
+  int8_t              level;
+}
+p4est_quadrant_sortkey_t;
+
+/* The key is sorted by 8-bit digits: one for the level, eight for each
+ * word.  Short arrays are passed to the comparison function instead. */
+#define P4EST_SORTKEY_DIGITS 17
+#define P4EST_SORTKEY_MIN 64
+
+static void
+p4est_quadrant_sortkey_init (const p4est_quadrant_t * q, int piggy,
+                             size_t index, p4est_quadrant_sortkey_t * key)
+{
+  /* in two's complement this adds 2^(P4EST_MAXLEVEL + 2) to negative
+     coordinates, which is the order used by p4est_coordinates_compare */
+  uint64_t            x = (uint32_t) q->x;
+  uint64_t            y = (uint32_t) q->y;
+#ifdef P4_TO_P8
+  uint64_t            z = (uint32_t) q->z;
+  uint64_t            high;
+#endif
+
+  P4EST_ASSERT (P4EST_MAXLEVEL + 2 == 32);
+  P4EST_ASSERT (q->level >= 0);
+
+#ifndef P4_TO_P8
+  key->low = p4est_morton_spread (x) | (p4est_morton_spread (y) << 1);
+  key->high = 0;
+#else
+  key->low = p4est_morton_spread (x) | (p4est_morton_spread (y) << 1) |
+    (p4est_morton_spread (z) << 2);
+  high = p4est_morton_spread (x >> P4EST_MORTON_BITS) |
+    (p4est_morton_spread (y >> P4EST_MORTON_BITS) << 1) |
+    (p4est_morton_spread (z >> P4EST_MORTON_BITS) << 2);
+  key->low |= high << 63;
+  key->high = high >> 1;
+#endif
+  if (piggy) {
+    P4EST_ASSERT (q->p.which_tree >= 0);
+    key->high |= (uint64_t) q->p.which_tree << 32;
+  }
+  key->index = index;
+  key->level = q->level;
+}
+
+static inline unsigned
+p4est_quadrant_sortkey_digit (const p4est_quadrant_sortkey_t * key, int d)
+{
+  if (d == 0) {
+    return (unsigned) key->level;
+  }
+  if (d <= 8) {
+    return (unsigned) (key->low >> (8 * (d - 1))) & 0xff;
+  }
+  return (unsigned) (key->high >> (8 * (d - 9))) & 0xff;
+}
+
+static void
+p4est_quadrant_array_sort_keys (sc_array_t * array, int piggy)
+{
+  int                 d;
+  unsigned            digit;
+  size_t              iz, count, offset, pos;
+  size_t             *histo, *h;
+  char               *sorted;
+  p4est_quadrant_sortkey_t *keys, *temp, *swap;
+
+  count = array->elem_count;
+  if (count < P4EST_SORTKEY_MIN) {
+    sc_array_sort (array, piggy ? p4est_quadrant_compare_piggy :
+                   p4est_quadrant_compare);
+    return;
+  }
+  P4EST_ASSERT (array->elem_size >= sizeof (p4est_quadrant_t));
+
+  /* compute every key and all digit histograms in one sweep */
+  keys = P4EST_ALLOC (p4est_quadrant_sortkey_t, count);
+  temp = P4EST_ALLOC (p4est_quadrant_sortkey_t, count);
+  histo = P4EST_ALLOC_ZERO (size_t, P4EST_SORTKEY_DIGITS * 256);
+  for (iz = 0; iz < count; ++iz) {
+    p4est_quadrant_sortkey_init ((p4est_quadrant_t *)
+                                 sc_array_index (array, iz), piggy, iz,
+                                 &keys[iz]);
+    for (d = 0; d < P4EST_SORTKEY_DIGITS; ++d) {
+      ++histo[256 * d + p4est_quadrant_sortkey_digit (&keys[iz], d)];
+    }
+  }
+
+  /* stable counting sort by each digit, least significant first */
+  for (d = 0; d < P4EST_SORTKEY_DIGITS; ++d) {
+    h = histo + 256 * d;
+    if (h[p4est_quadrant_sortkey_digit (&keys[0], d)] == count) {
+      /* all keys share this digit, which is common for the high bits */
+      continue;
+    }
+    for (offset = 0, digit = 0; digit < 256; ++digit) {
+      pos = h[digit];
+      h[digit] = offset;
+      offset += pos;
+    }
+    for (iz = 0; iz < count; ++iz) {
+      temp[h[p4est_quadrant_sortkey_digit (&keys[iz], d)]++] = keys[iz];
+    }
+    swap = keys;
+    keys = temp;
+    temp = swap;
+  }
+  P4EST_FREE (histo);
+  P4EST_FREE (temp);
+
+  /* move the array elements into sorted order */
+  sorted = P4EST_ALLOC (char, count * array->elem_size);
+  for (iz = 0; iz < count; ++iz) {
+    memcpy (sorted + iz * array->elem_size,
+            sc_array_index (array, keys[iz].index), array->elem_size);
+  }
+  memcpy (array->array, sorted, count * array->elem_size);
+  P4EST_FREE (sorted);
+  P4EST_FREE (keys);
+}
+
+void
+p4est_quadrant_array_sort (sc_array_t * array)
+{
+  p4est_quadrant_array_sort_keys (array, 0);
+}
+
+void
+p4est_quadrant_array_sort_piggy (sc_array_t * array)
+{
+  p4est_quadrant_array_sort_keys (array, 1);
+}
+
 void
 p4est_quadrant_successor (const p4est_quadrant_t * quadrant,
                           p4est_quadrant_t * result)
@@ -109,6 +109,7 @@ p4est_build_new (p4est_t * from, size_t data_size,
   p4est->global_num_quadrants = 0;
   p4est->global_first_quadrant = NULL;
   p4est->global_first_position = NULL;
+  p4est->shared = NULL;
   p4est->trees = NULL;
   p4est->user_data_pool = NULL;
   p4est->quadrant_pool = NULL;
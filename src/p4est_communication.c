@@ -62,6 +62,18 @@ p4est_comm_parallel_env_assign (p4est_t * p4est, sc_MPI_Comm mpicomm)
 
   /* retrieve MPI information */
   p4est_comm_parallel_env_get_info (p4est);
+
+#ifdef P4EST_ENABLE_MPICOMMSHARED
+  if (p4est->mpisize > 1) {
+    sc_MPI_Comm         intranode, internode;
+
+    /* the node communicators are cached with the communicator */
+    sc_mpi_comm_get_node_comms (mpicomm, &intranode, &internode);
+    if (intranode == sc_MPI_COMM_NULL) {
+      sc_mpi_comm_attach_node_comms (mpicomm, 0);
+    }
+  }
+#endif
 }
 
 void
@@ -133,6 +145,167 @@ p4est_comm_parallel_env_is_null (p4est_t * p4est)
   return (p4est->mpicomm == sc_MPI_COMM_NULL);
 }
 
+int
+p4est_comm_node_first (p4est_t * p4est, int *node_first)
+{
+  int                 num_nodes = 0;
+#ifdef P4EST_ENABLE_MPICOMMSHARED
+  int                 mpiret;
+  int                 p, leader, contiguous;
+  int                *leaders;
+  sc_MPI_Comm         intranode, internode;
+
+  P4EST_ASSERT (node_first != NULL);
+
+  sc_mpi_comm_get_node_comms (p4est->mpicomm, &intranode, &internode);
+  if (intranode == sc_MPI_COMM_NULL) {
+    return 0;
+  }
+
+  /* each node is represented by its smallest process */
+  mpiret = sc_MPI_Allreduce (&p4est->mpirank, &leader, 1, sc_MPI_INT,
+                             sc_MPI_MIN, intranode);
+  SC_CHECK_MPI (mpiret);
+  leaders = P4EST_ALLOC (int, p4est->mpisize);
+  mpiret = sc_MPI_Allgather (&leader, 1, sc_MPI_INT,
+                             leaders, 1, sc_MPI_INT, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  /* the processes of each node must follow their leader */
+  contiguous = 1;
+  for (p = 0; p < p4est->mpisize; ++p) {
+    if (leaders[p] == p) {
+      node_first[num_nodes++] = p;
+    }
+    else if (p == 0 || leaders[p] != leaders[p - 1]) {
+      contiguous = 0;
+      break;
+    }
+  }
+  node_first[num_nodes] = p4est->mpisize;
+  P4EST_FREE (leaders);
+  if (!contiguous) {
+    num_nodes = 0;
+  }
+#endif
+
+  return num_nodes;
+}
+
+void
+p4est_comm_intranode_ranks (p4est_t * p4est, int first, int num,
+                            int *intranode)
+{
+  int                 i;
+#ifdef P4EST_ENABLE_MPICOMMSHARED
+  int                 mpiret;
+  int                *ranks;
+  sc_MPI_Comm         intranode_comm, internode_comm;
+  sc_MPI_Group        group, intragroup;
+
+  P4EST_ASSERT (0 <= first && 0 <= num && first + num <= p4est->mpisize);
+
+  sc_mpi_comm_get_node_comms (p4est->mpicomm, &intranode_comm,
+                              &internode_comm);
+  if (intranode_comm != sc_MPI_COMM_NULL) {
+    /* translate all ranks in one call to the node communicator */
+    ranks = P4EST_ALLOC (int, num);
+    for (i = 0; i < num; ++i) {
+      ranks[i] = first + i;
+    }
+    mpiret = sc_MPI_Comm_group (p4est->mpicomm, &group);
+    SC_CHECK_MPI (mpiret);
+    mpiret = sc_MPI_Comm_group (intranode_comm, &intragroup);
+    SC_CHECK_MPI (mpiret);
+    mpiret = sc_MPI_Group_translate_ranks (group, num, ranks,
+                                           intragroup, intranode);
+    SC_CHECK_MPI (mpiret);
+    mpiret = sc_MPI_Group_free (&intragroup);
+    SC_CHECK_MPI (mpiret);
+    mpiret = sc_MPI_Group_free (&group);
+    SC_CHECK_MPI (mpiret);
+    P4EST_FREE (ranks);
+
+    /* a process is on this node if it is a member of the node communicator */
+    for (i = 0; i < num; ++i) {
+      intranode[i] = intranode[i] != sc_MPI_UNDEFINED;
+    }
+    return;
+  }
+#endif
+
+  for (i = 0; i < num; ++i) {
+    intranode[i] = -1;
+  }
+}
+
+int
+p4est_comm_is_intranode (p4est_t * p4est, int q)
+{
+  int                 intranode;
+
+  P4EST_ASSERT (0 <= q && q < p4est->mpisize);
+
+  p4est_comm_intranode_ranks (p4est, q, 1, &intranode);
+  return intranode;
+}
+
+void
+p4est_comm_share (p4est_t * p4est)
+{
+  const size_t        gfq_size =
+    (size_t) (p4est->mpisize + 1) * sizeof (p4est_gloidx_t);
+  const size_t        gfp_size =
+    (size_t) (p4est->mpisize + 1) * sizeof (p4est_quadrant_t);
+  char               *array;
+  p4est_shared_t     *shared;
+
+  if (p4est->shared != NULL) {
+    return;
+  }
+  shared = p4est_shared_new (p4est->mpicomm, gfq_size + gfp_size);
+  if (shared == NULL) {
+    return;
+  }
+
+  /* both arrays go into one window, the quadrants suitably aligned */
+  array = (char *) p4est_shared_array (shared);
+  if (p4est_shared_write_begin (shared)) {
+    memcpy (array, p4est->global_first_quadrant, gfq_size);
+    memcpy (array + gfq_size, p4est->global_first_position, gfp_size);
+  }
+  p4est_shared_write_end (shared);
+
+  P4EST_FREE (p4est->global_first_quadrant);
+  P4EST_FREE (p4est->global_first_position);
+  p4est->global_first_quadrant = (p4est_gloidx_t *) array;
+  p4est->global_first_position = (p4est_quadrant_t *) (array + gfq_size);
+  p4est->shared = shared;
+}
+
+void
+p4est_comm_unshare (p4est_t * p4est)
+{
+  const size_t        count = (size_t) p4est->mpisize + 1;
+  p4est_gloidx_t     *gfq;
+  p4est_quadrant_t   *gfp;
+
+  if (p4est->shared == NULL) {
+    return;
+  }
+
+  gfq = P4EST_ALLOC (p4est_gloidx_t, count);
+  memcpy (gfq, p4est->global_first_quadrant, count * sizeof (p4est_gloidx_t));
+  gfp = P4EST_ALLOC (p4est_quadrant_t, count);
+  memcpy (gfp, p4est->global_first_position,
+          count * sizeof (p4est_quadrant_t));
+
+  p4est_shared_destroy (p4est->shared);
+  p4est->shared = NULL;
+  p4est->global_first_quadrant = gfq;
+  p4est->global_first_position = gfp;
+}
+
 int
 p4est_comm_parallel_env_reduce (p4est_t ** p4est_supercomm)
 {
@@ -184,6 +357,12 @@ p4est_comm_parallel_env_reduce_ext (p4est_t ** p4est_supercomm,
     return 1;
   }
 
+  /* the reduced forest keeps its partition in private memory */
+  if (p4est->shared != NULL) {
+    p4est_comm_unshare (p4est);
+    global_first_position = p4est->global_first_position;
+  }
+
   /* create sub-group of non-empty processors */
   mpiret = sc_MPI_Comm_group (mpicomm, &group);
   SC_CHECK_MPI (mpiret);
@@ -323,19 +502,35 @@ void
 p4est_comm_count_quadrants (p4est_t * p4est)
 {
   int                 mpiret;
+  int                 writer;
   p4est_gloidx_t      qlocal = p4est->local_num_quadrants;
   p4est_gloidx_t     *global_first_quadrant = p4est->global_first_quadrant;
   int                 i;
   const int           num_procs = p4est->mpisize;
 
-  global_first_quadrant[0] = 0;
-  mpiret = sc_MPI_Allgather (&qlocal, 1, P4EST_MPI_GLOIDX,
-                             global_first_quadrant + 1, 1, P4EST_MPI_GLOIDX,
-                             p4est->mpicomm);
-  SC_CHECK_MPI (mpiret);
+  if (p4est->shared != NULL) {
+    /* the first process of each node writes the node-shared array */
+    writer = p4est_shared_write_begin (p4est->shared);
+    p4est_shared_allgather (p4est->shared, &qlocal, sizeof (p4est_gloidx_t),
+                            (char *) (global_first_quadrant + 1) -
+                            (char *) p4est_shared_array (p4est->shared));
+  }
+  else {
+    writer = 1;
+    mpiret = sc_MPI_Allgather (&qlocal, 1, P4EST_MPI_GLOIDX,
+                               global_first_quadrant + 1, 1, P4EST_MPI_GLOIDX,
+                               p4est->mpicomm);
+    SC_CHECK_MPI (mpiret);
+  }
 
-  for (i = 0; i < num_procs; ++i) {
-    global_first_quadrant[i + 1] += global_first_quadrant[i];
+  if (writer) {
+    global_first_quadrant[0] = 0;
+    for (i = 0; i < num_procs; ++i) {
+      global_first_quadrant[i + 1] += global_first_quadrant[i];
+    }
+  }
+  if (p4est->shared != NULL) {
+    p4est_shared_write_end (p4est->shared);
   }
   p4est->global_num_quadrants = global_first_quadrant[num_procs];
 }
@@ -347,15 +542,12 @@ p4est_comm_global_partition (p4est_t * p4est, p4est_quadrant_t * first_quad)
   const p4est_topidx_t num_trees = p4est->connectivity->num_trees;
   int                 i;
   int                 mpiret;
+  int                 writer;
   const p4est_topidx_t first_tree = p4est->first_local_tree;
   p4est_tree_t       *tree;
   p4est_quadrant_t   *quadrant;
   p4est_quadrant_t   *pi, input;
 
-  SC_BZERO (&p4est->global_first_position[num_procs], 1);
-  p4est->global_first_position[num_procs].level = P4EST_QMAXLEVEL;
-  p4est->global_first_position[num_procs].p.which_tree = num_trees;
-
   SC_BZERO (&input, 1);
   if (first_tree < 0) {
     /* i don't have any quadrants, send negative values */
@@ -384,27 +576,46 @@ p4est_comm_global_partition (p4est_t * p4est, p4est_quadrant_t * first_quad)
   }
   input.level = P4EST_QMAXLEVEL;
   input.p.which_tree = first_tree;
-  mpiret = sc_MPI_Allgather (&input, (int) sizeof (p4est_quadrant_t),
-                             sc_MPI_BYTE, p4est->global_first_position,
-                             (int) sizeof (p4est_quadrant_t), sc_MPI_BYTE,
-                             p4est->mpicomm);
-  SC_CHECK_MPI (mpiret);
+  if (p4est->shared != NULL) {
+    /* the first process of each node writes the node-shared array */
+    writer = p4est_shared_write_begin (p4est->shared);
+    p4est_shared_allgather (p4est->shared, &input, sizeof (p4est_quadrant_t),
+                            (char *) p4est->global_first_position -
+                            (char *) p4est_shared_array (p4est->shared));
+  }
+  else {
+    writer = 1;
+    mpiret = sc_MPI_Allgather (&input, (int) sizeof (p4est_quadrant_t),
+                               sc_MPI_BYTE, p4est->global_first_position,
+                               (int) sizeof (p4est_quadrant_t), sc_MPI_BYTE,
+                               p4est->mpicomm);
+    SC_CHECK_MPI (mpiret);
+  }
 
-  /* correct for processors that don't have any quadrants */
-  for (i = num_procs - 1; i >= 0; --i) {
-    pi = &p4est->global_first_position[i];
-    if (pi->p.which_tree < 0) {
-      P4EST_ASSERT (pi->x == -1 && pi->y == -1);
+  if (writer) {
+    SC_BZERO (&p4est->global_first_position[num_procs], 1);
+    p4est->global_first_position[num_procs].level = P4EST_QMAXLEVEL;
+    p4est->global_first_position[num_procs].p.which_tree = num_trees;
+
+    /* correct for processors that don't have any quadrants */
+    for (i = num_procs - 1; i >= 0; --i) {
+      pi = &p4est->global_first_position[i];
+      if (pi->p.which_tree < 0) {
+        P4EST_ASSERT (pi->x == -1 && pi->y == -1);
 #ifdef P4_TO_P8
-      P4EST_ASSERT (pi->z == -1);
+        P4EST_ASSERT (pi->z == -1);
 #endif
-      memcpy (pi, pi + 1, sizeof (p4est_quadrant_t));
-    }
-    P4EST_ASSERT (pi->x >= 0 && pi->y >= 0);
+        memcpy (pi, pi + 1, sizeof (p4est_quadrant_t));
+      }
+      P4EST_ASSERT (pi->x >= 0 && pi->y >= 0);
 #ifdef P4_TO_P8
-    P4EST_ASSERT (pi->z >= 0);
+      P4EST_ASSERT (pi->z >= 0);
 #endif
-    P4EST_ASSERT (pi->p.which_tree >= 0 && pi->level == P4EST_QMAXLEVEL);
+      P4EST_ASSERT (pi->p.which_tree >= 0 && pi->level == P4EST_QMAXLEVEL);
+    }
+  }
+  if (p4est->shared != NULL) {
+    p4est_shared_write_end (p4est->shared);
   }
 }
 
@@ -125,6 +125,11 @@ p4est_connectivity_face_neighbor_corner (int c, int f, int nf, int o)
 size_t
 p4est_connectivity_memory_used (p4est_connectivity_t * conn)
 {
+  if (conn->shared != NULL) {
+    /* the arrays are counted once per compute node */
+    return sizeof (p4est_connectivity_t) +
+      p4est_shared_memory_used (conn->shared);
+  }
   return sizeof (p4est_connectivity_t) +
     (conn->num_vertices > 0 ?
      (conn->num_vertices * 3 * sizeof (double) +
@@ -427,6 +432,14 @@ p4est_connectivity_bcast (p4est_connectivity_t * conn_in, int root,
 void
 p4est_connectivity_destroy (p4est_connectivity_t * conn)
 {
+  if (conn->shared != NULL) {
+    /* all arrays but the attributes live in one window */
+    p4est_shared_destroy (conn->shared);
+    p4est_connectivity_set_attr (conn, 0);
+    P4EST_FREE (conn);
+    return;
+  }
+
   P4EST_FREE (conn->vertices);
   P4EST_FREE (conn->tree_to_vertex);
 
@@ -450,6 +463,124 @@ p4est_connectivity_destroy (p4est_connectivity_t * conn)
   P4EST_FREE (conn);
 }
 
+/** Number of arrays of a connectivity that may be node-shared. */
+#ifndef P4_TO_P8
+#define P4EST_CONN_SHARED_ARRAYS 8
+#else
+#define P4EST_CONN_SHARED_ARRAYS 12
+#endif
+
+/** Each node-shared array begins at a multiple of the largest alignment. */
+#define P4EST_CONN_SHARED_PAD(b) \
+  (((b) + sizeof (double) - 1) & ~(sizeof (double) - 1))
+
+int
+p4est_connectivity_share (p4est_connectivity_t * conn, sc_MPI_Comm mpicomm)
+{
+  const size_t        ntrees = (size_t) conn->num_trees;
+  int                 i, num_arrays;
+  size_t              total;
+  size_t              bytes[P4EST_CONN_SHARED_ARRAYS];
+  void               *src[P4EST_CONN_SHARED_ARRAYS];
+  void               *dest[P4EST_CONN_SHARED_ARRAYS];
+  char               *pos;
+  p4est_shared_t     *shared;
+
+  if (conn->shared != NULL) {
+    return 1;
+  }
+  if (!p4est_shared_is_enabled (mpicomm)) {
+    return 0;
+  }
+
+  /* list the arrays in the order they are placed in the window */
+  i = 0;
+  src[i] = conn->vertices;
+  bytes[i++] = 3 * (size_t) conn->num_vertices * sizeof (double);
+  src[i] = conn->tree_to_vertex;
+  bytes[i++] = P4EST_CHILDREN * ntrees * sizeof (p4est_topidx_t);
+  src[i] = conn->tree_to_tree;
+  bytes[i++] = P4EST_FACES * ntrees * sizeof (p4est_topidx_t);
+  src[i] = conn->tree_to_face;
+  bytes[i++] = P4EST_FACES * ntrees * sizeof (int8_t);
+#ifdef P4_TO_P8
+  src[i] = conn->tree_to_edge;
+  bytes[i++] = P8EST_EDGES * ntrees * sizeof (p4est_topidx_t);
+  src[i] = conn->ett_offset;
+  bytes[i++] = ((size_t) conn->num_edges + 1) * sizeof (p4est_topidx_t);
+  src[i] = conn->edge_to_tree;
+  bytes[i++] = (size_t) conn->ett_offset[conn->num_edges] *
+    sizeof (p4est_topidx_t);
+  src[i] = conn->edge_to_edge;
+  bytes[i++] = (size_t) conn->ett_offset[conn->num_edges] * sizeof (int8_t);
+#endif
+  src[i] = conn->tree_to_corner;
+  bytes[i++] = P4EST_CHILDREN * ntrees * sizeof (p4est_topidx_t);
+  src[i] = conn->ctt_offset;
+  bytes[i++] = ((size_t) conn->num_corners + 1) * sizeof (p4est_topidx_t);
+  src[i] = conn->corner_to_tree;
+  bytes[i++] = (size_t) conn->ctt_offset[conn->num_corners] *
+    sizeof (p4est_topidx_t);
+  src[i] = conn->corner_to_corner;
+  bytes[i++] = (size_t) conn->ctt_offset[conn->num_corners] * sizeof (int8_t);
+  num_arrays = i;
+  P4EST_ASSERT (num_arrays == P4EST_CONN_SHARED_ARRAYS);
+
+  /* compute the size of the window */
+  total = 0;
+  for (i = 0; i < num_arrays; ++i) {
+    if (src[i] != NULL) {
+      total += P4EST_CONN_SHARED_PAD (bytes[i]);
+    }
+  }
+  shared = p4est_shared_new (mpicomm, total);
+  if (shared == NULL) {
+    return 0;
+  }
+
+  /* the first process of each node copies its arrays */
+  pos = (char *) p4est_shared_array (shared);
+  if (p4est_shared_write_begin (shared)) {
+    for (i = 0; i < num_arrays; ++i) {
+      if (src[i] != NULL) {
+        memcpy (pos, src[i], bytes[i]);
+        pos += P4EST_CONN_SHARED_PAD (bytes[i]);
+      }
+    }
+  }
+  p4est_shared_write_end (shared);
+
+  /* all processes point into the window */
+  pos = (char *) p4est_shared_array (shared);
+  for (i = 0; i < num_arrays; ++i) {
+    dest[i] = NULL;
+    if (src[i] != NULL) {
+      dest[i] = pos;
+      pos += P4EST_CONN_SHARED_PAD (bytes[i]);
+      P4EST_FREE (src[i]);
+    }
+  }
+  i = 0;
+  conn->vertices = (double *) dest[i++];
+  conn->tree_to_vertex = (p4est_topidx_t *) dest[i++];
+  conn->tree_to_tree = (p4est_topidx_t *) dest[i++];
+  conn->tree_to_face = (int8_t *) dest[i++];
+#ifdef P4_TO_P8
+  conn->tree_to_edge = (p4est_topidx_t *) dest[i++];
+  conn->ett_offset = (p4est_topidx_t *) dest[i++];
+  conn->edge_to_tree = (p4est_topidx_t *) dest[i++];
+  conn->edge_to_edge = (int8_t *) dest[i++];
+#endif
+  conn->tree_to_corner = (p4est_topidx_t *) dest[i++];
+  conn->ctt_offset = (p4est_topidx_t *) dest[i++];
+  conn->corner_to_tree = (p4est_topidx_t *) dest[i++];
+  conn->corner_to_corner = (int8_t *) dest[i++];
+  P4EST_ASSERT (i == num_arrays);
+  conn->shared = shared;
+
+  return 1;
+}
+
 void
 p4est_connectivity_set_attr (p4est_connectivity_t * conn,
                              size_t bytes_per_tree)
@@ -1262,6 +1393,585 @@ p4est_connectivity_load (const char *filename, size_t *bytes)
   return conn;
 }
 
+/** Sections of a connectivity in the order of the on-disk format. */
+typedef enum p4est_conn_section
+{
+  P4EST_CONN_VERTICES,
+  P4EST_CONN_TTE,
+  P4EST_CONN_TTV,
+  P4EST_CONN_TTC,
+  P4EST_CONN_TTT,
+  P4EST_CONN_TTF,
+  P4EST_CONN_ATTR,
+  P4EST_CONN_EOFF,
+  P4EST_CONN_ETT,
+  P4EST_CONN_ETE,
+  P4EST_CONN_COFF,
+  P4EST_CONN_CTT,
+  P4EST_CONN_CTC,
+  P4EST_CONN_NUM_SECTIONS
+}
+p4est_conn_section_t;
+
+/** Random access to the arrays of a connectivity in memory or on disk. */
+typedef struct p4est_conn_reader
+{
+  FILE               *file;     /**< file to read from, or NULL */
+  size_t              bytes;    /**< number of bytes read from file */
+  p4est_topidx_t      num_vertices, num_trees;
+  p4est_topidx_t      num_edges, num_ett, num_corners, num_ctt;
+  size_t              tree_attr_bytes;
+  size_t              elem_size[P4EST_CONN_NUM_SECTIONS];
+  uint64_t            offset[P4EST_CONN_NUM_SECTIONS];  /**< in file */
+  const char         *array[P4EST_CONN_NUM_SECTIONS];   /**< in memory */
+}
+p4est_conn_reader_t;
+
+/** The corners or edges touched by the extracted trees. */
+typedef struct p4est_conn_entities
+{
+  p4est_conn_section_t tt, off, ett, ete;       /**< sections to read */
+  int                 per_tree; /**< entities per tree */
+  sc_array_t          ids;      /**< sorted global entity numbers */
+  sc_array_t          offset;   /**< offsets into trees and codes */
+  sc_array_t          trees;    /**< global trees of the entities */
+  sc_array_t          codes;    /**< tree corner or edge numbers */
+}
+p4est_conn_entities_t;
+
+/** Compute the entry sizes and file positions of all sections. */
+static void
+p4est_conn_reader_layout (p4est_conn_reader_t * r)
+{
+  const size_t        topsize = sizeof (p4est_topidx_t);
+  const size_t        nt = (size_t) r->num_trees;
+  size_t              count[P4EST_CONN_NUM_SECTIONS];
+  int                 s;
+
+  r->elem_size[P4EST_CONN_VERTICES] = 3 * sizeof (double);
+  count[P4EST_CONN_VERTICES] = (size_t) r->num_vertices;
+#ifdef P4_TO_P8
+  r->elem_size[P4EST_CONN_TTE] = P8EST_EDGES * topsize;
+#else
+  r->elem_size[P4EST_CONN_TTE] = 0;
+#endif
+  count[P4EST_CONN_TTE] = r->num_edges > 0 ? nt : 0;
+  r->elem_size[P4EST_CONN_TTV] = P4EST_CHILDREN * topsize;
+  count[P4EST_CONN_TTV] = r->num_vertices > 0 ? nt : 0;
+  r->elem_size[P4EST_CONN_TTC] = P4EST_CHILDREN * topsize;
+  count[P4EST_CONN_TTC] = r->num_corners > 0 ? nt : 0;
+  r->elem_size[P4EST_CONN_TTT] = P4EST_FACES * topsize;
+  count[P4EST_CONN_TTT] = nt;
+  r->elem_size[P4EST_CONN_TTF] = P4EST_FACES * sizeof (int8_t);
+  count[P4EST_CONN_TTF] = nt;
+  r->elem_size[P4EST_CONN_ATTR] = r->tree_attr_bytes;
+  count[P4EST_CONN_ATTR] = nt;
+#ifdef P4_TO_P8
+  r->elem_size[P4EST_CONN_EOFF] = topsize;
+#else
+  r->elem_size[P4EST_CONN_EOFF] = 0;
+#endif
+  count[P4EST_CONN_EOFF] = (size_t) r->num_edges + 1;
+  r->elem_size[P4EST_CONN_ETT] = topsize;
+  count[P4EST_CONN_ETT] = r->num_edges > 0 ? (size_t) r->num_ett : 0;
+  r->elem_size[P4EST_CONN_ETE] = sizeof (int8_t);
+  count[P4EST_CONN_ETE] = count[P4EST_CONN_ETT];
+  r->elem_size[P4EST_CONN_COFF] = topsize;
+  count[P4EST_CONN_COFF] = (size_t) r->num_corners + 1;
+  r->elem_size[P4EST_CONN_CTT] = topsize;
+  count[P4EST_CONN_CTT] = r->num_corners > 0 ? (size_t) r->num_ctt : 0;
+  r->elem_size[P4EST_CONN_CTC] = sizeof (int8_t);
+  count[P4EST_CONN_CTC] = count[P4EST_CONN_CTT];
+
+  /* the sections follow the magic, the version and the header */
+  r->offset[0] = 8 + 24 + 10 * sizeof (uint64_t);
+  for (s = 1; s < P4EST_CONN_NUM_SECTIONS; ++s) {
+    r->offset[s] = r->offset[s - 1] +
+      (uint64_t) count[s - 1] * (uint64_t) r->elem_size[s - 1];
+  }
+}
+
+/** Prepare reading from a connectivity in memory. */
+static void
+p4est_conn_reader_memory (p4est_conn_reader_t * r,
+                          p4est_connectivity_t * conn)
+{
+  memset (r, 0, sizeof (*r));
+  r->num_vertices = conn->num_vertices;
+  r->num_trees = conn->num_trees;
+#ifdef P4_TO_P8
+  r->num_edges = conn->num_edges;
+  r->num_ett = conn->ett_offset[conn->num_edges];
+  r->array[P4EST_CONN_TTE] = (const char *) conn->tree_to_edge;
+  r->array[P4EST_CONN_EOFF] = (const char *) conn->ett_offset;
+  r->array[P4EST_CONN_ETT] = (const char *) conn->edge_to_tree;
+  r->array[P4EST_CONN_ETE] = (const char *) conn->edge_to_edge;
+#endif
+  r->num_corners = conn->num_corners;
+  r->num_ctt = conn->ctt_offset[conn->num_corners];
+  r->tree_attr_bytes = conn->tree_attr_bytes;
+  r->array[P4EST_CONN_VERTICES] = (const char *) conn->vertices;
+  r->array[P4EST_CONN_TTV] = (const char *) conn->tree_to_vertex;
+  r->array[P4EST_CONN_TTC] = (const char *) conn->tree_to_corner;
+  r->array[P4EST_CONN_TTT] = (const char *) conn->tree_to_tree;
+  r->array[P4EST_CONN_TTF] = (const char *) conn->tree_to_face;
+  r->array[P4EST_CONN_ATTR] = conn->tree_to_attr;
+  r->array[P4EST_CONN_COFF] = (const char *) conn->ctt_offset;
+  r->array[P4EST_CONN_CTT] = (const char *) conn->corner_to_tree;
+  r->array[P4EST_CONN_CTC] = (const char *) conn->corner_to_corner;
+  p4est_conn_reader_layout (r);
+}
+
+/** Seek to an absolute position that may exceed the range of long.
+ * \return          0 on success, nonzero on file error.
+ */
+static int
+p4est_conn_reader_seek (FILE * file, uint64_t offset)
+{
+#ifdef _WIN32
+  return _fseeki64 (file, (__int64) offset, SEEK_SET);
+#else
+  if ((uint64_t) (off_t) offset != offset) {
+    /* the offset does not fit into this platform's file offsets */
+    return -1;
+  }
+  return fseeko (file, (off_t) offset, SEEK_SET);
+#endif
+}
+
+/** Open a connectivity file and read its header.
+ * \return          0 on success, nonzero on file or format error.
+ */
+static int
+p4est_conn_reader_open (p4est_conn_reader_t * r, const char *filename)
+{
+  char                magic8[8];
+  uint64_t            array10[10];
+
+  memset (r, 0, sizeof (*r));
+  r->file = fopen (filename, "rb");
+  if (r->file == NULL) {
+    return -1;
+  }
+  if (fread (magic8, 1, 8, r->file) != 8 ||
+      strncmp (magic8, P4EST_STRING, 8) ||
+      p4est_conn_reader_seek (r->file, 8 + 24) ||
+      fread (array10, sizeof (uint64_t), 10, r->file) != 10 ||
+      array10[0] != P4EST_ONDISK_FORMAT ||
+      array10[1] != (uint64_t) sizeof (p4est_topidx_t)) {
+    return -1;
+  }
+  r->bytes = 8 + 24 + 10 * sizeof (uint64_t);
+  r->num_vertices = (p4est_topidx_t) array10[2];
+  r->num_trees = (p4est_topidx_t) array10[3];
+  r->num_edges = (p4est_topidx_t) array10[4];
+  r->num_ett = (p4est_topidx_t) array10[5];
+  r->num_corners = (p4est_topidx_t) array10[6];
+  r->num_ctt = (p4est_topidx_t) array10[7];
+  r->tree_attr_bytes = (size_t) array10[8];
+  if (r->num_vertices < 0 || r->num_trees < 0 || r->num_edges < 0 ||
+      r->num_ett < 0 || r->num_corners < 0 || r->num_ctt < 0) {
+    return -1;
+  }
+#ifndef P4_TO_P8
+  if (r->num_edges != 0 || r->num_ett != 0) {
+    return -1;
+  }
+#endif
+  p4est_conn_reader_layout (r);
+
+  return 0;
+}
+
+/** Read consecutive entries of one section.
+ * \return          0 on success, nonzero on file error.
+ */
+static int
+p4est_conn_reader_read (p4est_conn_reader_t * r, p4est_conn_section_t s,
+                        p4est_topidx_t first, p4est_topidx_t count,
+                        void *dest)
+{
+  const size_t        bytes = (size_t) count * r->elem_size[s];
+  const uint64_t      skip = (uint64_t) first * (uint64_t) r->elem_size[s];
+
+  if (bytes == 0) {
+    return 0;
+  }
+  if (r->file == NULL) {
+    memcpy (dest, r->array[s] + (size_t) skip, bytes);
+    return 0;
+  }
+  if (p4est_conn_reader_seek (r->file, r->offset[s] + skip) ||
+      fread (dest, 1, bytes, r->file) != bytes) {
+    return -1;
+  }
+  r->bytes += bytes;
+  return 0;
+}
+
+/** Read the entries of a section for a sorted list of indices.
+ * Consecutive indices are read in one piece.
+ * \return          0 on success, nonzero on file error.
+ */
+static int
+p4est_conn_reader_gather (p4est_conn_reader_t * r, p4est_conn_section_t s,
+                          sc_array_t * ids, void *dest)
+{
+  size_t              zz, zrun;
+  const p4est_topidx_t *id = (const p4est_topidx_t *) ids->array;
+  char               *pos = (char *) dest;
+
+  for (zz = 0; zz < ids->elem_count; zz = zrun) {
+    for (zrun = zz + 1; zrun < ids->elem_count &&
+         id[zrun] == id[zrun - 1] + 1; ++zrun) {
+    }
+    if (p4est_conn_reader_read (r, s, id[zz], (p4est_topidx_t) (zrun - zz),
+                                pos)) {
+      return -1;
+    }
+    pos += (zrun - zz) * r->elem_size[s];
+  }
+  return 0;
+}
+
+static void
+p4est_conn_entities_init (p4est_conn_entities_t * en,
+                          p4est_conn_section_t tt, p4est_conn_section_t off,
+                          p4est_conn_section_t ett, p4est_conn_section_t ete,
+                          int per_tree)
+{
+  en->tt = tt;
+  en->off = off;
+  en->ett = ett;
+  en->ete = ete;
+  en->per_tree = per_tree;
+  sc_array_init (&en->ids, sizeof (p4est_topidx_t));
+  sc_array_init (&en->offset, sizeof (p4est_topidx_t));
+  sc_array_init (&en->trees, sizeof (p4est_topidx_t));
+  sc_array_init (&en->codes, sizeof (int8_t));
+}
+
+static void
+p4est_conn_entities_reset (p4est_conn_entities_t * en)
+{
+  sc_array_reset (&en->ids);
+  sc_array_reset (&en->offset);
+  sc_array_reset (&en->trees);
+  sc_array_reset (&en->codes);
+}
+
+/** Read the trees that meet at the entities of a range of trees.
+ * \param [in] tt_range   The entities of the range, -1 entries are ignored.
+ * \param [in,out] trees  The trees found are appended.
+ * \return                0 on success, nonzero on file or format error.
+ */
+static int
+p4est_conn_entities_collect (p4est_conn_reader_t * r,
+                             p4est_conn_entities_t * en,
+                             const p4est_topidx_t * tt_range,
+                             size_t num_entries, sc_array_t * trees)
+{
+  size_t              zz;
+  p4est_topidx_t      e, count, range[2];
+  p4est_topidx_t     *off;
+
+  for (zz = 0; zz < num_entries; ++zz) {
+    if (tt_range[zz] >= 0) {
+      *(p4est_topidx_t *) sc_array_push (&en->ids) = tt_range[zz];
+    }
+  }
+  sc_array_sort (&en->ids, p4est_topidx_compare);
+  sc_array_uniq (&en->ids, p4est_topidx_compare);
+
+  sc_array_resize (&en->offset, en->ids.elem_count + 1);
+  off = (p4est_topidx_t *) en->offset.array;
+  off[0] = 0;
+  for (zz = 0; zz < en->ids.elem_count; ++zz) {
+    e = *(p4est_topidx_t *) sc_array_index (&en->ids, zz);
+    if (p4est_conn_reader_read (r, en->off, e, 2, range) ||
+        (count = range[1] - range[0]) < 0) {
+      return -1;
+    }
+    off[zz + 1] = off[zz] + count;
+    if (p4est_conn_reader_read (r, en->ett, range[0], count,
+                                sc_array_push_count (&en->trees,
+                                                     (size_t) count)) ||
+        p4est_conn_reader_read (r, en->ete, range[0], count,
+                                sc_array_push_count (&en->codes,
+                                                     (size_t) count))) {
+      return -1;
+    }
+  }
+  memcpy (sc_array_push_count (trees, en->trees.elem_count),
+          en->trees.array, en->trees.elem_count * sizeof (p4est_topidx_t));
+  return 0;
+}
+
+/** Translate the entities of the extracted trees into local numbers.
+ * Entities not touched by the range become -1.
+ * \param [in] tt_global  The global entities of all extracted trees.
+ * \param [in] tree_ids   The sorted global numbers of the extracted trees.
+ */
+static void
+p4est_conn_entities_assign (p4est_conn_entities_t * en,
+                            const p4est_topidx_t * tt_global,
+                            sc_array_t * tree_ids, p4est_topidx_t * tt,
+                            p4est_topidx_t * off, p4est_topidx_t * ett,
+                            int8_t * ete)
+{
+  size_t              zz, num_entries;
+  ssize_t             si;
+
+  num_entries = tree_ids->elem_count * en->per_tree;
+  for (zz = 0; zz < num_entries; ++zz) {
+    si = -1;
+    if (tt_global[zz] >= 0) {
+      si = sc_array_bsearch (&en->ids, &tt_global[zz], p4est_topidx_compare);
+    }
+    tt[zz] = (p4est_topidx_t) si;
+  }
+  memcpy (off, en->offset.array, en->offset.elem_count *
+          sizeof (p4est_topidx_t));
+  for (zz = 0; zz < en->trees.elem_count; ++zz) {
+    si = sc_array_bsearch (tree_ids, sc_array_index (&en->trees, zz),
+                           p4est_topidx_compare);
+    P4EST_ASSERT (si >= 0);
+    ett[zz] = (p4est_topidx_t) si;
+  }
+  memcpy (ete, en->codes.array, en->codes.elem_count * sizeof (int8_t));
+}
+
+/** Extract a range of trees and their neighbors through a reader.
+ * \return          The local connectivity, or NULL on file or format error.
+ */
+static p4est_connectivity_t *
+p4est_connectivity_extract_internal (p4est_conn_reader_t * r,
+                                     p4est_topidx_t first_tree,
+                                     p4est_topidx_t last_tree,
+                                     sc_array_t * tree_global)
+{
+  int                 retval, face;
+  size_t              zz, nt, num_range;
+  ssize_t             si;
+  p4est_topidx_t      jt, nv;
+  p4est_topidx_t     *gttt, *gttc, *gttv;
+  p4est_topidx_t     *pt;
+  int8_t             *gttf;
+  sc_array_t          trees, vertices;
+  p4est_conn_entities_t corners;
+#ifdef P4_TO_P8
+  p4est_topidx_t     *gtte;
+  p4est_conn_entities_t edges;
+#endif
+  p4est_connectivity_t *conn = NULL;
+
+  if (first_tree < 0 || last_tree < first_tree - 1 ||
+      last_tree >= r->num_trees) {
+    return NULL;
+  }
+  num_range = (size_t) (last_tree - first_tree + 1);
+
+  /* the trees of the range and their face neighbors */
+  sc_array_init (&trees, sizeof (p4est_topidx_t));
+  sc_array_init (&vertices, sizeof (p4est_topidx_t));
+  p4est_conn_entities_init (&corners, P4EST_CONN_TTC, P4EST_CONN_COFF,
+                            P4EST_CONN_CTT, P4EST_CONN_CTC, P4EST_CHILDREN);
+#ifdef P4_TO_P8
+  p4est_conn_entities_init (&edges, P4EST_CONN_TTE, P4EST_CONN_EOFF,
+                            P4EST_CONN_ETT, P4EST_CONN_ETE, P8EST_EDGES);
+  gtte = P4EST_ALLOC (p4est_topidx_t, P8EST_EDGES * num_range);
+#endif
+  gttt = P4EST_ALLOC (p4est_topidx_t, P4EST_FACES * num_range);
+  gttc = P4EST_ALLOC (p4est_topidx_t, P4EST_CHILDREN * num_range);
+  retval = p4est_conn_reader_read (r, P4EST_CONN_TTT, first_tree,
+                                   (p4est_topidx_t) num_range, gttt);
+  for (jt = first_tree; jt <= last_tree; ++jt) {
+    *(p4est_topidx_t *) sc_array_push (&trees) = jt;
+  }
+  memcpy (sc_array_push_count (&trees, P4EST_FACES * num_range), gttt,
+          P4EST_FACES * num_range * sizeof (p4est_topidx_t));
+
+  /* the trees that meet at the corners and edges of the range */
+  if (!retval && r->num_corners > 0) {
+    retval = p4est_conn_reader_read (r, P4EST_CONN_TTC, first_tree,
+                                     (p4est_topidx_t) num_range, gttc) ||
+      p4est_conn_entities_collect (r, &corners, gttc,
+                                   P4EST_CHILDREN * num_range, &trees);
+  }
+#ifdef P4_TO_P8
+  if (!retval && r->num_edges > 0) {
+    retval = p4est_conn_reader_read (r, P4EST_CONN_TTE, first_tree,
+                                     (p4est_topidx_t) num_range, gtte) ||
+      p4est_conn_entities_collect (r, &edges, gtte,
+                                   P8EST_EDGES * num_range, &trees);
+  }
+  P4EST_FREE (gtte);
+#endif
+  P4EST_FREE (gttt);
+  P4EST_FREE (gttc);
+  if (retval) {
+    goto extract_done;
+  }
+  sc_array_sort (&trees, p4est_topidx_compare);
+  sc_array_uniq (&trees, p4est_topidx_compare);
+  nt = trees.elem_count;
+
+  /* read the tree records of all extracted trees */
+  gttt = P4EST_ALLOC (p4est_topidx_t, P4EST_FACES * nt);
+  gttf = P4EST_ALLOC (int8_t, P4EST_FACES * nt);
+  gttv = P4EST_ALLOC (p4est_topidx_t, P4EST_CHILDREN * nt);
+  gttc = P4EST_ALLOC (p4est_topidx_t, P4EST_CHILDREN * nt);
+  retval = p4est_conn_reader_gather (r, P4EST_CONN_TTT, &trees, gttt) ||
+    p4est_conn_reader_gather (r, P4EST_CONN_TTF, &trees, gttf) ||
+    (r->num_vertices > 0 &&
+     p4est_conn_reader_gather (r, P4EST_CONN_TTV, &trees, gttv)) ||
+    (r->num_corners > 0 &&
+     p4est_conn_reader_gather (r, P4EST_CONN_TTC, &trees, gttc));
+#ifdef P4_TO_P8
+  gtte = P4EST_ALLOC (p4est_topidx_t, P8EST_EDGES * nt);
+  retval = retval || (r->num_edges > 0 &&
+                      p4est_conn_reader_gather (r, P4EST_CONN_TTE, &trees,
+                                                gtte));
+#endif
+
+  /* the vertices used by the extracted trees */
+  nv = 0;
+  if (!retval && r->num_vertices > 0) {
+    sc_array_resize (&vertices, P4EST_CHILDREN * nt);
+    memcpy (vertices.array, gttv, vertices.elem_count * vertices.elem_size);
+    sc_array_sort (&vertices, p4est_topidx_compare);
+    sc_array_uniq (&vertices, p4est_topidx_compare);
+    nv = (p4est_topidx_t) vertices.elem_count;
+  }
+
+  if (!retval) {
+    conn = p4est_connectivity_new (nv, (p4est_topidx_t) nt,
+#ifdef P4_TO_P8
+                                   (p4est_topidx_t) edges.ids.elem_count,
+                                   (p4est_topidx_t) edges.trees.elem_count,
+#endif
+                                   (p4est_topidx_t) corners.ids.elem_count,
+                                   (p4est_topidx_t) corners.trees.elem_count);
+    p4est_connectivity_set_attr (conn, r->tree_attr_bytes);
+    retval = p4est_conn_reader_gather (r, P4EST_CONN_ATTR, &trees,
+                                       conn->tree_to_attr) ||
+      (nv > 0 && p4est_conn_reader_gather (r, P4EST_CONN_VERTICES, &vertices,
+                                           conn->vertices));
+  }
+  if (!retval) {
+    /* faces to trees outside of the extracted ones become boundaries */
+    for (zz = 0; zz < nt; ++zz) {
+      for (face = 0; face < P4EST_FACES; ++face) {
+        pt = &gttt[P4EST_FACES * zz + face];
+        si = sc_array_bsearch (&trees, pt, p4est_topidx_compare);
+        if (si >= 0) {
+          conn->tree_to_tree[P4EST_FACES * zz + face] = (p4est_topidx_t) si;
+          conn->tree_to_face[P4EST_FACES * zz + face] =
+            gttf[P4EST_FACES * zz + face];
+        }
+        else {
+          conn->tree_to_tree[P4EST_FACES * zz + face] = (p4est_topidx_t) zz;
+          conn->tree_to_face[P4EST_FACES * zz + face] = (int8_t) face;
+        }
+      }
+    }
+    for (zz = 0; nv > 0 && zz < P4EST_CHILDREN * nt; ++zz) {
+      si = sc_array_bsearch (&vertices, &gttv[zz], p4est_topidx_compare);
+      P4EST_ASSERT (si >= 0);
+      conn->tree_to_vertex[zz] = (p4est_topidx_t) si;
+    }
+    if (conn->num_corners > 0) {
+      p4est_conn_entities_assign (&corners, gttc, &trees,
+                                  conn->tree_to_corner, conn->ctt_offset,
+                                  conn->corner_to_tree,
+                                  conn->corner_to_corner);
+    }
+#ifdef P4_TO_P8
+    if (conn->num_edges > 0) {
+      p4est_conn_entities_assign (&edges, gtte, &trees,
+                                  conn->tree_to_edge, conn->ett_offset,
+                                  conn->edge_to_tree, conn->edge_to_edge);
+    }
+#endif
+    if (tree_global != NULL) {
+      P4EST_ASSERT (tree_global->elem_size == sizeof (p4est_topidx_t));
+      sc_array_resize (tree_global, nt);
+      memcpy (tree_global->array, trees.array, nt * sizeof (p4est_topidx_t));
+    }
+    P4EST_ASSERT (p4est_connectivity_is_valid (conn));
+  }
+  else if (conn != NULL) {
+    p4est_connectivity_destroy (conn);
+    conn = NULL;
+  }
+
+  P4EST_FREE (gttt);
+  P4EST_FREE (gttf);
+  P4EST_FREE (gttv);
+  P4EST_FREE (gttc);
+#ifdef P4_TO_P8
+  P4EST_FREE (gtte);
+#endif
+
+extract_done:
+  sc_array_reset (&trees);
+  sc_array_reset (&vertices);
+  p4est_conn_entities_reset (&corners);
+#ifdef P4_TO_P8
+  p4est_conn_entities_reset (&edges);
+#endif
+  return conn;
+}
+
+p4est_connectivity_t *
+p4est_connectivity_extract (p4est_connectivity_t * conn,
+                            p4est_topidx_t first_tree,
+                            p4est_topidx_t last_tree, sc_array_t * tree_global)
+{
+  p4est_conn_reader_t reader;
+  p4est_connectivity_t *local;
+
+  P4EST_ASSERT (p4est_connectivity_is_valid (conn));
+  P4EST_ASSERT (0 <= first_tree && first_tree - 1 <= last_tree &&
+                last_tree < conn->num_trees);
+
+  p4est_conn_reader_memory (&reader, conn);
+  local = p4est_connectivity_extract_internal (&reader, first_tree,
+                                               last_tree, tree_global);
+  P4EST_ASSERT (local != NULL);
+
+  return local;
+}
+
+p4est_connectivity_t *
+p4est_connectivity_load_local (const char *filename,
+                               p4est_topidx_t first_tree,
+                               p4est_topidx_t last_tree,
+                               sc_array_t * tree_global, size_t *bytes)
+{
+  int                 retval;
+  p4est_conn_reader_t reader;
+  p4est_connectivity_t *conn = NULL;
+
+  retval = p4est_conn_reader_open (&reader, filename);
+  if (!retval) {
+    conn = p4est_connectivity_extract_internal (&reader, first_tree,
+                                                last_tree, tree_global);
+  }
+  if (reader.file != NULL) {
+    retval = fclose (reader.file);
+    if (retval && conn != NULL) {
+      p4est_connectivity_destroy (conn);
+      conn = NULL;
+    }
+  }
+
+  if (conn != NULL && bytes != NULL) {
+    *bytes = reader.bytes;
+  }
+  return conn;
+}
+
 #ifndef P4_TO_P8
 
 p4est_connectivity_t *
@@ -3346,6 +4056,7 @@ p4est_connectivity_complete (p4est_connectivity_t * conn)
   sc_array_t         *node_corners, *nc;
   sc_array_t         *cta = &cinfo.corner_transforms;
 
+  P4EST_ASSERT (conn->shared == NULL);
   P4EST_ASSERT (p4est_connectivity_is_valid (conn));
 
   /* prepare data structures and remove previous connectivity information */
@@ -3723,9 +4434,396 @@ p4est_connectivity_complete (p4est_connectivity_t * conn)
   P4EST_ASSERT (p4est_connectivity_is_valid (conn));
 }
 
+/** Gather the arrays of all processes in the order of their ranks.
+ * \param [in] local    Array of \ref p4est_topidx_t on this process.
+ * \param [out] global  Initialized array of \ref p4est_topidx_t that is
+ *                      resized to the concatenation of all local arrays.
+ */
+static void
+p4est_conn_allgather (sc_MPI_Comm mpicomm, int mpisize,
+                      sc_array_t * local, sc_array_t * global)
+{
+  int                 mpiret;
+  int                 p, count;
+  int                *counts, *displs;
+
+  P4EST_ASSERT (local->elem_size == sizeof (p4est_topidx_t));
+  P4EST_ASSERT (global->elem_size == sizeof (p4est_topidx_t));
+
+  counts = P4EST_ALLOC (int, mpisize);
+  displs = P4EST_ALLOC (int, mpisize + 1);
+  count = (int) local->elem_count;
+  mpiret = sc_MPI_Allgather (&count, 1, sc_MPI_INT,
+                             counts, 1, sc_MPI_INT, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  displs[0] = 0;
+  for (p = 0; p < mpisize; ++p) {
+    displs[p + 1] = displs[p] + counts[p];
+  }
+  sc_array_resize (global, (size_t) displs[mpisize]);
+  mpiret = sc_MPI_Allgatherv (local->array, count, P4EST_MPI_TOPIDX,
+                              global->array, counts, displs,
+                              P4EST_MPI_TOPIDX, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (counts);
+  P4EST_FREE (displs);
+}
+
+void
+p4est_connectivity_complete_parallel (p4est_connectivity_t * conn,
+                                      sc_MPI_Comm mpicomm)
+{
+  int                 mpiret, mpisize, mpirank;
+  int                 face, corner, r;
+  int                 primary, secondary, j;
+  size_t              pz, zz, zcount;
+  p4est_topidx_t      treeid, nodeid, tt;
+  p4est_topidx_t      first_vertex, end_vertex;
+  p4est_topidx_t      count, offset, num_records;
+  p4est_topidx_t     *ttv, *whichttv[2], *rec;
+  p4est_conn_face_info_t fikey, *fi;
+  sc_hash_array_t    *face_ha;
+  sc_array_t          local, global;
+#ifdef P4_TO_P8
+  int                 edge;
+  size_t              ez;
+  p4est_topidx_t      pos, enode[2], num_pos;
+  p4est_topidx_t     *order;
+  p8est_conn_edge_info_t eikey, *ei;
+  p8est_edge_info_t   einfo;
+  sc_hash_array_t    *edge_ha;
+  sc_array_t          edge_array, edge_to_pz;
+  sc_array_t          rec_trees, rec_codes;
+  sc_array_t         *eta = &einfo.edge_transforms;
+#endif
+  p4est_corner_info_t cinfo;
+  sc_array_t         *node_trees, *nt;
+  sc_array_t         *node_corners, *nc;
+  sc_array_t         *cta = &cinfo.corner_transforms;
+
+  P4EST_ASSERT (conn->shared == NULL);
+  P4EST_ASSERT (p4est_connectivity_is_valid (conn));
+
+  mpiret = sc_MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+  if (mpisize == 1) {
+    p4est_connectivity_complete (conn);
+    return;
+  }
+
+  /* each process owns the faces, edges and corners of a vertex range */
+  first_vertex = (p4est_topidx_t)
+    (((long long) conn->num_vertices * mpirank) / mpisize);
+  end_vertex = (p4est_topidx_t)
+    (((long long) conn->num_vertices * (mpirank + 1)) / mpisize);
+  sc_array_init (&local, sizeof (p4est_topidx_t));
+  sc_array_init (&global, sizeof (p4est_topidx_t));
+
+  /* pair the owned faces and exchange the new face connections */
+  face_ha = sc_hash_array_new (sizeof (p4est_conn_face_info_t),
+                               p4est_conn_face_hash, p4est_conn_face_equal,
+                               NULL);
+  ttv = conn->tree_to_vertex;
+  for (treeid = 0; treeid < conn->num_trees; ++treeid) {
+    for (face = 0; face < P4EST_FACES; ++face) {
+      p4est_conn_face_key (fikey.key, ttv, face);
+      if (fikey.key[0] < first_vertex || fikey.key[0] >= end_vertex) {
+        continue;
+      }
+      fi = (p4est_conn_face_info_t *)
+        sc_hash_array_insert_unique (face_ha, &fikey, &pz);
+      if (fi != NULL) {
+        memcpy (fi->key, fikey.key, P4EST_HALF * sizeof (p4est_topidx_t));
+        fi->trees[0] = treeid;
+        fi->faces[0] = (int8_t) face;
+        fi->trees[1] = -1;
+        fi->faces[1] = -1;
+        continue;
+      }
+      fi = (p4est_conn_face_info_t *) sc_array_index (&face_ha->a, pz);
+      P4EST_ASSERT (fi->trees[1] == -1 && fi->faces[1] == -1);
+      fi->trees[1] = treeid;
+      fi->faces[1] = (int8_t) face;
+
+      /* find primary face and orientation as in the serial algorithm */
+      primary = (fi->faces[0] <= fi->faces[1] ? 0 : 1);
+      secondary = 1 - primary;
+      whichttv[0] = conn->tree_to_vertex + P4EST_CHILDREN * fi->trees[0];
+      whichttv[1] = ttv;
+      nodeid = whichttv[primary][p4est_face_corners[fi->faces[primary]][0]];
+      for (r = 0; r < P4EST_HALF; ++r) {
+        corner = p4est_face_corners[fi->faces[secondary]][r];
+        if (nodeid == whichttv[secondary][corner]) {
+          break;
+        }
+      }
+      P4EST_ASSERT (r < P4EST_HALF);
+      for (j = 0; j < 2; ++j) {
+        rec = (p4est_topidx_t *) sc_array_push_count (&local, 3);
+        rec[0] = P4EST_FACES * fi->trees[j] + fi->faces[j];
+        rec[1] = fi->trees[1 - j];
+        rec[2] = (p4est_topidx_t) (P4EST_FACES * r + fi->faces[1 - j]);
+      }
+    }
+    ttv += P4EST_CHILDREN;
+  }
+  sc_hash_array_destroy (face_ha);
+  p4est_conn_allgather (mpicomm, mpisize, &local, &global);
+  for (zz = 0; zz < global.elem_count; zz += 3) {
+    rec = (p4est_topidx_t *) sc_array_index (&global, zz);
+    conn->tree_to_tree[rec[0]] = rec[1];
+    conn->tree_to_face[rec[0]] = (int8_t) rec[2];
+  }
+  sc_array_reset (&local);
+
+#ifdef P4_TO_P8
+  /* collect the owned edges in the order of their second occurrence */
+  edge_ha = sc_hash_array_new (sizeof (p8est_conn_edge_info_t),
+                               p8est_conn_edge_hash, p8est_conn_edge_equal,
+                               NULL);
+  sc_array_init (&edge_to_pz, sizeof (p4est_topidx_t));
+  sc_array_init (&rec_trees, sizeof (p4est_topidx_t));
+  sc_array_init (&rec_codes, sizeof (int8_t));
+  ttv = conn->tree_to_vertex;
+  for (treeid = 0; treeid < conn->num_trees; ++treeid) {
+    for (edge = 0; edge < P8EST_EDGES; ++edge) {
+      p8est_conn_edge_key (eikey.key, ttv, edge);
+      if (eikey.key[0] < first_vertex || eikey.key[0] >= end_vertex) {
+        continue;
+      }
+      ei = (p8est_conn_edge_info_t *)
+        sc_hash_array_insert_unique (edge_ha, &eikey, &pz);
+      if (ei != NULL) {
+        memcpy (ei->key, eikey.key, 2 * sizeof (p4est_topidx_t));
+        ei->edgeid = -1;
+        sc_array_init (&ei->trees, sizeof (p4est_topidx_t));
+        sc_array_init (&ei->edges, sizeof (int8_t));
+      }
+      else {
+        ei = (p8est_conn_edge_info_t *) sc_array_index (&edge_ha->a, pz);
+        if (ei->trees.elem_count == 1) {
+          /* remember the position that numbers the edge */
+          ei->edgeid = P8EST_EDGES * treeid + edge;
+          *(p4est_topidx_t *) sc_array_push (&edge_to_pz) =
+            (p4est_topidx_t) pz;
+        }
+      }
+      *(p4est_topidx_t *) sc_array_push (&ei->trees) = treeid;
+      *(int8_t *) sc_array_push (&ei->edges) = (int8_t) edge;
+    }
+    ttv += P4EST_CHILDREN;
+  }
+
+  /* keep the non-redundant edges as records of position and trees */
+  sc_hash_array_rip (edge_ha, &edge_array);
+  sc_array_init (eta, sizeof (p8est_edge_transform_t));
+  for (ez = 0; ez < edge_to_pz.elem_count; ++ez) {
+    ei = (p8est_conn_edge_info_t *) sc_array_index
+      (&edge_array, *(p4est_topidx_t *) sc_array_index (&edge_to_pz, ez));
+    zcount = ei->trees.elem_count;
+    P4EST_ASSERT (zcount > 1 && zcount == ei->edges.elem_count);
+    sc_array_resize (&rec_trees, zcount);
+    sc_array_resize (&rec_codes, zcount);
+    for (zz = 0; zz < zcount; ++zz) {
+      treeid = *(p4est_topidx_t *) sc_array_index (&ei->trees, zz);
+      edge = (int) *(int8_t *) sc_array_index (&ei->edges, zz);
+      for (j = 0; j < 2; ++j) {
+        enode[j] = conn->tree_to_vertex[P4EST_CHILDREN * treeid
+                                        + p8est_edge_corners[edge][j]];
+      }
+      P4EST_ASSERT (enode[0] != enode[1]);
+      *(p4est_topidx_t *) sc_array_index (&rec_trees, zz) = treeid;
+      *(int8_t *) sc_array_index (&rec_codes, zz) =
+        (int8_t) (edge + (enode[0] < enode[1] ? 0 : P8EST_EDGES));
+    }
+    for (zz = 0; zz < zcount; ++zz) {
+      einfo.iedge = -1;         /* unused */
+      p8est_find_edge_transform_internal
+        (conn, *(p4est_topidx_t *) sc_array_index (&ei->trees, zz),
+         (int) *(int8_t *) sc_array_index (&ei->edges, zz), &einfo,
+         (p4est_topidx_t *) rec_trees.array, (int8_t *) rec_codes.array,
+         (p4est_topidx_t) zcount);
+      if (eta->elem_count != 0) {
+        break;
+      }
+    }
+    if (eta->elem_count != 0) {
+      sc_array_reset (eta);
+      rec = (p4est_topidx_t *) sc_array_push_count (&local, 2 + 2 * zcount);
+      rec[0] = ei->edgeid;
+      rec[1] = (p4est_topidx_t) zcount;
+      for (zz = 0; zz < zcount; ++zz) {
+        rec[2 + 2 * zz] = *(p4est_topidx_t *) sc_array_index (&rec_trees, zz);
+        rec[3 + 2 * zz] = *(int8_t *) sc_array_index (&rec_codes, zz);
+      }
+    }
+  }
+  for (ez = 0; ez < edge_array.elem_count; ++ez) {
+    ei = (p8est_conn_edge_info_t *) sc_array_index (&edge_array, ez);
+    sc_array_reset (&ei->trees);
+    sc_array_reset (&ei->edges);
+  }
+  sc_array_reset (&edge_array);
+  sc_array_reset (&edge_to_pz);
+  sc_array_reset (&rec_trees);
+  sc_array_reset (&rec_codes);
+  p4est_conn_allgather (mpicomm, mpisize, &local, &global);
+  sc_array_reset (&local);
+
+  /* number the edges by the position of their second occurrence */
+  P4EST_FREE (conn->tree_to_edge);
+  P4EST_FREE (conn->ett_offset);
+  P4EST_FREE (conn->edge_to_tree);
+  P4EST_FREE (conn->edge_to_edge);
+  num_pos = P8EST_EDGES * conn->num_trees;
+  conn->tree_to_edge = P4EST_ALLOC (p4est_topidx_t, num_pos);
+  memset (conn->tree_to_edge, -1, num_pos * sizeof (p4est_topidx_t));
+  num_records = offset = 0;
+  for (zz = 0; zz < global.elem_count; zz += 2 + 2 * (size_t) count) {
+    rec = (p4est_topidx_t *) sc_array_index (&global, zz);
+    conn->tree_to_edge[rec[0]] = (p4est_topidx_t) zz;
+    count = rec[1];
+    ++num_records;
+    offset += count;
+  }
+  order = P4EST_ALLOC (p4est_topidx_t, num_records);
+  num_records = 0;
+  for (pos = 0; pos < num_pos; ++pos) {
+    if (conn->tree_to_edge[pos] >= 0) {
+      order[num_records++] = conn->tree_to_edge[pos];
+      conn->tree_to_edge[pos] = -1;
+    }
+  }
+  conn->num_edges = num_records;
+  conn->ett_offset = P4EST_ALLOC (p4est_topidx_t, conn->num_edges + 1);
+  conn->edge_to_tree = P4EST_ALLOC (p4est_topidx_t, offset);
+  conn->edge_to_edge = P4EST_ALLOC (int8_t, offset);
+  offset = 0;
+  for (tt = 0; tt < conn->num_edges; ++tt) {
+    rec = (p4est_topidx_t *) sc_array_index (&global, (size_t) order[tt]);
+    conn->ett_offset[tt] = offset;
+    for (j = 0; j < (int) rec[1]; ++j) {
+      treeid = rec[2 + 2 * j];
+      edge = (int) rec[3 + 2 * j];
+      conn->tree_to_edge[P8EST_EDGES * treeid + edge % P8EST_EDGES] = tt;
+      conn->edge_to_tree[offset] = treeid;
+      conn->edge_to_edge[offset] = (int8_t) edge;
+      ++offset;
+    }
+  }
+  conn->ett_offset[conn->num_edges] = offset;
+  P4EST_FREE (order);
+#endif /* P4_TO_P8 */
+
+  /* collect the trees at the owned vertices */
+  node_trees = P4EST_ALLOC (sc_array_t, end_vertex - first_vertex);
+  node_corners = P4EST_ALLOC (sc_array_t, end_vertex - first_vertex);
+  for (nodeid = 0; nodeid < end_vertex - first_vertex; ++nodeid) {
+    sc_array_init (node_trees + nodeid, sizeof (p4est_topidx_t));
+    sc_array_init (node_corners + nodeid, sizeof (int8_t));
+  }
+  ttv = conn->tree_to_vertex;
+  for (treeid = 0; treeid < conn->num_trees; ++treeid) {
+    for (corner = 0; corner < P4EST_CHILDREN; ++corner) {
+      nodeid = ttv[corner];
+      if (nodeid < first_vertex || nodeid >= end_vertex) {
+        continue;
+      }
+      *(p4est_topidx_t *) sc_array_push (node_trees + nodeid -
+                                         first_vertex) = treeid;
+      *(int8_t *) sc_array_push (node_corners + nodeid - first_vertex) =
+        (int8_t) corner;
+    }
+    ttv += P4EST_CHILDREN;
+  }
+
+  /* keep the non-redundant corners as records of vertex and trees */
+  sc_array_init (cta, sizeof (p4est_corner_transform_t));
+  for (nodeid = first_vertex; nodeid < end_vertex; ++nodeid) {
+    nt = node_trees + nodeid - first_vertex;
+    nc = node_corners + nodeid - first_vertex;
+    zcount = nt->elem_count;
+    P4EST_ASSERT (zcount == nc->elem_count);
+    if (zcount > 1) {
+      for (zz = 0; zz < zcount; ++zz) {
+        cinfo.icorner = -1;     /* unused */
+        (void)
+          p4est_find_corner_transform_internal
+          (conn, *(p4est_topidx_t *) sc_array_index (nt, zz),
+           (int) *(int8_t *) sc_array_index (nc, zz), &cinfo,
+           (p4est_topidx_t *) nt->array, (int8_t *) nc->array,
+           (p4est_topidx_t) zcount);
+        if (cta->elem_count != 0) {
+          break;
+        }
+      }
+      if (cta->elem_count != 0) {
+        sc_array_reset (cta);
+        rec = (p4est_topidx_t *) sc_array_push_count (&local,
+                                                      1 + 2 * zcount);
+        rec[0] = (p4est_topidx_t) zcount;
+        for (zz = 0; zz < zcount; ++zz) {
+          rec[1 + 2 * zz] = *(p4est_topidx_t *) sc_array_index (nt, zz);
+          rec[2 + 2 * zz] = *(int8_t *) sc_array_index (nc, zz);
+        }
+      }
+    }
+    sc_array_reset (nt);
+    sc_array_reset (nc);
+  }
+  P4EST_FREE (node_trees);
+  P4EST_FREE (node_corners);
+  p4est_conn_allgather (mpicomm, mpisize, &local, &global);
+  sc_array_reset (&local);
+
+  /* the corners are numbered in the order of their vertices */
+  P4EST_FREE (conn->tree_to_corner);
+  P4EST_FREE (conn->ctt_offset);
+  P4EST_FREE (conn->corner_to_tree);
+  P4EST_FREE (conn->corner_to_corner);
+  num_records = offset = 0;
+  for (zz = 0; zz < global.elem_count; zz += 1 + 2 * (size_t) count) {
+    count = *(p4est_topidx_t *) sc_array_index (&global, zz);
+    ++num_records;
+    offset += count;
+  }
+  tt = P4EST_CHILDREN * conn->num_trees;
+  conn->tree_to_corner = P4EST_ALLOC (p4est_topidx_t, tt);
+  memset (conn->tree_to_corner, -1, tt * sizeof (p4est_topidx_t));
+  conn->num_corners = num_records;
+  conn->ctt_offset = P4EST_ALLOC (p4est_topidx_t, conn->num_corners + 1);
+  conn->corner_to_tree = P4EST_ALLOC (p4est_topidx_t, offset);
+  conn->corner_to_corner = P4EST_ALLOC (int8_t, offset);
+  zz = 0;
+  offset = 0;
+  for (tt = 0; tt < conn->num_corners; ++tt) {
+    rec = (p4est_topidx_t *) sc_array_index (&global, zz);
+    conn->ctt_offset[tt] = offset;
+    for (j = 0; j < (int) rec[0]; ++j) {
+      treeid = rec[1 + 2 * j];
+      corner = (int) rec[2 + 2 * j];
+      conn->tree_to_corner[P4EST_CHILDREN * treeid + corner] = tt;
+      conn->corner_to_tree[offset] = treeid;
+      conn->corner_to_corner[offset] = (int8_t) corner;
+      ++offset;
+    }
+    zz += 1 + 2 * (size_t) rec[0];
+  }
+  conn->ctt_offset[conn->num_corners] = offset;
+
+  sc_array_reset (&global);
+
+  /* and be done */
+  P4EST_ASSERT (p4est_connectivity_is_valid (conn));
+}
+
 void
 p4est_connectivity_reduce (p4est_connectivity_t * conn)
 {
+  P4EST_ASSERT (conn->shared == NULL);
+
   conn->num_corners = 0;
   conn->ctt_offset[conn->num_corners] = 0;
   P4EST_FREE (conn->tree_to_corner);
@@ -3758,6 +4856,8 @@ p4est_connectivity_permute (p4est_connectivity_t * conn, sc_array_t * inperm,
   sc_array_t          array_view;
   int                 j;
 
+  P4EST_ASSERT (conn->shared == NULL);
+
   /* we want the permutation to be the current to new map, not
    * the new to current map */
   if (is_current_to_new) {
@@ -4089,6 +5189,329 @@ p4est_topidx_compare_2 (const void *A, const void *B)
   return ret;
 }
 
+/** Number of bits per coordinate in the space-filling curve keys. */
+#define P4EST_CONN_SFC_BITS 21
+
+/** A tree together with its position on a space-filling curve. */
+typedef struct p4est_conn_sfc_key
+{
+  uint64_t            key;
+  p4est_topidx_t      tree;
+}
+p4est_conn_sfc_key_t;
+
+static int
+p4est_conn_sfc_key_compare (const void *A, const void *B)
+{
+  const p4est_conn_sfc_key_t *a = (const p4est_conn_sfc_key_t *) A;
+  const p4est_conn_sfc_key_t *b = (const p4est_conn_sfc_key_t *) B;
+
+  if (a->key != b->key) {
+    return a->key < b->key ? -1 : 1;
+  }
+  return a->tree == b->tree ? 0 : (a->tree < b->tree ? -1 : 1);
+}
+
+/** Compute the Morton or Hilbert index of a point with integer coordinates.
+ * The Hilbert index follows J. Skilling, Programming the Hilbert curve,
+ * AIP Conference Proceedings 707 (2004), which works in any dimension.
+ * \param [in,out] x    \a dim coordinates of P4EST_CONN_SFC_BITS bits each,
+ *                      the last one varying fastest.  They are overwritten.
+ * \param [in] dim      The number of coordinates, 2 or 3.
+ */
+static uint64_t
+p4est_conn_sfc_index (uint32_t x[3], int dim, int hilbert)
+{
+  int                 i, j;
+  uint32_t            p, q, t;
+  uint64_t            key;
+
+  P4EST_ASSERT (dim == 2 || dim == 3);
+
+  if (hilbert) {
+    /* undo the excess work of the recursive construction */
+    for (q = (uint32_t) 1 << (P4EST_CONN_SFC_BITS - 1); q > 1; q >>= 1) {
+      p = q - 1;
+      for (i = 0; i < dim; ++i) {
+        if (x[i] & q) {
+          x[0] ^= p;
+        }
+        else {
+          t = (x[0] ^ x[i]) & p;
+          x[0] ^= t;
+          x[i] ^= t;
+        }
+      }
+    }
+
+    /* Gray encode the transposed index */
+    for (i = 1; i < dim; ++i) {
+      x[i] ^= x[i - 1];
+    }
+    t = 0;
+    for (q = (uint32_t) 1 << (P4EST_CONN_SFC_BITS - 1); q > 1; q >>= 1) {
+      if (x[dim - 1] & q) {
+        t ^= q - 1;
+      }
+    }
+    for (i = 0; i < dim; ++i) {
+      x[i] ^= t;
+    }
+  }
+
+  /* interleave the bits of the coordinates */
+  key = 0;
+  for (j = P4EST_CONN_SFC_BITS - 1; j >= 0; --j) {
+    for (i = 0; i < dim; ++i) {
+      key = (key << 1) | ((x[i] >> j) & 1);
+    }
+  }
+  return key;
+}
+
+/** Order the trees by a space-filling curve through their vertex centroids.
+ * \param [out] order   The old tree numbers in their new order.
+ */
+static void
+p4est_conn_order_sfc (p4est_connectivity_t * conn, int hilbert,
+                      p4est_topidx_t * order)
+{
+  const p4est_topidx_t num_trees = conn->num_trees;
+  int                 i, c, dim;
+  double              lower[3], upper[3], extent, scale;
+  double             *centroid;
+  uint32_t            x[3];
+  p4est_topidx_t      jt;
+  p4est_conn_sfc_key_t *sk;
+  sc_array_t          keys;
+
+  P4EST_ASSERT (conn->num_vertices > 0 && num_trees > 0);
+
+  /* the centroids and their bounding box */
+  centroid = P4EST_ALLOC (double, 3 * num_trees);
+  for (jt = 0; jt < num_trees; ++jt) {
+    for (i = 0; i < 3; ++i) {
+      centroid[3 * jt + i] = 0.;
+      for (c = 0; c < P4EST_CHILDREN; ++c) {
+        centroid[3 * jt + i] += conn->vertices
+          [3 * conn->tree_to_vertex[P4EST_CHILDREN * jt + c] + i];
+      }
+      centroid[3 * jt + i] /= P4EST_CHILDREN;
+      if (jt == 0) {
+        lower[i] = upper[i] = centroid[i];
+      }
+      lower[i] = SC_MIN (lower[i], centroid[3 * jt + i]);
+      upper[i] = SC_MAX (upper[i], centroid[3 * jt + i]);
+    }
+  }
+
+  /* scale all directions alike to preserve the aspect ratio */
+  extent = 0.;
+  for (i = 0; i < 3; ++i) {
+    extent = SC_MAX (extent, upper[i] - lower[i]);
+  }
+  scale = extent > 0. ?
+    (double) (((uint32_t) 1 << P4EST_CONN_SFC_BITS) - 1) / extent : 0.;
+
+  /* use a two-dimensional curve if all centroids lie in a plane z = const */
+  dim = upper[2] > lower[2] ? 3 : 2;
+
+  sc_array_init_size (&keys, sizeof (p4est_conn_sfc_key_t),
+                      (size_t) num_trees);
+  for (jt = 0; jt < num_trees; ++jt) {
+    for (i = 0; i < dim; ++i) {
+      /* the first axis varies fastest as in the Morton order of p4est */
+      x[dim - 1 - i] =
+        (uint32_t) ((centroid[3 * jt + i] - lower[i]) * scale + .5);
+    }
+    sk = (p4est_conn_sfc_key_t *) sc_array_index (&keys, (size_t) jt);
+    sk->key = p4est_conn_sfc_index (x, dim, hilbert);
+    sk->tree = jt;
+  }
+  P4EST_FREE (centroid);
+
+  sc_array_sort (&keys, p4est_conn_sfc_key_compare);
+  for (jt = 0; jt < num_trees; ++jt) {
+    order[jt] =
+      ((p4est_conn_sfc_key_t *) sc_array_index (&keys, (size_t) jt))->tree;
+  }
+  sc_array_reset (&keys);
+}
+
+/** Order the trees by reverse Cuthill-McKee on the dual graph.
+ * \param [out] order   The old tree numbers in their new order.
+ */
+static void
+p4est_conn_order_rcm (p4est_connectivity_t * conn,
+                      p4est_connect_type_t ctype, p4est_topidx_t * order)
+{
+  const p4est_topidx_t num_trees = conn->num_trees;
+  const int           conntype = p4est_connect_type_int (ctype);
+  int                 j;
+  size_t              zz, first, last;
+  p4est_topidx_t      jt, nt, head, tail, start, swap;
+  p4est_topidx_t     *offset, *degree, *pair;
+  char               *visited;
+  sc_array_t          adjacency, neighbors, pairs, by_degree;
+  p4est_corner_info_t ci;
+  sc_array_t         *cta = &ci.corner_transforms;
+#ifdef P4_TO_P8
+  p8est_edge_info_t   ei;
+  sc_array_t         *eta = &ei.edge_transforms;
+#endif
+
+  /* the distinct neighbors of every tree in compressed rows */
+  offset = P4EST_ALLOC (p4est_topidx_t, num_trees + 1);
+  degree = P4EST_ALLOC (p4est_topidx_t, num_trees);
+  sc_array_init (&adjacency, sizeof (p4est_topidx_t));
+  sc_array_init (&neighbors, sizeof (p4est_topidx_t));
+  sc_array_init (&pairs, 2 * sizeof (p4est_topidx_t));
+  sc_array_init (cta, sizeof (p4est_corner_transform_t));
+#ifdef P4_TO_P8
+  sc_array_init (eta, sizeof (p8est_edge_transform_t));
+#endif
+  offset[0] = 0;
+  for (jt = 0; jt < num_trees; ++jt) {
+    sc_array_truncate (&neighbors);
+    for (j = 0; j < P4EST_FACES; ++j) {
+      *(p4est_topidx_t *) sc_array_push (&neighbors) =
+        conn->tree_to_tree[P4EST_FACES * jt + j];
+    }
+#ifdef P4_TO_P8
+    if (conntype >= 2) {
+      for (j = 0; j < P8EST_EDGES; ++j) {
+        p8est_find_edge_transform (conn, jt, j, &ei);
+        for (zz = 0; zz < eta->elem_count; ++zz) {
+          *(p4est_topidx_t *) sc_array_push (&neighbors) =
+            p8est_edge_array_index (eta, zz)->ntree;
+        }
+      }
+    }
+#endif
+    if (conntype == P4EST_DIM) {
+      for (j = 0; j < P4EST_CHILDREN; ++j) {
+        p4est_find_corner_transform (conn, jt, j, &ci);
+        for (zz = 0; zz < cta->elem_count; ++zz) {
+          *(p4est_topidx_t *) sc_array_push (&neighbors) =
+            p4est_corner_array_index (cta, zz)->ntree;
+        }
+      }
+    }
+    sc_array_sort (&neighbors, p4est_topidx_compare);
+    sc_array_uniq (&neighbors, p4est_topidx_compare);
+    for (zz = 0; zz < neighbors.elem_count; ++zz) {
+      nt = *(p4est_topidx_t *) sc_array_index (&neighbors, zz);
+      if (nt != jt) {
+        *(p4est_topidx_t *) sc_array_push (&adjacency) = nt;
+      }
+    }
+    offset[jt + 1] = (p4est_topidx_t) adjacency.elem_count;
+    degree[jt] = offset[jt + 1] - offset[jt];
+  }
+  sc_array_reset (cta);
+#ifdef P4_TO_P8
+  sc_array_reset (eta);
+#endif
+
+  /* components start from an unvisited tree of least degree */
+  sc_array_init_size (&by_degree, 2 * sizeof (p4est_topidx_t),
+                      (size_t) num_trees);
+  for (jt = 0; jt < num_trees; ++jt) {
+    pair = (p4est_topidx_t *) sc_array_index (&by_degree, (size_t) jt);
+    pair[0] = degree[jt];
+    pair[1] = jt;
+  }
+  sc_array_sort (&by_degree, p4est_topidx_compare_2);
+
+  /* breadth-first search visiting neighbors by increasing degree */
+  visited = P4EST_ALLOC_ZERO (char, num_trees);
+  head = tail = start = 0;
+  while (tail < num_trees) {
+    if (head == tail) {
+      do {
+        pair = (p4est_topidx_t *) sc_array_index (&by_degree,
+                                                  (size_t) start++);
+      } while (visited[pair[1]]);
+      visited[pair[1]] = 1;
+      order[tail++] = pair[1];
+    }
+    jt = order[head++];
+    sc_array_truncate (&pairs);
+    for (nt = offset[jt]; nt < offset[jt + 1]; ++nt) {
+      swap = *(p4est_topidx_t *) sc_array_index (&adjacency, (size_t) nt);
+      if (!visited[swap]) {
+        visited[swap] = 1;
+        pair = (p4est_topidx_t *) sc_array_push (&pairs);
+        pair[0] = degree[swap];
+        pair[1] = swap;
+      }
+    }
+    sc_array_sort (&pairs, p4est_topidx_compare_2);
+    for (zz = 0; zz < pairs.elem_count; ++zz) {
+      order[tail++] = ((p4est_topidx_t *) sc_array_index (&pairs, zz))[1];
+    }
+  }
+  P4EST_ASSERT (head <= tail && tail == num_trees);
+
+  /* reverse the order */
+  for (first = 0, last = (size_t) num_trees; first + 1 < last;
+       ++first, --last) {
+    swap = order[first];
+    order[first] = order[last - 1];
+    order[last - 1] = swap;
+  }
+
+  P4EST_FREE (visited);
+  P4EST_FREE (offset);
+  P4EST_FREE (degree);
+  sc_array_reset (&adjacency);
+  sc_array_reset (&neighbors);
+  sc_array_reset (&pairs);
+  sc_array_reset (&by_degree);
+}
+
+void
+p4est_connectivity_sort_trees (p4est_connectivity_t * conn,
+                               p4est_connectivity_order_t order,
+                               p4est_connect_type_t ctype, sc_array_t * newid)
+{
+  p4est_topidx_t      jt;
+  p4est_topidx_t     *neworder;
+  sc_array_t         *perm;
+
+  P4EST_ASSERT (p4est_connectivity_is_valid (conn));
+  P4EST_ASSERT (conn->shared == NULL);
+  P4EST_ASSERT (order == P4EST_CONN_ORDER_MORTON ||
+                order == P4EST_CONN_ORDER_HILBERT ||
+                order == P4EST_CONN_ORDER_RCM);
+  P4EST_ASSERT (newid == NULL || newid->elem_size == sizeof (size_t));
+
+  neworder = P4EST_ALLOC (p4est_topidx_t, conn->num_trees);
+  if (conn->num_trees == 0) {
+    /* nothing to sort */
+  }
+  else if (order == P4EST_CONN_ORDER_RCM) {
+    p4est_conn_order_rcm (conn, ctype, neworder);
+  }
+  else {
+    SC_CHECK_ABORT (conn->num_vertices > 0,
+                    "Space-filling curve order requires vertices");
+    p4est_conn_order_sfc (conn, order == P4EST_CONN_ORDER_HILBERT, neworder);
+  }
+
+  perm = newid != NULL ? newid : sc_array_new (sizeof (size_t));
+  sc_array_resize (perm, (size_t) conn->num_trees);
+  for (jt = 0; jt < conn->num_trees; ++jt) {
+    *(size_t *) sc_array_index (perm, (size_t) neworder[jt]) = (size_t) jt;
+  }
+  P4EST_FREE (neworder);
+
+  p4est_connectivity_permute (conn, perm, 1);
+  if (newid == NULL) {
+    sc_array_destroy (perm);
+  }
+}
+
 static void
 p4est_connectivity_store_corner (p4est_connectivity_t * conn,
                                  p4est_topidx_t t, int c)
@@ -4509,6 +5932,7 @@ p4est_connectivity_join_faces (p4est_connectivity_t * conn,
 #endif
   int                 i;
 
+  P4EST_ASSERT (conn->shared == NULL);
   P4EST_ASSERT (p4est_connectivity_is_valid (conn));
   P4EST_ASSERT (tree_left >= 0 && tree_left < conn->num_trees);
   P4EST_ASSERT (tree_right >= 0 && tree_right < conn->num_trees);
@@ -132,6 +132,15 @@ typedef enum
 }
 p4est_connectivity_encode_t;
 
+/** Orders of the trees computed by \ref p4est_connectivity_sort_trees. */
+typedef enum
+{
+  P4EST_CONN_ORDER_MORTON,      /**< Morton curve through tree centroids. */
+  P4EST_CONN_ORDER_HILBERT,     /**< Hilbert curve through tree centroids. */
+  P4EST_CONN_ORDER_RCM          /**< Reverse Cuthill-McKee on the trees. */
+}
+p4est_connectivity_order_t;
+
 /** Convert the p4est_connect_type_t into a number.
  * \param [in] btype    The balance type to convert.
  * \return              Returns 1 or 2.
@@ -215,10 +224,14 @@ typedef struct p4est_connectivity
   p4est_topidx_t     *corner_to_tree; /**< list of trees that meet at a corner */
   int8_t             *corner_to_corner; /**< list of tree-corners that meet at
                                              a corner */
+  p4est_shared_t     *shared;   /**< if not NULL, all arrays except \a
+                                     tree_to_attr are node-shared memory */
 }
 p4est_connectivity_t;
 
 /** Calculate memory usage of a connectivity structure.
+ * Node-shared arrays, see \ref p4est_connectivity_share, are counted
+ * on the first process of each compute node only.
  * \param [in] conn   Connectivity structure.
  * \return            Memory used in bytes.
  */
@@ -436,10 +449,30 @@ p4est_connectivity_t *p4est_connectivity_bcast (p4est_connectivity_t *
                                                 sc_MPI_Comm comm);
 
 /** Destroy a connectivity structure.  Also destroy all attributes.
+ * If the connectivity is node-shared, see \ref p4est_connectivity_share,
+ * this function is collective over the processes of each compute node.
  */
 void                p4est_connectivity_destroy (p4est_connectivity_t *
                                                 connectivity);
 
+/** Move the arrays of a connectivity into memory shared per compute node.
+ * This is done only if \ref p4est_shared_set_enabled was called on \a
+ * mpicomm and MPI-3 shared windows are available.  Then the first process
+ * of each node copies the arrays into a shared window and all processes
+ * free their private copies.
+ * The node-shared connectivity must not be modified afterwards,
+ * except for the attributes in \a tree_to_attr that stay private.
+ * This function is collective over \a mpicomm and all processes must
+ * pass identical connectivities.  It is called by p4est_new_ext and
+ * p4est_load_ext on the connectivity they are given or load.
+ * \param [in,out] conn  Connectivity that is not modified by this call
+ *                       if node-shared memory is not enabled.
+ * \param [in] mpicomm   Communicator with node communicators attached.
+ * \return               True if the arrays of \a conn are node-shared.
+ */
+int                 p4est_connectivity_share (p4est_connectivity_t * conn,
+                                              sc_MPI_Comm mpicomm);
+
 /** Allocate or free the attribute fields in a connectivity.
  * \param [in,out] conn         The conn->*_to_attr fields must either be NULL
  *                              or previously be allocated by this function.
@@ -510,6 +543,55 @@ p4est_connectivity_t *p4est_connectivity_inflate (sc_array_t * buffer);
 p4est_connectivity_t *p4est_connectivity_load (const char *filename,
                                                size_t *bytes);
 
+/** Extract a range of trees and their neighborhood from a connectivity.
+ * The result contains the trees of the range and every tree that touches
+ * one of them through a face or a corner.  Its trees are numbered in
+ * ascending order of their global numbers.  The connections of the trees
+ * of the range are complete.  The connections of the neighbor trees to
+ * trees outside of the result become boundaries, and the corners that
+ * do not touch the range are set to -1.  Vertices are restricted to
+ * those used and renumbered, tree attributes are copied.
+ * Transformations between local trees, e.g. by \ref p4est_find_face_transform,
+ * agree with those of the original connectivity after the tree numbers
+ * have been translated by \a tree_global.
+ * This is a standalone building block, not a distributed connectivity:
+ * p4est_new, ghost, balance and the face and corner transformations
+ * still index the global connectivity by global tree number, so every
+ * forest requires it in full.  The local quadrants of a forest may be
+ * placed in space by \ref p4est_geometry_new_local.
+ * \param [in] conn        Valid connectivity structure.
+ * \param [in] first_tree  First global tree of the range.
+ * \param [in] last_tree   Last global tree of the range, inclusive.
+ *                         May be first_tree - 1 for an empty range.
+ * \param [in,out] tree_global  If not NULL, an array of \ref p4est_topidx_t
+ *                         that is resized to the local number of trees
+ *                         and filled with the global number of each.
+ * \return                 The newly created local connectivity.
+ */
+p4est_connectivity_t *p4est_connectivity_extract (p4est_connectivity_t * conn,
+                                                  p4est_topidx_t first_tree,
+                                                  p4est_topidx_t last_tree,
+                                                  sc_array_t * tree_global);
+
+/** Load a range of trees and their neighborhood from disk.
+ * Only the parts of the file needed are read.  Like the extracted
+ * connectivity, the result cannot replace the global one of a forest.
+ * The result is identical to that of \ref p4est_connectivity_extract
+ * applied to the connectivity in the file.
+ * \param [in] filename    Name of a file written by \ref p4est_connectivity_save.
+ * \param [in] first_tree  First global tree of the range.
+ * \param [in] last_tree   Last global tree of the range, inclusive.
+ * \param [in,out] tree_global  See \ref p4est_connectivity_extract.
+ * \param [in,out] bytes   Number of bytes read from the file or NULL.
+ * \return                 Returns valid connectivity, or NULL on file error
+ *                         or if the range does not fit the file.
+ */
+p4est_connectivity_t *p4est_connectivity_load_local (const char *filename,
+                                                     p4est_topidx_t first_tree,
+                                                     p4est_topidx_t last_tree,
+                                                     sc_array_t * tree_global,
+                                                     size_t *bytes);
+
 /** Create a connectivity structure for the unit square.
  */
 p4est_connectivity_t *p4est_connectivity_new_unitsquare (void);
@@ -764,6 +846,19 @@ void                p4est_find_corner_transform (p4est_connectivity_t *
  */
 void                p4est_connectivity_complete (p4est_connectivity_t * conn);
 
+/** Internally connect a connectivity in parallel.
+ * The result is identical to that of \ref p4est_connectivity_complete.
+ * The faces and corners are split between the processes by the range of
+ * their lowest vertex.  Each process hashes and checks its own share,
+ * and the results are exchanged by allgather.
+ * \param [in,out] conn     As for \ref p4est_connectivity_complete.
+ *                          It must be identical on all processes.
+ * \param [in] mpicomm      Communicator of all processes holding \a conn.
+ */
+void                p4est_connectivity_complete_parallel (p4est_connectivity_t
+                                                          * conn,
+                                                          sc_MPI_Comm mpicomm);
+
 /** Removes corner information of a connectivity
  *  such that enough information is left to run p4est_connectivity_complete successfully.
  *  The reduced connectivity still passes p4est_connectivity_is_valid.
@@ -788,6 +883,32 @@ void                p4est_connectivity_reduce (p4est_connectivity_t * conn);
 void                p4est_connectivity_permute (p4est_connectivity_t * conn,
                                                 sc_array_t * perm,
                                                 int is_current_to_new);
+
+/** Reorder the trees of a connectivity for locality without METIS.
+ * With a space-filling curve the trees are sorted by the Morton or Hilbert
+ * index of the centroid of their vertices, which requires vertices.
+ * The curve is two-dimensional if all centroids have the same z coordinate
+ * and three-dimensional otherwise.
+ * Reverse Cuthill-McKee orders the trees by breadth-first search on the
+ * graph of tree neighbors defined by \a ctype, which needs no geometry.
+ * Consecutive trees are close to each other in both cases, such that a
+ * partition into contiguous ranges of trees has short boundaries.
+ * The connectivity is permuted in place by \ref p4est_connectivity_permute;
+ * this should be done before a p4est is created from it.
+ * The result is deterministic and may be computed on every process.
+ * \param [in,out] conn     Valid connectivity that is reordered.
+ * \param [in] order        The order of the trees.
+ * \param [in] ctype        Neighbors used by \ref P4EST_CONN_ORDER_RCM.
+ *                          Ignored for the space-filling curves.
+ * \param [in,out] newid    If not NULL, an array of size_t that is resized
+ *                          and maps each old tree index to its new index.
+ */
+void                p4est_connectivity_sort_trees (p4est_connectivity_t * conn,
+                                                   p4est_connectivity_order_t
+                                                   order,
+                                                   p4est_connect_type_t ctype,
+                                                   sc_array_t * newid);
+
 #ifdef P4EST_WITH_METIS
 
 /** Reorder a connectivity using METIS.
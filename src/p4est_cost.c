@@ -0,0 +1,251 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+
+#ifndef P4_TO_P8
+#include <p4est_algorithms.h>
+#include <p4est_cost.h>
+#include <p4est_extended.h>
+#else
+#include <p8est_algorithms.h>
+#include <p8est_cost.h>
+#include <p8est_extended.h>
+#endif
+
+/** Number of levels in the model. */
+#define P4EST_COST_LEVELS (P4EST_QMAXLEVEL + 1)
+
+/** Integer weight given to the most expensive quadrant of the model. */
+#define P4EST_COST_RESOLUTION (1 << 16)
+
+static int
+p4est_cost_class (p4est_cost_t * cost, p4est_t * p4est,
+                  p4est_topidx_t which_tree, p4est_quadrant_t * quadrant)
+{
+  int                 c;
+
+  if (cost->class_fn == NULL) {
+    return 0;
+  }
+  c = cost->class_fn (p4est, which_tree, quadrant);
+  P4EST_ASSERT (0 <= c && c < cost->num_classes);
+  return c;
+}
+
+p4est_cost_t       *
+p4est_cost_new (int num_classes, p4est_cost_class_t class_fn)
+{
+  p4est_cost_t       *cost;
+  const size_t        size = (size_t) P4EST_COST_LEVELS * num_classes;
+
+  P4EST_ASSERT (num_classes >= 1);
+  P4EST_ASSERT (class_fn != NULL || num_classes == 1);
+
+  cost = P4EST_ALLOC_ZERO (p4est_cost_t, 1);
+  cost->num_classes = num_classes;
+  cost->class_fn = class_fn;
+  cost->sums = P4EST_ALLOC_ZERO (double, size);
+  cost->counts = P4EST_ALLOC_ZERO (double, size);
+  cost->model = P4EST_ALLOC_ZERO (double, size);
+  cost->imbalance = 1.;
+
+  return cost;
+}
+
+void
+p4est_cost_destroy (p4est_cost_t * cost)
+{
+  P4EST_FREE (cost->sums);
+  P4EST_FREE (cost->counts);
+  P4EST_FREE (cost->model);
+  P4EST_FREE (cost);
+}
+
+void
+p4est_cost_reset (p4est_cost_t * cost)
+{
+  const size_t        size = (size_t) P4EST_COST_LEVELS * cost->num_classes;
+
+  memset (cost->sums, 0, size * sizeof (double));
+  memset (cost->counts, 0, size * sizeof (double));
+}
+
+void
+p4est_cost_add (p4est_cost_t * cost, p4est_t * p4est,
+                p4est_topidx_t which_tree, p4est_quadrant_t * quadrant,
+                double seconds)
+{
+  size_t              iz;
+
+  P4EST_ASSERT (seconds >= 0.);
+  P4EST_ASSERT (0 <= quadrant->level && quadrant->level <= P4EST_QMAXLEVEL);
+
+  iz = (size_t) quadrant->level * cost->num_classes +
+    p4est_cost_class (cost, p4est, which_tree, quadrant);
+  cost->sums[iz] += seconds;
+  cost->counts[iz] += 1.;
+}
+
+void
+p4est_cost_fit (p4est_cost_t * cost, sc_MPI_Comm mpicomm)
+{
+  const int           C = cost->num_classes;
+  const size_t        size = (size_t) P4EST_COST_LEVELS * C;
+  int                 mpiret;
+  int                 l, c;
+  size_t              iz;
+  double             *local, *global, *gsums, *gcounts;
+  double              allsum, allcount, csum, ccount, mean;
+
+  /* sum the samples of all processes in one reduction */
+  local = P4EST_ALLOC (double, 4 * size);
+  global = local + 2 * size;
+  memcpy (local, cost->sums, size * sizeof (double));
+  memcpy (local + size, cost->counts, size * sizeof (double));
+  mpiret = sc_MPI_Allreduce (local, global, (int) (2 * size), sc_MPI_DOUBLE,
+                             sc_MPI_SUM, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  gsums = global;
+  gcounts = global + size;
+
+  /* the mean of all samples is the last fallback */
+  allsum = allcount = 0.;
+  for (iz = 0; iz < size; ++iz) {
+    allsum += gsums[iz];
+    allcount += gcounts[iz];
+  }
+  mean = allcount > 0. ? allsum / allcount : 1.;
+
+  for (c = 0; c < C; ++c) {
+    csum = ccount = 0.;
+    for (l = 0; l < P4EST_COST_LEVELS; ++l) {
+      csum += gsums[l * C + c];
+      ccount += gcounts[l * C + c];
+    }
+    for (l = 0; l < P4EST_COST_LEVELS; ++l) {
+      if (gcounts[l * C + c] > 0.) {
+        cost->model[l * C + c] = gsums[l * C + c] / gcounts[l * C + c];
+      }
+      else {
+        cost->model[l * C + c] = ccount > 0. ? csum / ccount : mean;
+      }
+    }
+  }
+  cost->fitted = 1;
+  P4EST_FREE (local);
+
+  P4EST_GLOBAL_INFOF ("Cost model fitted to %.0f samples mean %g\n",
+                      allcount, mean);
+}
+
+double
+p4est_cost_predict (p4est_cost_t * cost, p4est_t * p4est,
+                    p4est_topidx_t which_tree, p4est_quadrant_t * quadrant)
+{
+  P4EST_ASSERT (cost->fitted);
+
+  return cost->model[(size_t) quadrant->level * cost->num_classes +
+                     p4est_cost_class (cost, p4est, which_tree, quadrant)];
+}
+
+double
+p4est_cost_imbalance (p4est_cost_t * cost, p4est_t * p4est)
+{
+  int                 mpiret;
+  size_t              zz;
+  double              load, maxload, sumload;
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+
+  load = 0.;
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      load += p4est_cost_predict (cost, p4est, jt, q);
+    }
+  }
+  mpiret = sc_MPI_Allreduce (&load, &maxload, 1, sc_MPI_DOUBLE, sc_MPI_MAX,
+                             p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Allreduce (&load, &sumload, 1, sc_MPI_DOUBLE, sc_MPI_SUM,
+                             p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  return sumload > 0. ? maxload * p4est->mpisize / sumload : 1.;
+}
+
+p4est_gloidx_t
+p4est_partition_auto (p4est_t * p4est, p4est_cost_t * cost,
+                      double threshold, int partition_for_coarsening)
+{
+  const size_t        size = (size_t) P4EST_COST_LEVELS * cost->num_classes;
+  size_t              iz, zz;
+  double              maxmodel, scale, w;
+  int                *weights;
+  p4est_topidx_t      jt;
+  p4est_locidx_t      kl;
+  p4est_gloidx_t      global_shipped;
+  p4est_quadrant_t   *q;
+  p4est_tree_t       *tree;
+
+  p4est_cost_fit (cost, p4est->mpicomm);
+  cost->imbalance = p4est_cost_imbalance (cost, p4est);
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING
+                            "_partition_auto with predicted imbalance %g\n",
+                            cost->imbalance);
+  if (cost->imbalance <= threshold) {
+    P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING
+                             "_partition_auto no shipping\n");
+    return 0;
+  }
+
+  /* map the most expensive class to the weight resolution */
+  maxmodel = 0.;
+  for (iz = 0; iz < size; ++iz) {
+    maxmodel = SC_MAX (maxmodel, cost->model[iz]);
+  }
+  scale = maxmodel > 0. ? P4EST_COST_RESOLUTION / maxmodel : 0.;
+
+  /* the class callback sees the user's pointer while the weights are set */
+  weights = P4EST_ALLOC (int, p4est->local_num_quadrants + 1);
+  kl = 0;
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz, ++kl) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      w = p4est_cost_predict (cost, p4est, jt, q);
+      weights[kl] = w > 0. ? SC_MAX ((int) ceil (w * scale), 1) : 0;
+    }
+  }
+  P4EST_ASSERT (kl == p4est->local_num_quadrants);
+  global_shipped = p4est_partition_weights (p4est, partition_for_coarsening,
+                                            weights);
+  P4EST_FREE (weights);
+
+  P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING
+                            "_partition_auto shipped %lld quadrants\n",
+                            (long long) global_shipped);
+  return global_shipped;
+}
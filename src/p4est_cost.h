@@ -0,0 +1,153 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+
+#ifndef P4EST_COST_H
+#define P4EST_COST_H
+
+#include <p4est.h>
+
+SC_EXTERN_C_BEGIN;
+
+/** \file p4est_cost.h
+ * Fit a cost model to measured quadrant timings and partition by it.
+ *
+ * The application records measured times of individual quadrants by
+ * \ref p4est_cost_add, for example from the callbacks of p4est_iterate.
+ * The samples are classified by quadrant level and an optional user class.
+ * \ref p4est_cost_fit reduces them over all processes to the mean cost of
+ * each level and class.  \ref p4est_partition_auto predicts the load of
+ * every process from this model and repartitions only if the predicted
+ * imbalance exceeds a threshold.
+ */
+
+/** Callback function prototype to assign a quadrant to a cost class.
+ * \param [in] p4est       the forest
+ * \param [in] which_tree  the tree containing \a quadrant
+ * \param [in] quadrant    the quadrant to be classified
+ * \return an integer between 0 and the number of classes minus one.
+ */
+typedef int         (*p4est_cost_class_t) (p4est_t * p4est,
+                                           p4est_topidx_t which_tree,
+                                           p4est_quadrant_t * quadrant);
+
+/** Measured samples and the fitted cost model. */
+typedef struct p4est_cost
+{
+  int                 num_classes;      /**< Number of user classes. */
+  p4est_cost_class_t  class_fn;         /**< Class callback or NULL. */
+  double             *sums;             /**< Local sum of the samples by
+                                             level and class. */
+  double             *counts;           /**< Local number of samples by
+                                             level and class. */
+  double             *model;            /**< Mean cost by level and class,
+                                             valid after the first fit. */
+  int                 fitted;           /**< True after the first fit. */
+  double              imbalance;        /**< Predicted imbalance seen by
+                                             the last partition_auto. */
+}
+p4est_cost_t;
+
+/** Create an empty cost accumulator.
+ * \param [in] num_classes  Number of user classes, at least 1.
+ * \param [in] class_fn     Assigns quadrants to classes.  May be NULL
+ *                          if \a num_classes is 1.
+ * \return                  Cost object without samples.
+ */
+p4est_cost_t       *p4est_cost_new (int num_classes,
+                                    p4est_cost_class_t class_fn);
+
+/** Free the memory of a cost object.
+ * \param [in] cost         Created by \ref p4est_cost_new.
+ */
+void                p4est_cost_destroy (p4est_cost_t * cost);
+
+/** Remove all samples.  The fitted model is kept.
+ * \param [in,out] cost     The cost object.
+ */
+void                p4est_cost_reset (p4est_cost_t * cost);
+
+/** Record the measured cost of one local quadrant.
+ * \param [in,out] cost     The cost object.
+ * \param [in] p4est        The forest containing the quadrant.
+ * \param [in] which_tree   The tree containing \a quadrant.
+ * \param [in] quadrant     The quadrant measured.
+ * \param [in] seconds      The measured cost, >= 0.
+ */
+void                p4est_cost_add (p4est_cost_t * cost, p4est_t * p4est,
+                                    p4est_topidx_t which_tree,
+                                    p4est_quadrant_t * quadrant,
+                                    double seconds);
+
+/** Fit the model to the samples of all processes.  This is collective.
+ * The model of a level and class is the mean of its samples.  Without
+ * samples it is the mean of the class over all levels, then the mean
+ * of all samples, and 1 if there are no samples at all.
+ * \param [in,out] cost     The cost object.
+ * \param [in] mpicomm      The communicator of the forest.
+ */
+void                p4est_cost_fit (p4est_cost_t * cost,
+                                    sc_MPI_Comm mpicomm);
+
+/** Predict the cost of a quadrant by the fitted model.
+ * \param [in] cost         The cost object after \ref p4est_cost_fit.
+ * \param [in] p4est        The forest containing the quadrant.
+ * \param [in] which_tree   The tree containing \a quadrant.
+ * \param [in] quadrant     The quadrant to predict.
+ * \return                  The predicted cost.
+ */
+double              p4est_cost_predict (p4est_cost_t * cost,
+                                        p4est_t * p4est,
+                                        p4est_topidx_t which_tree,
+                                        p4est_quadrant_t * quadrant);
+
+/** Compute the predicted imbalance of the current partition.
+ * This is collective.
+ * \param [in] cost         The cost object after \ref p4est_cost_fit.
+ * \param [in] p4est        The forest.
+ * \return                  Maximum over average predicted process load,
+ *                          1 if the total predicted load is zero.
+ */
+double              p4est_cost_imbalance (p4est_cost_t * cost,
+                                          p4est_t * p4est);
+
+/** Fit the model and repartition if the predicted imbalance is too large.
+ * The model is converted to integer weights for \ref p4est_partition_ext.
+ * The samples are not removed; call \ref p4est_cost_reset to start over.
+ * \param [in,out] p4est    The forest to be partitioned.
+ * \param [in,out] cost     The cost object with samples of all processes.
+ *                          Its imbalance member is set to the predicted
+ *                          imbalance before partitioning.
+ * \param [in] threshold    Partition only if the predicted imbalance is
+ *                          larger, for example 1.1 for 10 percent.
+ * \param [in] partition_for_coarsening  As in \ref p4est_partition_ext.
+ * \return                  The global number of shipped quadrants.
+ */
+p4est_gloidx_t      p4est_partition_auto (p4est_t * p4est,
+                                          p4est_cost_t * cost,
+                                          double threshold,
+                                          int partition_for_coarsening);
+
+SC_EXTERN_C_END;
+
+#endif /* !P4EST_COST_H */
@@ -85,6 +85,46 @@ struct p4est_inspect
   /** time spent in sc_notify_allgather */
   double              balance_notify_allgather;
   int                 use_B;
+  /** If true, p4est_refine_ext writes the quadrants and their children
+   * into a new tree array, using a depth-first stack instead of a
+   * quadrant list.  The callbacks are called in the same order. */
+  int                 use_refine_stack;
+  /** If greater than one, p4est_refine_ext runs this many threads,
+   * which implies \a use_refine_stack.  This requires libsc to be
+   * configured with pthread support; otherwise one thread is used.
+   * See p4est_refine_ext for the callback rules. */
+  int                 refine_num_threads;
+  /** If greater than one, p4est_balance_ext balances the local trees
+   * before and after communication on this many threads.  The result is
+   * the same as with one thread.  Work is distributed by whole trees, so
+   * a process with a single local tree is not sped up; splitting a tree
+   * into chunks that are balanced apart and merged is not implemented.
+   * This requires libsc to be configured with pthread support; otherwise
+   * one thread is used. */
+  int                 balance_num_threads;
+  /** If true, the balance kernel keeps the new quadrants of each level
+   * by value in an open addressing table instead of a chained hash table
+   * of individually allocated quadrants.
+   * The result is the same. */
+  int                 use_balance_flat;
+  double              balance_A_local;  /**< time in local tree balance */
+  double              balance_B_local;  /**< time in border balance */
+  double              adapt_refine;     /**< p4est_adapt refine time */
+  double              adapt_coarsen;    /**< p4est_adapt coarsen time */
+  double              adapt_balance;    /**< p4est_adapt balance time */
+  double              adapt_partition;  /**< p4est_adapt partition time */
+  /** Bytes sent by the most recent p4est_partition_given to other processes
+   * on the same compute node and on other nodes, respectively.  They are
+   * only counted when node communicators were attached to the forest's
+   * communicator by the caller, see p4est_comm_parallel_env_assign. */
+  size_t              partition_bytes_intranode;
+  size_t              partition_bytes_internode;
+  /** Messages and bytes sent and received by this process in the most
+   * recent batched ghost exchange, see p4est_ghost_exchange_fields. */
+  size_t              ghost_fields_sends;
+  size_t              ghost_fields_bytes_sent;
+  size_t              ghost_fields_receives;
+  size_t              ghost_fields_bytes_received;
 };
 
 /** Callback function prototype to replace one set of quadrants with another.
@@ -113,6 +153,21 @@ typedef void        (*p4est_replace_t) (p4est_t * p4est,
                                         int num_incoming,
                                         p4est_quadrant_t * incoming[]);
 
+/** Callback function prototype to calculate several weights per quadrant.
+ * Used for multi-constraint partitioning by \ref p4est_partition_multi.
+ * \param [in] p4est       the forest
+ * \param [in] which_tree  the tree containing \a quadrant
+ * \param [in] quadrant    the quadrant to be weighted
+ * \param [out] weights    Array of the length passed to the partition
+ *                         function, zeroed before the call; each weight
+ *                         must be assigned an integer >= 0.
+ * \note    Global sum of each weight must fit into a 64bit integer.
+ */
+typedef void        (*p4est_multi_weight_t) (p4est_t * p4est,
+                                            p4est_topidx_t which_tree,
+                                            p4est_quadrant_t * quadrant,
+                                            int *weights);
+
 /** Compare the p4est_lid_t \a a and the p4est_lid_t \a b.
  * \param [in]  a A pointer to a p4est_lid_t.
  * \param [in]  b A pointer to a p4est_lid_t.
@@ -354,9 +409,15 @@ void                p4est_quadrant_set_morton_ext128 (p4est_quadrant_t *
  * Regardless, \ref p4est_refine can go as deep as \ref P4EST_QMAXLEVEL.
  *
  * \param [in] mpicomm          A valid MPI communicator.
- * \param [in] connectivity     This is the connectivity information that
+ * \param [in,out] connectivity
+ *                              This is the connectivity information that
  *                              the forest is built with.  Note the forest
  *                              does not take ownership of the memory.
+ *                              If \ref p4est_shared_set_enabled allowed
+ *                              node-shared memory on \a mpicomm, its arrays
+ *                              are moved into a shared window in place by
+ *                              \ref p4est_connectivity_share, and it must
+ *                              not be modified afterwards.
  * \param [in] min_quadrants    Minimum initial quadrants per processor.
  *                              Makes the refinement pattern mpisize-specific.
  *                              For maximum reproducibility, set this to 0.
@@ -438,6 +499,17 @@ p4est_t            *p4est_copy_ext (p4est_t * input, int copy_data,
  * \param [in] replace_fn Callback function that allows the user to change
  *                        incoming quadrants based on the quadrants they
  *                        replace; may be NULL.
+ *
+ * If \a p4est->inspect is present and its use_refine_stack member is
+ * true, the callbacks are called in the same order as without the switch.
+ * If the refine_num_threads member is greater than one, the local
+ * quadrants are split into contiguous ranges that are refined this way on
+ * that many threads.  The resulting forest is always
+ * the same as with the default algorithm.  With threads the callbacks for
+ * different ranges run concurrently.  They must not modify any state shared
+ * between quadrants without synchronizing it themselves, and they must not
+ * call any p4est function that changes the forest.  Accessing the
+ * user_data of the quadrants passed to them is safe.
  */
 void                p4est_refine_ext (p4est_t * p4est,
                                       int refine_recursive, int maxlevel,
@@ -472,6 +544,65 @@ void                p4est_coarsen_ext (p4est_t * p4est, int coarsen_recursive,
                                        p4est_init_t init_fn,
                                        p4est_replace_t replace_fn);
 
+/** Refine a forest non-recursively by one marker per local quadrant.
+ * This is done in one linear pass without calling back into the user code,
+ * except for initializing the data of new quadrants.  Quadrants at the
+ * compile-time constant QMAXLEVEL in p4est.h are not refined.
+ * \param [in,out] p4est  The forest is changed in place.
+ * \param [in,out] flags  One marker for each local quadrant in order.
+ *                        A quadrant is refined if its marker is positive.
+ *                        On output, the marker is 1 for each quadrant that
+ *                        has been refined and 0 for all others.
+ * \param [in] init_fn    Callback function to initialize the user_data of
+ *                        newly created quadrants; may be NULL.
+ * \param [out] old_to_new If not NULL, an array of the input number of local
+ *                        quadrants.  On output, entry i is the new local
+ *                        index of quadrant i, or of its first child if it
+ *                        has been refined.
+ */
+void                p4est_refine_flags (p4est_t * p4est, int8_t * flags,
+                                        p4est_init_t init_fn,
+                                        p4est_locidx_t * old_to_new);
+
+/** Coarsen a forest non-recursively by one marker per local quadrant.
+ * A family is replaced by its parent if it is consecutive in the local
+ * quadrants of one tree and the markers of all its members are negative.
+ * \param [in,out] p4est  The forest is changed in place.
+ * \param [in,out] flags  One marker for each local quadrant in order.
+ *                        On output, the marker is -1 for each quadrant that
+ *                        has been coarsened and 0 for all others.
+ * \param [in] init_fn    Callback function to initialize the user_data of
+ *                        newly created quadrants; may be NULL.
+ * \param [out] old_to_new If not NULL, an array of the input number of local
+ *                        quadrants.  On output, entry i is the new local
+ *                        index of quadrant i, or of its parent if it has
+ *                        been coarsened.
+ */
+void                p4est_coarsen_flags (p4est_t * p4est, int8_t * flags,
+                                         p4est_init_t init_fn,
+                                         p4est_locidx_t * old_to_new);
+
+/** Refine and coarsen a forest by one marker per local quadrant.
+ * Positive markers request refinement as in \ref p4est_refine_flags and
+ * negative markers request coarsening as in \ref p4est_coarsen_flags.
+ * Both are done together in one linear pass.  The forest is not balanced.
+ * \param [in,out] p4est  The forest is changed in place.
+ * \param [in,out] flags  One marker for each local quadrant in order.
+ *                        On output, the marker is 1 for each quadrant that
+ *                        has been refined, -1 for each quadrant that has
+ *                        been coarsened and 0 for all others.
+ * \param [in] init_fn    Callback function to initialize the user_data of
+ *                        newly created quadrants; may be NULL.
+ * \param [out] old_to_new If not NULL, an array of the input number of local
+ *                        quadrants.  On output, entry i is the new local
+ *                        index of quadrant i, of its first child if it has
+ *                        been refined, or of its parent if it has been
+ *                        coarsened.
+ */
+void                p4est_adapt_flags (p4est_t * p4est, int8_t * flags,
+                                       p4est_init_t init_fn,
+                                       p4est_locidx_t * old_to_new);
+
 /** 2:1 balance the size differences of neighboring elements in a forest.
  * \param [in,out] p4est  The p4est to be worked on.
  * \param [in] btype      Balance type (face or corner/full).
@@ -482,12 +613,84 @@ void                p4est_coarsen_ext (p4est_t * p4est, int coarsen_recursive,
  * \param [in] replace_fn Callback function that allows the user to change
  *                        incoming quadrants based on the quadrants they
  *                        replace.
+ *
+ * If \a p4est->inspect is present and its balance_num_threads member is
+ * greater than one, the local trees are balanced on that many threads, see
+ * \ref p4est_balance_trees.  The resulting forest is the same.  Each tree
+ * is balanced by one thread, thus there is no speedup for a forest with
+ * one local tree.  The callbacks for different trees run concurrently
+ * then and must follow the rules given for threads in \ref p4est_refine_ext.
  */
 void                p4est_balance_ext (p4est_t * p4est,
                                        p4est_connect_type_t btype,
                                        p4est_init_t init_fn,
                                        p4est_replace_t replace_fn);
 
+/** 2:1 balance a forest that has been changed since it was balanced.
+ *
+ * The forest must have been balanced with \a btype or a stronger type,
+ * then changed by refinement and/or coarsening.  The changed quadrants are
+ * marked in \a changed.  The result is the same as that of
+ * \ref p4est_balance_ext, but the local balance runs only on trees with
+ * changes, and unchanged quadrants are sent only to processes that have
+ * changes.  If no process has changes, the function returns immediately.
+ *
+ * \param [in,out] p4est  The forest to be balanced.
+ * \param [in] btype      Balance type as in \ref p4est_balance_ext.
+ * \param [in] changed    Array of length p4est->local_num_quadrants that
+ *                        is nonzero for every quadrant that has been created
+ *                        since the forest was balanced: refined children and
+ *                        coarsened families.  Others must be unchanged.
+ *                        It is not modified and not valid afterwards.
+ *                        If NULL, all quadrants are considered changed.
+ * \param [in] init_fn    Callback function to initialize the user_data.
+ * \param [in] replace_fn Callback function as in \ref p4est_balance_ext.
+ */
+void                p4est_balance_changed (p4est_t * p4est,
+                                           p4est_connect_type_t btype,
+                                           const int8_t * changed,
+                                           p4est_init_t init_fn,
+                                           p4est_replace_t replace_fn);
+
+/** Refine, coarsen, balance and partition a forest in one call.
+ *
+ * This does the same as calling \ref p4est_refine_ext,
+ * \ref p4est_coarsen_ext, \ref p4est_balance_ext and
+ * \ref p4est_partition_ext in this order.  Refinement and coarsening do
+ * not count the global quadrants but mark the quadrants they create, and
+ * balance only processes those changes as in \ref p4est_balance_changed,
+ * without gathering which processes have changed.  These three global
+ * operations are all that is saved: balance still counts the quadrants
+ * and the partition gathers its weights or counts separately.
+ * The marks use the pad8 field, which is zero on output.
+ * The forest must be balanced with \a btype or a stronger type on input.
+ * If \a p4est->inspect is present, the stage timings are stored there.
+ * A ghost layer must be created anew afterwards.
+ *
+ * \param [in,out] p4est  The forest is changed in place.
+ * \param [in] refine_recursive  Boolean as in \ref p4est_refine_ext.
+ * \param [in] allowed_level     Maximum level as in \ref p4est_refine_ext.
+ * \param [in] refine_fn         Refinement callback, NULL to skip.
+ * \param [in] coarsen_recursive Boolean as in \ref p4est_coarsen_ext.
+ * \param [in] coarsen_fn        Coarsening callback, NULL to skip.
+ *                               It is not called on orphans.
+ * \param [in] btype      Balance type as in \ref p4est_balance_ext.
+ * \param [in] partition_for_coarsening  As in \ref p4est_partition_ext.
+ * \param [in] weight_fn  Weight callback for partition or NULL.
+ * \param [in] init_fn    Callback function to initialize the user_data.
+ * \param [in] replace_fn Replace callback for all stages or NULL.
+ * \return                The global number of shipped quadrants.
+ */
+p4est_gloidx_t      p4est_adapt (p4est_t * p4est, int refine_recursive,
+                                 int allowed_level, p4est_refine_t refine_fn,
+                                 int coarsen_recursive,
+                                 p4est_coarsen_t coarsen_fn,
+                                 p4est_connect_type_t btype,
+                                 int partition_for_coarsening,
+                                 p4est_weight_t weight_fn,
+                                 p4est_init_t init_fn,
+                                 p4est_replace_t replace_fn);
+
 void                p4est_balance_subtree_ext (p4est_t * p4est,
                                                p4est_connect_type_t btype,
                                                p4est_topidx_t which_tree,
@@ -514,6 +717,158 @@ p4est_gloidx_t      p4est_partition_ext (p4est_t * p4est,
                                          int partition_for_coarsening,
                                          p4est_weight_t weight_fn);
 
+/** Repartition the forest balancing several weights at once.
+ *
+ * Each quadrant carries \a num_weights weights.  The cuts along the space
+ * filling curve are placed such that, for each cut, the largest deviation
+ * of any weight's prefix sum from its ideal value is minimal.  Weights
+ * whose global sum is zero are ignored.  If all are zero, nothing happens.
+ * With a single weight the result may differ slightly from
+ * \ref p4est_partition_ext, which always rounds the cut upward.
+ *
+ * \param [in,out] p4est      The forest that will be partitioned.
+ * \param [in]     partition_for_coarsening     If true, the partition
+ *                            is modified to allow one level of coarsening.
+ * \param [in]     num_weights  Number of weights per quadrant, >= 1.
+ * \param [in]     weights_fn   Callback computing the weights; not NULL.
+ * \param [out]    imbalance    If not NULL, array of \a num_weights that
+ *                            receives the ratio of the maximum to the average
+ *                            process weight for each constraint.  The ratio
+ *                            is that of the new partition, including any
+ *                            correction for coarsening, and is 1 for
+ *                            weights with zero sum.
+ * \return         The global number of shipped quadrants
+ */
+p4est_gloidx_t      p4est_partition_multi (p4est_t * p4est,
+                                          int partition_for_coarsening,
+                                          int num_weights,
+                                          p4est_multi_weight_t weights_fn,
+                                          double *imbalance);
+
+/** Plan a partition that moves the current cuts as little as possible.
+ *
+ * The ideal cuts split the total weight into equal parts.  Each current
+ * cut whose prefix weight is within \a tolerance times the average process
+ * weight of its ideal value is kept.  Any other cut is moved to the
+ * nearest end of this window.  Thus the tolerance trades the imbalance of
+ * at most 2 * \a tolerance against the volume of data to be moved.
+ * The forest is not changed.  The plan may be corrected with
+ * \ref p4est_partition_for_coarsening and executed by
+ * p4est_partition_given.
+ *
+ * \param [in] p4est          The forest, not modified.
+ * \param [in] weight_fn      A weighting function or NULL for unit weights.
+ * \param [in] tolerance      Nonnegative; 0 yields the ideal cuts.
+ * \param [out] num_quadrants_in_proc  Array of mpisize entries that
+ *                            receives the planned quadrant counts.
+ * \param [out] bytes_shipped If not NULL, the number of bytes of quadrants
+ *                            and their user data that would be shipped.
+ * \return                    The global number of quadrants that would be
+ *                            shipped by executing the plan.
+ */
+p4est_gloidx_t      p4est_partition_plan (p4est_t * p4est,
+                                         p4est_weight_t weight_fn,
+                                         double tolerance,
+                                         p4est_locidx_t *
+                                         num_quadrants_in_proc,
+                                         uint64_t * bytes_shipped);
+
+/** Partition the forest hierarchically by compute nodes.
+ *
+ * The curve is first split among the nodes of the communicator as
+ * determined by \ref p4est_comm_node_first.  Each cut between two nodes is
+ * kept if its prefix weight is within \a tolerance times the average node
+ * weight of its ideal value, and otherwise moved to the nearest end of
+ * this window as in \ref p4est_partition_plan.  Then the segment of each
+ * node is split evenly among its processes.  Thus the tolerance limits
+ * the data moved between nodes, while the processes of a node are kept
+ * in balance.  With a zero tolerance, the result is that of
+ * \ref p4est_partition_ext.  This is also called if there are no node
+ * communicators or there is just one node.
+ * The bytes sent within and between nodes are counted in the inspect
+ * structure, see \ref p4est_inspect.
+ * Only the partition is aware of the nodes: ghost layer construction and
+ * balance still communicate with each process directly.
+ *
+ * \param [in,out] p4est      The forest that will be partitioned.
+ * \param [in]     partition_for_coarsening     If true, the partition
+ *                            is modified to allow one level of coarsening.
+ * \param [in]     weight_fn  A weighting function or NULL
+ *                            for uniform partitioning.
+ * \param [in]     tolerance  Nonnegative fraction of the node weight.
+ * \return         The global number of shipped quadrants
+ */
+p4est_gloidx_t      p4est_partition_node (p4est_t * p4est,
+                                         int partition_for_coarsening,
+                                         p4est_weight_t weight_fn,
+                                         double tolerance);
+
+/** State of a partition whose communication is in progress.
+ * Created by \ref p4est_partition_begin and freed by \ref p4est_partition_end.
+ */
+typedef struct p4est_partition_context
+{
+  p4est_t            *p4est;    /**< The forest being partitioned. */
+  p4est_gloidx_t     *src_gfq;  /**< Partition before, mpisize + 1 entries. */
+  p4est_gloidx_t     *dest_gfq; /**< Partition after, mpisize + 1 entries. */
+  p4est_gloidx_t      global_shipped;   /**< Quadrants to be shipped. */
+
+  /* internal data */
+  struct p4est_partition_given *given;
+  sc_array_t         *transfers;
+}
+p4est_partition_context_t;
+
+/** Begin a partition with the same parameters as \ref p4est_partition_ext.
+ *
+ * The new partition is computed and all messages carrying the quadrants
+ * are posted.  The forest is not changed until \ref p4est_partition_end.
+ * In between, more messages may be posted, for example by
+ * \ref p4est_partition_transfer_fixed, and local work may be done that
+ * does not modify the forest or its user data.
+ * The call is collective over the forest's communicator.
+ *
+ * \param [in] p4est      The forest to be partitioned.
+ * \param [in] partition_for_coarsening     If true, the partition
+ *                        is modified to allow one level of coarsening.
+ * \param [in] weight_fn  A weighting function or NULL
+ *                        for uniform partitioning.
+ * \return                The context to be passed to \ref p4est_partition_end.
+ *                        Its public members may be read in between.
+ */
+p4est_partition_context_t *p4est_partition_begin (p4est_t * p4est,
+                                                  int partition_for_coarsening,
+                                                  p4est_weight_t weight_fn);
+
+/** Transfer fixed-size data per quadrant along with a partition in progress.
+ * The transfer is posted immediately by \ref p4est_transfer_fixed_begin
+ * from \a src_data in the old to \a dest_data in the new partition, and
+ * completed by \ref p4est_partition_end.
+ * The call is collective over the forest's communicator.
+ * \param [in] pc         Context from \ref p4est_partition_begin.
+ * \param [in] tag        MPI tag, must differ from P4EST_COMM_PARTITION_GIVEN
+ *                        and from the tags of other transfers in flight.
+ * \param [out] dest_data Memory of data_size times dest_gfq[rank + 1] -
+ *                        dest_gfq[rank] bytes.  Valid after completion.
+ * \param [in] src_data   Memory of data_size times the current number
+ *                        of local quadrants.  Must stay alive and unchanged
+ *                        until completion.
+ * \param [in] data_size  Fixed data size per quadrant.
+ */
+void                p4est_partition_transfer_fixed (p4est_partition_context_t *
+                                                   pc, int tag,
+                                                   void *dest_data,
+                                                   const void *src_data,
+                                                   size_t data_size);
+
+/** Complete a partition started by \ref p4est_partition_begin.
+ * The forest is rebuilt in the new partition and all transfers
+ * added by \ref p4est_partition_transfer_fixed are completed.
+ * \param [in] pc         Context from \ref p4est_partition_begin, freed here.
+ * \return                The global number of shipped quadrants.
+ */
+p4est_gloidx_t      p4est_partition_end (p4est_partition_context_t * pc);
+
 /** Correct partition to allow one level of coarsening.
  *
  * \param [in] p4est                     forest whose partition is corrected
@@ -572,6 +927,7 @@ void                p4est_save_ext (const char *filename, p4est_t * p4est,
  * \param [in] user_pointer     Assign to the user_pointer member of the p4est
  *                              before init_fn is called the first time.
  * \param [out] connectivity    Connectivity must be destroyed separately.
+ *                              It is node-shared as in \ref p4est_new_ext.
  * \return          Returns a valid forest structure. A pointer to a valid
  *                  connectivity structure is returned through the last
  *                  argument.
@@ -222,6 +222,61 @@ p4est_geometry_new_connectivity (p4est_connectivity_t *conn)
   return geom;
 }
 
+/** A geometry on a local connectivity addressed by global tree numbers. */
+typedef struct p4est_geometry_local
+{
+  /** The geom member needs to come first; we cast to p4est_geometry_t * */
+  p4est_geometry_t    geom;
+  sc_array_t          tree_global;      /**< sorted global tree numbers */
+}
+p4est_geometry_local_t;
+
+static void
+p4est_geometry_local_X (p4est_geometry_t *geom, p4est_topidx_t which_tree,
+                        const double abc[3], double xyz[3])
+{
+  p4est_geometry_local_t *local = (p4est_geometry_local_t *) geom;
+  ssize_t             lt;
+
+  lt = sc_array_bsearch (&local->tree_global, &which_tree,
+                         p4est_topidx_compare);
+  SC_CHECK_ABORTF (lt >= 0, "Tree %lld not in local connectivity",
+                   (long long) which_tree);
+  p4est_geometry_connectivity_X (geom, (p4est_topidx_t) lt, abc, xyz);
+}
+
+static void
+p4est_geometry_local_destroy (p4est_geometry_t *geom)
+{
+  p4est_geometry_local_t *local = (p4est_geometry_local_t *) geom;
+
+  sc_array_reset (&local->tree_global);
+  P4EST_FREE (local);
+}
+
+p4est_geometry_t   *
+p4est_geometry_new_local (p4est_connectivity_t *local,
+                          sc_array_t *tree_global)
+{
+  p4est_geometry_local_t *lgeom;
+
+  P4EST_ASSERT (local->vertices != NULL);
+  P4EST_ASSERT (tree_global->elem_size == sizeof (p4est_topidx_t));
+  P4EST_ASSERT (tree_global->elem_count == (size_t) local->num_trees);
+
+  lgeom = P4EST_ALLOC_ZERO (p4est_geometry_local_t, 1);
+  sc_array_init_size (&lgeom->tree_global, sizeof (p4est_topidx_t),
+                      tree_global->elem_count);
+  sc_array_copy (&lgeom->tree_global, tree_global);
+
+  lgeom->geom.name = P4EST_STRING "_local";
+  lgeom->geom.user = local;
+  lgeom->geom.X = p4est_geometry_local_X;
+  lgeom->geom.destroy = p4est_geometry_local_destroy;
+
+  return (p4est_geometry_t *) lgeom;
+}
+
 #ifndef P4_TO_P8
 
 /**
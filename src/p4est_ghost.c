@@ -77,6 +77,30 @@ p4est_ghost_array_index (sc_array_t * array, int i)
 
 #endif
 
+/** Compute a checksum of the partition boundaries of a forest.
+ * It is unchanged by refinement, coarsening and balance, but not by
+ * a partition that moves any boundary.
+ */
+static unsigned
+p4est_ghost_partition_checksum (p4est_t * p4est)
+{
+  int                 p;
+  unsigned            crc;
+  const p4est_quadrant_t *pos;
+
+  crc = (unsigned) p4est->mpisize;
+  for (p = 0; p <= p4est->mpisize; ++p) {
+    pos = &p4est->global_first_position[p];
+    crc = crc * 1000003U ^ (unsigned) pos->p.which_tree;
+    crc = crc * 1000003U ^ (unsigned) pos->x;
+    crc = crc * 1000003U ^ (unsigned) pos->y;
+#ifdef P4_TO_P8
+    crc = crc * 1000003U ^ (unsigned) pos->z;
+#endif
+  }
+  return crc;
+}
+
 p4est_ghost_t      *
 p4est_ghost_new_local (p4est_t * p4est, p4est_connect_type_t ctype)
 {
@@ -96,6 +120,7 @@ p4est_ghost_new_local (p4est_t * p4est, p4est_connect_type_t ctype)
   Ppo = (ghost->mpisize = p4est->mpisize) + 1;
   ntpo = (ghost->num_trees = p4est->connectivity->num_trees) + 1;
   ghost->btype = ctype;
+  ghost->partition_checksum = p4est_ghost_partition_checksum (p4est);
 
   /* the ghost and mirror quadrants themselves */
   sc_array_init (&ghost->ghosts, sizeof (p4est_quadrant_t));
@@ -1207,12 +1232,12 @@ p4est_ghost_mirror_t;
 
 /** Initialize temporary mirror storage */
 static void
-p4est_ghost_mirror_init (p4est_ghost_t * ghost, int mpirank,
+p4est_ghost_mirror_init (int mpisize, int mpirank, sc_array_t * mirrors,
                          sc_array_t * send_bufs, p4est_ghost_mirror_t * m)
 {
   int                 p;
 
-  m->mpisize = ghost->mpisize;
+  m->mpisize = mpisize;
   m->mpirank = mpirank;
   /* m->known is left undefined: it needs to be set to 0 for every quadrant */
   m->sum_all_procs = 0;
@@ -1221,12 +1246,12 @@ p4est_ghost_mirror_init (p4est_ghost_t * ghost, int mpirank,
   P4EST_ASSERT (m->send_bufs->elem_size == sizeof (sc_array_t));
   P4EST_ASSERT (m->send_bufs->elem_count == (size_t) m->mpisize);
 
-  m->mirrors = &ghost->mirrors;
+  m->mirrors = mirrors;
   P4EST_ASSERT (m->mirrors->elem_size == sizeof (p4est_quadrant_t));
   P4EST_ASSERT (m->mirrors->elem_count == 0);
 
-  m->offsets_by_proc = P4EST_ALLOC (sc_array_t, ghost->mpisize);
-  for (p = 0; p < ghost->mpisize; ++p) {
+  m->offsets_by_proc = P4EST_ALLOC (sc_array_t, mpisize);
+  for (p = 0; p < mpisize; ++p) {
     sc_array_init (m->offsets_by_proc + p, sizeof (p4est_locidx_t));
   }
 }
@@ -1420,6 +1445,472 @@ p4est_ghost_test_add (p4est_t * p4est, p4est_ghost_mirror_t * m,
   }
 }
 
+/** Record a local quadrant as mirror for all processes it is a ghost to.
+ * The quadrant must not have a 3x3 neighborhood owned by this process.
+ * \param [in,out] m     Temporary mirror storage to add to.
+ * \param [in] btype     Which neighbors to take into account.
+ * \param [in] tol       Balance tolerance, see p4est_ghost_new_check.
+ * \param [in] nt        The tree of \a q.
+ * \param [in] local_num The process-local number of \a q.
+ * \param [in] q         The local quadrant to look at.
+ * \param [in,out] procs Work arrays of int, P4EST_DIM - 1 of them.
+ * \return               True if an owner inconsistency has been found.
+ */
+static int
+p4est_ghost_mirror_quadrant (p4est_t * p4est, p4est_ghost_mirror_t * m,
+                             p4est_connect_type_t btype,
+                             p4est_ghost_tolerance_t tol, p4est_topidx_t nt,
+                             p4est_locidx_t local_num, p4est_quadrant_t * q,
+                             sc_array_t * procs)
+{
+  const int           rank = p4est->mpirank;
+  p4est_connectivity_t *conn = p4est->connectivity;
+  int                 face, corner;
+  int                 nface, ncheck, ncount;
+  int                 i;
+  int                 n0_proc, n0ur_proc, n1_proc;
+  int                 maxed;
+  int                 urg[P4EST_DIM - 1];
+  size_t              pz;
+  p4est_quadrant_t    n[P4EST_HALF], nur[P4EST_HALF];
+#ifdef P4_TO_P8
+  int                 edge, nedge;
+  p8est_edge_info_t   ei;
+  p8est_edge_transform_t *et;
+  sc_array_t         *eta;
+  size_t              etree;
+  int                 o, ref, set;
+  int                 c0, c1;
+  int                 nc0, nc1;
+  int                 oppedge;
+  int                 n1ur_proc;
+#endif
+  int                 ftransform[P4EST_FTRANSFORM];
+  int32_t             touch;
+  p4est_topidx_t      nnt;
+  p4est_corner_info_t ci;
+  p4est_corner_transform_t *ct;
+  sc_array_t         *cta;
+  size_t              ctree;
+
+#ifdef P4_TO_P8
+  eta = &ei.edge_transforms;
+#endif
+  cta = &ci.corner_transforms;
+
+  for (i = 0; i < P4EST_HALF; ++i) {
+    P4EST_QUADRANT_INIT (&n[i]);
+    P4EST_QUADRANT_INIT (&nur[i]);
+  }
+  m->known = 0;
+
+  /* Find smaller face neighbors */
+  for (face = 0; face < 2 * P4EST_DIM; ++face) {
+    if (tol < P4EST_GHOST_UNBALANCED_ALLOW) {
+      if (q->level == P4EST_QMAXLEVEL) {
+        p4est_quadrant_face_neighbor (q, face, &n[0]);
+        ncheck = 0;
+        ncount = 1;
+      }
+      else {
+        p4est_quadrant_half_face_neighbors (q, face, n, nur);
+        ncheck = ncount = P4EST_HALF;
+      }
+
+      n1_proc = -1;
+      for (i = 0; i < ncount; ++i) {
+        n0_proc = p4est_quadrant_find_owner (p4est, nt, face, &n[i]);
+        if (i < ncheck) {
+          /* Note that we will always check this
+           * because it prevents deadlocks
+           */
+          n0ur_proc = p4est_quadrant_find_owner (p4est, nt, face,
+                                                 &nur[i]);
+          if (n0_proc != n0ur_proc) {
+            P4EST_NOTICE ("Small face owner inconsistency\n");
+            return 1;
+          }
+        }
+
+        if (n0_proc != rank && n0_proc >= 0 && n0_proc != n1_proc) {
+#if 0
+          buf = p4est_ghost_array_index (&send_bufs, n0_proc);
+          p4est_add_ghost_to_buf (buf, nt, local_num, q);
+#endif
+          p4est_ghost_mirror_add (m, nt, local_num, q, n0_proc);
+          n1_proc = n0_proc;
+        }
+      }
+    }
+    else {
+      p4est_quadrant_face_neighbor (q, face, &n[0]);
+      if (p4est_quadrant_is_inside_root (&n[0])) {
+        nface = face ^ 1;
+        touch = ((int32_t) 1 << nface);
+        p4est_ghost_test_add (p4est, m, q, nt, &n[0], nt, touch, rank,
+                              local_num);
+      }
+      else {
+        nnt = p4est_find_face_transform (conn, nt, face, ftransform);
+        if (nnt < 0) {
+          continue;
+        }
+        nface = (int) conn->tree_to_face[nt * P4EST_FACES + face];
+        nface %= P4EST_FACES;
+        touch = ((int32_t) 1 << nface);
+        p4est_quadrant_transform_face (&n[0], &n[1], ftransform);
+        p4est_ghost_test_add (p4est, m, q, nt, &n[1], nnt, touch, rank,
+                              local_num);
+      }
+    }
+  }
+
+  if (btype == P4EST_CONNECT_FACE) {
+    return 0;
+  }
+
+#ifdef P4_TO_P8
+
+  /* Find smaller edge neighbors */
+  for (edge = 0; edge < 12; ++edge) {
+    if (tol < P4EST_GHOST_UNBALANCED_ALLOW) {
+      if (q->level == P4EST_QMAXLEVEL) {
+        p8est_quadrant_edge_neighbor (q, edge, &n[0]);
+        maxed = 1;
+      }
+      else {
+        p8est_quadrant_get_half_edge_neighbors (q, edge, n, nur);
+        maxed = 0;
+      }
+
+      /* Check to see if we are a tree edge neighbor */
+      P4EST_ASSERT (!p4est_quadrant_is_outside_corner (&n[0]));
+      if (p8est_quadrant_is_outside_edge (&n[0])) {
+        p8est_quadrant_find_tree_edge_owners (p4est, nt, edge,
+                                              &n[0], &procs[0], &urg[0]);
+        if (!maxed) {
+          p8est_quadrant_find_tree_edge_owners (p4est, nt, edge,
+                                                &n[1], &procs[1],
+                                                &urg[1]);
+          P4EST_ASSERT (procs[0].elem_count == procs[1].elem_count);
+
+          if (!urg[0] || !urg[1]) {
+            P4EST_NOTICE ("Tree edge owner inconsistency\n");
+            return 1;
+          }
+        }
+
+        /* Then we have to loop over multiple neighbors */
+        for (pz = 0; pz < procs[0].elem_count; ++pz) {
+          n0_proc = *((int *) sc_array_index (&procs[0], pz));
+
+          if (n0_proc != rank) {
+#if 0
+            buf = p4est_ghost_array_index (&send_bufs, n0_proc);
+            p4est_add_ghost_to_buf (buf, nt, local_num, q);
+#endif
+            p4est_ghost_mirror_add (m, nt, local_num, q, n0_proc);
+          }
+
+          if (!maxed) {
+            n1_proc = *((int *) sc_array_index (&procs[1], pz));
+
+            if (n1_proc != n0_proc && n1_proc != rank) {
+#if 0
+              buf = p4est_ghost_array_index (&send_bufs, n1_proc);
+              p4est_add_ghost_to_buf (buf, nt, local_num, q);
+#endif
+              p4est_ghost_mirror_add (m, nt, local_num, q, n1_proc);
+            }
+          }
+        }
+      }
+      else {
+        /* We are not at a tree edge so we only have two neighbors
+         * either inside the tree or across a face
+         */
+        n0_proc = n1_proc =
+          p4est_quadrant_find_owner (p4est, nt, -1, &n[0]);
+        if (!maxed) {
+          n1_proc = p4est_quadrant_find_owner (p4est, nt, -1, &n[1]);
+          n0ur_proc = p4est_quadrant_find_owner (p4est, nt, -1, &nur[0]);
+          n1ur_proc = p4est_quadrant_find_owner (p4est, nt, -1, &nur[1]);
+
+          /* Note that we will always check this
+           * because it prevents deadlocks
+           */
+          if (n0_proc != n0ur_proc || n1_proc != n1ur_proc) {
+            P4EST_NOTICE ("Small edge owner inconsistency\n");
+            return 1;
+          }
+        }
+
+        if (n0_proc != rank && n0_proc >= 0) {
+#if 0
+          buf = p4est_ghost_array_index (&send_bufs, n0_proc);
+          p4est_add_ghost_to_buf (buf, nt, local_num, q);
+#endif
+          p4est_ghost_mirror_add (m, nt, local_num, q, n0_proc);
+        }
+
+        if (n1_proc != n0_proc && n1_proc != rank && n1_proc >= 0) {
+#if 0
+          buf = p4est_ghost_array_index (&send_bufs, n1_proc);
+          p4est_add_ghost_to_buf (buf, nt, local_num, q);
+#endif
+          p4est_ghost_mirror_add (m, nt, local_num, q, n1_proc);
+        }
+      }
+    }
+    else {
+      p8est_quadrant_edge_neighbor (q, edge, &n[0]);
+      if (p4est_quadrant_is_inside_root (&n[0])) {
+        nedge = edge ^ 3;
+        touch = ((int32_t) 1 << (6 + nedge));
+        p4est_ghost_test_add (p4est, m, q, nt, &n[0], nt, touch, rank,
+                              local_num);
+      }
+      else if (p4est_quadrant_is_outside_face (&n[0])) {
+        P4EST_ASSERT (p4est_quadrant_is_extended (&n[0]));
+        face = -1;
+        if (n[0].x < 0 || n[0].x >= P4EST_ROOT_LEN) {
+          face = p8est_edge_faces[edge][0];
+        }
+        else if (n[0].z < 0 || n[0].z >= P4EST_ROOT_LEN) {
+          face = p8est_edge_faces[edge][1];
+        }
+        else if (n[0].y < 0) {
+          face = 2;
+        }
+        else {
+          face = 3;
+        }
+        nnt = p4est_find_face_transform (conn, nt, face, ftransform);
+        if (nnt < 0) {
+          continue;
+        }
+        P4EST_ASSERT (face >= 0);
+        P4EST_ASSERT (p8est_edge_face_corners[edge][face][0] != -1);
+        if (p8est_edge_faces[edge][0] == face) {
+          oppedge = edge ^ 2;
+          P4EST_ASSERT (p8est_edge_faces[oppedge][0] == face);
+        }
+        else {
+          P4EST_ASSERT (p8est_edge_faces[edge][1] == face);
+          oppedge = edge ^ 1;
+          P4EST_ASSERT (p8est_edge_faces[oppedge][1] == face);
+        }
+        nface = (int) conn->tree_to_face[nt * P4EST_FACES + face];
+        o = nface / P4EST_FACES;
+        nface %= P4EST_FACES;
+        ref = p8est_face_permutation_refs[face][nface];
+        set = p8est_face_permutation_sets[ref][o];
+        c0 = p8est_edge_face_corners[oppedge][face][0];
+        c1 = p8est_edge_face_corners[oppedge][face][1];
+        nc0 = p8est_face_permutations[set][c0];
+        nc1 = p8est_face_permutations[set][c1];
+        nc0 = p8est_face_corners[nface][nc0];
+        nc1 = p8est_face_corners[nface][nc1];
+        nedge = p8est_child_corner_edges[nc0][nc1];
+        touch = ((int32_t) 1 << (6 + nedge));
+        p4est_quadrant_transform_face (&n[0], &n[1], ftransform);
+        p4est_ghost_test_add (p4est, m, q, nt, &n[1], nnt, touch, rank,
+                              local_num);
+      }
+      else {
+        P4EST_ASSERT (p8est_quadrant_is_outside_edge (&n[0]));
+        sc_array_init (eta, sizeof (p8est_edge_transform_t));
+        p8est_find_edge_transform (conn, nt, edge, &ei);
+        for (etree = 0; etree < eta->elem_count; etree++) {
+          et = p8est_edge_array_index (eta, etree);
+          p8est_quadrant_transform_edge (&n[0], &n[1], &ei, et, 1);
+          nnt = et->ntree;
+          nedge = (int) et->nedge;
+          touch = ((int32_t) 1 << (6 + nedge));
+          p4est_ghost_test_add (p4est, m, q, nt, &n[1], nnt, touch, rank,
+                                local_num);
+        }
+        sc_array_reset (eta);
+      }
+    }
+  }
+
+  if (btype == P8EST_CONNECT_EDGE) {
+    return 0;
+  }
+#endif
+
+  /* Find smaller corner neighbors */
+  for (corner = 0; corner < P4EST_CHILDREN; ++corner) {
+    if (tol < P4EST_GHOST_UNBALANCED_ALLOW) {
+      if (q->level == P4EST_QMAXLEVEL) {
+        p4est_quadrant_corner_neighbor (q, corner, &n[0]);
+        maxed = 1;
+      }
+      else {
+        p4est_quadrant_get_half_corner_neighbor (q, corner, &n[0],
+                                                 &nur[0]);
+        maxed = 0;
+      }
+
+      /* Check to see if we are a tree corner neighbor */
+      if (p4est_quadrant_is_outside_corner (&n[0])) {
+        /* Then we have to loop over multiple corner neighbors */
+        p4est_quadrant_find_tree_corner_owners (p4est, nt, corner, &n[0],
+                                                &procs[0], &urg[0]);
+        if (!urg[0]) {
+          P4EST_NOTICE ("Tree corner owner inconsistency\n");
+          return 1;
+        }
+
+        for (pz = 0; pz < procs[0].elem_count; ++pz) {
+          n0_proc = *((int *) sc_array_index (&procs[0], pz));
+
+          if (n0_proc != rank) {
+#if 0
+            buf = p4est_ghost_array_index (&send_bufs, n0_proc);
+            p4est_add_ghost_to_buf (buf, nt, local_num, q);
+#endif
+            p4est_ghost_mirror_add (m, nt, local_num, q, n0_proc);
+          }
+        }
+      }
+#ifdef P4_TO_P8
+      /* Check to see if we are a tree edge neighbor */
+      else if (p8est_quadrant_is_outside_edge_extra (&n[0], &edge)) {
+        p8est_quadrant_find_tree_edge_owners (p4est, nt, edge,
+                                              &n[0], &procs[0], &urg[0]);
+        if (!urg[0]) {
+          P4EST_NOTICE ("Tree corner/edge owner inconsistency\n");
+          return 1;
+        }
+
+        /* Then we have to loop over multiple edge neighbors */
+        for (pz = 0; pz < procs[0].elem_count; ++pz) {
+          n0_proc = *((int *) sc_array_index (&procs[0], pz));
+
+          if (n0_proc != rank) {
+#if 0
+            buf = p4est_ghost_array_index (&send_bufs, n0_proc);
+            p4est_add_ghost_to_buf (buf, nt, local_num, q);
+#endif
+            p4est_ghost_mirror_add (m, nt, local_num, q, n0_proc);
+          }
+        }
+      }
+#endif
+      else {
+        /* We are not at a tree edge or corner so
+         * we only have one corner neighbor
+         */
+        n0_proc = p4est_quadrant_find_owner (p4est, nt, -1, &n[0]);
+        if (!maxed) {
+          n0ur_proc = p4est_quadrant_find_owner (p4est, nt, -1, &nur[0]);
+
+          /* Note that we will always check this
+           * because it prevents deadlocks
+           */
+          if (n0_proc != n0ur_proc) {
+            P4EST_NOTICE ("Small corner owner inconsistency\n");
+            return 1;
+          }
+        }
+
+        if (n0_proc != rank && n0_proc >= 0) {
+#if 0
+          buf = p4est_ghost_array_index (&send_bufs, n0_proc);
+          p4est_add_ghost_to_buf (buf, nt, local_num, q);
+#endif
+          p4est_ghost_mirror_add (m, nt, local_num, q, n0_proc);
+        }
+      }
+    }
+    else {
+      p4est_quadrant_corner_descendant (q, &n[1], corner,
+                                        P4EST_QMAXLEVEL);
+      p4est_quadrant_corner_neighbor (&n[1], corner, &n[0]);
+      if (p4est_quadrant_is_inside_root (&n[0])) {
+        n0_proc = p4est_comm_find_owner (p4est, nt, &n[0], rank);
+        P4EST_ASSERT (n0_proc >= 0);
+        if (n0_proc != rank) {
+#if 0
+          buf = p4est_ghost_array_index (&send_bufs, n0_proc);
+          p4est_add_ghost_to_buf (buf, nt, local_num, q);
+#endif
+          p4est_ghost_mirror_add (m, nt, local_num, q, n0_proc);
+        }
+      }
+      else if (p4est_quadrant_is_outside_face (&n[0])) {
+        if (n[0].x < 0 || n[0].x >= P4EST_ROOT_LEN) {
+          face = p4est_corner_faces[corner][0];
+        }
+#ifdef P4_TO_P8
+        else if (n[0].y < 0 || n[0].y >= P4EST_ROOT_LEN) {
+          face = p4est_corner_faces[corner][1];
+        }
+#endif
+        else {
+          face = p4est_corner_faces[corner][P4EST_DIM - 1];
+        }
+        nnt = p4est_find_face_transform (conn, nt, face, ftransform);
+        if (nnt < 0) {
+          continue;
+        }
+        p4est_quadrant_transform_face (&n[0], &n[1], ftransform);
+        n0_proc = p4est_comm_find_owner (p4est, nnt, &n[1], rank);
+        if (n0_proc != rank) {
+#if 0
+          buf = p4est_ghost_array_index (&send_bufs, n0_proc);
+          p4est_add_ghost_to_buf (buf, nt, local_num, q);
+#endif
+          p4est_ghost_mirror_add (m, nt, local_num, q, n0_proc);
+        }
+      }
+#ifdef P4_TO_P8
+      else if (p8est_quadrant_is_outside_edge_extra (&n[0], &edge)) {
+        sc_array_init (eta, sizeof (p8est_edge_transform_t));
+        p8est_find_edge_transform (conn, nt, edge, &ei);
+        for (etree = 0; etree < eta->elem_count; etree++) {
+          et = p8est_edge_array_index (eta, etree);
+          p8est_quadrant_transform_edge (&n[0], &n[1], &ei, et, 1);
+          nnt = et->ntree;
+          n0_proc = p4est_comm_find_owner (p4est, nnt, &n[1], rank);
+          if (n0_proc != rank) {
+#if 0
+            buf = p4est_ghost_array_index (&send_bufs, n0_proc);
+            p4est_add_ghost_to_buf (buf, nt, local_num, q);
+#endif
+            p4est_ghost_mirror_add (m, nt, local_num, q, n0_proc);
+          }
+        }
+        sc_array_reset (eta);
+      }
+#endif
+      else {
+        sc_array_init (cta, sizeof (p4est_corner_transform_t));
+        p4est_find_corner_transform (conn, nt, corner, &ci);
+        for (ctree = 0; ctree < cta->elem_count; ++ctree) {
+          ct = p4est_corner_array_index (cta, ctree);
+          p4est_quadrant_transform_corner (&n[0], (int) ct->ncorner, 1);
+          nnt = ct->ntree;
+          n0_proc = p4est_comm_find_owner (p4est, nnt, &n[0], rank);
+          if (n0_proc != rank) {
+#if 0
+            buf = p4est_ghost_array_index (&send_bufs, n0_proc);
+            p4est_add_ghost_to_buf (buf, nt, local_num, q);
+#endif
+            p4est_ghost_mirror_add (m, nt, local_num, q, n0_proc);
+          }
+        }
+        sc_array_reset (cta);
+      }
+    }
+  }
+
+  P4EST_ASSERT (btype == P4EST_CONNECT_FULL);
+  return 0;
+}
+
 #endif /* P4EST_ENABLE_MPI */
 
 static p4est_ghost_t *
@@ -1429,19 +1920,13 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
   const p4est_topidx_t num_trees = p4est->connectivity->num_trees;
   const int           num_procs = p4est->mpisize;
 #ifdef P4EST_ENABLE_MPI
-  const int           rank = p4est->mpirank;
   MPI_Comm            comm = p4est->mpicomm;
-  p4est_connectivity_t *conn = p4est->connectivity;
-  int                 face, corner;
-  int                 nface, ncheck, ncount;
   int                 i;
-  int                 n0_proc, n0ur_proc, n1_proc;
   int                 num_peers, peer, peer_proc;
   int                 mpiret;
-  int                 maxed, failed;
+  int                 failed;
   int                 full_tree[2], tree_contact[2 * P4EST_DIM];
-  int                 urg[P4EST_DIM - 1];
-  size_t              pz, zz;
+  size_t              zz;
   p4est_topidx_t      first_local_tree = p4est->first_local_tree;
   p4est_topidx_t      last_local_tree = p4est->last_local_tree;
 #ifdef P4EST_ENABLE_DEBUG
@@ -1452,34 +1937,14 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
   p4est_locidx_t     *send_counts, *recv_counts;
   p4est_tree_t       *tree;
   p4est_quadrant_t   *q;
-  p4est_quadrant_t    n[P4EST_HALF], nur[P4EST_HALF];
   sc_array_t          send_bufs;
   sc_array_t          procs[P4EST_DIM - 1];
   sc_array_t         *buf, *quadrants;
   MPI_Request        *recv_request, *send_request;
   MPI_Request        *recv_load_request, *send_load_request;
-#ifdef P4_TO_P8
-  int                 edge, nedge;
-  p8est_edge_info_t   ei;
-  p8est_edge_transform_t *et;
-  sc_array_t         *eta;
-  size_t              etree;
-  int                 o, ref, set;
-  int                 c0, c1;
-  int                 nc0, nc1;
-  int                 oppedge;
-  int                 n1ur_proc;
-#endif
 #ifdef P4EST_ENABLE_DEBUG
   p4est_quadrant_t   *q2;
 #endif
-  int                 ftransform[P4EST_FTRANSFORM];
-  int32_t             touch;
-  p4est_topidx_t      nnt;
-  p4est_corner_info_t ci;
-  p4est_corner_transform_t *ct;
-  sc_array_t         *cta;
-  size_t              ctree;
   p4est_ghost_mirror_t m;
 #endif
   size_t             *ppz;
@@ -1496,6 +1961,7 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
   gl->mpisize = num_procs;
   gl->num_trees = num_trees;
   gl->btype = btype;
+  gl->partition_checksum = p4est_ghost_partition_checksum (p4est);
 
   ghost_layer = &gl->ghosts;
   sc_array_init (ghost_layer, sizeof (p4est_quadrant_t));
@@ -1515,16 +1981,6 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
   gl->proc_offsets[1] = 0;
   gl->mirror_proc_offsets[1] = 0;
 #else
-#ifdef P4_TO_P8
-  eta = &ei.edge_transforms;
-#endif
-  cta = &ci.corner_transforms;
-
-  for (i = 0; i < P4EST_HALF; ++i) {
-    P4EST_QUADRANT_INIT (&n[i]);
-    P4EST_QUADRANT_INIT (&nur[i]);
-  }
-
   failed = 0;
   for (i = 0; i < P4EST_DIM - 1; ++i) {
     sc_array_init (&procs[i], sizeof (int));
@@ -1540,7 +1996,8 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
   }
 
   /* initialize structure to keep track of mirror quadrants */
-  p4est_ghost_mirror_init (gl, p4est->mpirank, &send_bufs, &m);
+  p4est_ghost_mirror_init (num_procs, p4est->mpirank, &gl->mirrors,
+                           &send_bufs, &m);
 
   /* loop over all local trees */
   local_num = 0;
@@ -1558,8 +2015,6 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
     /* Find the smaller neighboring processors of each quadrant */
     for (zz = 0; zz < quadrants->elem_count; ++local_num, ++zz) {
       q = p4est_quadrant_array_index (quadrants, zz);
-      m.known = 0;
-
       if (p4est_comm_neighborhood_owned
           (p4est, nt, full_tree, tree_contact, q)) {
         /* The 3x3 neighborhood of q is owned by this processor */
@@ -1567,427 +2022,24 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
         continue;
       }
 
-      /* Find smaller face neighbors */
-      for (face = 0; face < 2 * P4EST_DIM; ++face) {
-        if (tol < P4EST_GHOST_UNBALANCED_ALLOW) {
-          if (q->level == P4EST_QMAXLEVEL) {
-            p4est_quadrant_face_neighbor (q, face, &n[0]);
-            ncheck = 0;
-            ncount = 1;
-          }
-          else {
-            p4est_quadrant_half_face_neighbors (q, face, n, nur);
-            ncheck = ncount = P4EST_HALF;
-          }
+      if (p4est_ghost_mirror_quadrant (p4est, &m, btype, tol, nt, local_num,
+                                       q, procs)) {
+        failed = 1;
+        goto failtest;
+      }
+    }
+  }
+  P4EST_ASSERT (local_num == p4est->local_num_quadrants);
+  for (nt = SC_MAX (p4est->last_local_tree + 1, 0); nt <= num_trees; ++nt) {
+    /* needs to cover all trees if this processor is empty */
+    /* needs to run inclusive on num_trees */
+    gl->mirror_tree_offsets[nt] = (p4est_locidx_t) gl->mirrors.elem_count;
+  }
 
-          n1_proc = -1;
-          for (i = 0; i < ncount; ++i) {
-            n0_proc = p4est_quadrant_find_owner (p4est, nt, face, &n[i]);
-            if (i < ncheck) {
-              /* Note that we will always check this
-               * because it prevents deadlocks
-               */
-              n0ur_proc = p4est_quadrant_find_owner (p4est, nt, face,
-                                                     &nur[i]);
-              if (n0_proc != n0ur_proc) {
-                P4EST_NOTICE ("Small face owner inconsistency\n");
-                failed = 1;
-                goto failtest;
-              }
-            }
-
-            if (n0_proc != rank && n0_proc >= 0 && n0_proc != n1_proc) {
-#if 0
-              buf = p4est_ghost_array_index (&send_bufs, n0_proc);
-              p4est_add_ghost_to_buf (buf, nt, local_num, q);
-#endif
-              p4est_ghost_mirror_add (&m, nt, local_num, q, n0_proc);
-              n1_proc = n0_proc;
-            }
-          }
-        }
-        else {
-          p4est_quadrant_face_neighbor (q, face, &n[0]);
-          if (p4est_quadrant_is_inside_root (&n[0])) {
-            nface = face ^ 1;
-            touch = ((int32_t) 1 << nface);
-            p4est_ghost_test_add (p4est, &m, q, nt, &n[0], nt, touch, rank,
-                                  local_num);
-          }
-          else {
-            nnt = p4est_find_face_transform (conn, nt, face, ftransform);
-            if (nnt < 0) {
-              continue;
-            }
-            nface = (int) conn->tree_to_face[nt * P4EST_FACES + face];
-            nface %= P4EST_FACES;
-            touch = ((int32_t) 1 << nface);
-            p4est_quadrant_transform_face (&n[0], &n[1], ftransform);
-            p4est_ghost_test_add (p4est, &m, q, nt, &n[1], nnt, touch, rank,
-                                  local_num);
-          }
-        }
-      }
-
-      if (btype == P4EST_CONNECT_FACE)
-        continue;
-
-#ifdef P4_TO_P8
-
-      /* Find smaller edge neighbors */
-      for (edge = 0; edge < 12; ++edge) {
-        if (tol < P4EST_GHOST_UNBALANCED_ALLOW) {
-          if (q->level == P4EST_QMAXLEVEL) {
-            p8est_quadrant_edge_neighbor (q, edge, &n[0]);
-            maxed = 1;
-          }
-          else {
-            p8est_quadrant_get_half_edge_neighbors (q, edge, n, nur);
-            maxed = 0;
-          }
-
-          /* Check to see if we are a tree edge neighbor */
-          P4EST_ASSERT (!p4est_quadrant_is_outside_corner (&n[0]));
-          if (p8est_quadrant_is_outside_edge (&n[0])) {
-            p8est_quadrant_find_tree_edge_owners (p4est, nt, edge,
-                                                  &n[0], &procs[0], &urg[0]);
-            if (!maxed) {
-              p8est_quadrant_find_tree_edge_owners (p4est, nt, edge,
-                                                    &n[1], &procs[1],
-                                                    &urg[1]);
-              P4EST_ASSERT (procs[0].elem_count == procs[1].elem_count);
-
-              if (!urg[0] || !urg[1]) {
-                P4EST_NOTICE ("Tree edge owner inconsistency\n");
-                failed = 1;
-                goto failtest;
-              }
-            }
-
-            /* Then we have to loop over multiple neighbors */
-            for (pz = 0; pz < procs[0].elem_count; ++pz) {
-              n0_proc = *((int *) sc_array_index (&procs[0], pz));
-
-              if (n0_proc != rank) {
-#if 0
-                buf = p4est_ghost_array_index (&send_bufs, n0_proc);
-                p4est_add_ghost_to_buf (buf, nt, local_num, q);
-#endif
-                p4est_ghost_mirror_add (&m, nt, local_num, q, n0_proc);
-              }
-
-              if (!maxed) {
-                n1_proc = *((int *) sc_array_index (&procs[1], pz));
-
-                if (n1_proc != n0_proc && n1_proc != rank) {
-#if 0
-                  buf = p4est_ghost_array_index (&send_bufs, n1_proc);
-                  p4est_add_ghost_to_buf (buf, nt, local_num, q);
-#endif
-                  p4est_ghost_mirror_add (&m, nt, local_num, q, n1_proc);
-                }
-              }
-            }
-          }
-          else {
-            /* We are not at a tree edge so we only have two neighbors
-             * either inside the tree or across a face
-             */
-            n0_proc = n1_proc =
-              p4est_quadrant_find_owner (p4est, nt, -1, &n[0]);
-            if (!maxed) {
-              n1_proc = p4est_quadrant_find_owner (p4est, nt, -1, &n[1]);
-              n0ur_proc = p4est_quadrant_find_owner (p4est, nt, -1, &nur[0]);
-              n1ur_proc = p4est_quadrant_find_owner (p4est, nt, -1, &nur[1]);
-
-              /* Note that we will always check this
-               * because it prevents deadlocks
-               */
-              if (n0_proc != n0ur_proc || n1_proc != n1ur_proc) {
-                P4EST_NOTICE ("Small edge owner inconsistency\n");
-                failed = 1;
-                goto failtest;
-              }
-            }
-
-            if (n0_proc != rank && n0_proc >= 0) {
-#if 0
-              buf = p4est_ghost_array_index (&send_bufs, n0_proc);
-              p4est_add_ghost_to_buf (buf, nt, local_num, q);
-#endif
-              p4est_ghost_mirror_add (&m, nt, local_num, q, n0_proc);
-            }
-
-            if (n1_proc != n0_proc && n1_proc != rank && n1_proc >= 0) {
-#if 0
-              buf = p4est_ghost_array_index (&send_bufs, n1_proc);
-              p4est_add_ghost_to_buf (buf, nt, local_num, q);
-#endif
-              p4est_ghost_mirror_add (&m, nt, local_num, q, n1_proc);
-            }
-          }
-        }
-        else {
-          p8est_quadrant_edge_neighbor (q, edge, &n[0]);
-          if (p4est_quadrant_is_inside_root (&n[0])) {
-            nedge = edge ^ 3;
-            touch = ((int32_t) 1 << (6 + nedge));
-            p4est_ghost_test_add (p4est, &m, q, nt, &n[0], nt, touch, rank,
-                                  local_num);
-          }
-          else if (p4est_quadrant_is_outside_face (&n[0])) {
-            P4EST_ASSERT (p4est_quadrant_is_extended (&n[0]));
-            face = -1;
-            if (n[0].x < 0 || n[0].x >= P4EST_ROOT_LEN) {
-              face = p8est_edge_faces[edge][0];
-            }
-            else if (n[0].z < 0 || n[0].z >= P4EST_ROOT_LEN) {
-              face = p8est_edge_faces[edge][1];
-            }
-            else if (n[0].y < 0) {
-              face = 2;
-            }
-            else {
-              face = 3;
-            }
-            nnt = p4est_find_face_transform (conn, nt, face, ftransform);
-            if (nnt < 0) {
-              continue;
-            }
-            P4EST_ASSERT (face >= 0);
-            P4EST_ASSERT (p8est_edge_face_corners[edge][face][0] != -1);
-            if (p8est_edge_faces[edge][0] == face) {
-              oppedge = edge ^ 2;
-              P4EST_ASSERT (p8est_edge_faces[oppedge][0] == face);
-            }
-            else {
-              P4EST_ASSERT (p8est_edge_faces[edge][1] == face);
-              oppedge = edge ^ 1;
-              P4EST_ASSERT (p8est_edge_faces[oppedge][1] == face);
-            }
-            nface = (int) conn->tree_to_face[nt * P4EST_FACES + face];
-            o = nface / P4EST_FACES;
-            nface %= P4EST_FACES;
-            ref = p8est_face_permutation_refs[face][nface];
-            set = p8est_face_permutation_sets[ref][o];
-            c0 = p8est_edge_face_corners[oppedge][face][0];
-            c1 = p8est_edge_face_corners[oppedge][face][1];
-            nc0 = p8est_face_permutations[set][c0];
-            nc1 = p8est_face_permutations[set][c1];
-            nc0 = p8est_face_corners[nface][nc0];
-            nc1 = p8est_face_corners[nface][nc1];
-            nedge = p8est_child_corner_edges[nc0][nc1];
-            touch = ((int32_t) 1 << (6 + nedge));
-            p4est_quadrant_transform_face (&n[0], &n[1], ftransform);
-            p4est_ghost_test_add (p4est, &m, q, nt, &n[1], nnt, touch, rank,
-                                  local_num);
-          }
-          else {
-            P4EST_ASSERT (p8est_quadrant_is_outside_edge (&n[0]));
-            sc_array_init (eta, sizeof (p8est_edge_transform_t));
-            p8est_find_edge_transform (conn, nt, edge, &ei);
-            for (etree = 0; etree < eta->elem_count; etree++) {
-              et = p8est_edge_array_index (eta, etree);
-              p8est_quadrant_transform_edge (&n[0], &n[1], &ei, et, 1);
-              nnt = et->ntree;
-              nedge = (int) et->nedge;
-              touch = ((int32_t) 1 << (6 + nedge));
-              p4est_ghost_test_add (p4est, &m, q, nt, &n[1], nnt, touch, rank,
-                                    local_num);
-            }
-            sc_array_reset (eta);
-          }
-        }
-      }
-
-      if (btype == P8EST_CONNECT_EDGE)
-        continue;
-#endif
-
-      /* Find smaller corner neighbors */
-      for (corner = 0; corner < P4EST_CHILDREN; ++corner) {
-        if (tol < P4EST_GHOST_UNBALANCED_ALLOW) {
-          if (q->level == P4EST_QMAXLEVEL) {
-            p4est_quadrant_corner_neighbor (q, corner, &n[0]);
-            maxed = 1;
-          }
-          else {
-            p4est_quadrant_get_half_corner_neighbor (q, corner, &n[0],
-                                                     &nur[0]);
-            maxed = 0;
-          }
-
-          /* Check to see if we are a tree corner neighbor */
-          if (p4est_quadrant_is_outside_corner (&n[0])) {
-            /* Then we have to loop over multiple corner neighbors */
-            p4est_quadrant_find_tree_corner_owners (p4est, nt, corner, &n[0],
-                                                    &procs[0], &urg[0]);
-            if (!urg[0]) {
-              P4EST_NOTICE ("Tree corner owner inconsistency\n");
-              failed = 1;
-              goto failtest;
-            }
-
-            for (pz = 0; pz < procs[0].elem_count; ++pz) {
-              n0_proc = *((int *) sc_array_index (&procs[0], pz));
-
-              if (n0_proc != rank) {
-#if 0
-                buf = p4est_ghost_array_index (&send_bufs, n0_proc);
-                p4est_add_ghost_to_buf (buf, nt, local_num, q);
-#endif
-                p4est_ghost_mirror_add (&m, nt, local_num, q, n0_proc);
-              }
-            }
-          }
-#ifdef P4_TO_P8
-          /* Check to see if we are a tree edge neighbor */
-          else if (p8est_quadrant_is_outside_edge_extra (&n[0], &edge)) {
-            p8est_quadrant_find_tree_edge_owners (p4est, nt, edge,
-                                                  &n[0], &procs[0], &urg[0]);
-            if (!urg[0]) {
-              P4EST_NOTICE ("Tree corner/edge owner inconsistency\n");
-              failed = 1;
-              goto failtest;
-            }
-
-            /* Then we have to loop over multiple edge neighbors */
-            for (pz = 0; pz < procs[0].elem_count; ++pz) {
-              n0_proc = *((int *) sc_array_index (&procs[0], pz));
-
-              if (n0_proc != rank) {
-#if 0
-                buf = p4est_ghost_array_index (&send_bufs, n0_proc);
-                p4est_add_ghost_to_buf (buf, nt, local_num, q);
-#endif
-                p4est_ghost_mirror_add (&m, nt, local_num, q, n0_proc);
-              }
-            }
-          }
-#endif
-          else {
-            /* We are not at a tree edge or corner so
-             * we only have one corner neighbor
-             */
-            n0_proc = p4est_quadrant_find_owner (p4est, nt, -1, &n[0]);
-            if (!maxed) {
-              n0ur_proc = p4est_quadrant_find_owner (p4est, nt, -1, &nur[0]);
-
-              /* Note that we will always check this
-               * because it prevents deadlocks
-               */
-              if (n0_proc != n0ur_proc) {
-                P4EST_NOTICE ("Small corner owner inconsistency\n");
-                failed = 1;
-                goto failtest;
-              }
-            }
-
-            if (n0_proc != rank && n0_proc >= 0) {
-#if 0
-              buf = p4est_ghost_array_index (&send_bufs, n0_proc);
-              p4est_add_ghost_to_buf (buf, nt, local_num, q);
-#endif
-              p4est_ghost_mirror_add (&m, nt, local_num, q, n0_proc);
-            }
-          }
-        }
-        else {
-          p4est_quadrant_corner_descendant (q, &n[1], corner,
-                                            P4EST_QMAXLEVEL);
-          p4est_quadrant_corner_neighbor (&n[1], corner, &n[0]);
-          if (p4est_quadrant_is_inside_root (&n[0])) {
-            n0_proc = p4est_comm_find_owner (p4est, nt, &n[0], rank);
-            P4EST_ASSERT (n0_proc >= 0);
-            if (n0_proc != rank) {
-#if 0
-              buf = p4est_ghost_array_index (&send_bufs, n0_proc);
-              p4est_add_ghost_to_buf (buf, nt, local_num, q);
-#endif
-              p4est_ghost_mirror_add (&m, nt, local_num, q, n0_proc);
-            }
-          }
-          else if (p4est_quadrant_is_outside_face (&n[0])) {
-            if (n[0].x < 0 || n[0].x >= P4EST_ROOT_LEN) {
-              face = p4est_corner_faces[corner][0];
-            }
-#ifdef P4_TO_P8
-            else if (n[0].y < 0 || n[0].y >= P4EST_ROOT_LEN) {
-              face = p4est_corner_faces[corner][1];
-            }
-#endif
-            else {
-              face = p4est_corner_faces[corner][P4EST_DIM - 1];
-            }
-            nnt = p4est_find_face_transform (conn, nt, face, ftransform);
-            if (nnt < 0) {
-              continue;
-            }
-            p4est_quadrant_transform_face (&n[0], &n[1], ftransform);
-            n0_proc = p4est_comm_find_owner (p4est, nnt, &n[1], rank);
-            if (n0_proc != rank) {
-#if 0
-              buf = p4est_ghost_array_index (&send_bufs, n0_proc);
-              p4est_add_ghost_to_buf (buf, nt, local_num, q);
-#endif
-              p4est_ghost_mirror_add (&m, nt, local_num, q, n0_proc);
-            }
-          }
-#ifdef P4_TO_P8
-          else if (p8est_quadrant_is_outside_edge_extra (&n[0], &edge)) {
-            sc_array_init (eta, sizeof (p8est_edge_transform_t));
-            p8est_find_edge_transform (conn, nt, edge, &ei);
-            for (etree = 0; etree < eta->elem_count; etree++) {
-              et = p8est_edge_array_index (eta, etree);
-              p8est_quadrant_transform_edge (&n[0], &n[1], &ei, et, 1);
-              nnt = et->ntree;
-              n0_proc = p4est_comm_find_owner (p4est, nnt, &n[1], rank);
-              if (n0_proc != rank) {
-#if 0
-                buf = p4est_ghost_array_index (&send_bufs, n0_proc);
-                p4est_add_ghost_to_buf (buf, nt, local_num, q);
-#endif
-                p4est_ghost_mirror_add (&m, nt, local_num, q, n0_proc);
-              }
-            }
-            sc_array_reset (eta);
-          }
-#endif
-          else {
-            sc_array_init (cta, sizeof (p4est_corner_transform_t));
-            p4est_find_corner_transform (conn, nt, corner, &ci);
-            for (ctree = 0; ctree < cta->elem_count; ++ctree) {
-              ct = p4est_corner_array_index (cta, ctree);
-              p4est_quadrant_transform_corner (&n[0], (int) ct->ncorner, 1);
-              nnt = ct->ntree;
-              n0_proc = p4est_comm_find_owner (p4est, nnt, &n[0], rank);
-              if (n0_proc != rank) {
-#if 0
-                buf = p4est_ghost_array_index (&send_bufs, n0_proc);
-                p4est_add_ghost_to_buf (buf, nt, local_num, q);
-#endif
-                p4est_ghost_mirror_add (&m, nt, local_num, q, n0_proc);
-              }
-            }
-            sc_array_reset (cta);
-          }
-        }
-      }
-
-      P4EST_ASSERT (btype == P4EST_CONNECT_FULL);
-    }
-  }
-  P4EST_ASSERT (local_num == p4est->local_num_quadrants);
-  for (nt = SC_MAX (p4est->last_local_tree + 1, 0); nt <= num_trees; ++nt) {
-    /* needs to cover all trees if this processor is empty */
-    /* needs to run inclusive on num_trees */
-    gl->mirror_tree_offsets[nt] = (p4est_locidx_t) gl->mirrors.elem_count;
-  }
-
-failtest:
-  if (tol == P4EST_GHOST_UNBALANCED_FAIL) {
-    if (p4est_comm_sync_flag (p4est, failed, MPI_BOR)) {
-      p4est_ghost_mirror_reset (gl, &m, 0);
+failtest:
+  if (tol == P4EST_GHOST_UNBALANCED_FAIL) {
+    if (p4est_comm_sync_flag (p4est, failed, MPI_BOR)) {
+      p4est_ghost_mirror_reset (gl, &m, 0);
 
       for (i = 0; i < num_procs; ++i) {
         buf = p4est_ghost_array_index (&send_bufs, i);
@@ -2029,7 +2081,7 @@ failtest:
     buf = p4est_ghost_array_index (&send_bufs, i);
     if (buf->elem_count > 0) {
       peer_proc = i;
-      P4EST_ASSERT (peer_proc != rank);
+      P4EST_ASSERT (peer_proc != p4est->mpirank);
       P4EST_LDEBUGF ("ghost layer post count receive from %d\n", peer_proc);
       mpiret = MPI_Irecv (recv_counts + peer, 1, P4EST_MPI_LOCIDX,
                           peer_proc, P4EST_COMM_GHOST_COUNT, comm,
@@ -2220,94 +2272,470 @@ p4est_ghost_new (p4est_t * p4est, p4est_connect_type_t btype)
   return p4est_ghost_new_check (p4est, btype, P4EST_GHOST_UNBALANCED_ALLOW);
 }
 
-void
-p4est_ghost_destroy (p4est_ghost_t * ghost)
+#ifdef P4EST_ENABLE_MPI
+
+/** Look up a quadrant in the local part of the forest.
+ * \return          Its process-local number, or -1 if it does not exist.
+ */
+static              p4est_locidx_t
+p4est_ghost_find_local (p4est_t * p4est, p4est_topidx_t which_tree,
+                        const p4est_quadrant_t * q)
 {
-  sc_array_reset (&ghost->ghosts);
-  P4EST_FREE (ghost->tree_offsets);
-  P4EST_FREE (ghost->proc_offsets);
+  ssize_t             result;
+  p4est_tree_t       *tree;
 
-  if (ghost->mirror_proc_fronts != ghost->mirror_proc_mirrors) {
-    P4EST_ASSERT (ghost->mirror_proc_front_offsets !=
-                  ghost->mirror_proc_offsets);
-    P4EST_FREE (ghost->mirror_proc_fronts);
-    P4EST_FREE (ghost->mirror_proc_front_offsets);
+  if (which_tree < p4est->first_local_tree ||
+      which_tree > p4est->last_local_tree) {
+    return -1;
   }
-
-  sc_array_reset (&ghost->mirrors);
-  P4EST_FREE (ghost->mirror_tree_offsets);
-  P4EST_FREE (ghost->mirror_proc_mirrors);
-  P4EST_FREE (ghost->mirror_proc_offsets);
-
-  P4EST_FREE (ghost);
+  tree = p4est_tree_array_index (p4est->trees, which_tree);
+  result = sc_array_bsearch (&tree->quadrants, q, p4est_quadrant_compare);
+  return result < 0 ? -1 : tree->quadrants_offset + (p4est_locidx_t) result;
 }
 
-unsigned
-p4est_ghost_checksum (p4est_t * p4est, p4est_ghost_t * ghost)
-{
-  unsigned            crc;
-  uint32_t           *check;
-#ifdef P4_TO_P8
-  int                 level_difference;
-#endif
-  size_t              zz, csize, qcount, offset;
-  size_t              nt1, np1, local_count;
-  sc_array_t         *quadrants, *checkarray;
-  p4est_quadrant_t   *q;
-
-  quadrants = &ghost->ghosts;
-  qcount = quadrants->elem_count;
-  nt1 = (size_t) p4est->connectivity->num_trees + 1;
-  np1 = (size_t) p4est->mpisize + 1;
-
-  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
+#endif /* P4EST_ENABLE_MPI */
 
-  csize = sizeof (uint32_t);
-  checkarray = sc_array_new (csize);
+void
+p4est_ghost_update (p4est_t * p4est, p4est_ghost_t * ghost,
+                    sc_array_t * changed)
+{
+#ifdef P4EST_ENABLE_MPI
+  const p4est_topidx_t num_trees = p4est->connectivity->num_trees;
+  const int           num_procs = p4est->mpisize;
+  const int           rank = p4est->mpirank;
+  MPI_Comm            comm = p4est->mpicomm;
+  int                 i, p;
+  int                 mpiret;
+  int                 num_peers, peer;
+  int                 full_tree[2], tree_contact[2 * P4EST_DIM];
+  int                *peers;
+  char              **sbufs, **rbufs;
+  size_t              zz, zn, za, zo;
+  size_t             *ppz;
+  p4est_topidx_t      nt, ct;
+  p4est_locidx_t      li, lo, lend, ln, delta, lastdelta;
+  p4est_locidx_t      num_old, num_added, num_mirrors;
+  p4est_locidx_t      nremoved, nruns, nadded;
+  p4est_locidx_t     *old_new, *added_new, *old_lnum;
+  p4est_locidx_t     *counts, *send_counts, *recv_counts;
+  p4est_locidx_t     *mpm, *mpo, *rdata;
+  p4est_quadrant_t   *q, *aq, *qnew;
+  p4est_ghost_mirror_t m;
+  sc_array_t          changed_local, added, mirrors, ghosts;
+  sc_array_t          send_bufs, proc_mirrors, removed, runs;
+  sc_array_t          procs[P4EST_DIM - 1];
+  sc_array_t          split;
+  sc_array_t         *buf;
+  MPI_Request        *requests;
 
-  local_count = qcount * (P4EST_DIM + 3) + nt1 + np1;
-  sc_array_resize (checkarray, local_count);
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING "_ghost_update %s\n",
+                            p4est_connect_type_string (ghost->btype));
+  p4est_log_indent_push ();
 
-  /* checksum ghost quadrants */
-  for (zz = 0; zz < qcount; ++zz) {
-    q = p4est_quadrant_array_index (quadrants, zz);
-    P4EST_ASSERT (p4est_quadrant_is_valid (q));
-    check = (uint32_t *) sc_array_index (checkarray, zz * (P4EST_DIM + 3));
-#ifndef P4_TO_P8
-    check[0] = htonl ((uint32_t) q->x);
-    check[1] = htonl ((uint32_t) q->y);
-#else
-    if (q->level <= P4EST_OLD_QMAXLEVEL) {
-      /* shift the quadrant coordinates to ensure backward compatibility */
-      level_difference = P4EST_MAXLEVEL - P4EST_OLD_MAXLEVEL;
-      /* *INDENT-OFF* */
-      check[0] =
-        htonl ((q->x < 0) ? -(((uint32_t) -q->x) >> level_difference) :
-                              (((uint32_t) q->x) >> level_difference));
-      check[1] =
-        htonl ((q->y < 0) ? -(((uint32_t) -q->y) >> level_difference) :
-                              (((uint32_t) q->y) >> level_difference));
-      check[2] =
-        htonl ((q->z < 0) ? -(((uint32_t) -q->z) >> level_difference) :
-                              (((uint32_t) q->z) >> level_difference));
-      /* *INDENT-ON* */
-    }
-    else {
-      check[0] = htonl ((uint32_t) q->x);
-      check[1] = htonl ((uint32_t) q->y);
-      check[2] = htonl ((uint32_t) q->z);
+  P4EST_ASSERT (ghost->mpisize == num_procs);
+  P4EST_ASSERT (ghost->num_trees == num_trees);
+  P4EST_ASSERT (changed != NULL);
+  P4EST_ASSERT (changed->elem_size == sizeof (p4est_quadrant_t));
+  SC_CHECK_ABORT (ghost->mirror_proc_fronts == ghost->mirror_proc_mirrors,
+                  "Updating an expanded ghost layer is not supported");
+  SC_CHECK_ABORT (ghost->partition_checksum ==
+                  p4est_ghost_partition_checksum (p4est),
+                  "Updating a ghost layer after a partition is not supported");
+
+  /* find the changed quadrants that still exist, in local order */
+  sc_array_init (&changed_local, sizeof (p4est_quadrant_t));
+  for (zz = 0; zz < changed->elem_count; ++zz) {
+    q = p4est_quadrant_array_index (changed, zz);
+    nt = q->p.piggy3.which_tree;
+    ln = p4est_ghost_find_local (p4est, nt, q);
+    if (ln >= 0) {
+      qnew = p4est_quadrant_array_push_copy (&changed_local, q);
+      qnew->p.piggy3.which_tree = nt;
+      qnew->p.piggy3.local_num = ln;
     }
-#endif
-    check[P4EST_DIM] = htonl ((uint32_t) q->level);
-    check[P4EST_DIM + 1] = htonl ((uint32_t) q->p.piggy3.which_tree);
-    check[P4EST_DIM + 2] = htonl ((uint32_t) q->p.piggy3.local_num);
   }
+  sc_array_sort (&changed_local, p4est_quadrant_compare_piggy);
+  sc_array_uniq (&changed_local, p4est_quadrant_compare_piggy);
 
-  /* checksum tree_offsets */
-  offset = qcount * (P4EST_DIM + 3);
-  for (zz = 0; zz < nt1; ++zz) {
-    check = (uint32_t *) sc_array_index (checkarray, offset + zz);
-    *check = htonl ((uint32_t) ghost->tree_offsets[zz]);
+  /* recompute the mirror processes of the changed quadrants only */
+  sc_array_init (&added, sizeof (p4est_quadrant_t));
+  sc_array_init (&send_bufs, sizeof (sc_array_t));
+  sc_array_resize (&send_bufs, (size_t) num_procs);
+  for (p = 0; p < num_procs; ++p) {
+    buf = p4est_ghost_array_index (&send_bufs, p);
+    sc_array_init (buf, sizeof (p4est_quadrant_t));
+  }
+  for (i = 0; i < P4EST_DIM - 1; ++i) {
+    sc_array_init (&procs[i], sizeof (int));
+  }
+  p4est_ghost_mirror_init (num_procs, rank, &added, &send_bufs, &m);
+  ct = -1;
+  for (zz = 0; zz < changed_local.elem_count; ++zz) {
+    q = p4est_quadrant_array_index (&changed_local, zz);
+    nt = q->p.piggy3.which_tree;
+    if (nt != ct) {
+      p4est_comm_tree_info (p4est, nt, full_tree, tree_contact, NULL, NULL);
+      ct = nt;
+    }
+    if (p4est_comm_neighborhood_owned
+        (p4est, nt, full_tree, tree_contact, q)) {
+      continue;
+    }
+    P4EST_EXECUTE_ASSERT_FALSE
+      (p4est_ghost_mirror_quadrant (p4est, &m, ghost->btype,
+                                    P4EST_GHOST_UNBALANCED_ALLOW, nt,
+                                    q->p.piggy3.local_num, q, procs));
+  }
+  for (i = 0; i < P4EST_DIM - 1; ++i) {
+    sc_array_reset (&procs[i]);
+  }
+
+  /* renumber the old mirrors; removed and changed ones are dropped */
+  num_old = (p4est_locidx_t) ghost->mirrors.elem_count;
+  old_lnum = P4EST_ALLOC (p4est_locidx_t, num_old);
+  for (li = 0, zn = 0; li < num_old; ++li) {
+    q = p4est_quadrant_array_index (&ghost->mirrors, (size_t) li);
+    ln = p4est_ghost_find_local (p4est, q->p.piggy3.which_tree, q);
+    if (ln >= 0) {
+      while (zn < changed_local.elem_count &&
+             p4est_quadrant_array_index (&changed_local, zn)->
+             p.piggy3.local_num < ln) {
+        ++zn;
+      }
+      if (zn < changed_local.elem_count &&
+          p4est_quadrant_array_index (&changed_local, zn)->
+          p.piggy3.local_num == ln) {
+        ln = -1;
+      }
+    }
+    old_lnum[li] = ln;
+  }
+  sc_array_reset (&changed_local);
+
+  /* merge the surviving and the added mirrors in local order */
+  num_added = (p4est_locidx_t) added.elem_count;
+  old_new = P4EST_ALLOC (p4est_locidx_t, num_old + num_added);
+  added_new = old_new + num_old;
+  sc_array_init (&mirrors, sizeof (p4est_quadrant_t));
+  for (li = 0, za = 0;; ++li) {
+    while (li < num_old && old_lnum[li] < 0) {
+      old_new[li++] = -1;
+    }
+    while (za < added.elem_count &&
+           (li == num_old || p4est_quadrant_array_index (&added, za)->
+            p.piggy3.local_num < old_lnum[li])) {
+      added_new[za] = (p4est_locidx_t) mirrors.elem_count;
+      p4est_quadrant_array_push_copy
+        (&mirrors, p4est_quadrant_array_index (&added, za++));
+    }
+    if (li == num_old) {
+      break;
+    }
+    old_new[li] = (p4est_locidx_t) mirrors.elem_count;
+    qnew = p4est_quadrant_array_push_copy
+      (&mirrors, p4est_quadrant_array_index (&ghost->mirrors, (size_t) li));
+    qnew->p.piggy3.local_num = old_lnum[li];
+  }
+  num_mirrors = (p4est_locidx_t) mirrors.elem_count;
+
+  /* build the new mirror lists and the delta to send to each peer */
+  num_peers = 0;
+  peers = P4EST_ALLOC (int, num_procs);
+  sbufs = P4EST_ALLOC (char *, 2 * num_procs);
+  rbufs = sbufs + num_procs;
+  counts = P4EST_ALLOC (p4est_locidx_t, 6 * num_procs);
+  send_counts = counts;
+  recv_counts = counts + 3 * num_procs;
+  mpo = P4EST_ALLOC (p4est_locidx_t, num_procs + 1);
+  sc_array_init (&proc_mirrors, sizeof (p4est_locidx_t));
+  sc_array_init (&removed, sizeof (p4est_locidx_t));
+  sc_array_init (&runs, sizeof (p4est_locidx_t));
+  for (p = 0; p < num_procs; ++p) {
+    mpo[p] = (p4est_locidx_t) proc_mirrors.elem_count;
+    lo = ghost->mirror_proc_offsets[p];
+    lend = ghost->mirror_proc_offsets[p + 1];
+    buf = p4est_ghost_array_index (&send_bufs, p);
+    if (lo == lend && m.offsets_by_proc[p].elem_count == 0) {
+      continue;
+    }
+    P4EST_ASSERT (p != rank);
+    sc_array_truncate (&removed);
+    sc_array_truncate (&runs);
+    lastdelta = -1;
+    mpm = (p4est_locidx_t *) m.offsets_by_proc[p].array;
+    for (li = lo, za = 0;; ++li) {
+      while (li < lend && old_new[ghost->mirror_proc_mirrors[li]] < 0) {
+        *(p4est_locidx_t *) sc_array_push (&removed) = li - lo;
+        ++li;
+      }
+      while (za < m.offsets_by_proc[p].elem_count &&
+             (li == lend || added_new[mpm[za]] <
+              old_new[ghost->mirror_proc_mirrors[li]])) {
+        *(p4est_locidx_t *) sc_array_push (&proc_mirrors) =
+          added_new[mpm[za++]];
+      }
+      if (li == lend) {
+        break;
+      }
+      *(p4est_locidx_t *) sc_array_push (&proc_mirrors) =
+        old_new[ghost->mirror_proc_mirrors[li]];
+      q = p4est_quadrant_array_index (&ghost->mirrors,
+                                      (size_t) ghost->mirror_proc_mirrors[li]);
+      delta = old_lnum[ghost->mirror_proc_mirrors[li]] -
+        q->p.piggy3.local_num;
+      if (runs.elem_count == 0 || delta != lastdelta) {
+        *(p4est_locidx_t *) sc_array_push (&runs) = li - lo;
+        *(p4est_locidx_t *) sc_array_push (&runs) = lastdelta = delta;
+      }
+    }
+    P4EST_ASSERT (buf->elem_count == m.offsets_by_proc[p].elem_count);
+
+    /* the delta holds the added quadrants, removed indices and renumbering */
+    nadded = (p4est_locidx_t) buf->elem_count;
+    nremoved = (p4est_locidx_t) removed.elem_count;
+    nruns = (p4est_locidx_t) runs.elem_count / 2;
+    send_counts[3 * num_peers + 0] = nadded;
+    send_counts[3 * num_peers + 1] = nremoved;
+    send_counts[3 * num_peers + 2] = nruns;
+    sbufs[num_peers] = P4EST_ALLOC (char, nadded * sizeof (p4est_quadrant_t)
+                                    + (nremoved + 2 * nruns) *
+                                    sizeof (p4est_locidx_t));
+    memcpy (sbufs[num_peers], buf->array, nadded * sizeof (p4est_quadrant_t));
+    memcpy (sbufs[num_peers] + nadded * sizeof (p4est_quadrant_t),
+            removed.array, nremoved * sizeof (p4est_locidx_t));
+    memcpy (sbufs[num_peers] + nadded * sizeof (p4est_quadrant_t) +
+            nremoved * sizeof (p4est_locidx_t), runs.array,
+            2 * nruns * sizeof (p4est_locidx_t));
+    peers[num_peers++] = p;
+  }
+  mpo[num_procs] = (p4est_locidx_t) proc_mirrors.elem_count;
+  P4EST_ASSERT ((size_t) m.sum_all_procs <= proc_mirrors.elem_count);
+  sc_array_reset (&removed);
+  sc_array_reset (&runs);
+  for (p = 0; p < num_procs; ++p) {
+    buf = p4est_ghost_array_index (&send_bufs, p);
+    sc_array_reset (buf);
+    sc_array_reset (m.offsets_by_proc + p);
+  }
+  sc_array_reset (&send_bufs);
+  P4EST_FREE (m.offsets_by_proc);
+  sc_array_reset (&added);
+  P4EST_FREE (old_new);
+
+  /* exchange the sizes of the deltas with the peers */
+  requests = P4EST_ALLOC (MPI_Request, 2 * num_peers);
+  for (peer = 0; peer < num_peers; ++peer) {
+    mpiret = MPI_Irecv (recv_counts + 3 * peer, 3, P4EST_MPI_LOCIDX,
+                        peers[peer], P4EST_COMM_GHOST_COUNT, comm,
+                        requests + peer);
+    SC_CHECK_MPI (mpiret);
+    mpiret = MPI_Isend (send_counts + 3 * peer, 3, P4EST_MPI_LOCIDX,
+                        peers[peer], P4EST_COMM_GHOST_COUNT, comm,
+                        requests + num_peers + peer);
+    SC_CHECK_MPI (mpiret);
+  }
+  mpiret = sc_MPI_Waitall (2 * num_peers, requests, MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+
+  /* exchange the deltas */
+  for (peer = 0; peer < num_peers; ++peer) {
+    zz = recv_counts[3 * peer] * sizeof (p4est_quadrant_t) +
+      (recv_counts[3 * peer + 1] + 2 * recv_counts[3 * peer + 2]) *
+      sizeof (p4est_locidx_t);
+    rbufs[peer] = P4EST_ALLOC (char, zz);
+    mpiret = MPI_Irecv (rbufs[peer], (int) zz, MPI_BYTE, peers[peer],
+                        P4EST_COMM_GHOST_LOAD, comm, requests + peer);
+    SC_CHECK_MPI (mpiret);
+    zz = send_counts[3 * peer] * sizeof (p4est_quadrant_t) +
+      (send_counts[3 * peer + 1] + 2 * send_counts[3 * peer + 2]) *
+      sizeof (p4est_locidx_t);
+    mpiret = MPI_Isend (sbufs[peer], (int) zz, MPI_BYTE, peers[peer],
+                        P4EST_COMM_GHOST_LOAD, comm,
+                        requests + num_peers + peer);
+    SC_CHECK_MPI (mpiret);
+  }
+  mpiret = sc_MPI_Waitall (2 * num_peers, requests, MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (requests);
+
+  /* apply the deltas to the ghost quadrants of each peer */
+  sc_array_init (&ghosts, sizeof (p4est_quadrant_t));
+  for (p = 0, peer = 0; p < num_procs; ++p) {
+    lo = ghost->proc_offsets[p];
+    lend = ghost->proc_offsets[p + 1];
+    ghost->proc_offsets[p] = (p4est_locidx_t) ghosts.elem_count;
+    if (peer == num_peers || peers[peer] != p) {
+      P4EST_ASSERT (lo == lend);
+      continue;
+    }
+    nadded = recv_counts[3 * peer];
+    nremoved = recv_counts[3 * peer + 1];
+    nruns = recv_counts[3 * peer + 2];
+    aq = (p4est_quadrant_t *) rbufs[peer];
+    rdata = (p4est_locidx_t *) (aq + nadded);
+    za = zo = 0;
+    for (li = 0; li < lend - lo; ++li) {
+      if ((p4est_locidx_t) zo < nremoved && rdata[zo] == li) {
+        ++zo;
+        continue;
+      }
+      while (za + 1 < (size_t) nruns &&
+             rdata[nremoved + 2 * (za + 1)] <= li) {
+        ++za;
+      }
+      P4EST_ASSERT (za < (size_t) nruns && rdata[nremoved + 2 * za] <= li);
+      q = p4est_quadrant_array_index (&ghost->ghosts, (size_t) (lo + li));
+      while (nadded > 0 && p4est_quadrant_compare_piggy (aq, q) < 0) {
+        p4est_quadrant_array_push_copy (&ghosts, aq++);
+        --nadded;
+      }
+      qnew = p4est_quadrant_array_push_copy (&ghosts, q);
+      qnew->p.piggy3.local_num += rdata[nremoved + 2 * za + 1];
+    }
+    P4EST_ASSERT ((p4est_locidx_t) zo == nremoved);
+    for (; nadded > 0; --nadded) {
+      p4est_quadrant_array_push_copy (&ghosts, aq++);
+    }
+    P4EST_FREE (rbufs[peer]);
+    P4EST_FREE (sbufs[peer]);
+    ++peer;
+  }
+  ghost->proc_offsets[num_procs] = (p4est_locidx_t) ghosts.elem_count;
+  P4EST_VERBOSEF ("Ghost update peers %d mirrors %lld ghosts %lld\n",
+                  num_peers, (long long) num_mirrors,
+                  (long long) ghosts.elem_count);
+  P4EST_FREE (peers);
+  P4EST_FREE (sbufs);
+  P4EST_FREE (counts);
+  P4EST_FREE (old_lnum);
+
+  /* replace the contents of the ghost layer */
+  sc_array_reset (&ghost->ghosts);
+  ghost->ghosts = ghosts;
+  sc_array_reset (&ghost->mirrors);
+  ghost->mirrors = mirrors;
+  P4EST_FREE (ghost->mirror_proc_mirrors);
+  P4EST_FREE (ghost->mirror_proc_offsets);
+  ghost->mirror_proc_mirrors = P4EST_ALLOC (p4est_locidx_t,
+                                            proc_mirrors.elem_count);
+  memcpy (ghost->mirror_proc_mirrors, proc_mirrors.array,
+          proc_mirrors.elem_count * sizeof (p4est_locidx_t));
+  sc_array_reset (&proc_mirrors);
+  ghost->mirror_proc_offsets = mpo;
+  ghost->mirror_proc_fronts = ghost->mirror_proc_mirrors;
+  ghost->mirror_proc_front_offsets = ghost->mirror_proc_offsets;
+
+  /* calculate tree offsets */
+  sc_array_init (&split, sizeof (size_t));
+  sc_array_split (&ghost->ghosts, &split,
+                  (size_t) num_trees, ghost_tree_type, NULL);
+  for (nt = 0; nt <= num_trees; ++nt) {
+    ppz = (size_t *) sc_array_index (&split, (size_t) nt);
+    ghost->tree_offsets[nt] = (p4est_locidx_t) *ppz;
+  }
+  sc_array_split (&ghost->mirrors, &split,
+                  (size_t) num_trees, ghost_tree_type, NULL);
+  for (nt = 0; nt <= num_trees; ++nt) {
+    ppz = (size_t *) sc_array_index (&split, (size_t) nt);
+    ghost->mirror_tree_offsets[nt] = (p4est_locidx_t) *ppz;
+  }
+  sc_array_reset (&split);
+
+  P4EST_ASSERT (p4est_ghost_is_valid (p4est, ghost));
+
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_ghost_update\n");
+#endif /* P4EST_ENABLE_MPI */
+}
+
+void
+p4est_ghost_destroy (p4est_ghost_t * ghost)
+{
+  sc_array_reset (&ghost->ghosts);
+  P4EST_FREE (ghost->tree_offsets);
+  P4EST_FREE (ghost->proc_offsets);
+
+  if (ghost->mirror_proc_fronts != ghost->mirror_proc_mirrors) {
+    P4EST_ASSERT (ghost->mirror_proc_front_offsets !=
+                  ghost->mirror_proc_offsets);
+    P4EST_FREE (ghost->mirror_proc_fronts);
+    P4EST_FREE (ghost->mirror_proc_front_offsets);
+  }
+
+  sc_array_reset (&ghost->mirrors);
+  P4EST_FREE (ghost->mirror_tree_offsets);
+  P4EST_FREE (ghost->mirror_proc_mirrors);
+  P4EST_FREE (ghost->mirror_proc_offsets);
+
+  P4EST_FREE (ghost);
+}
+
+unsigned
+p4est_ghost_checksum (p4est_t * p4est, p4est_ghost_t * ghost)
+{
+  unsigned            crc;
+  uint32_t           *check;
+#ifdef P4_TO_P8
+  int                 level_difference;
+#endif
+  size_t              zz, csize, qcount, offset;
+  size_t              nt1, np1, local_count;
+  sc_array_t         *quadrants, *checkarray;
+  p4est_quadrant_t   *q;
+
+  quadrants = &ghost->ghosts;
+  qcount = quadrants->elem_count;
+  nt1 = (size_t) p4est->connectivity->num_trees + 1;
+  np1 = (size_t) p4est->mpisize + 1;
+
+  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
+
+  csize = sizeof (uint32_t);
+  checkarray = sc_array_new (csize);
+
+  local_count = qcount * (P4EST_DIM + 3) + nt1 + np1;
+  sc_array_resize (checkarray, local_count);
+
+  /* checksum ghost quadrants */
+  for (zz = 0; zz < qcount; ++zz) {
+    q = p4est_quadrant_array_index (quadrants, zz);
+    P4EST_ASSERT (p4est_quadrant_is_valid (q));
+    check = (uint32_t *) sc_array_index (checkarray, zz * (P4EST_DIM + 3));
+#ifndef P4_TO_P8
+    check[0] = htonl ((uint32_t) q->x);
+    check[1] = htonl ((uint32_t) q->y);
+#else
+    if (q->level <= P4EST_OLD_QMAXLEVEL) {
+      /* shift the quadrant coordinates to ensure backward compatibility */
+      level_difference = P4EST_MAXLEVEL - P4EST_OLD_MAXLEVEL;
+      /* *INDENT-OFF* */
+      check[0] =
+        htonl ((q->x < 0) ? -(((uint32_t) -q->x) >> level_difference) :
+                              (((uint32_t) q->x) >> level_difference));
+      check[1] =
+        htonl ((q->y < 0) ? -(((uint32_t) -q->y) >> level_difference) :
+                              (((uint32_t) q->y) >> level_difference));
+      check[2] =
+        htonl ((q->z < 0) ? -(((uint32_t) -q->z) >> level_difference) :
+                              (((uint32_t) q->z) >> level_difference));
+      /* *INDENT-ON* */
+    }
+    else {
+      check[0] = htonl ((uint32_t) q->x);
+      check[1] = htonl ((uint32_t) q->y);
+      check[2] = htonl ((uint32_t) q->z);
+    }
+#endif
+    check[P4EST_DIM] = htonl ((uint32_t) q->level);
+    check[P4EST_DIM + 1] = htonl ((uint32_t) q->p.piggy3.which_tree);
+    check[P4EST_DIM + 2] = htonl ((uint32_t) q->p.piggy3.local_num);
+  }
+
+  /* checksum tree_offsets */
+  offset = qcount * (P4EST_DIM + 3);
+  for (zz = 0; zz < nt1; ++zz) {
+    check = (uint32_t *) sc_array_index (checkarray, offset + zz);
+    *check = htonl ((uint32_t) ghost->tree_offsets[zz]);
   }
 
   /* checksum proc_offsets */
@@ -2499,6 +2927,9 @@ p4est_ghost_exchange_custom_end (p4est_ghost_exchange_t * exc)
   /* don't confuse it with p4est_ghost_exchange_custom_levels_end either */
   P4EST_ASSERT (!exc->is_levels);
 
+  /* nor with p4est_ghost_exchange_fields_end */
+  P4EST_ASSERT (exc->fields == NULL);
+
   /* wait for messages to complete and clean up */
   mpiret = sc_MPI_Waitall (exc->requests.elem_count, (sc_MPI_Request *)
                            exc->requests.array, sc_MPI_STATUSES_IGNORE);
@@ -2755,6 +3186,627 @@ p4est_ghost_exchange_custom_levels_end (p4est_ghost_exchange_t * exc)
   P4EST_FREE (exc);
 }
 
+/** Count the quadrants of a sequence that lie in the level range of a field.
+ * \param [in] field    Field with the level range.
+ * \param [in] quads    Array of mirror or ghost quadrants.
+ * \param [in] indices  Indices into quads, or NULL for first, first + 1, ...
+ * \param [in] first    Meaningful if indices is NULL.
+ * \param [in] count    Length of the sequence.
+ * \return              Number of matching quadrants.
+ */
+static              p4est_locidx_t
+p4est_ghost_field_count (const p4est_ghost_field_t * field,
+                         sc_array_t * quads, const p4est_locidx_t * indices,
+                         p4est_locidx_t first, p4est_locidx_t count)
+{
+  p4est_locidx_t      i, lmatches;
+  p4est_quadrant_t   *q;
+
+  if (field->data_size == 0 || field->minlevel > field->maxlevel) {
+    return 0;
+  }
+  if (field->minlevel <= 0 && field->maxlevel >= P4EST_QMAXLEVEL) {
+    return count;
+  }
+  for (lmatches = 0, i = 0; i < count; ++i) {
+    q = p4est_quadrant_array_index
+      (quads, (size_t) (indices != NULL ? indices[i] : first + i));
+    if (field->minlevel <= (int) q->level &&
+        (int) q->level <= field->maxlevel) {
+      ++lmatches;
+    }
+  }
+  return lmatches;
+}
+
+void
+p4est_ghost_exchange_fields (p4est_t * p4est, p4est_ghost_t * ghost,
+                             int num_fields,
+                             const p4est_ghost_field_t * fields)
+{
+  p4est_ghost_exchange_fields_end (p4est_ghost_exchange_fields_begin
+                                   (p4est, ghost, num_fields, fields));
+}
+
+p4est_ghost_exchange_t *
+p4est_ghost_exchange_fields_begin (p4est_t * p4est, p4est_ghost_t * ghost,
+                                   int num_fields,
+                                   const p4est_ghost_field_t * fields)
+{
+  const int           num_procs = p4est->mpisize;
+  int                 mpiret;
+  int                 q, k;
+  size_t              bytes;
+  char               *mem, **rbuf, **sbuf;
+  const p4est_ghost_field_t *f;
+  p4est_locidx_t      ng_excl, ng, theg;
+  p4est_locidx_t      mirr;
+  p4est_quadrant_t   *m;
+  p4est_ghost_exchange_t *exc;
+  p4est_inspect_t    *inspect = p4est->inspect;
+  sc_MPI_Request     *r;
+
+  P4EST_ASSERT (num_fields >= 0);
+
+  /* initialize transient storage */
+  exc = P4EST_ALLOC_ZERO (p4est_ghost_exchange_t, 1);
+  exc->is_custom = 1;
+  exc->p4est = p4est;
+  exc->ghost = ghost;
+  exc->minlevel = 0;
+  exc->maxlevel = P4EST_QMAXLEVEL;
+  exc->num_fields = num_fields;
+  exc->fields = P4EST_ALLOC (p4est_ghost_field_t, num_fields);
+  memcpy (exc->fields, fields, num_fields * sizeof (p4est_ghost_field_t));
+  sc_array_init (&exc->requests, sizeof (sc_MPI_Request));
+  sc_array_init (&exc->rrequests, sizeof (sc_MPI_Request));
+  sc_array_init (&exc->rbuffers, sizeof (char *));
+  sc_array_init (&exc->sbuffers, sizeof (char *));
+  exc->qactive = P4EST_ALLOC (int, num_procs);
+  if (inspect != NULL) {
+    inspect->ghost_fields_sends = 0;
+    inspect->ghost_fields_bytes_sent = 0;
+    inspect->ghost_fields_receives = 0;
+    inspect->ghost_fields_bytes_received = 0;
+  }
+
+  /* receive all fields from a peer in one message */
+  for (q = 0; q < num_procs; ++q) {
+    ng_excl = ghost->proc_offsets[q];
+    ng = ghost->proc_offsets[q + 1] - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    for (bytes = 0, k = 0; k < num_fields && ng > 0; ++k) {
+      f = fields + k;
+      bytes += f->data_size * p4est_ghost_field_count
+        (f, &ghost->ghosts, NULL, ng_excl, ng);
+    }
+    if (bytes > 0) {
+      P4EST_ASSERT (q != p4est->mpirank);
+      exc->qactive[exc->rrequests.elem_count] = q;
+      r = (sc_MPI_Request *) sc_array_push (&exc->rrequests);
+      rbuf = (char **) sc_array_push (&exc->rbuffers);
+      *rbuf = P4EST_ALLOC (char, bytes);
+      mpiret = sc_MPI_Irecv (*rbuf, bytes, sc_MPI_BYTE, q,
+                             P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
+      if (inspect != NULL) {
+        ++inspect->ghost_fields_receives;
+        inspect->ghost_fields_bytes_received += bytes;
+      }
+    }
+  }
+
+  /* pack all fields for a peer field by field into one message */
+  for (q = 0; q < num_procs; ++q) {
+    ng_excl = ghost->mirror_proc_offsets[q];
+    ng = ghost->mirror_proc_offsets[q + 1] - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    for (bytes = 0, k = 0; k < num_fields && ng > 0; ++k) {
+      f = fields + k;
+      bytes += f->data_size * p4est_ghost_field_count
+        (f, &ghost->mirrors, ghost->mirror_proc_mirrors + ng_excl, 0, ng);
+    }
+    if (bytes == 0) {
+      continue;
+    }
+    P4EST_ASSERT (q != p4est->mpirank);
+    sbuf = (char **) sc_array_push (&exc->sbuffers);
+    mem = *sbuf = P4EST_ALLOC (char, bytes);
+    for (k = 0; k < num_fields; ++k) {
+      f = fields + k;
+      if (f->data_size == 0) {
+        continue;
+      }
+      for (theg = 0; theg < ng; ++theg) {
+        mirr = ghost->mirror_proc_mirrors[ng_excl + theg];
+        P4EST_ASSERT (0 <= mirr && (size_t) mirr < ghost->mirrors.elem_count);
+        m = p4est_quadrant_array_index (&ghost->mirrors, mirr);
+        if (f->minlevel <= (int) m->level && (int) m->level <= f->maxlevel) {
+          memcpy (mem, f->mirror_data[mirr], f->data_size);
+          mem += f->data_size;
+        }
+      }
+    }
+    P4EST_ASSERT (mem == *sbuf + bytes);
+    r = (sc_MPI_Request *) sc_array_push (&exc->requests);
+    mpiret = sc_MPI_Isend (*sbuf, bytes, sc_MPI_BYTE, q,
+                           P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
+    SC_CHECK_MPI (mpiret);
+    if (inspect != NULL) {
+      ++inspect->ghost_fields_sends;
+      inspect->ghost_fields_bytes_sent += bytes;
+    }
+  }
+
+  /* we are done posting messages */
+  return exc;
+}
+
+void
+p4est_ghost_exchange_fields_end (p4est_ghost_exchange_t * exc)
+{
+  p4est_ghost_t      *ghost = exc->ghost;
+  int                 mpiret;
+  int                 i, k, expected, remaining, received, *peers;
+  int                 q;
+  char               *mem, **rbuf, **sbuf;
+  size_t              zz;
+  const p4est_ghost_field_t *f;
+  p4est_locidx_t      ng_excl, ng, theg;
+  p4est_quadrant_t   *g;
+
+  /* make sure that the begin function matches the end function */
+  P4EST_ASSERT (exc->is_custom);
+  P4EST_ASSERT (!exc->is_levels);
+
+  /* wait for receives and copy each field into its ghost data */
+  peers = P4EST_ALLOC (int, exc->rrequests.elem_count);
+  expected = remaining = (int) exc->rrequests.elem_count;
+  while (remaining > 0) {
+    mpiret =
+      sc_MPI_Waitsome (expected, (sc_MPI_Request *) exc->rrequests.array,
+                       &received, peers, sc_MPI_STATUSES_IGNORE);
+    SC_CHECK_MPI (mpiret);
+    P4EST_ASSERT (received != sc_MPI_UNDEFINED);
+    P4EST_ASSERT (received > 0);
+    for (i = 0; i < received; ++i) {
+      P4EST_ASSERT (0 <= peers[i] &&
+                    peers[i] < (int) exc->rrequests.elem_count);
+      q = exc->qactive[peers[i]];
+      ng_excl = ghost->proc_offsets[q];
+      ng = ghost->proc_offsets[q + 1] - ng_excl;
+      rbuf = (char **) sc_array_index_int (&exc->rbuffers, peers[i]);
+      mem = *rbuf;
+      for (k = 0; k < exc->num_fields; ++k) {
+        f = exc->fields + k;
+        if (f->data_size == 0) {
+          continue;
+        }
+        for (theg = 0; theg < ng; ++theg) {
+          g = p4est_quadrant_array_index (&ghost->ghosts, ng_excl + theg);
+          if (f->minlevel <= (int) g->level &&
+              (int) g->level <= f->maxlevel) {
+            memcpy ((char *) f->ghost_data + (ng_excl + theg) * f->data_size,
+                    mem, f->data_size);
+            mem += f->data_size;
+          }
+        }
+      }
+      P4EST_FREE (*rbuf);
+    }
+    remaining -= received;
+  }
+  P4EST_FREE (peers);
+  P4EST_FREE (exc->qactive);
+  sc_array_reset (&exc->rrequests);
+  sc_array_reset (&exc->rbuffers);
+
+  /* wait for sends and clean up */
+  mpiret = sc_MPI_Waitall (exc->requests.elem_count, (sc_MPI_Request *)
+                           exc->requests.array, sc_MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  sc_array_reset (&exc->requests);
+  for (zz = 0; zz < exc->sbuffers.elem_count; ++zz) {
+    sbuf = (char **) sc_array_index (&exc->sbuffers, zz);
+    P4EST_FREE (*sbuf);
+  }
+  sc_array_reset (&exc->sbuffers);
+
+  /* free temporary storage */
+  P4EST_FREE (exc->fields);
+  P4EST_FREE (exc);
+}
+
+/** Allocate a plan and its persistent requests, one per peer and direction. */
+static p4est_ghost_plan_t *
+p4est_ghost_plan_alloc (p4est_t * p4est, p4est_ghost_t * ghost,
+                        size_t data_size, void *ghost_data)
+{
+  const int           num_procs = p4est->mpisize;
+  int                 q;
+  p4est_ghost_plan_t *plan;
+
+  plan = P4EST_ALLOC_ZERO (p4est_ghost_plan_t, 1);
+  plan->p4est = p4est;
+  plan->ghost = ghost;
+  plan->revision = p4est_revision (p4est);
+  plan->proc_offsets = P4EST_ALLOC (p4est_locidx_t, num_procs + 1);
+  memcpy (plan->proc_offsets, ghost->proc_offsets,
+          (num_procs + 1) * sizeof (p4est_locidx_t));
+  plan->mirror_proc_offsets = P4EST_ALLOC (p4est_locidx_t, num_procs + 1);
+  memcpy (plan->mirror_proc_offsets, ghost->mirror_proc_offsets,
+          (num_procs + 1) * sizeof (p4est_locidx_t));
+  plan->data_size = data_size;
+  plan->ghost_data = ghost_data;
+
+  /* there is nothing to exchange without data */
+  if (data_size == 0) {
+    return plan;
+  }
+
+  for (q = 0; q < num_procs; ++q) {
+    if (ghost->proc_offsets[q + 1] > ghost->proc_offsets[q]) {
+      ++plan->num_requests;
+    }
+    if (ghost->mirror_proc_offsets[q + 1] > ghost->mirror_proc_offsets[q]) {
+      ++plan->num_requests;
+    }
+  }
+  plan->requests = P4EST_ALLOC (sc_MPI_Request, plan->num_requests);
+
+#ifndef P4EST_ENABLE_MPI
+  /* a serial forest has no ghosts */
+  P4EST_ASSERT (plan->num_requests == 0);
+#endif
+
+  return plan;
+}
+
+p4est_ghost_plan_t *
+p4est_ghost_plan_new (p4est_t * p4est, p4est_ghost_t * ghost,
+                      size_t data_size, void *ghost_data)
+{
+  p4est_ghost_plan_t *plan;
+#ifdef P4EST_ENABLE_MPI
+  const int           num_procs = p4est->mpisize;
+  int                 q;
+  int                 mpiret;
+  p4est_locidx_t      ng_excl, ng;
+  MPI_Request        *r;
+#endif
+
+  plan = p4est_ghost_plan_alloc (p4est, ghost, data_size, ghost_data);
+  if (plan->num_requests == 0) {
+    return plan;
+  }
+  plan->sbuffer = P4EST_ALLOC (char, data_size * (size_t)
+                               ghost->mirror_proc_offsets[p4est->mpisize]);
+
+#ifdef P4EST_ENABLE_MPI
+  /* receive directly into the ghost data */
+  r = plan->requests;
+  for (q = 0; q < num_procs; ++q) {
+    ng_excl = ghost->proc_offsets[q];
+    ng = ghost->proc_offsets[q + 1] - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+      mpiret = MPI_Recv_init ((char *) ghost_data + ng_excl * data_size,
+                              ng * data_size, MPI_BYTE, q,
+                              P4EST_COMM_GHOST_PLAN, p4est->mpicomm, r++);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+
+  /* send from the segment of each peer in the send buffer */
+  for (q = 0; q < num_procs; ++q) {
+    ng_excl = ghost->mirror_proc_offsets[q];
+    ng = ghost->mirror_proc_offsets[q + 1] - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+      mpiret = MPI_Send_init (plan->sbuffer + ng_excl * data_size,
+                              ng * data_size, MPI_BYTE, q,
+                              P4EST_COMM_GHOST_PLAN, p4est->mpicomm, r++);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+  P4EST_ASSERT (r == plan->requests + plan->num_requests);
+#endif
+
+  return plan;
+}
+
+#ifdef P4EST_ENABLE_MPI
+
+/** Create a datatype addressing the fields of a sequence of quadrants.
+ * \param [in] layout   Byte displacements are relative to its base.
+ * \param [in] qnums    Quadrant numbers, or NULL for first, first + 1, ...
+ * \param [in] first    Meaningful if qnums is NULL.
+ * \param [in] count    Number of quadrants in the sequence.
+ * \return              A committed datatype.
+ */
+static              MPI_Datatype
+p4est_ghost_layout_type (const p4est_ghost_layout_t * layout,
+                         const p4est_locidx_t * qnums,
+                         p4est_locidx_t first, p4est_locidx_t count)
+{
+  int                 mpiret;
+  int                 k, num_blocks;
+  int                *lengths;
+  p4est_locidx_t      i, qnum;
+  MPI_Aint           *displs, disp;
+  MPI_Datatype        dtype;
+
+  lengths = P4EST_ALLOC (int, count * layout->num_fields);
+  displs = P4EST_ALLOC (MPI_Aint, count * layout->num_fields);
+
+  /* blocks are quadrant-major to match the order on the other side */
+  num_blocks = 0;
+  for (i = 0; i < count; ++i) {
+    qnum = qnums != NULL ? qnums[i] : first + i;
+    for (k = 0; k < layout->num_fields; ++k) {
+      if (layout->field_sizes[k] == 0) {
+        continue;
+      }
+      disp = (MPI_Aint) (qnum * layout->stride + layout->field_offsets[k]);
+      if (num_blocks > 0 &&
+          displs[num_blocks - 1] + lengths[num_blocks - 1] == disp) {
+        /* merge contiguous fields, as in array-of-structs storage */
+        lengths[num_blocks - 1] += (int) layout->field_sizes[k];
+      }
+      else {
+        displs[num_blocks] = disp;
+        lengths[num_blocks] = (int) layout->field_sizes[k];
+        ++num_blocks;
+      }
+    }
+  }
+
+  mpiret = MPI_Type_create_hindexed (num_blocks, lengths, displs,
+                                     MPI_BYTE, &dtype);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Type_commit (&dtype);
+  SC_CHECK_MPI (mpiret);
+
+  P4EST_FREE (lengths);
+  P4EST_FREE (displs);
+  return dtype;
+}
+
+#endif /* P4EST_ENABLE_MPI */
+
+p4est_ghost_plan_t *
+p4est_ghost_plan_new_layout (p4est_t * p4est, p4est_ghost_t * ghost,
+                             const p4est_ghost_layout_t * mirror_layout,
+                             const p4est_ghost_layout_t * ghost_layout)
+{
+  int                 k;
+  size_t              data_size;
+  p4est_ghost_plan_t *plan;
+#ifdef P4EST_ENABLE_MPI
+  const int           num_procs = p4est->mpisize;
+  int                 q;
+  int                 mpiret;
+  size_t              zz;
+  p4est_locidx_t      ng_excl, ng;
+  p4est_locidx_t     *qnums;
+  p4est_quadrant_t   *mirror;
+  MPI_Request        *r;
+  MPI_Datatype       *t;
+#endif
+
+  P4EST_ASSERT (mirror_layout->num_fields == ghost_layout->num_fields);
+  data_size = 0;
+  for (k = 0; k < mirror_layout->num_fields; ++k) {
+    P4EST_ASSERT (mirror_layout->field_sizes[k] ==
+                  ghost_layout->field_sizes[k]);
+    data_size += mirror_layout->field_sizes[k];
+  }
+
+  plan = p4est_ghost_plan_alloc (p4est, ghost, data_size,
+                                 ghost_layout->base);
+  plan->is_layout = 1;
+  if (plan->num_requests == 0) {
+    return plan;
+  }
+  plan->datatypes = P4EST_ALLOC (sc_MPI_Datatype, plan->num_requests);
+
+#ifdef P4EST_ENABLE_MPI
+  /* receive directly into the ghost array */
+  r = plan->requests;
+  t = plan->datatypes;
+  for (q = 0; q < num_procs; ++q) {
+    ng_excl = ghost->proc_offsets[q];
+    ng = ghost->proc_offsets[q + 1] - ng_excl;
+    if (ng > 0) {
+      *t = p4est_ghost_layout_type (ghost_layout, NULL, ng_excl, ng);
+      mpiret = MPI_Recv_init (ghost_layout->base, 1, *t++, q,
+                              P4EST_COMM_GHOST_PLAN, p4est->mpicomm, r++);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+
+  /* send directly from the local quadrant array */
+  qnums = P4EST_ALLOC (p4est_locidx_t,
+                       ghost->mirror_proc_offsets[num_procs]);
+  for (zz = 0; zz < (size_t) ghost->mirror_proc_offsets[num_procs]; ++zz) {
+    mirror = p4est_quadrant_array_index (&ghost->mirrors, (size_t)
+                                         ghost->mirror_proc_mirrors[zz]);
+    qnums[zz] = mirror->p.piggy3.local_num;
+  }
+  for (q = 0; q < num_procs; ++q) {
+    ng_excl = ghost->mirror_proc_offsets[q];
+    ng = ghost->mirror_proc_offsets[q + 1] - ng_excl;
+    if (ng > 0) {
+      *t = p4est_ghost_layout_type (mirror_layout, qnums + ng_excl, 0, ng);
+      mpiret = MPI_Send_init (mirror_layout->base, 1, *t++, q,
+                              P4EST_COMM_GHOST_PLAN, p4est->mpicomm, r++);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+  P4EST_FREE (qnums);
+  P4EST_ASSERT (r == plan->requests + plan->num_requests);
+  P4EST_ASSERT (t == plan->datatypes + plan->num_requests);
+#endif
+
+  return plan;
+}
+
+void
+p4est_ghost_plan_destroy (p4est_ghost_plan_t * plan)
+{
+#ifdef P4EST_ENABLE_MPI
+  int                 mpiret;
+  int                 i;
+#endif
+
+  P4EST_ASSERT (!plan->is_active);
+
+#ifdef P4EST_ENABLE_MPI
+  for (i = 0; i < plan->num_requests; ++i) {
+    mpiret = MPI_Request_free (plan->requests + i);
+    SC_CHECK_MPI (mpiret);
+    if (plan->is_layout) {
+      mpiret = MPI_Type_free (plan->datatypes + i);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+#endif
+  P4EST_FREE (plan->requests);
+  P4EST_FREE (plan->datatypes);
+  P4EST_FREE (plan->sbuffer);
+  P4EST_FREE (plan->mirror_quads);
+  P4EST_FREE (plan->proc_offsets);
+  P4EST_FREE (plan->mirror_proc_offsets);
+  P4EST_FREE (plan);
+}
+
+int
+p4est_ghost_plan_is_valid (p4est_ghost_plan_t * plan)
+{
+  const size_t        bytes =
+    (plan->p4est->mpisize + 1) * sizeof (p4est_locidx_t);
+
+  /* the ghost layer may grow without a change of the forest */
+  return plan->revision == p4est_revision (plan->p4est) &&
+    !memcmp (plan->proc_offsets, plan->ghost->proc_offsets, bytes) &&
+    !memcmp (plan->mirror_proc_offsets, plan->ghost->mirror_proc_offsets,
+             bytes);
+}
+
+/** Find the local quadrant of every mirror for exchanging user data. */
+static p4est_quadrant_t **
+p4est_ghost_plan_mirror_quads (p4est_t * p4est, p4est_ghost_t * ghost)
+{
+  size_t              zz;
+  p4est_locidx_t      which_quad;
+  p4est_quadrant_t   *mirror;
+  p4est_quadrant_t  **quads;
+  p4est_tree_t       *tree;
+
+  quads = P4EST_ALLOC (p4est_quadrant_t *, ghost->mirrors.elem_count);
+  for (zz = 0; zz < ghost->mirrors.elem_count; ++zz) {
+    mirror = p4est_quadrant_array_index (&ghost->mirrors, zz);
+    P4EST_ASSERT (p4est->first_local_tree <= mirror->p.piggy3.which_tree &&
+                  mirror->p.piggy3.which_tree <= p4est->last_local_tree);
+    tree = p4est_tree_array_index (p4est->trees, mirror->p.piggy3.which_tree);
+    which_quad = mirror->p.piggy3.local_num - tree->quadrants_offset;
+    P4EST_ASSERT (0 <= which_quad &&
+                  which_quad < (p4est_locidx_t) tree->quadrants.elem_count);
+    quads[zz] = p4est_quadrant_array_index (&tree->quadrants, which_quad);
+  }
+  return quads;
+}
+
+void
+p4est_ghost_plan_begin (p4est_ghost_plan_t * plan, void **mirror_data)
+{
+  p4est_t            *p4est = plan->p4est;
+  p4est_ghost_t      *ghost = plan->ghost;
+  const size_t        data_size = plan->data_size;
+  size_t              zz, num_sends;
+  char               *mem;
+  void               *src;
+  p4est_locidx_t      mirr;
+  p4est_quadrant_t   *q;
+#ifdef P4EST_ENABLE_MPI
+  int                 mpiret;
+#endif
+
+  SC_CHECK_ABORT (p4est_ghost_plan_is_valid (plan),
+                  "Ghost plan used after the forest has changed");
+  P4EST_ASSERT (!plan->is_active);
+  plan->is_active = 1;
+
+  /* return early if there is nothing to do */
+  if (plan->num_requests == 0) {
+    return;
+  }
+
+  /* layout plans send straight from the user array */
+  if (plan->is_layout) {
+    P4EST_ASSERT (mirror_data == NULL);
+#ifdef P4EST_ENABLE_MPI
+    mpiret = MPI_Startall (plan->num_requests, plan->requests);
+    SC_CHECK_MPI (mpiret);
+#endif
+    return;
+  }
+
+  /* the quadrants do not move as long as the revision is unchanged */
+  if (mirror_data == NULL) {
+    P4EST_ASSERT (data_size == (p4est->data_size == 0 ?
+                                sizeof (void *) : p4est->data_size));
+    if (plan->mirror_quads == NULL) {
+      plan->mirror_quads = p4est_ghost_plan_mirror_quads (p4est, ghost);
+    }
+  }
+
+  /* pack the send buffer in the order of the peer segments */
+  mem = plan->sbuffer;
+  num_sends = (size_t) ghost->mirror_proc_offsets[p4est->mpisize];
+  for (zz = 0; zz < num_sends; ++zz) {
+    mirr = ghost->mirror_proc_mirrors[zz];
+    P4EST_ASSERT (0 <= mirr && (size_t) mirr < ghost->mirrors.elem_count);
+    if (mirror_data != NULL) {
+      src = mirror_data[mirr];
+    }
+    else {
+      q = plan->mirror_quads[mirr];
+      src = p4est->data_size == 0 ? &q->p.user_data : q->p.user_data;
+    }
+    memcpy (mem, src, data_size);
+    mem += data_size;
+  }
+
+#ifdef P4EST_ENABLE_MPI
+  mpiret = MPI_Startall (plan->num_requests, plan->requests);
+  SC_CHECK_MPI (mpiret);
+#endif
+}
+
+void
+p4est_ghost_plan_end (p4est_ghost_plan_t * plan)
+{
+  int                 mpiret;
+
+  P4EST_ASSERT (plan->is_active);
+  plan->is_active = 0;
+
+  /* the requests become inactive and may be started again */
+  if (plan->num_requests > 0) {
+    mpiret = sc_MPI_Waitall (plan->num_requests, plan->requests,
+                             sc_MPI_STATUSES_IGNORE);
+    SC_CHECK_MPI (mpiret);
+  }
+}
+
+void
+p4est_ghost_plan_exchange (p4est_ghost_plan_t * plan, void **mirror_data)
+{
+  p4est_ghost_plan_begin (plan, mirror_data);
+  p4est_ghost_plan_end (plan);
+}
+
 #ifdef P4EST_ENABLE_MPI
 
 static void
@@ -3518,7 +4570,7 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
     }
 
     if (buf->elem_count) {
-      sc_array_sort (buf, p4est_quadrant_compare_piggy);
+      p4est_quadrant_array_sort_piggy (buf);
       sc_array_uniq (buf, p4est_quadrant_compare_piggy_proc);
     }
     send_counts[peer] = (p4est_locidx_t) buf->elem_count;
@@ -3751,14 +4803,14 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
     for (p = 0; p < mpisize; p++) {
       buf = (sc_array_t *) sc_array_index_int (send_bufs, p);
 
-      sc_array_sort (buf, p4est_quadrant_compare_piggy);
+      p4est_quadrant_array_sort_piggy (buf);
       sc_array_uniq (buf, p4est_quadrant_compare_piggy);
     }
 
     sc_array_resize (ghost_layer, (size_t) (old_num_ghosts + num_new_ghosts));
     if (num_new_ghosts) {
       /* update the ghost layer */
-      sc_array_sort (ghost_layer, p4est_quadrant_compare_piggy);
+      p4est_quadrant_array_sort_piggy (ghost_layer);
       sc_array_uniq (ghost_layer, p4est_quadrant_compare_piggy);
 
       num_new_ghosts = ghost_layer->elem_count - old_num_ghosts;
@@ -3811,7 +4863,7 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
               buf->array, buf->elem_count * buf->elem_size);
     }
   }
-  sc_array_sort (new_mirrors, p4est_quadrant_compare_piggy);
+  p4est_quadrant_array_sort_piggy (new_mirrors);
   sc_array_uniq (new_mirrors, p4est_quadrant_compare_piggy);
   new_num_mirrors = (p4est_locidx_t) new_mirrors->elem_count;
   P4EST_ASSERT (new_num_mirrors >= old_num_mirrors);
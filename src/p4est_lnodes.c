@@ -2848,7 +2848,7 @@ p4est_ghost_support_lnodes (p4est_t * p4est, p4est_lnodes_t * lnodes,
             (send_quads, node_to_quad + qid);
         }
       }
-      sc_array_sort (send_quads, p4est_quadrant_compare_piggy);
+      p4est_quadrant_array_sort_piggy (send_quads);
       sc_array_uniq (send_quads, p4est_quadrant_compare_piggy);
 
       nquads = (p4est_locidx_t) send_quads->elem_count;
@@ -2937,7 +2937,7 @@ p4est_ghost_support_lnodes (p4est_t * p4est, p4est_lnodes_t * lnodes,
     new_mirror_proc_mirrors =
       P4EST_ALLOC (p4est_locidx_t, newmpoffset[mpisize]);
 
-    sc_array_sort (new_mirrors, p4est_quadrant_compare_piggy);
+    p4est_quadrant_array_sort_piggy (new_mirrors);
     sc_array_uniq (new_mirrors, p4est_quadrant_compare_piggy);
     new_num_mirrors = (p4est_locidx_t) new_mirrors->elem_count;
     P4EST_ASSERT (new_num_mirrors >= old_num_mirrors);
@@ -3146,7 +3146,7 @@ p4est_ghost_support_lnodes (p4est_t * p4est, p4est_lnodes_t * lnodes,
 
         sc_array_init_view (&pview, new_ghosts, startidx,
                             (size_t) (endidx - startidx));
-        sc_array_sort (&pview, p4est_quadrant_compare_piggy);
+        p4est_quadrant_array_sort_piggy (&pview);
         sc_array_reset (&pview);
       }
     }
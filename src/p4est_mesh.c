@@ -2389,3 +2389,252 @@ p4est_mesh_face_neighbor_data (p4est_mesh_face_neighbor_t * mfn,
     return (void *) ((char *) ghost_data + data_size * qtq);
   }
 }
+
+/** Visit the neighbors of a local quadrant across one face.
+ * \param [in] mesh     The mesh.
+ * \param [in] qid      Local quadrant number.
+ * \param [in] face     Face of the local quadrant.
+ * \param [out] nquads  Up to P4EST_HALF neighbors in mesh encoding.
+ * \param [out] nface   The neighbors' face number.
+ * \return              Number of neighbors.
+ */
+static int
+mesh_face_neighbors (p4est_mesh_t * mesh, p4est_locidx_t qid, int face,
+                     p4est_locidx_t * nquads, int *nface)
+{
+  int                 h;
+  int                 qtf;
+  p4est_locidx_t      qtq, *halfs;
+
+  qtq = mesh->quad_to_quad[P4EST_FACES * qid + face];
+  qtf = (int) mesh->quad_to_face[P4EST_FACES * qid + face];
+  if (qtf >= 0) {
+    /* same- or double-size neighbor */
+    nquads[0] = qtq;
+    *nface = qtf % P4EST_FACES;
+    return 1;
+  }
+
+  /* half-size neighbors */
+  halfs = (p4est_locidx_t *) sc_array_index (mesh->quad_to_half, qtq);
+  for (h = 0; h < P4EST_HALF; ++h) {
+    nquads[h] = halfs[h];
+  }
+  *nface = (qtf + P4EST_HALF * P4EST_FACES) % P4EST_FACES;
+  return P4EST_HALF;
+}
+
+p4est_ghost_faces_t *
+p4est_ghost_faces_new (p4est_t * p4est, p4est_ghost_t * ghost,
+                       p4est_mesh_t * mesh)
+{
+  const int           num_procs = p4est->mpisize;
+  const p4est_locidx_t lq = mesh->local_num_quadrants;
+  int                 q, f, nf, h, nh;
+  uint8_t             bits;
+  p4est_locidx_t      qid, ng_excl, ng_incl, theg, jl;
+  p4est_locidx_t      nquads[P4EST_HALF];
+  p4est_quadrant_t   *mirror;
+  p4est_ghost_faces_t *faces;
+
+  P4EST_ASSERT (lq == p4est->local_num_quadrants);
+  P4EST_ASSERT (mesh->ghost_num_quadrants ==
+                (p4est_locidx_t) ghost->ghosts.elem_count);
+
+  faces = P4EST_ALLOC_ZERO (p4est_ghost_faces_t, 1);
+  faces->p4est = p4est;
+  faces->ghost = ghost;
+  faces->revision = p4est_revision (p4est);
+  faces->mirror_faces = P4EST_ALLOC_ZERO (uint8_t,
+                                          ghost->mirror_proc_offsets
+                                          [num_procs]);
+  faces->ghost_faces = P4EST_ALLOC_ZERO (uint8_t, ghost->ghosts.elem_count);
+  faces->send_offsets = P4EST_ALLOC (p4est_locidx_t, num_procs + 1);
+  faces->recv_offsets = P4EST_ALLOC (p4est_locidx_t, num_procs + 1);
+  sc_array_init (&faces->requests, sizeof (sc_MPI_Request));
+
+  /* a ghost receives the faces by which a local quadrant sees it */
+  for (qid = 0; qid < lq; ++qid) {
+    for (f = 0; f < P4EST_FACES; ++f) {
+      nh = mesh_face_neighbors (mesh, qid, f, nquads, &nf);
+      for (h = 0; h < nh; ++h) {
+        if (nquads[h] >= lq) {
+          faces->ghost_faces[nquads[h] - lq] |= (uint8_t) (1 << nf);
+        }
+      }
+    }
+  }
+
+  /* a mirror sends the faces by which it sees a ghost of the peer */
+  faces->send_offsets[0] = 0;
+  for (q = 0; q < num_procs; ++q) {
+    faces->send_offsets[q + 1] = faces->send_offsets[q];
+    ng_excl = ghost->mirror_proc_offsets[q];
+    ng_incl = ghost->mirror_proc_offsets[q + 1];
+    for (theg = ng_excl; theg < ng_incl; ++theg) {
+      mirror = p4est_quadrant_array_index
+        (&ghost->mirrors, (size_t) ghost->mirror_proc_mirrors[theg]);
+      qid = mirror->p.piggy3.local_num;
+      bits = 0;
+      for (f = 0; f < P4EST_FACES; ++f) {
+        nh = mesh_face_neighbors (mesh, qid, f, nquads, &nf);
+        for (h = 0; h < nh; ++h) {
+          jl = nquads[h];
+          if (jl >= lq && mesh->ghost_to_proc[jl - lq] == q) {
+            bits |= (uint8_t) (1 << f);
+            ++faces->send_offsets[q + 1];
+            break;
+          }
+        }
+      }
+      faces->mirror_faces[theg] = bits;
+    }
+  }
+
+  /* count the faces received from each peer */
+  faces->recv_offsets[0] = 0;
+  for (q = 0; q < num_procs; ++q) {
+    faces->recv_offsets[q + 1] = faces->recv_offsets[q];
+    for (theg = ghost->proc_offsets[q]; theg < ghost->proc_offsets[q + 1];
+         ++theg) {
+      for (bits = faces->ghost_faces[theg]; bits; bits &= bits - 1) {
+        ++faces->recv_offsets[q + 1];
+      }
+    }
+  }
+
+  return faces;
+}
+
+void
+p4est_ghost_faces_destroy (p4est_ghost_faces_t * faces)
+{
+  P4EST_ASSERT (faces->requests.elem_count == 0);
+
+  sc_array_reset (&faces->requests);
+  P4EST_FREE (faces->mirror_faces);
+  P4EST_FREE (faces->ghost_faces);
+  P4EST_FREE (faces->send_offsets);
+  P4EST_FREE (faces->recv_offsets);
+  P4EST_FREE (faces);
+}
+
+void
+p4est_ghost_faces_begin (p4est_ghost_faces_t * faces, size_t face_size,
+                         p4est_ghost_faces_pack_t pack, void *ghost_face_data)
+{
+  p4est_t            *p4est = faces->p4est;
+  p4est_ghost_t      *ghost = faces->ghost;
+  const int           num_procs = p4est->mpisize;
+  int                 mpiret;
+  int                 q, f;
+  size_t              bytes;
+  char               *mem;
+  p4est_locidx_t      theg;
+  p4est_quadrant_t   *mirror;
+  sc_MPI_Request     *r;
+
+  SC_CHECK_ABORT (faces->revision == p4est_revision (p4est),
+                  "Ghost faces used after the forest has changed");
+  P4EST_ASSERT (faces->requests.elem_count == 0);
+
+  faces->face_size = face_size;
+  faces->ghost_face_data = ghost_face_data;
+  if (face_size == 0) {
+    return;
+  }
+
+  /* receive all faces from a peer in one message */
+  faces->rbuffer = P4EST_ALLOC (char, face_size *
+                                faces->recv_offsets[num_procs]);
+  for (q = 0; q < num_procs; ++q) {
+    bytes = face_size * (faces->recv_offsets[q + 1] - faces->recv_offsets[q]);
+    if (bytes > 0) {
+      P4EST_ASSERT (q != p4est->mpirank);
+      r = (sc_MPI_Request *) sc_array_push (&faces->requests);
+      mpiret = sc_MPI_Irecv (faces->rbuffer +
+                             face_size * faces->recv_offsets[q], bytes,
+                             sc_MPI_BYTE, q, P4EST_COMM_GHOST_EXCHANGE,
+                             p4est->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+
+  /* pack the flagged faces of the mirrors in order of the peers */
+  faces->sbuffer = mem = P4EST_ALLOC (char, face_size *
+                                      faces->send_offsets[num_procs]);
+  for (q = 0; q < num_procs; ++q) {
+    for (theg = ghost->mirror_proc_offsets[q];
+         theg < ghost->mirror_proc_offsets[q + 1]; ++theg) {
+      if (faces->mirror_faces[theg] == 0) {
+        continue;
+      }
+      mirror = p4est_quadrant_array_index
+        (&ghost->mirrors, (size_t) ghost->mirror_proc_mirrors[theg]);
+      for (f = 0; f < P4EST_FACES; ++f) {
+        if (faces->mirror_faces[theg] & (1 << f)) {
+          pack (p4est, mirror, f, mem);
+          mem += face_size;
+        }
+      }
+    }
+    bytes = face_size * (faces->send_offsets[q + 1] - faces->send_offsets[q]);
+    if (bytes > 0) {
+      r = (sc_MPI_Request *) sc_array_push (&faces->requests);
+      mpiret = sc_MPI_Isend (mem - bytes, bytes, sc_MPI_BYTE, q,
+                             P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+  P4EST_ASSERT (mem == faces->sbuffer +
+                face_size * faces->send_offsets[num_procs]);
+}
+
+void
+p4est_ghost_faces_end (p4est_ghost_faces_t * faces)
+{
+  const size_t        face_size = faces->face_size;
+  const size_t        ng = faces->ghost->ghosts.elem_count;
+  int                 mpiret;
+  int                 f;
+  size_t              zz;
+  char               *mem;
+
+  /* wait for all messages */
+  mpiret = sc_MPI_Waitall ((int) faces->requests.elem_count,
+                           (sc_MPI_Request *) faces->requests.array,
+                           sc_MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  sc_array_reset (&faces->requests);
+  if (face_size == 0) {
+    return;
+  }
+
+  /* the faces arrive in the order of the ghosts */
+  mem = faces->rbuffer;
+  for (zz = 0; zz < ng; ++zz) {
+    for (f = 0; f < P4EST_FACES; ++f) {
+      if (faces->ghost_faces[zz] & (1 << f)) {
+        memcpy ((char *) faces->ghost_face_data +
+                (P4EST_FACES * zz + f) * face_size, mem, face_size);
+        mem += face_size;
+      }
+    }
+  }
+  P4EST_ASSERT (mem == faces->rbuffer + face_size *
+                faces->recv_offsets[faces->p4est->mpisize]);
+
+  P4EST_FREE (faces->rbuffer);
+  P4EST_FREE (faces->sbuffer);
+  faces->rbuffer = faces->sbuffer = NULL;
+  faces->ghost_face_data = NULL;
+}
+
+void
+p4est_ghost_faces_exchange (p4est_ghost_faces_t * faces, size_t face_size,
+                            p4est_ghost_faces_pack_t pack,
+                            void *ghost_face_data)
+{
+  p4est_ghost_faces_begin (faces, face_size, pack, ghost_face_data);
+  p4est_ghost_faces_end (faces);
+}
@@ -719,7 +719,7 @@ p4est_nodes_new (p4est_t * p4est, p4est_ghost_t * ghost)
     in->pad16 = (int16_t) (-1);
     in->p.piggy3.local_num = il;
   }
-  sc_array_sort (inda, p4est_quadrant_compare_piggy);
+  p4est_quadrant_array_sort_piggy (inda);
   for (il = 0; il < num_indep_nodes; ++il) {
     in = (p4est_indep_t *) sc_array_index (inda, (size_t) il);
     new_node_number[in->p.piggy3.local_num] = il;
@@ -193,6 +193,94 @@ p4est_find_higher_bound (sc_array_t * array,
   return (ssize_t) guess;
 }
 
+/** Return the first position at or after \a start whose quadrant is
+ * not less than \a q, or greater than \a q if \a strict is true.
+ * Return the array count if there is no such position.
+ * We gallop with doubling steps and then bisect the bracketed range. */
+static size_t
+p4est_find_bound_gallop (sc_array_t * array, const p4est_quadrant_t * q,
+                         size_t start, int strict)
+{
+  int                 comp;
+  size_t              count = array->elem_count;
+  size_t              low, high, guess, step;
+
+  low = start;
+  step = 1;
+  for (;;) {
+    if (count - low <= step) {
+      high = count;
+      break;
+    }
+    guess = low + step - 1;
+    comp = p4est_quadrant_compare (p4est_quadrant_array_index (array, guess),
+                                   q);
+    if (strict ? comp > 0 : comp >= 0) {
+      high = guess;
+      break;
+    }
+    low = guess + 1;
+    step *= 2;
+  }
+
+  while (low < high) {
+    guess = low + (high - low) / 2;
+    comp = p4est_quadrant_compare (p4est_quadrant_array_index (array, guess),
+                                   q);
+    if (strict ? comp > 0 : comp >= 0) {
+      high = guess;
+    }
+    else {
+      low = guess + 1;
+    }
+  }
+  return low;
+}
+
+static void
+p4est_find_bounds (sc_array_t * array, sc_array_t * queries,
+                   sc_array_t * results, int higher)
+{
+  size_t              iz, pos;
+  ssize_t            *res;
+  const p4est_quadrant_t *q;
+
+  P4EST_ASSERT (array->elem_size == sizeof (p4est_quadrant_t));
+  P4EST_ASSERT (queries->elem_size == sizeof (p4est_quadrant_t));
+  P4EST_ASSERT (results->elem_size == sizeof (ssize_t));
+  P4EST_ASSERT (sc_array_is_sorted (queries, p4est_quadrant_compare));
+
+  sc_array_resize (results, queries->elem_count);
+  pos = 0;
+  for (iz = 0; iz < queries->elem_count; ++iz) {
+    q = p4est_quadrant_array_index (queries, iz);
+    res = (ssize_t *) sc_array_index (results, iz);
+
+    /* the bounds of sorted queries never decrease */
+    pos = p4est_find_bound_gallop (array, q, pos, higher);
+    if (higher) {
+      *res = (ssize_t) pos - 1;
+    }
+    else {
+      *res = pos < array->elem_count ? (ssize_t) pos : -1;
+    }
+  }
+}
+
+void
+p4est_find_lower_bounds (sc_array_t * array, sc_array_t * queries,
+                         sc_array_t * results)
+{
+  p4est_find_bounds (array, queries, results, 0);
+}
+
+void
+p4est_find_higher_bounds (sc_array_t * array, sc_array_t * queries,
+                          sc_array_t * results)
+{
+  p4est_find_bounds (array, queries, results, 1);
+}
+
 p4est_quadrant_t   *
 p4est_find_quadrant_cumulative (p4est_t * p4est, p4est_locidx_t cumulative_id,
                                 p4est_topidx_t * which_tree,
@@ -90,6 +90,9 @@
 #define P4EST_CONNECT_CORNER            P8EST_CONNECT_CORNER
 #define P4EST_CONNECT_FULL              P8EST_CONNECT_FULL
 #define P4EST_CONN_ENCODE_NONE          P8EST_CONN_ENCODE_NONE
+#define P4EST_CONN_ORDER_MORTON         P8EST_CONN_ORDER_MORTON
+#define P4EST_CONN_ORDER_HILBERT        P8EST_CONN_ORDER_HILBERT
+#define P4EST_CONN_ORDER_RCM            P8EST_CONN_ORDER_RCM
 #define P4EST_TRANSFER_COMM_SRC         P8EST_TRANSFER_COMM_SRC
 #define P4EST_TRANSFER_COMM_DEST        P8EST_TRANSFER_COMM_DEST
 #define P4EST_TRANSFER_COMM_SRC_DUP     P8EST_TRANSFER_COMM_SRC_DUP
@@ -98,6 +101,9 @@
 #define P4EST_WRAP_NONE                 P8EST_WRAP_NONE
 #define P4EST_WRAP_REFINE               P8EST_WRAP_REFINE
 #define P4EST_WRAP_COARSEN              P8EST_WRAP_COARSEN
+#define P4EST_TRANSITION_KEEP           P8EST_TRANSITION_KEEP
+#define P4EST_TRANSITION_REFINE         P8EST_TRANSITION_REFINE
+#define P4EST_TRANSITION_COARSEN        P8EST_TRANSITION_COARSEN
 
 #ifdef P4EST_ENABLE_FILE_DEPRECATED
 
@@ -131,6 +137,7 @@
 #endif
 #define p4est_connect_type_t            p8est_connect_type_t
 #define p4est_connectivity_encode_t     p8est_connectivity_encode_t
+#define p4est_connectivity_order_t      p8est_connectivity_order_t
 #define p4est_connectivity_t            p8est_connectivity_t
 #define p4est_corner_transform_t        p8est_corner_transform_t
 #define p4est_corner_info_t             p8est_corner_info_t
@@ -148,6 +155,9 @@
 #define p4est_weight_t                  p8est_weight_t
 #define p4est_ghost_t                   p8est_ghost_t
 #define p4est_ghost_exchange_t          p8est_ghost_exchange_t
+#define p4est_ghost_field_t             p8est_ghost_field_t
+#define p4est_ghost_plan_t              p8est_ghost_plan_t
+#define p4est_ghost_layout_t            p8est_ghost_layout_t
 #define p4est_indep_t                   p8est_indep_t
 #define p4est_nodes_t                   p8est_nodes_t
 #define p4est_lid_t                     p8est_lid_t
@@ -175,11 +185,22 @@
 #define p4est_build_t                   p8est_build_t
 #define p4est_transfer_comm_t           p8est_transfer_comm_t
 #define p4est_transfer_context_t        p8est_transfer_context_t
+#define p4est_partition_given_t         p8est_partition_given_t
+#define p4est_partition_context_t       p8est_partition_context_t
 #define p4est_mesh_t                    p8est_mesh_t
 #define p4est_mesh_face_neighbor_t      p8est_mesh_face_neighbor_t
+#define p4est_ghost_faces_t             p8est_ghost_faces_t
+#define p4est_ghost_faces_pack_t        p8est_ghost_faces_pack_t
 #define p4est_wrap_t                    p8est_wrap_t
 #define p4est_wrap_leaf_t               p8est_wrap_leaf_t
 #define p4est_wrap_flags_t              p8est_wrap_flags_t
+#define p4est_transition_type_t         p8est_transition_type_t
+#define p4est_transition_range_t        p8est_transition_range_t
+#define p4est_transition_t              p8est_transition_t
+#define p4est_transition_refine_t       p8est_transition_refine_t
+#define p4est_transition_coarsen_t      p8est_transition_coarsen_t
+#define p4est_cost_class_t              p8est_cost_class_t
+#define p4est_cost_t                    p8est_cost_t
 #define p4est_wrap_params_t             p8est_wrap_params_t
 #define p4est_vtk_context_t             p8est_vtk_context_t
 #define p4est_file_context_t            p8est_file_context_t
@@ -211,6 +232,7 @@
 #define p4est_connectivity_new_copy     p8est_connectivity_new_copy
 #define p4est_connectivity_bcast        p8est_connectivity_bcast
 #define p4est_connectivity_destroy      p8est_connectivity_destroy
+#define p4est_connectivity_share        p8est_connectivity_share
 #define p4est_connectivity_set_attr     p8est_connectivity_set_attr
 #define p4est_connectivity_is_valid     p8est_connectivity_is_valid
 #define p4est_connectivity_is_equal     p8est_connectivity_is_equal
@@ -220,7 +242,11 @@
 #define p4est_connectivity_source       p8est_connectivity_source
 #define p4est_connectivity_inflate      p8est_connectivity_inflate
 #define p4est_connectivity_load         p8est_connectivity_load
+#define p4est_connectivity_load_local   p8est_connectivity_load_local
+#define p4est_connectivity_extract      p8est_connectivity_extract
 #define p4est_connectivity_complete     p8est_connectivity_complete
+#define p4est_connectivity_complete_parallel            \
+        p8est_connectivity_complete_parallel
 #define p4est_connectivity_reduce       p8est_connectivity_reduce
 #define p4est_expand_face_transform     p8est_expand_face_transform
 #define p4est_find_face_transform       p8est_find_face_transform
@@ -238,6 +264,7 @@
 #define p4est_connectivity_reorder_newid                \
         p8est_connectivity_reorder_newid
 #define p4est_connectivity_permute      p8est_connectivity_permute
+#define p4est_connectivity_sort_trees   p8est_connectivity_sort_trees
 #define p4est_connectivity_join_faces   p8est_connectivity_join_faces
 #define p4est_connectivity_is_equivalent p8est_connectivity_is_equivalent
 #define p4est_connectivity_read_inp_stream p8est_connectivity_read_inp_stream
@@ -270,6 +297,7 @@
 
 /* functions in p4est_extended */
 #define p4est_replace_t                 p8est_replace_t
+#define p4est_multi_weight_t            p8est_multi_weight_t
 #define p4est_lid_compare               p8est_lid_compare
 #define p4est_lid_is_equal              p8est_lid_is_equal
 #define p4est_lid_init                  p8est_lid_init
@@ -299,9 +327,20 @@
 #define p4est_copy_ext                  p8est_copy_ext
 #define p4est_refine_ext                p8est_refine_ext
 #define p4est_coarsen_ext               p8est_coarsen_ext
+#define p4est_refine_flags              p8est_refine_flags
+#define p4est_coarsen_flags             p8est_coarsen_flags
+#define p4est_adapt_flags               p8est_adapt_flags
 #define p4est_balance_ext               p8est_balance_ext
+#define p4est_balance_changed           p8est_balance_changed
+#define p4est_adapt                     p8est_adapt
 #define p4est_balance_subtree_ext       p8est_balance_subtree_ext
 #define p4est_partition_ext             p8est_partition_ext
+#define p4est_partition_multi           p8est_partition_multi
+#define p4est_partition_plan            p8est_partition_plan
+#define p4est_partition_node            p8est_partition_node
+#define p4est_partition_begin           p8est_partition_begin
+#define p4est_partition_transfer_fixed  p8est_partition_transfer_fixed
+#define p4est_partition_end             p8est_partition_end
 #define p4est_partition_for_coarsening  p8est_partition_for_coarsening
 #define p4est_save_ext                  p8est_save_ext
 #define p4est_load_ext                  p8est_load_ext
@@ -325,6 +364,22 @@
 /* functions in p4est_points */
 #define p4est_new_points                p8est_new_points
 
+/* functions in p4est_transition */
+#define p4est_transition_new            p8est_transition_new
+#define p4est_transition_complete       p8est_transition_complete
+#define p4est_transition_destroy        p8est_transition_destroy
+#define p4est_transition_project        p8est_transition_project
+
+/* functions in p4est_cost */
+#define p4est_cost_new                  p8est_cost_new
+#define p4est_cost_destroy              p8est_cost_destroy
+#define p4est_cost_reset                p8est_cost_reset
+#define p4est_cost_add                  p8est_cost_add
+#define p4est_cost_fit                  p8est_cost_fit
+#define p4est_cost_predict              p8est_cost_predict
+#define p4est_cost_imbalance            p8est_cost_imbalance
+#define p4est_partition_auto            p8est_partition_auto
+
 /* functions in p4est_bits */
 #define p4est_quadrant_pad              p8est_quadrant_pad
 #define p4est_quadrant_print            p8est_quadrant_print
@@ -335,6 +390,8 @@
 #define p4est_coordinates_compare       p8est_coordinates_compare
 #define p4est_quadrant_disjoint         p8est_quadrant_disjoint
 #define p4est_quadrant_compare_piggy    p8est_quadrant_compare_piggy
+#define p4est_quadrant_array_sort       p8est_quadrant_array_sort
+#define p4est_quadrant_array_sort_piggy p8est_quadrant_array_sort_piggy
 #define p4est_quadrant_compare_local_num p8est_quadrant_compare_local_num
 #define p4est_quadrant_equal_fn         p8est_quadrant_equal_fn
 #define p4est_quadrant_hash_fn          p8est_quadrant_hash_fn
@@ -425,6 +482,8 @@
 #define p4est_find_partition            p8est_find_partition
 #define p4est_find_lower_bound          p8est_find_lower_bound
 #define p4est_find_higher_bound         p8est_find_higher_bound
+#define p4est_find_lower_bounds         p8est_find_lower_bounds
+#define p4est_find_higher_bounds        p8est_find_higher_bounds
 #define p4est_find_quadrant_cumulative  p8est_find_quadrant_cumulative
 #define p4est_split_array               p8est_split_array
 #define p4est_find_range_boundaries     p8est_find_range_boundaries
@@ -461,11 +520,15 @@
 #define p4est_complete_subtree          p8est_complete_subtree
 #define p4est_balance_subtree           p8est_balance_subtree
 #define p4est_balance_border            p8est_balance_border
+#define p4est_balance_trees             p8est_balance_trees
 #define p4est_linearize_tree            p8est_linearize_tree
 #define p4est_next_nonempty_process     p8est_next_nonempty_process
 #define p4est_partition_correction      p8est_partition_correction
 #define p4est_partition_for_coarsening  p8est_partition_for_coarsening
 #define p4est_partition_given           p8est_partition_given
+#define p4est_partition_given_begin     p8est_partition_given_begin
+#define p4est_partition_given_end       p8est_partition_given_end
+#define p4est_partition_weights         p8est_partition_weights
 #define p4est_quadrant_on_face_boundary p8est_quadrant_on_face_boundary
 
 /* functions in p4est_communication */
@@ -475,6 +538,11 @@
 #define p4est_comm_parallel_env_replace p8est_comm_parallel_env_replace
 #define p4est_comm_parallel_env_get_info p8est_comm_parallel_env_get_info
 #define p4est_comm_parallel_env_is_null p8est_comm_parallel_env_is_null
+#define p4est_comm_node_first           p8est_comm_node_first
+#define p4est_comm_is_intranode         p8est_comm_is_intranode
+#define p4est_comm_intranode_ranks      p8est_comm_intranode_ranks
+#define p4est_comm_share                p8est_comm_share
+#define p4est_comm_unshare              p8est_comm_unshare
 #define p4est_comm_parallel_env_reduce  p8est_comm_parallel_env_reduce
 #define p4est_comm_parallel_env_reduce_ext p8est_comm_parallel_env_reduce_ext
 #define p4est_comm_count_quadrants      p8est_comm_count_quadrants
@@ -533,6 +601,7 @@
         p8est_geometry_transform_coordinates
 #define p4est_geometry_destroy          p8est_geometry_destroy
 #define p4est_geometry_new_connectivity p8est_geometry_new_connectivity
+#define p4est_geometry_new_local        p8est_geometry_new_local
 #define p4est_geometry_connectivity_X   p8est_geometry_connectivity_X
 #define p4est_geometry_coordinates_lnodes p8est_geometry_coordinates_lnodes
 
@@ -558,6 +627,7 @@
 #define p4est_ghost_new                 p8est_ghost_new
 #define p4est_ghost_new_local           p8est_ghost_new_local
 #define p4est_ghost_destroy             p8est_ghost_destroy
+#define p4est_ghost_update              p8est_ghost_update
 #define p4est_ghost_exchange_data       p8est_ghost_exchange_data
 #define p4est_ghost_exchange_data_begin p8est_ghost_exchange_data_begin
 #define p4est_ghost_exchange_data_end   p8est_ghost_exchange_data_end
@@ -569,6 +639,16 @@
         p8est_ghost_exchange_custom_levels_begin
 #define p4est_ghost_exchange_custom_levels_end  \
         p8est_ghost_exchange_custom_levels_end
+#define p4est_ghost_exchange_fields     p8est_ghost_exchange_fields
+#define p4est_ghost_exchange_fields_begin p8est_ghost_exchange_fields_begin
+#define p4est_ghost_exchange_fields_end p8est_ghost_exchange_fields_end
+#define p4est_ghost_plan_new            p8est_ghost_plan_new
+#define p4est_ghost_plan_new_layout     p8est_ghost_plan_new_layout
+#define p4est_ghost_plan_destroy        p8est_ghost_plan_destroy
+#define p4est_ghost_plan_is_valid       p8est_ghost_plan_is_valid
+#define p4est_ghost_plan_begin          p8est_ghost_plan_begin
+#define p4est_ghost_plan_end            p8est_ghost_plan_end
+#define p4est_ghost_plan_exchange       p8est_ghost_plan_exchange
 #define p4est_ghost_bsearch             p8est_ghost_bsearch
 #define p4est_ghost_contains            p8est_ghost_contains
 #define p4est_ghost_is_valid            p8est_ghost_is_valid
@@ -614,6 +694,11 @@
 #define p4est_mesh_face_neighbor_init2  p8est_mesh_face_neighbor_init2
 #define p4est_mesh_face_neighbor_next   p8est_mesh_face_neighbor_next
 #define p4est_mesh_face_neighbor_data   p8est_mesh_face_neighbor_data
+#define p4est_ghost_faces_new           p8est_ghost_faces_new
+#define p4est_ghost_faces_destroy       p8est_ghost_faces_destroy
+#define p4est_ghost_faces_begin         p8est_ghost_faces_begin
+#define p4est_ghost_faces_end           p8est_ghost_faces_end
+#define p4est_ghost_faces_exchange      p8est_ghost_faces_exchange
 
 /* functions in p4est_balance */
 #define p4est_balance_seeds_face        p8est_balance_seeds_face
@@ -0,0 +1,397 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+
+#ifndef P4_TO_P8
+#include <p4est_bits.h>
+#include <p4est_transition.h>
+#else
+#include <p8est_bits.h>
+#include <p8est_transition.h>
+#endif
+
+/** Maximum number of quadrants held in the projection scratch space. */
+#define P4EST_TRANSITION_SCRATCH (P4EST_CHILDREN * (P4EST_QMAXLEVEL + 1) + 1)
+
+p4est_transition_t *
+p4est_transition_new (p4est_t * p4est)
+{
+  size_t              zz;
+  int8_t             *levels;
+  p4est_locidx_t      il;
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q, *s;
+  p4est_transition_t *transition;
+
+  transition = P4EST_ALLOC_ZERO (p4est_transition_t, 1);
+  transition->num_old = p4est->local_num_quadrants;
+  transition->num_new = -1;
+  transition->first_local_tree = p4est->first_local_tree;
+  transition->last_local_tree = p4est->last_local_tree;
+  transition->old_levels = sc_array_new_size (sizeof (int8_t),
+                                              (size_t) transition->num_old);
+  transition->snapshot = sc_array_new_size (sizeof (p4est_quadrant_t),
+                                            (size_t) transition->num_old);
+
+  /* copy the local quadrants with their tree number */
+  il = 0;
+  levels = (int8_t *) transition->old_levels->array;
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz, ++il) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      s = p4est_quadrant_array_index (transition->snapshot, (size_t) il);
+      *s = *q;
+      s->p.which_tree = jt;
+      levels[il] = q->level;
+    }
+  }
+  P4EST_ASSERT (il == transition->num_old);
+
+  return transition;
+}
+
+/** Append a range to the map, merging it with the previous one if both
+ * keep quadrants, or both refine or coarsen by exactly one level.
+ */
+static void
+p4est_transition_push (sc_array_t * ranges, p4est_transition_type_t type,
+                       p4est_locidx_t old_index, p4est_locidx_t new_index,
+                       p4est_locidx_t num_old, p4est_locidx_t num_new)
+{
+  p4est_transition_range_t *r;
+
+  if (ranges->elem_count > 0 &&
+      (type == P4EST_TRANSITION_KEEP ||
+       (type == P4EST_TRANSITION_REFINE && num_new == P4EST_CHILDREN) ||
+       (type == P4EST_TRANSITION_COARSEN && num_old == P4EST_CHILDREN))) {
+    r = (p4est_transition_range_t *) sc_array_index (ranges,
+                                                     ranges->elem_count - 1);
+    if (r->type == type &&
+        (type == P4EST_TRANSITION_KEEP ||
+         (type == P4EST_TRANSITION_REFINE &&
+          r->num_new == P4EST_CHILDREN * r->num_old) ||
+         (type == P4EST_TRANSITION_COARSEN &&
+          r->num_old == P4EST_CHILDREN * r->num_new))) {
+      P4EST_ASSERT (r->old_index + r->num_old == old_index);
+      P4EST_ASSERT (r->new_index + r->num_new == new_index);
+      r->num_old += num_old;
+      r->num_new += num_new;
+      return;
+    }
+  }
+
+  r = (p4est_transition_range_t *) sc_array_push (ranges);
+  r->type = type;
+  r->old_index = old_index;
+  r->new_index = new_index;
+  r->num_old = num_old;
+  r->num_new = num_new;
+}
+
+void
+p4est_transition_complete (p4est_transition_t * transition, p4est_t * p4est)
+{
+  size_t              zz, incount;
+  int8_t             *levels;
+  p4est_locidx_t      io, in, m;
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *o, *n;
+  p4est_transition_type_t type;
+  sc_array_t         *snapshot = transition->snapshot;
+
+  P4EST_ASSERT (snapshot != NULL);
+  SC_CHECK_ABORT (transition->first_local_tree == p4est->first_local_tree &&
+                  transition->last_local_tree == p4est->last_local_tree,
+                  "Transition across a change of partition");
+
+  transition->num_new = p4est->local_num_quadrants;
+  transition->new_levels = sc_array_new_size (sizeof (int8_t),
+                                              (size_t) transition->num_new);
+  transition->ranges = sc_array_new (sizeof (p4est_transition_range_t));
+  levels = (int8_t *) transition->new_levels->array;
+
+  /* merge the old and new quadrants of each tree in order */
+  io = in = 0;
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    incount = tree->quadrants.elem_count;
+    for (zz = 0; zz < incount;) {
+      SC_CHECK_ABORT (io < transition->num_old,
+                      "Transition across a change of partition");
+      o = p4est_quadrant_array_index (snapshot, (size_t) io);
+      n = p4est_quadrant_array_index (&tree->quadrants, zz);
+      SC_CHECK_ABORT (o->p.which_tree == jt,
+                      "Transition across a change of partition");
+      if (p4est_quadrant_is_equal (o, n)) {
+        type = P4EST_TRANSITION_KEEP;
+        levels[in] = n->level;
+        m = 1;
+        p4est_transition_push (transition->ranges, type, io, in, 1, 1);
+        ++io;
+      }
+      else if (p4est_quadrant_is_ancestor (o, n)) {
+        /* the old quadrant has been refined into descendants */
+        type = P4EST_TRANSITION_REFINE;
+        for (m = 0; zz + m < incount; ++m) {
+          n = p4est_quadrant_array_index (&tree->quadrants, zz + m);
+          if (!p4est_quadrant_is_ancestor (o, n)) {
+            break;
+          }
+          levels[in + m] = n->level;
+        }
+        p4est_transition_push (transition->ranges, type, io, in, 1, m);
+        ++io;
+      }
+      else {
+        /* the old quadrants have been coarsened into an ancestor */
+        SC_CHECK_ABORT (p4est_quadrant_is_ancestor (n, o),
+                        "Transition across a change of partition");
+        type = P4EST_TRANSITION_COARSEN;
+        levels[in] = n->level;
+        for (m = 0; io + m < transition->num_old; ++m) {
+          o = p4est_quadrant_array_index (snapshot, (size_t) (io + m));
+          if (o->p.which_tree != jt || !p4est_quadrant_is_ancestor (n, o)) {
+            break;
+          }
+        }
+        p4est_transition_push (transition->ranges, type, io, in, m, 1);
+        io += m;
+        m = 1;
+      }
+      zz += (size_t) m;
+      in += m;
+    }
+  }
+  SC_CHECK_ABORT (io == transition->num_old && in == transition->num_new,
+                  "Transition across a change of partition");
+
+  P4EST_VERBOSEF ("Transition from %lld to %lld quadrants in %llu ranges\n",
+                  (long long) transition->num_old,
+                  (long long) transition->num_new,
+                  (unsigned long long) transition->ranges->elem_count);
+
+  sc_array_destroy (snapshot);
+  transition->snapshot = NULL;
+}
+
+void
+p4est_transition_destroy (p4est_transition_t * transition)
+{
+  if (transition->snapshot != NULL) {
+    sc_array_destroy (transition->snapshot);
+  }
+  if (transition->ranges != NULL) {
+    sc_array_destroy (transition->ranges);
+  }
+  if (transition->new_levels != NULL) {
+    sc_array_destroy (transition->new_levels);
+  }
+  sc_array_destroy (transition->old_levels);
+  P4EST_FREE (transition);
+}
+
+static void
+p4est_transition_refine_batch (p4est_transition_refine_t refine_fn,
+                               size_t num_parents, size_t data_size,
+                               const char *parents, char *children,
+                               void *user)
+{
+  size_t              zz;
+  int                 k;
+
+  if (refine_fn != NULL) {
+    refine_fn (num_parents, data_size, parents, children, user);
+    return;
+  }
+  for (zz = 0; zz < num_parents; ++zz) {
+    for (k = 0; k < P4EST_CHILDREN; ++k) {
+      memcpy (children + (P4EST_CHILDREN * zz + k) * data_size,
+              parents + zz * data_size, data_size);
+    }
+  }
+}
+
+static void
+p4est_transition_coarsen_batch (p4est_transition_coarsen_t coarsen_fn,
+                                size_t num_parents, size_t data_size,
+                                const char *children, char *parents,
+                                void *user)
+{
+  size_t              zz;
+
+  if (coarsen_fn != NULL) {
+    coarsen_fn (num_parents, data_size, children, parents, user);
+    return;
+  }
+  for (zz = 0; zz < num_parents; ++zz) {
+    memcpy (parents + zz * data_size,
+            children + P4EST_CHILDREN * zz * data_size, data_size);
+  }
+}
+
+/** Refine one quadrant into descendants of several levels.
+ * \param [in] levels   Levels of all the descendants.
+ * \param [in,out] pos  Index of the next descendant to be written.
+ * \param [out] out     Data of all the descendants.
+ * \param [in] scratch  Space for P4EST_CHILDREN quadrants per level.
+ */
+static void
+p4est_transition_refine_multi (p4est_transition_refine_t refine_fn,
+                               size_t data_size, const char *parent,
+                               int level, const int8_t * levels,
+                               p4est_locidx_t * pos, char *out,
+                               char *scratch, void *user)
+{
+  int                 k;
+  char               *child;
+
+  p4est_transition_refine_batch (refine_fn, 1, data_size, parent, scratch,
+                                 user);
+  for (k = 0; k < P4EST_CHILDREN; ++k) {
+    child = scratch + k * data_size;
+    if ((int) levels[*pos] == level + 1) {
+      memcpy (out + *pos * data_size, child, data_size);
+      ++*pos;
+    }
+    else {
+      P4EST_ASSERT ((int) levels[*pos] > level + 1);
+      p4est_transition_refine_multi (refine_fn, data_size, child, level + 1,
+                                     levels, pos, out,
+                                     scratch + P4EST_CHILDREN * data_size,
+                                     user);
+    }
+  }
+}
+
+/** Coarsen the descendants of several levels into one quadrant.
+ * Complete families are reduced as soon as they appear on a stack.
+ * \param [in] levels   Levels of all the descendants.
+ * \param [in] scratch  Space for P4EST_TRANSITION_SCRATCH quadrants.
+ */
+static void
+p4est_transition_coarsen_multi (p4est_transition_coarsen_t coarsen_fn,
+                                size_t data_size, const char *children,
+                                const int8_t * levels, p4est_locidx_t count,
+                                int level, char *parent, char *scratch,
+                                void *user)
+{
+  int                 k, top;
+  int8_t              stack_levels[P4EST_TRANSITION_SCRATCH];
+  char               *tmp;
+  p4est_locidx_t      il;
+
+  tmp = scratch + (P4EST_TRANSITION_SCRATCH - 1) * data_size;
+  top = 0;
+  for (il = 0; il < count; ++il) {
+    P4EST_ASSERT (top < P4EST_TRANSITION_SCRATCH - 1);
+    memcpy (scratch + top * data_size, children + il * data_size, data_size);
+    stack_levels[top++] = levels[il];
+    while (top >= P4EST_CHILDREN && stack_levels[top - 1] > level) {
+      for (k = 2; k <= P4EST_CHILDREN; ++k) {
+        if (stack_levels[top - k] != stack_levels[top - 1]) {
+          break;
+        }
+      }
+      if (k <= P4EST_CHILDREN) {
+        break;
+      }
+      top -= P4EST_CHILDREN;
+      p4est_transition_coarsen_batch (coarsen_fn, 1, data_size,
+                                      scratch + top * data_size, tmp, user);
+      memcpy (scratch + top * data_size, tmp, data_size);
+      --stack_levels[top];
+      ++top;
+    }
+  }
+  P4EST_ASSERT (top == 1 && (int) stack_levels[0] == level);
+  memcpy (parent, scratch, data_size);
+}
+
+void
+p4est_transition_project (p4est_transition_t * transition, size_t data_size,
+                          const void *old_data, void *new_data,
+                          p4est_transition_refine_t refine_fn,
+                          p4est_transition_coarsen_t coarsen_fn, void *user)
+{
+  size_t              zz;
+  const int8_t       *old_levels, *new_levels;
+  const char         *src;
+  char               *dst, *scratch;
+  p4est_locidx_t      pos;
+  p4est_transition_range_t *r;
+
+  P4EST_ASSERT (transition->ranges != NULL);
+  if (data_size == 0) {
+    return;
+  }
+
+  old_levels = (const int8_t *) transition->old_levels->array;
+  new_levels = (const int8_t *) transition->new_levels->array;
+  scratch = NULL;
+  for (zz = 0; zz < transition->ranges->elem_count; ++zz) {
+    r = (p4est_transition_range_t *) sc_array_index (transition->ranges, zz);
+    src = (const char *) old_data + r->old_index * data_size;
+    dst = (char *) new_data + r->new_index * data_size;
+    switch (r->type) {
+    case P4EST_TRANSITION_KEEP:
+      memcpy (dst, src, r->num_old * data_size);
+      break;
+    case P4EST_TRANSITION_REFINE:
+      if (r->num_new == P4EST_CHILDREN * r->num_old) {
+        p4est_transition_refine_batch (refine_fn, (size_t) r->num_old,
+                                       data_size, src, dst, user);
+        break;
+      }
+      if (scratch == NULL) {
+        scratch = P4EST_ALLOC (char, P4EST_TRANSITION_SCRATCH * data_size);
+      }
+      pos = 0;
+      p4est_transition_refine_multi (refine_fn, data_size, src,
+                                     (int) old_levels[r->old_index],
+                                     new_levels + r->new_index, &pos, dst,
+                                     scratch, user);
+      P4EST_ASSERT (pos == r->num_new);
+      break;
+    case P4EST_TRANSITION_COARSEN:
+      if (r->num_old == P4EST_CHILDREN * r->num_new) {
+        p4est_transition_coarsen_batch (coarsen_fn, (size_t) r->num_new,
+                                        data_size, src, dst, user);
+        break;
+      }
+      if (scratch == NULL) {
+        scratch = P4EST_ALLOC (char, P4EST_TRANSITION_SCRATCH * data_size);
+      }
+      p4est_transition_coarsen_multi (coarsen_fn, data_size, src,
+                                      old_levels + r->old_index, r->num_old,
+                                      (int) new_levels[r->new_index], dst,
+                                      scratch, user);
+      break;
+    default:
+      SC_ABORT_NOT_REACHED ();
+    }
+  }
+  P4EST_FREE (scratch);
+}
@@ -179,6 +179,9 @@ typedef struct p8est
   sc_mempool_t       *quadrant_pool;  /**< memory allocator for temporary
                                            quadrants */
   p8est_inspect_t    *inspect;        /**< algorithmic switches */
+  p4est_shared_t     *shared;         /**< if not NULL, the global
+                                           quadrant and position arrays
+                                           are node-shared memory */
 }
 p8est_t;
 
@@ -282,6 +285,8 @@ void                p8est_qcoord_to_vertex (p8est_connectivity_t *
  *
  * \note The connectivity structure must not be destroyed
  *       during the lifetime of this forest.
+ * \note The connectivity may be moved into node-shared memory,
+ *       see \ref p8est_new_ext.
  */
 p8est_t            *p8est_new (sc_MPI_Comm mpicomm,
                                p8est_connectivity_t * connectivity,
@@ -291,6 +296,8 @@ p8est_t            *p8est_new (sc_MPI_Comm mpicomm,
 /** Destroy a p8est.
  *
  * \note The connectivity structure is not destroyed with the p8est.
+ * \note If the partition arrays are node-shared, see \ref p8est_comm_share,
+ *       this function is collective over the processes of each node.
  */
 void                p8est_destroy (p8est_t * p8est);
 
@@ -258,6 +258,36 @@ void                p8est_balance_border (p8est_t * p8est,
                                           p8est_replace_t replace_fn,
                                           sc_array_t * borders);
 
+/** Balance several local trees of a p8est, possibly on multiple threads.
+ * Without borders this runs \ref p8est_balance_subtree_ext on each tree,
+ * otherwise \ref p8est_balance_border.  The trees are handed out to the
+ * threads dynamically and a tree is never split between threads, so the
+ * speedup is bounded by the number of trees.  Each thread uses its own
+ * quadrant memory pool, and the user data pool is locked when quadrant
+ * data is allocated or freed.
+ * The resulting trees do not depend on the number of threads.
+ * \param [in,out] p8est      The p8est to work on.
+ * \param [in]     btype      The balance type.
+ * \param [in]     num_threads Number of threads, including the calling one.
+ *                            Values less than 2 or a libsc configured without
+ *                            pthread support result in serial execution.
+ * \param [in]     which_trees Array of p4est_topidx_t local tree numbers.
+ * \param [in]     init_fn    Callback function to initialize the user_data.
+ *                            With threads it is called concurrently for
+ *                            different trees.
+ * \param [in]     replace_fn Callback function to replace quadrants, may be
+ *                            NULL.  Same concurrency as \a init_fn.
+ * \param [in,out] borders    If not NULL, the border quadrants of each local
+ *                            tree as expected by \ref p8est_balance_border.
+ */
+void                p8est_balance_trees (p8est_t * p8est,
+                                         p8est_connect_type_t btype,
+                                         int num_threads,
+                                         sc_array_t * which_trees,
+                                         p8est_init_t init_fn,
+                                         p8est_replace_t replace_fn,
+                                         sc_array_t * borders);
+
 /** Remove overlaps from a sorted list of quadrants.
  *
  * This is algorithm 8 from H. Sundar, R.S. Sampath and G. Biros
@@ -342,6 +372,46 @@ p4est_gloidx_t      p8est_partition_given (p8est_t * p8est,
                                            const p4est_locidx_t *
                                            num_quadrants_in_proc);
 
+/** Opaque state of a partition whose communication is in progress. */
+typedef struct p8est_partition_given p8est_partition_given_t;
+
+/** Begin to partition \a p8est given the number of quadrants per proc.
+ *
+ * Computes the communication pattern and posts all messages.
+ * The forest must not be modified until \ref p8est_partition_given_end
+ * is called, which must happen collectively on all processes.
+ * \param [in] p8est       The forest to be partitioned; it is not changed.
+ * \param [in]     num_quadrants_in_proc  an integer array of the number of
+ *                                        quadrants desired per processor.
+ * \return                 State to be passed to p8est_partition_given_end.
+ */
+p8est_partition_given_t *p8est_partition_given_begin (p8est_t * p8est,
+                                                      const p4est_locidx_t *
+                                                      num_quadrants_in_proc);
+
+/** Complete a partition started by \ref p8est_partition_given_begin.
+ * The forest is rebuilt from the received quadrants.
+ * \param [in] pg          State returned by the begin call, freed here.
+ * \return                 Returns the global count of shipped quadrants.
+ */
+p4est_gloidx_t      p8est_partition_given_end (p8est_partition_given_t *
+                                               pg);
+
+/** Partition \a p8est by weights of the local quadrants given in an array.
+ * This is equivalent to \ref p8est_partition_ext with a weight callback
+ * that returns the same weights, but the forest's user_pointer is free for
+ * the caller's own callbacks while the weights are computed beforehand.
+ * \param [in,out] p8est       The forest that is partitioned.
+ * \param [in] partition_for_coarsening   If true, the partition is
+ *                          modified to allow one level of coarsening.
+ * \param [in] weights      Not NULL.  One nonnegative weight for each
+ *                          local quadrant in the order of the local trees.
+ * \return                  Returns the global count of shipped quadrants.
+ */
+p4est_gloidx_t      p8est_partition_weights (p8est_t * p8est,
+                                          int partition_for_coarsening,
+                                          const int *weights);
+
 /** Checks if a quadrant's face is on the boundary of the forest.
  *
  * \param [in] p4est  The forest in which to search for \a q
@@ -121,6 +121,24 @@ int                 p8est_quadrant_disjoint (const void *v1, const void *v2);
 int                 p8est_quadrant_compare_piggy (const void *v1,
                                                   const void *v2);
 
+/** Sort an array of quadrants in the order of \ref p8est_quadrant_compare.
+ * The Morton index of each quadrant is computed once and the array is
+ * sorted by radix sort on these keys, avoiding the comparison callback.
+ * The result is the same as sc_array_sort with p8est_quadrant_compare,
+ * where equal quadrants keep their relative order.
+ * \param [in,out] array   Array of extended quadrants or nodes; its
+ *                         element size may exceed the quadrant size.
+ */
+void                p8est_quadrant_array_sort (sc_array_t * array);
+
+/** Sort an array of quadrants in the order of
+ * \ref p8est_quadrant_compare_piggy, using the which_tree member.
+ * Works like \ref p8est_quadrant_array_sort otherwise.
+ * \param [in,out] array   Array of extended quadrants or nodes with
+ *                         non-negative which_tree member.
+ */
+void                p8est_quadrant_array_sort_piggy (sc_array_t * array);
+
 /** Compare two quadrants with respect to their local_num in the piggy3 member.
  * \return Returns < 0 if \a v1 < \a v2,
  *                   0 if \a v1 == \a v2,
@@ -54,6 +54,12 @@ int                 p8est_bsearch_partition (p4est_gloidx_t target,
                                              int nmemb);
 
 /** Assign an MPI communicator to p8est; retrieve parallel environment.
+ *
+ * If MPI shared memory communicators are available, the intranode and
+ * internode communicators are attached to \a mpicomm.  They are cached
+ * with the communicator, so the collective split happens only the first
+ * time it is assigned.  Node communicators attached beforehand by
+ * sc_mpi_comm_attach_node_comms are kept as they are.
  *
  * \param [in] mpicomm    A valid MPI communicator.
  *
@@ -85,6 +91,60 @@ void                p8est_comm_parallel_env_replace (p8est_t * p8est,
  */
 void                p8est_comm_parallel_env_get_info (p8est_t * p8est);
 
+/** Determine the processes of each compute node.
+ * This function is collective over the forest's communicator.
+ * \param [in] p8est       Its communicator should have node communicators
+ *                      attached, see \ref p8est_comm_parallel_env_assign.
+ * \param [out] node_first  Array of mpisize + 1 entries.  On success,
+ *                      node k consists of the processes node_first[k]
+ *                      up to node_first[k + 1] - 1.
+ * \return              The number of nodes, or 0 if no node communicators
+ *                      are attached or the processes of some node are not
+ *                      consecutive.  Then \a node_first is undefined.
+ */
+int                 p8est_comm_node_first (p8est_t * p8est, int *node_first);
+
+/** Query whether a process runs on the same compute node as this one.
+ * This function is not collective.
+ * \param [in] p8est       The forest, see \ref p8est_comm_node_first.
+ * \param [in] q        A process of the forest's communicator.
+ * \return              True if \a q is on this node, false if not,
+ *                      and -1 if no node communicators are attached.
+ */
+int                 p8est_comm_is_intranode (p8est_t * p8est, int q);
+
+/** Query for a range of processes whether they run on this compute node.
+ * This function is not collective.  Unlike repeated calls to
+ * \ref p8est_comm_is_intranode, it translates all ranks at once.
+ * \param [in] p8est       The forest, see \ref p8est_comm_node_first.
+ * \param [in] first    The first process of the range.
+ * \param [in] num      The number of processes in the range.
+ * \param [out] intranode   Array of \a num entries.  Entry i is set as
+ *                      \ref p8est_comm_is_intranode would return it
+ *                      for process \a first + i.
+ */
+void                p8est_comm_intranode_ranks (p8est_t * p8est, int first,
+                                                int num,
+                                                int *intranode);
+
+/** Move the global partition arrays into memory shared per compute node.
+ * This is done only if \ref p4est_shared_set_enabled was called on the
+ * forest's communicator and MPI-3 shared windows are available.
+ * Afterwards \ref p8est_comm_count_quadrants and \ref
+ * p8est_comm_global_partition update the node-shared arrays, and
+ * \ref p8est_destroy is collective over the processes of each node.
+ * This function is collective over the forest's communicator.
+ * \param [in,out] p8est  Its \a global_first_quadrant and \a
+ *                      global_first_position arrays may be replaced.
+ */
+void                p8est_comm_share (p8est_t * p8est);
+
+/** Move node-shared global partition arrays back into private memory.
+ * This function is collective over the processes of each compute node.
+ * \param [in,out] p8est  Does nothing if its arrays are not node-shared.
+ */
+void                p8est_comm_unshare (p8est_t * p8est);
+
 /** Check if the MPI communicator is valid.
  *
  * \return True if communicator is not NULL communicator, false otherwise.
@@ -99,6 +99,23 @@ void                p8est_geometry_destroy (p8est_geometry_t * geom);
 p8est_geometry_t   *p8est_geometry_new_connectivity (p8est_connectivity_t *
                                                      conn);
 
+/** Create a geometry based on the vertices of a local connectivity.
+ * The local connectivity is obtained by \ref p8est_connectivity_extract or
+ * \ref p8est_connectivity_load_local.  The geometry is called with global
+ * tree numbers, which allows to compute the coordinates of the local
+ * quadrants of a forest or to write it by \ref p8est_vtk_write_file
+ * without the vertices of the global connectivity.
+ * \param [in] local       A local connectivity with vertex information.
+ *                         We do \a not take ownership and expect this
+ *                         structure to stay alive.
+ * \param [in] tree_global The global numbers of the local trees as
+ *                         returned with \a local.  It is copied.
+ * \return          Geometry structure; use with \ref p8est_geometry_destroy.
+ *                  It aborts when called for a tree not in \a local.
+ */
+p8est_geometry_t   *p8est_geometry_new_local (p8est_connectivity_t * local,
+                                              sc_array_t * tree_global);
+
 /** Geometric coordinate transformation for geometry created with
  * \ref p8est_geometry_new_connectivity. This is defined by
  * tri/binlinear interpolation from vertex coordinates.
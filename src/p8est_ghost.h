@@ -80,6 +80,9 @@ typedef struct
   p4est_locidx_t     *mirror_proc_front_offsets;        /**< NULL until
                                                            p8est_ghost_expand is
                                                            called */
+  unsigned            partition_checksum;       /**< checksum of the forest's
+                                                   global_first_position at
+                                                   creation of the ghost */
 }
 p8est_ghost_t;
 
@@ -150,6 +153,28 @@ p8est_ghost_t      *p8est_ghost_new_local (p8est_t * p8est,
 /** Frees all memory used for the ghost layer. */
 void                p8est_ghost_destroy (p8est_ghost_t * ghost);
 
+/** Update a ghost layer after local refinement, coarsening or balance.
+ * Only the mirror status of the quadrants listed in \a changed is
+ * recomputed, and only the difference to the previous ghost layer is sent.
+ * The result is identical to a ghost layer created anew by
+ * p8est_ghost_new, which can be verified with p8est_ghost_checksum.
+ * The partition of the forest must not have changed since \a ghost was
+ * created, which holds for p8est_refine, p8est_coarsen and p8est_balance.
+ * This is verified by a checksum of the partition boundaries, and a
+ * repartitioned forest aborts the program.
+ * \param [in] p8est        The forest after modification.
+ * \param [in,out] ghost    Ghost layer created by p8est_ghost_new or
+ *                          updated before.  It must not be expanded.
+ * \param [in] changed      Array of p8est_quadrant_t that holds every
+ *                          quadrant created since the ghost layer was last
+ *                          built, for example collected in the replace
+ *                          callback, with \c p.piggy3.which_tree set.
+ *                          Entries no longer in the forest are ignored.
+ */
+void                p8est_ghost_update (p8est_t * p8est,
+                                       p8est_ghost_t * ghost,
+                                       sc_array_t * changed);
+
 /** Conduct binary search for exact match on a range of the ghost layer.
  * \param [in] ghost            The ghost layer.
  * \param [in] which_proc       The owner of the searched quadrant.  Can be -1.
@@ -268,6 +293,21 @@ void                p8est_ghost_exchange_data (p8est_t * p8est,
                                                p8est_ghost_t * ghost,
                                                void *ghost_data);
 
+/** One field of a batched ghost exchange. */
+typedef struct p8est_ghost_field
+{
+  size_t              data_size;        /**< The data size per quadrant */
+  int                 minlevel;         /**< Level of the largest quadrant
+                                             to exchange, may be 0 */
+  int                 maxlevel;         /**< Level of the smallest quadrant
+                                             to exchange, may be
+                                             P8EST_QMAXLEVEL */
+  void              **mirror_data;      /**< One pointer per mirror */
+  void               *ghost_data;       /**< Contiguous data for all ghosts,
+                                             data_size bytes each */
+}
+p8est_ghost_field_t;
+
 /** Transient storage for asynchronous ghost exchange. */
 typedef struct p8est_ghost_exchange
 {
@@ -285,6 +325,8 @@ typedef struct p8est_ghost_exchange
   sc_array_t          sbuffers;         /**< Array of send buffers */
   sc_array_t          rrequests;        /**< Array of receive requests */
   sc_array_t          rbuffers;         /**< Array of receive buffers */
+  int                 num_fields;       /**< Number of batched fields */
+  p8est_ghost_field_t *fields;          /**< Copy of the batched fields */
 }
 p8est_ghost_exchange_t;
 
@@ -405,6 +447,182 @@ p8est_ghost_exchange_t *p8est_ghost_exchange_custom_levels_begin
 void                p8est_ghost_exchange_custom_levels_end
   (p8est_ghost_exchange_t * exc);
 
+/** Description of quadrant data in a user array with a fixed stride.
+ * The data of quadrant i begins at base + i * stride.  It consists of
+ * num_fields fields, where field k occupies field_sizes[k] bytes starting
+ * at field_offsets[k] relative to the beginning of the quadrant's data.
+ * Both array-of-structs and struct-of-arrays storage can be described:
+ * in the latter case, stride is the size of one value and field_offsets[k]
+ * is the distance of the k-th array from base.
+ */
+typedef struct p8est_ghost_layout
+{
+  void               *base;             /**< Address of quadrant 0 data */
+  size_t              stride;           /**< Bytes from one quadrant to next */
+  int                 num_fields;       /**< Number of fields per quadrant */
+  const size_t       *field_offsets;    /**< Byte offset of each field */
+  const size_t       *field_sizes;      /**< Byte size of each field */
+}
+p8est_ghost_layout_t;
+
+/** Persistent plan for repeated ghost exchanges of one data layout.
+ * It holds persistent MPI requests and a preallocated send buffer, so
+ * exchanging again only packs the mirror data and restarts the messages.
+ * A plan is tied to the revision of the forest and to the ghost and mirror
+ * offsets at creation: once the forest changes, or the ghost layer is grown
+ * by \ref p8est_ghost_expand or p8est_ghost_support_lnodes,
+ * \ref p8est_ghost_plan_is_valid returns false and the plan must be
+ * destroyed and recreated for the new ghost layer.
+ */
+typedef struct p8est_ghost_plan
+{
+  p8est_t            *p4est;            /**< The forest used for reference */
+  p8est_ghost_t      *ghost;            /**< The ghost layer used for reference */
+  long                revision;         /**< Forest revision at creation */
+  p4est_locidx_t     *proc_offsets;     /**< Ghost offsets at creation */
+  p4est_locidx_t     *mirror_proc_offsets;      /**< Mirror offsets at creation */
+  size_t              data_size;        /**< The data size to transfer per quadrant */
+  void               *ghost_data;       /**< Receive array for ghost data */
+  char               *sbuffer;          /**< Send buffer for all mirrors */
+  p8est_quadrant_t  **mirror_quads;     /**< Local quadrant of each mirror */
+  int                 num_requests;     /**< Persistent receives and sends */
+  int                 is_active;        /**< True between begin and end */
+  int                 is_layout;        /**< Created with a data layout */
+  sc_MPI_Request     *requests;         /**< Receive requests come first */
+  sc_MPI_Datatype    *datatypes;        /**< One per request for layout plans */
+}
+p8est_ghost_plan_t;
+
+/** Create a persistent plan for exchanging data of a fixed size per quadrant.
+ * This function is collective, but does not communicate.
+ * \param [in] p8est            The forest used for reference.
+ * \param [in] ghost            The ghost layer used for reference.
+ *                              It must stay alive as long as the plan.
+ * \param [in] data_size        The data size to transfer per quadrant.
+ *                              When exchanging the quadrant user data, this
+ *                              must be p8est->data_size, or sizeof (void *)
+ *                              if that is 0.
+ * \param [in,out] ghost_data   Pre-allocated contiguous data for all ghost
+ *                              quadrants in sequence, data_size each.
+ *                              It is the target of every exchange and must
+ *                              stay alive as long as the plan.
+ * \return                      A plan to be freed by p8est_ghost_plan_destroy.
+ */
+p8est_ghost_plan_t *p8est_ghost_plan_new (p8est_t * p8est,
+                                          p8est_ghost_t * ghost,
+                                          size_t data_size,
+                                          void *ghost_data);
+
+/** Create a persistent plan that exchanges fields directly between arrays.
+ * MPI datatypes are built once for the mirrors and ghosts of every peer,
+ * such that data is sent from the local quadrant array and received into
+ * the ghost array without intermediate copies.
+ * This function is collective, but does not communicate.
+ * \param [in] p8est            The forest used for reference.
+ * \param [in] ghost            The ghost layer used for reference.
+ *                              It must stay alive as long as the plan.
+ * \param [in] mirror_layout    Data of the local quadrants, indexed by
+ *                              local quadrant number across all trees.
+ * \param [in] ghost_layout     Data of the ghost quadrants, indexed by their
+ *                              position in the ghost layer.  It must have
+ *                              the same number and sizes of fields as the
+ *                              mirror layout, while offsets and stride
+ *                              may differ.
+ *                              The arrays of both layouts must stay alive as
+ *                              long as the plan, the layout structs need not.
+ * \return                      A plan to be used with p8est_ghost_plan_begin
+ *                              and NULL mirror data, and to be freed by
+ *                              p8est_ghost_plan_destroy.
+ */
+p8est_ghost_plan_t *p8est_ghost_plan_new_layout (p8est_t * p8est,
+                                                 p8est_ghost_t * ghost,
+                                                 const p8est_ghost_layout_t *
+                                                 mirror_layout,
+                                                 const p8est_ghost_layout_t *
+                                                 ghost_layout);
+
+/** Destroy a persistent ghost exchange plan.
+ * \param [in] plan     A plan that is not in the middle of an exchange.
+ */
+void                p8est_ghost_plan_destroy (p8est_ghost_plan_t * plan);
+
+/** Check whether the forest is unchanged since the plan was created.
+ * \param [in] plan     A valid plan.
+ * \return              True if the plan may be used for another exchange.
+ */
+int                 p8est_ghost_plan_is_valid (p8est_ghost_plan_t * plan);
+
+/** Begin an asynchronous ghost exchange with a persistent plan.
+ * The mirror data is copied into the send buffer before returning.
+ * The ghost data must not be accessed before completion.
+ * It is an error to call this function with a plan that is not valid.
+ * \param [in,out] plan         The plan must not be active.
+ * \param [in] mirror_data      One data pointer per mirror quadrant, or NULL
+ *                              to send the quadrant user data as done by
+ *                              p8est_ghost_exchange_data.
+ *                              Must be NULL for plans created by
+ *                              p8est_ghost_plan_new_layout.
+ */
+void                p8est_ghost_plan_begin (p8est_ghost_plan_t * plan,
+                                            void **mirror_data);
+
+/** Complete an asynchronous ghost exchange with a persistent plan.
+ * This function waits for all pending MPI communications.
+ * The plan is kept for the next exchange.
+ * \param [in,out] plan         The plan must be active.
+ */
+void                p8est_ghost_plan_end (p8est_ghost_plan_t * plan);
+
+/** Exchange ghost data with a persistent plan.
+ * This is a convenience wrapper calling p8est_ghost_plan_begin and
+ * p8est_ghost_plan_end in turn.
+ * \param [in,out] plan         The plan must not be active.
+ * \param [in] mirror_data      See p8est_ghost_plan_begin.
+ */
+void                p8est_ghost_plan_exchange (p8est_ghost_plan_t * plan,
+                                               void **mirror_data);
+
+/** Transfer data for several fields of local quadrants that are ghosts to
+ * other processors, aggregating all fields into one message per peer.
+ * Each field has its own data size and level range, with the same meaning
+ * as in p8est_ghost_exchange_custom_levels.
+ * If p8est->inspect is not NULL, the number of messages and bytes sent and
+ * received by this process are recorded in its ghost_fields_* members.
+ * \param [in] p8est            The forest used for reference.
+ * \param [in] ghost            The ghost layer used for reference.
+ * \param [in] num_fields       Number of entries in \a fields.
+ * \param [in] fields           Field descriptions.  Each ghost_data array
+ *                              is only written for the ghosts within the
+ *                              level range of its field.
+ */
+void                p8est_ghost_exchange_fields (p8est_t * p8est,
+                                                 p8est_ghost_t * ghost,
+                                                 int num_fields,
+                                                 const p8est_ghost_field_t *
+                                                 fields);
+
+/** Begin an asynchronous batched ghost data exchange by posting messages.
+ * The arguments are identical to p8est_ghost_exchange_fields.
+ * The return type is always non-NULL and must be passed to
+ * p8est_ghost_exchange_fields_end to complete the exchange.
+ * The ghost data must not be accessed before completion.
+ * The mirror data is not required to stay alive any longer, while
+ * the ghost data must stay alive into the completion call.
+ * The array of field descriptions is copied and may be freed.
+ * \return          Transient storage for messages in progress.
+ */
+p8est_ghost_exchange_t *p8est_ghost_exchange_fields_begin
+  (p8est_t * p8est, p8est_ghost_t * ghost,
+   int num_fields, const p8est_ghost_field_t * fields);
+
+/** Complete an asynchronous batched ghost data exchange.
+ * This function waits for all pending MPI communications.
+ * \param [in,out]  exc created ONLY by p8est_ghost_exchange_fields_begin.
+ *                  It is deallocated before this function returns.
+ */
+void                p8est_ghost_exchange_fields_end
+  (p8est_ghost_exchange_t * exc);
+
 /** Expand the size of the ghost layer and mirrors by one additional layer of
  * adjacency.
  * \param [in] p8est            The forest from which the ghost layer was
@@ -422,6 +422,103 @@ p8est_quadrant_t   *p8est_mesh_face_neighbor_next (p8est_mesh_face_neighbor_t
 void               *p8est_mesh_face_neighbor_data (p8est_mesh_face_neighbor_t
                                                    * mfn, void *ghost_data);
 
+/** Callback to extract the data on one face of a local quadrant.
+ * The forest's user_pointer may be used to access the user's data.
+ * \param [in] p8est        The forest.
+ * \param [in] mirror       A mirror of the ghost layer.  Its piggy3 member
+ *                          holds the tree and the local quadrant number.
+ * \param [in] face         The face whose data is requested.
+ * \param [out] slice       The face data of the size passed to
+ *                          p8est_ghost_faces_begin.
+ */
+typedef void        (*p8est_ghost_faces_pack_t) (p8est_t * p8est,
+                                                 const p8est_quadrant_t *
+                                                 mirror, int face,
+                                                 void *slice);
+
+/** Face pattern of a ghost layer for exchanging data on faces only.
+ * For high-order methods only the traces on the faces between processes
+ * are needed, which is much less data than the volume of a quadrant.
+ * For every mirror and every peer it is sent to, a bit mask records the
+ * faces that touch a quadrant of that peer.  For every ghost, a bit mask
+ * records the faces that touch a local quadrant; only these faces receive
+ * data.  A pattern is tied to the forest revision at creation.
+ */
+typedef struct p8est_ghost_faces
+{
+  p8est_t            *p4est;            /**< The forest used for reference */
+  p8est_ghost_t      *ghost;            /**< The ghost layer used for reference */
+  long                revision;         /**< Forest revision at creation */
+  uint8_t            *mirror_faces;     /**< Face bits for each entry of
+                                             ghost->mirror_proc_mirrors */
+  uint8_t            *ghost_faces;      /**< Face bits for each ghost */
+  p4est_locidx_t     *send_offsets;     /**< Faces sent to each process,
+                                             mpisize + 1 offsets */
+  p4est_locidx_t     *recv_offsets;     /**< Faces received from each
+                                             process, mpisize + 1 offsets */
+
+  /* these members are used during an exchange */
+  size_t              face_size;        /**< Bytes per face */
+  void               *ghost_face_data;  /**< Target of the exchange */
+  char               *sbuffer;          /**< Packed faces for all peers */
+  char               *rbuffer;          /**< Received faces from all peers */
+  sc_array_t          requests;         /**< Receives first, then sends */
+}
+p8est_ghost_faces_t;
+
+/** Compute the face pattern of a ghost layer.
+ * This function does not communicate.
+ * \param [in] p8est    The forest used for reference.
+ * \param [in] ghost    The ghost layer used for reference.
+ *                      It must stay alive as long as the pattern.
+ * \param [in] mesh     A mesh created from the forest and ghost layer.
+ *                      It is only used in this function.
+ * \return              The pattern to be freed by p8est_ghost_faces_destroy.
+ */
+p8est_ghost_faces_t *p8est_ghost_faces_new (p8est_t * p8est,
+                                            p8est_ghost_t * ghost,
+                                            p8est_mesh_t * mesh);
+
+/** Free the face pattern of a ghost layer.
+ * \param [in] faces    A pattern that is not in the middle of an exchange.
+ */
+void                p8est_ghost_faces_destroy (p8est_ghost_faces_t * faces);
+
+/** Begin an asynchronous exchange of the face data of the mirrors.
+ * Only the faces of a mirror that touch a quadrant of the receiving process
+ * are packed by the callback and sent.
+ * It is an error to call this function after the forest has changed.
+ * \param [in,out] faces        A pattern not in the middle of an exchange.
+ * \param [in] face_size        Bytes of data per face.
+ * \param [in] pack             Called once per face and peer to be sent to.
+ * \param [in,out] ghost_face_data  P8EST_FACES * face_size bytes for each
+ *                              ghost quadrant in sequence.  On completion,
+ *                              the slots of the faces flagged in
+ *                              faces->ghost_faces hold the data of the
+ *                              mirrors' faces.  Other slots are unchanged.
+ *                              Must stay alive into the completion call.
+ */
+void                p8est_ghost_faces_begin (p8est_ghost_faces_t * faces,
+                                             size_t face_size,
+                                             p8est_ghost_faces_pack_t pack,
+                                             void *ghost_face_data);
+
+/** Complete an asynchronous exchange of face data.
+ * \param [in,out] faces        The pattern passed to p8est_ghost_faces_begin.
+ */
+void                p8est_ghost_faces_end (p8est_ghost_faces_t * faces);
+
+/** Exchange face data by calling p8est_ghost_faces_begin and _end in turn.
+ * \param [in,out] faces        A pattern not in the middle of an exchange.
+ * \param [in] face_size        Bytes of data per face.
+ * \param [in] pack             Called once per face and peer to be sent to.
+ * \param [in,out] ghost_face_data  See p8est_ghost_faces_begin.
+ */
+void                p8est_ghost_faces_exchange (p8est_ghost_faces_t * faces,
+                                                size_t face_size,
+                                                p8est_ghost_faces_pack_t pack,
+                                                void *ghost_face_data);
+
 SC_EXTERN_C_END;
 
 #endif /* !P8EST_MESH_H */
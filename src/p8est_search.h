@@ -111,6 +111,33 @@ ssize_t             p8est_find_higher_bound (sc_array_t * array,
                                              const p8est_quadrant_t * q,
                                              size_t guess);
 
+/** Find the lower bounds of many quadrants in one sweep.
+ * The queries must be sorted ascending by \ref p8est_quadrant_compare.
+ * Since the results are then non-decreasing, each search gallops forward
+ * from the previous result, which is much cheaper than repeated calls to
+ * \ref p8est_find_lower_bound when the queries are dense.
+ * \param [in] array       Sorted quadrant array to search in.
+ * \param [in] queries     Sorted array of quadrants to search for.
+ * \param [out] results    Resized to the number of queries and filled with
+ *                         the ssize_t result of p8est_find_lower_bound
+ *                         for each query.
+ */
+void                p8est_find_lower_bounds (sc_array_t * array,
+                                             sc_array_t * queries,
+                                             sc_array_t * results);
+
+/** Find the higher bounds of many quadrants in one sweep.
+ * Works like \ref p8est_find_lower_bounds with the result
+ * of \ref p8est_find_higher_bound for each query.
+ * \param [in] array       Sorted quadrant array to search in.
+ * \param [in] queries     Sorted array of quadrants to search for.
+ * \param [out] results    Resized to the number of queries and filled with
+ *                         the ssize_t result for each query.
+ */
+void                p8est_find_higher_bounds (sc_array_t * array,
+                                              sc_array_t * queries,
+                                              sc_array_t * results);
+
 /** Search a local quadrant by its cumulative number in the forest.
  *
  * We perform a binary search over the processor-local trees,
@@ -0,0 +1,172 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+
+#ifndef P8EST_TRANSITION_H
+#define P8EST_TRANSITION_H
+
+#include <p8est.h>
+
+SC_EXTERN_C_BEGIN;
+
+/** \file p8est_transition.h
+ * Record how the local quadrants change under adaptation and project
+ * fixed-size data arrays from the old to the new forest in batches.
+ *
+ * A transition object takes a snapshot of the local quadrants by
+ * \ref p8est_transition_new.  Then any sequence of refinement, coarsening
+ * and balance may be applied to the forest, but no partitioning.
+ * \ref p8est_transition_complete computes a compact map of index ranges.
+ * \ref p8est_transition_project uses it to call user supplied kernels on
+ * contiguous runs of refined and coarsened families.  This replaces the
+ * per-family invocations of a \ref p8est_replace_t callback.
+ */
+
+/** The kind of change of a range of local quadrants. */
+typedef enum p8est_transition_type
+{
+  P8EST_TRANSITION_KEEP,        /**< Quadrants are unchanged. */
+  P8EST_TRANSITION_REFINE,      /**< Quadrants are replaced by descendants. */
+  P8EST_TRANSITION_COARSEN      /**< Quadrants are replaced by an ancestor. */
+}
+p8est_transition_type_t;
+
+/** A contiguous range of old local quadrants and what they turned into.
+ * For kept quadrants, \a num_old equals \a num_new.
+ * A range of quadrants each refined once holds \a num_new equal to
+ * P8EST_CHILDREN times \a num_old, and a range of families each coarsened
+ * once holds \a num_old equal to P8EST_CHILDREN times \a num_new.
+ * Any other refinement or coarsening covers exactly one old or new
+ * quadrant, respectively, and spans multiple levels.
+ */
+typedef struct p8est_transition_range
+{
+  p8est_transition_type_t type;         /**< The kind of change. */
+  p4est_locidx_t      old_index;        /**< First old local index. */
+  p4est_locidx_t      new_index;        /**< First new local index. */
+  p4est_locidx_t      num_old;          /**< Number of old quadrants. */
+  p4est_locidx_t      num_new;          /**< Number of new quadrants. */
+}
+p8est_transition_range_t;
+
+/** The map between the local quadrants before and after adaptation. */
+typedef struct p8est_transition
+{
+  p4est_locidx_t      num_old;          /**< Old local quadrant count. */
+  p4est_locidx_t      num_new;          /**< New local quadrant count, or
+                                             -1 before completion. */
+  sc_array_t         *ranges;           /**< Ranges of type
+                                             \ref p8est_transition_range_t
+                                             in ascending order, or NULL
+                                             before completion. */
+  sc_array_t         *old_levels;       /**< int8_t level of each old
+                                             local quadrant. */
+  sc_array_t         *new_levels;       /**< int8_t level of each new local
+                                             quadrant, or NULL before
+                                             completion. */
+
+  /* internal data */
+  p4est_topidx_t      first_local_tree, last_local_tree;
+  sc_array_t         *snapshot;
+}
+p8est_transition_t;
+
+/** Batch kernel to compute children data from parent data.
+ * \param [in] num_parents  Number of parents to refine.
+ * \param [in] data_size    Number of bytes per quadrant.
+ * \param [in] parents      Data of \a num_parents parents, contiguous.
+ * \param [out] children    Data of \a num_parents times P8EST_CHILDREN
+ *                          children, contiguous family by family.
+ * \param [in] user         Passed through from \ref p8est_transition_project.
+ */
+typedef void        (*p8est_transition_refine_t) (size_t num_parents,
+                                                  size_t data_size,
+                                                  const void *parents,
+                                                  void *children,
+                                                  void *user);
+
+/** Batch kernel to compute parent data from the data of its children.
+ * \param [in] num_parents  Number of families to coarsen.
+ * \param [in] data_size    Number of bytes per quadrant.
+ * \param [in] children     Data of \a num_parents times P8EST_CHILDREN
+ *                          children, contiguous family by family.
+ * \param [out] parents     Data of \a num_parents parents, contiguous.
+ * \param [in] user         Passed through from \ref p8est_transition_project.
+ */
+typedef void        (*p8est_transition_coarsen_t) (size_t num_parents,
+                                                   size_t data_size,
+                                                   const void *children,
+                                                   void *parents,
+                                                   void *user);
+
+/** Take a snapshot of the local quadrants of a forest.
+ * \param [in] p8est    The forest to be adapted afterwards.
+ * \return              A transition to be passed to
+ *                      \ref p8est_transition_complete after adaptation.
+ */
+p8est_transition_t *p8est_transition_new (p8est_t * p8est);
+
+/** Compute the transition map after adapting the forest.
+ * The forest must have been modified only by refinement, coarsening and
+ * balance since \ref p8est_transition_new; otherwise this function aborts.
+ * The snapshot is freed inside.
+ * \param [in,out] transition   Created from the forest before adaptation.
+ * \param [in] p8est            The same forest after adaptation.
+ */
+void                p8est_transition_complete (p8est_transition_t *
+                                               transition, p8est_t * p8est);
+
+/** Free the memory of a transition.
+ * \param [in] transition       Created by \ref p8est_transition_new.
+ */
+void                p8est_transition_destroy (p8est_transition_t *
+                                              transition);
+
+/** Project data from the old to the new local quadrants.
+ * Kept quadrants are copied in contiguous blocks.  Runs of quadrants that
+ * are refined or coarsened by one level are passed to a single invocation
+ * of the kernel each.  Changes of more than one level are carried out by
+ * repeated kernel calls through temporary storage.
+ * \param [in] transition   Completed by \ref p8est_transition_complete.
+ * \param [in] data_size    Number of bytes per quadrant, may be zero.
+ * \param [in] old_data     Data of the \a num_old old local quadrants.
+ * \param [out] new_data    Data of the \a num_new new local quadrants.
+ *                          Must not overlap with \a old_data.
+ * \param [in] refine_fn    Refinement kernel.  If NULL, the parent data is
+ *                          copied into each child.
+ * \param [in] coarsen_fn   Coarsening kernel.  If NULL, the data of the
+ *                          first child is copied into the parent.
+ * \param [in] user         Passed through to the kernels.
+ */
+void                p8est_transition_project (p8est_transition_t *
+                                              transition, size_t data_size,
+                                              const void *old_data,
+                                              void *new_data,
+                                              p8est_transition_refine_t
+                                              refine_fn,
+                                              p8est_transition_coarsen_t
+                                              coarsen_fn, void *user);
+
+SC_EXTERN_C_END;
+
+#endif /* !P8EST_TRANSITION_H */
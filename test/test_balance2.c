@@ -86,6 +86,36 @@ refine_fn (p4est_t * p4est, p4est_topidx_t which_tree,
   return 1;
 }
 
+static void
+mark_old_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+             p4est_quadrant_t * quadrant)
+{
+  *(int8_t *) quadrant->p.user_data = 0;
+}
+
+static void
+mark_new_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+             p4est_quadrant_t * quadrant)
+{
+  *(int8_t *) quadrant->p.user_data = 1;
+}
+
+static int
+refine_changed_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+                   p4est_quadrant_t * quadrant)
+{
+  /* changes in one tree only, so that some processes have none */
+  return which_tree == 1 && (int) quadrant->level < refine_level + 2 &&
+    p4est_quadrant_child_id (quadrant) == (int) (quadrant->level % 3);
+}
+
+static int
+coarsen_changed_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+                    p4est_quadrant_t * quadrants[])
+{
+  return which_tree == 0 && quadrants[0]->x == 0;
+}
+
 static unsigned
 test_checksum (p4est_t * p4est, int have_zlib)
 {
@@ -103,11 +133,19 @@ main (int argc, char **argv)
 #ifndef P4_TO_P8
   size_t              kz;
   int8_t              l;
-  p4est_quadrant_t   *q;
   p4est_tree_t        stree, *tree = &stree;
 #endif
-  p4est_t            *p4est;
+  p4est_quadrant_t   *q;
+  int                 k;
+  int8_t             *changed;
+  p4est_locidx_t      il;
+  p4est_topidx_t      nt;
+  size_t              zz;
+  p4est_tree_t       *ctree;
+  p4est_t            *p4est, *copy, *copy2;
   p4est_connectivity_t *connectivity;
+  p4est_connect_type_t btype;
+  p4est_inspect_t     inspect;
 
   /* initialize MPI */
   mpiret = sc_MPI_Init (&argc, &argv);
@@ -181,6 +219,32 @@ main (int argc, char **argv)
   p4est_refine (p4est, 1, refine_fn, NULL);
   SC_CHECK_ABORT (!p4est_is_balanced (p4est, P4EST_CONNECT_FULL),
                   "Balance 2");
+
+  /* balance with threads or flat tables must produce the same forest */
+  for (k = 0; k < 4; ++k) {
+    copy = p4est_copy (p4est, 0);
+    copy2 = p4est_copy (p4est, 0);
+    p4est_reset_data (copy, 8, init_fn, NULL);
+    p4est_reset_data (copy2, 8, init_fn, NULL);
+    memset (&inspect, 0, sizeof (inspect));
+    if (k < 2) {
+      inspect.balance_num_threads = 3;
+    }
+    else {
+      inspect.use_balance_flat = 1;
+    }
+    copy->inspect = &inspect;
+    btype = k % 2 == 0 ? P4EST_CONNECT_FACE : P4EST_CONNECT_FULL;
+    p4est_balance (copy, btype, init_fn);
+    p4est_balance (copy2, btype, init_fn);
+    SC_CHECK_ABORT (p4est_is_equal (copy, copy2, 0),
+                    k < 2 ? "Balance threads" : "Balance flat");
+    SC_CHECK_ABORT (copy->user_data_pool->elem_count ==
+                    (size_t) copy->local_num_quadrants, "Balance data");
+    copy->inspect = NULL;
+    p4est_destroy (copy);
+    p4est_destroy (copy2);
+  }
   p4est_balance (p4est, P4EST_CONNECT_FULL, NULL);
   SC_CHECK_ABORT (p4est_is_balanced (p4est, P4EST_CONNECT_FULL), "Balance 3");
 
@@ -194,6 +258,37 @@ main (int argc, char **argv)
   SC_CHECK_ABORT (test_checksum (p4est, have_zlib) == crc, "Partition");
   SC_CHECK_ABORT (p4est_is_balanced (p4est, P4EST_CONNECT_FULL), "Balance 4");
 
+  /* balance of the changes only must produce the same forest */
+  for (k = 0; k < 2; ++k) {
+    copy = p4est_copy (p4est, 0);
+    p4est_reset_data (copy, sizeof (int8_t), mark_old_fn, NULL);
+    p4est_refine (copy, 1, refine_changed_fn, mark_new_fn);
+    p4est_coarsen (copy, 0, coarsen_changed_fn, mark_new_fn);
+    copy2 = p4est_copy (copy, 1);
+    changed = P4EST_ALLOC (int8_t, copy->local_num_quadrants);
+    il = 0;
+    for (nt = copy->first_local_tree; nt <= copy->last_local_tree; ++nt) {
+      ctree = p4est_tree_array_index (copy->trees, nt);
+      for (zz = 0; zz < ctree->quadrants.elem_count; ++zz) {
+        q = p4est_quadrant_array_index (&ctree->quadrants, zz);
+        changed[il++] = *(int8_t *) q->p.user_data;
+      }
+    }
+    btype = k == 0 ? P4EST_CONNECT_FACE : P4EST_CONNECT_FULL;
+    p4est_balance_changed (copy, btype, changed, mark_new_fn, NULL);
+    p4est_balance_ext (copy2, btype, mark_new_fn, NULL);
+    SC_CHECK_ABORT (p4est_is_equal (copy, copy2, 1), "Balance changed");
+    P4EST_FREE (changed);
+
+    /* nothing to do without changes */
+    changed = P4EST_ALLOC_ZERO (int8_t, copy->local_num_quadrants);
+    p4est_balance_changed (copy, btype, changed, mark_new_fn, NULL);
+    SC_CHECK_ABORT (p4est_is_equal (copy, copy2, 1), "Balance unchanged");
+    P4EST_FREE (changed);
+    p4est_destroy (copy);
+    p4est_destroy (copy2);
+  }
+
   /* check reset data function */
   p4est_reset_data (p4est, 3, NULL, NULL);
   p4est_reset_data (p4est, 3, NULL, NULL);
@@ -249,6 +249,14 @@ test_coarsen (p4est_t * p4est, p4est_topidx_t which_tree,
   return coarsen_all || q[0]->y >= P4EST_ROOT_LEN / 2;
 }
 
+static int
+test_refine_adapt (p4est_t * p4est, p4est_topidx_t which_tree,
+                   p4est_quadrant_t * quadrant)
+{
+  return (int) quadrant->level <= refine_level &&
+    quadrant->x < P4EST_ROOT_LEN / 4;
+}
+
 static void
 p4est_coarsen_both (p4est_t * p4est, int coarsen_recursive,
                     p4est_coarsen_t coarsen_fn, p4est_init_t init_fn)
@@ -271,6 +279,197 @@ p4est_coarsen_both (p4est_t * p4est, int coarsen_recursive,
   p4est_destroy (copy);
 }
 
+static p4est_quadrant_t *
+test_local_quadrant (p4est_t * p4est, p4est_locidx_t lid)
+{
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree;
+
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    if (lid < tree->quadrants_offset +
+        (p4est_locidx_t) tree->quadrants.elem_count) {
+      return p4est_quadrant_array_index (&tree->quadrants,
+                                         lid - tree->quadrants_offset);
+    }
+  }
+  SC_ABORT_NOT_REACHED ();
+}
+
+static void
+test_check_old_to_new (p4est_t * before, p4est_t * after,
+                       const int8_t * flags,
+                       const p4est_locidx_t * old_to_new)
+{
+  p4est_locidx_t      il;
+  p4est_quadrant_t   *o, *n, d;
+
+  for (il = 0; il < before->local_num_quadrants; ++il) {
+    SC_CHECK_ABORT (0 <= old_to_new[il] &&
+                    old_to_new[il] < after->local_num_quadrants,
+                    "Flags index range");
+    o = test_local_quadrant (before, il);
+    n = test_local_quadrant (after, old_to_new[il]);
+    if (flags[il] > 0) {
+      p4est_quadrant_first_descendant (o, &d, (int) o->level + 1);
+      SC_CHECK_ABORT (p4est_quadrant_is_equal (n, &d), "Flags refine map");
+    }
+    else if (flags[il] < 0) {
+      SC_CHECK_ABORT (p4est_quadrant_is_parent (n, o), "Flags coarsen map");
+    }
+    else {
+      SC_CHECK_ABORT (p4est_quadrant_is_equal (n, o), "Flags keep map");
+    }
+  }
+}
+
+/* the forest and the normalized flags that the references look up */
+static p4est_t     *flags_before;
+static const int8_t *flags_done;
+
+/* return the flag of a quadrant in flags_before or 0 if it is not there */
+static int
+test_flag_lookup (p4est_topidx_t which_tree, p4est_quadrant_t * q)
+{
+  ssize_t             pos;
+  p4est_tree_t       *tree;
+
+  tree = p4est_tree_array_index (flags_before->trees, which_tree);
+  pos = sc_array_bsearch (&tree->quadrants, q, p4est_quadrant_compare);
+  if (pos < 0) {
+    return 0;
+  }
+  return flags_done[tree->quadrants_offset + (p4est_locidx_t) pos];
+}
+
+static int
+test_refine_flags (p4est_t * p4est, p4est_topidx_t which_tree,
+                   p4est_quadrant_t * quadrant)
+{
+  return test_flag_lookup (which_tree, quadrant) > 0;
+}
+
+static int
+test_coarsen_flags (p4est_t * p4est, p4est_topidx_t which_tree,
+                    p4est_quadrant_t * q[])
+{
+  return test_flag_lookup (which_tree, q[0]) < 0;
+}
+
+/* compare the flag based refinement and coarsening with the callbacks */
+static void
+p4est_flags_both (p4est_t * input, int mode)
+{
+  int                 success, k;
+  int8_t             *flags;
+  size_t              zz, incount;
+  p4est_locidx_t      il, *old_to_new;
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q, *c[P4EST_CHILDREN];
+  p4est_t            *p4est, *before, *copy;
+
+  p4est = p4est_copy (input, 0);
+  before = p4est_copy (input, 0);
+  copy = p4est_copy (input, 0);
+  flags = P4EST_ALLOC_ZERO (int8_t, p4est->local_num_quadrants);
+  old_to_new = P4EST_ALLOC (p4est_locidx_t, p4est->local_num_quadrants);
+
+  /* mark quadrants as the callbacks would decide */
+  il = 0;
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    incount = tree->quadrants.elem_count;
+    for (zz = 0; zz < incount;) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      if (mode != 1 && zz + P4EST_CHILDREN <= incount) {
+        for (k = 0; k < P4EST_CHILDREN; ++k) {
+          c[k] = q + k;
+        }
+        if (p4est_quadrant_is_familypv (c) && test_coarsen (p4est, jt, c)) {
+          for (k = 0; k < P4EST_CHILDREN; ++k) {
+            flags[il + k] = -7;
+          }
+          il += P4EST_CHILDREN;
+          zz += P4EST_CHILDREN;
+          continue;
+        }
+      }
+      if (mode != 0 && test_refine (p4est, jt, q)) {
+        flags[il] = 5;
+      }
+      ++il;
+      ++zz;
+    }
+  }
+  P4EST_ASSERT (il == p4est->local_num_quadrants);
+
+  if (mode == 0) {
+    p4est_coarsen (copy, 0, test_coarsen, NULL);
+    p4est_coarsen_flags (p4est, flags, NULL, old_to_new);
+  }
+  else if (mode == 1) {
+    p4est_refine (copy, 0, test_refine, NULL);
+    p4est_refine_flags (p4est, flags, NULL, old_to_new);
+  }
+  else {
+    /* the reference refines and then coarsens by the normalized flags */
+    p4est_adapt_flags (p4est, flags, NULL, old_to_new);
+    flags_before = before;
+    flags_done = flags;
+    p4est_refine (copy, 0, test_refine_flags, NULL);
+    p4est_coarsen (copy, 0, test_coarsen_flags, NULL);
+    flags_before = NULL;
+    flags_done = NULL;
+  }
+  test_check_old_to_new (before, p4est, flags, old_to_new);
+  success = p4est_is_equal (p4est, copy, 0);
+  SC_CHECK_ABORT (success, "Flags mismatch");
+  SC_CHECK_ABORT (p4est_checksum (p4est) == p4est_checksum (copy),
+                  "Flags checksum");
+
+  P4EST_FREE (flags);
+  P4EST_FREE (old_to_new);
+  p4est_destroy (p4est);
+  p4est_destroy (before);
+  p4est_destroy (copy);
+}
+
+/* the fused adapt must match the sequence of its stages */
+static void
+p4est_adapt_both (p4est_t * p4est)
+{
+  int                 success;
+  p4est_gloidx_t      shipped, shipped_copy;
+  p4est_t            *adapted, *copy;
+  p4est_inspect_t     inspect;
+
+  copy = p4est_copy (p4est, 1);
+  p4est_refine_ext (copy, 0, -1, test_refine_adapt, NULL, NULL);
+  p4est_coarsen_ext (copy, 0, 0, test_coarsen, NULL, NULL);
+  p4est_balance_ext (copy, P4EST_CONNECT_FULL, NULL, NULL);
+  shipped_copy = p4est_partition_ext (copy, 0, NULL);
+
+  adapted = p4est_copy (p4est, 1);
+  memset (&inspect, 0, sizeof (inspect));
+  adapted->inspect = &inspect;
+  shipped = p4est_adapt (adapted, 0, -1, test_refine_adapt, 0, test_coarsen,
+                         P4EST_CONNECT_FULL, 0, NULL, NULL, NULL);
+  adapted->inspect = NULL;
+  SC_CHECK_ABORT (shipped == shipped_copy, "Adapt shipped");
+  SC_CHECK_ABORT (inspect.adapt_balance > 0., "Adapt timing");
+
+  success = p4est_is_equal (adapted, copy, 1);
+  SC_CHECK_ABORT (success, "Adapt mismatch");
+  SC_CHECK_ABORT (adapted->global_num_quadrants ==
+                  copy->global_num_quadrants, "Adapt count");
+  SC_CHECK_ABORT (p4est_checksum (adapted) == p4est_checksum (copy),
+                  "Adapt checksum");
+
+  p4est_destroy (adapted);
+  p4est_destroy (copy);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -307,6 +506,13 @@ main (int argc, char **argv)
   p4est_refine (p4est, 1, test_refine, NULL);
   p4est_balance (p4est, P4EST_CONNECT_FULL, NULL);
 
+  /* the flag based interface must match the callbacks */
+  coarsen_all = 0;
+  p4est_flags_both (p4est, 0);
+  p4est_flags_both (p4est, 1);
+  p4est_flags_both (p4est, 2);
+  p4est_adapt_both (p4est);
+
   coarsen_all = 1;
   p4est_coarsen_both (p4est, 0, test_coarsen, NULL);
   coarsen_all = 0;
@@ -50,6 +50,9 @@ test_the_p4est (p4est_connectivity_t * conn, int N)
 static void
 test_complete (p4est_connectivity_t * conn, const char *which, int test_p4est)
 {
+  sc_array_t         *buffer;
+  p4est_connectivity_t *copy;
+
   SC_GLOBAL_INFOF ("Testing standard connectivity %s\n", which);
   SC_CHECK_ABORTF (p4est_connectivity_is_valid (conn),
                    "Invalid connectivity %s before completion", which);
@@ -57,10 +60,20 @@ test_complete (p4est_connectivity_t * conn, const char *which, int test_p4est)
     test_the_p4est (conn, 3);
   }
 
+  buffer = p4est_connectivity_deflate (conn, P4EST_CONN_ENCODE_NONE);
+  copy = p4est_connectivity_inflate (buffer);
+  sc_array_destroy (buffer);
+
   SC_GLOBAL_INFOF ("Testing completion for connectivity %s\n", which);
   p4est_connectivity_complete (conn);
   SC_CHECK_ABORTF (p4est_connectivity_is_valid (conn),
                    "Invalid connectivity %s after completion", which);
+
+  /* parallel completion yields the same connectivity */
+  p4est_connectivity_complete_parallel (copy, sc_MPI_COMM_WORLD);
+  SC_CHECK_ABORTF (p4est_connectivity_is_equal (conn, copy),
+                   "Parallel completion of %s differs", which);
+  p4est_connectivity_destroy (copy);
   if (test_p4est) {
     test_the_p4est (conn, 3);
   }
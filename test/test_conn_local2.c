@@ -0,0 +1,310 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef P4_TO_P8
+#include <p4est_bits.h>
+#include <p4est_geometry.h>
+#include <p4est_vtk.h>
+#else
+#include <p8est_bits.h>
+#include <p8est_geometry.h>
+#include <p8est_vtk.h>
+#endif
+
+/** Compare the connections of a local tree to those of its global tree. */
+static void
+test_local_tree (p4est_connectivity_t * conn, p4est_connectivity_t * local,
+                 const p4est_topidx_t * tree_global, p4est_topidx_t lt)
+{
+  const p4est_topidx_t gt = tree_global[lt];
+  int                 face, corner;
+  int                 gft[9], lft[9];
+  size_t              zz;
+  p4est_topidx_t      gnt, lnt;
+  p4est_corner_info_t gci, lci;
+  p4est_corner_transform_t *gct, *lct;
+#ifdef P4_TO_P8
+  int                 edge;
+  p8est_edge_info_t   gei, lei;
+  p8est_edge_transform_t *get, *let;
+#endif
+
+  for (face = 0; face < P4EST_FACES; ++face) {
+    SC_CHECK_ABORT (tree_global[local->tree_to_tree[P4EST_FACES * lt + face]]
+                    == conn->tree_to_tree[P4EST_FACES * gt + face] &&
+                    local->tree_to_face[P4EST_FACES * lt + face] ==
+                    conn->tree_to_face[P4EST_FACES * gt + face],
+                    "Local face connection");
+    gnt = p4est_find_face_transform (conn, gt, face, gft);
+    lnt = p4est_find_face_transform (local, lt, face, lft);
+    SC_CHECK_ABORT ((gnt < 0 && lnt < 0) ||
+                    (lnt >= 0 && tree_global[lnt] == gnt &&
+                     !memcmp (gft, lft, 9 * sizeof (int))),
+                    "Local face transform");
+  }
+
+#ifdef P4_TO_P8
+  for (edge = 0; edge < P8EST_EDGES; ++edge) {
+    sc_array_init (&gei.edge_transforms, sizeof (p8est_edge_transform_t));
+    sc_array_init (&lei.edge_transforms, sizeof (p8est_edge_transform_t));
+    p8est_find_edge_transform (conn, gt, edge, &gei);
+    p8est_find_edge_transform (local, lt, edge, &lei);
+    SC_CHECK_ABORT (gei.edge_transforms.elem_count ==
+                    lei.edge_transforms.elem_count, "Local edge count");
+    for (zz = 0; zz < gei.edge_transforms.elem_count; ++zz) {
+      get = p8est_edge_array_index (&gei.edge_transforms, zz);
+      let = p8est_edge_array_index (&lei.edge_transforms, zz);
+      SC_CHECK_ABORT (tree_global[let->ntree] == get->ntree &&
+                      let->nedge == get->nedge && let->nflip == get->nflip &&
+                      !memcmp (let->naxis, get->naxis, 3 * sizeof (int8_t)),
+                      "Local edge transform");
+    }
+    sc_array_reset (&gei.edge_transforms);
+    sc_array_reset (&lei.edge_transforms);
+  }
+#endif
+
+  for (corner = 0; corner < P4EST_CHILDREN; ++corner) {
+    sc_array_init (&gci.corner_transforms, sizeof (p4est_corner_transform_t));
+    sc_array_init (&lci.corner_transforms, sizeof (p4est_corner_transform_t));
+    p4est_find_corner_transform (conn, gt, corner, &gci);
+    p4est_find_corner_transform (local, lt, corner, &lci);
+    SC_CHECK_ABORT (gci.corner_transforms.elem_count ==
+                    lci.corner_transforms.elem_count, "Local corner count");
+    for (zz = 0; zz < gci.corner_transforms.elem_count; ++zz) {
+      gct = p4est_corner_array_index (&gci.corner_transforms, zz);
+      lct = p4est_corner_array_index (&lci.corner_transforms, zz);
+      SC_CHECK_ABORT (tree_global[lct->ntree] == gct->ntree &&
+                      lct->ncorner == gct->ncorner, "Local corner transform");
+    }
+    sc_array_reset (&gci.corner_transforms);
+    sc_array_reset (&lci.corner_transforms);
+  }
+}
+
+static int
+refine_uniform (p4est_t * p4est, p4est_topidx_t which_tree,
+                p4est_quadrant_t * quadrant)
+{
+  return quadrant->level < 2;
+}
+
+/** Place the local quadrants of a forest by the local connectivity only. */
+static void
+test_local_forest (sc_MPI_Comm mpicomm, p4est_connectivity_t * conn,
+                   const char *which)
+{
+  int                 c, j;
+  char                filename[BUFSIZ];
+  size_t              zz;
+  double              gxyz[3], lxyz[3];
+  p4est_qcoord_t      coords[P4EST_DIM];
+  p4est_topidx_t      jt, first_tree, last_tree;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q, corner;
+  sc_array_t          tree_global;
+  p4est_t            *p4est;
+  p4est_connectivity_t *local;
+  p4est_geometry_t   *ggeom, *lgeom;
+
+  p4est = p4est_new (mpicomm, conn, 0, NULL, NULL);
+  p4est_refine (p4est, 1, refine_uniform, NULL);
+  p4est_partition (p4est, 0, NULL);
+
+  /* the local trees of the forest and their neighbors */
+  first_tree = SC_MAX (p4est->first_local_tree, 0);
+  last_tree = p4est->first_local_tree < 0 ? first_tree - 1 :
+    p4est->last_local_tree;
+  sc_array_init (&tree_global, sizeof (p4est_topidx_t));
+  local = p4est_connectivity_extract (conn, first_tree, last_tree,
+                                      &tree_global);
+  ggeom = p4est_geometry_new_connectivity (conn);
+  lgeom = p4est_geometry_new_local (local, &tree_global);
+
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      for (c = 0; c < P4EST_CHILDREN; ++c) {
+        p4est_quadrant_corner_node (q, c, &corner);
+        coords[0] = corner.x;
+        coords[1] = corner.y;
+#ifdef P4_TO_P8
+        coords[2] = corner.z;
+#endif
+        p4est_geometry_transform_coordinates (ggeom, jt, coords, gxyz);
+        p4est_geometry_transform_coordinates (lgeom, jt, coords, lxyz);
+        for (j = 0; j < 3; ++j) {
+          SC_CHECK_ABORT (gxyz[j] == lxyz[j], "Local geometry");
+        }
+      }
+    }
+  }
+
+  /* the forest is written with the vertices of the local trees */
+  snprintf (filename, BUFSIZ, "%s_local_%s", P4EST_STRING, which);
+  p4est_vtk_write_file (p4est, lgeom, filename);
+
+  p4est_geometry_destroy (lgeom);
+  p4est_geometry_destroy (ggeom);
+  p4est_connectivity_destroy (local);
+  sc_array_reset (&tree_global);
+  p4est_destroy (p4est);
+}
+
+/** Store the tree numbers as attributes. */
+static p4est_connectivity_t *
+test_attr (p4est_connectivity_t * conn)
+{
+  p4est_topidx_t      jt;
+
+  p4est_connectivity_set_attr (conn, sizeof (p4est_topidx_t));
+  for (jt = 0; jt < conn->num_trees; ++jt) {
+    ((p4est_topidx_t *) conn->tree_to_attr)[jt] = jt;
+  }
+  return conn;
+}
+
+/** Extract and load the trees of one process and check their connections. */
+static void
+test_local (sc_MPI_Comm mpicomm, p4est_connectivity_t * conn,
+            const char *which)
+{
+  int                 mpiret, mpisize, mpirank;
+  int                 retval;
+  char                filename[BUFSIZ];
+  size_t              bytes, bytes_global;
+  p4est_topidx_t      first_tree, last_tree, lt;
+  p4est_topidx_t     *tree_global;
+  sc_array_t          global_extract, global_load;
+  p4est_connectivity_t *extracted, *loaded;
+
+  mpiret = sc_MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  SC_GLOBAL_INFOF ("Testing local connectivity %s\n", which);
+  snprintf (filename, BUFSIZ, "%s_local_%s.conn", P4EST_STRING, which);
+  if (mpirank == 0) {
+    retval = p4est_connectivity_save (filename, conn);
+    SC_CHECK_ABORT (!retval, "Connectivity save");
+  }
+  mpiret = sc_MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  first_tree = (p4est_topidx_t)
+    (((long long) conn->num_trees * mpirank) / mpisize);
+  last_tree = (p4est_topidx_t)
+    (((long long) conn->num_trees * (mpirank + 1)) / mpisize) - 1;
+
+  sc_array_init (&global_extract, sizeof (p4est_topidx_t));
+  sc_array_init (&global_load, sizeof (p4est_topidx_t));
+  extracted = p4est_connectivity_extract (conn, first_tree, last_tree,
+                                          &global_extract);
+  loaded = p4est_connectivity_load_local (filename, first_tree, last_tree,
+                                          &global_load, &bytes);
+  SC_CHECK_ABORT (loaded != NULL, "Local connectivity load");
+  SC_CHECK_ABORT (p4est_connectivity_is_valid (extracted),
+                  "Local connectivity valid");
+  SC_CHECK_ABORT (p4est_connectivity_is_equal (extracted, loaded) &&
+                  sc_array_is_equal (&global_extract, &global_load),
+                  "Local connectivity equal");
+  SC_CHECK_ABORT (extracted->num_trees <= conn->num_trees,
+                  "Local number of trees");
+  SC_CHECK_ABORT (extracted->tree_attr_bytes == conn->tree_attr_bytes,
+                  "Local tree attributes");
+
+  /* the trees of the range come in order */
+  tree_global = (p4est_topidx_t *) global_extract.array;
+  for (lt = 0; lt < extracted->num_trees; ++lt) {
+    SC_CHECK_ABORT (lt == 0 || tree_global[lt - 1] < tree_global[lt],
+                    "Local tree order");
+    SC_CHECK_ABORT (conn->tree_attr_bytes == 0 ||
+                    !memcmp (extracted->tree_to_attr +
+                             lt * conn->tree_attr_bytes,
+                             conn->tree_to_attr +
+                             tree_global[lt] * conn->tree_attr_bytes,
+                             conn->tree_attr_bytes), "Local attribute");
+    if (first_tree <= tree_global[lt] && tree_global[lt] <= last_tree) {
+      test_local_tree (conn, extracted, tree_global, lt);
+    }
+  }
+
+  /* a process with few trees reads less than the whole file */
+  p4est_connectivity_destroy (loaded);
+  loaded = p4est_connectivity_load (filename, &bytes_global);
+  SC_CHECK_ABORT (loaded != NULL && p4est_connectivity_is_equal (conn, loaded),
+                  "Global connectivity load");
+  SC_CHECK_ABORT (2 * extracted->num_trees > conn->num_trees ||
+                  bytes < bytes_global, "Local bytes read");
+  SC_GLOBAL_INFOF ("Local connectivity %s bytes %lld of %lld\n", which,
+                   (long long) bytes, (long long) bytes_global);
+
+  p4est_connectivity_destroy (extracted);
+  p4est_connectivity_destroy (loaded);
+  sc_array_reset (&global_extract);
+  sc_array_reset (&global_load);
+
+  test_local_forest (mpicomm, conn, which);
+  p4est_connectivity_destroy (conn);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int                 mpiret;
+  sc_MPI_Comm         mpicomm;
+
+  /* initialize MPI and p4est internals */
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+#ifndef P4_TO_P8
+  test_local (mpicomm, p4est_connectivity_new_unitsquare (), "unitsquare");
+  test_local (mpicomm, p4est_connectivity_new_moebius (), "moebius");
+  test_local (mpicomm, p4est_connectivity_new_star (), "star");
+  test_local (mpicomm, p4est_connectivity_new_disk (1, 1), "disk11");
+  test_local (mpicomm,
+              test_attr (p4est_connectivity_new_brick (12, 9, 1, 0)),
+              "brick10");
+#else
+  test_local (mpicomm, p8est_connectivity_new_unitcube (), "unitcube");
+  test_local (mpicomm, p8est_connectivity_new_twowrap (), "twowrap");
+  test_local (mpicomm, p8est_connectivity_new_rotcubes (), "rotcubes");
+  test_local (mpicomm,
+              test_attr (p8est_connectivity_new_brick (6, 5, 4, 1, 0, 1)),
+              "brick101");
+#endif
+
+  /* clean up and exit */
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+  return 0;
+}
@@ -0,0 +1,181 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef P4_TO_P8
+#include <p4est_connectivity.h>
+#else
+#include <p8est_connectivity.h>
+#endif
+
+/** Permute the trees by a reproducible pseudo-random sequence. */
+static void
+test_shuffle_trees (p4est_connectivity_t * conn, unsigned long seed)
+{
+  size_t              zz, zj, swap;
+  size_t             *perm;
+  unsigned long       state = seed;
+  sc_array_t         *newid;
+
+  /* Fisher-Yates shuffle with a linear congruential generator */
+  newid = sc_array_new_count (sizeof (size_t), (size_t) conn->num_trees);
+  perm = (size_t *) newid->array;
+  for (zz = 0; zz < newid->elem_count; ++zz) {
+    perm[zz] = zz;
+  }
+  for (zz = newid->elem_count; zz > 1; --zz) {
+    state = (state * 1103515245UL + 12345UL) & 0x7fffffffUL;
+    zj = (size_t) (state % zz);
+    swap = perm[zz - 1];
+    perm[zz - 1] = perm[zj];
+    perm[zj] = swap;
+  }
+  p4est_connectivity_permute (conn, newid, 1);
+  sc_array_destroy (newid);
+}
+
+/** Count the face connections between the pieces of a uniform partition. */
+static p4est_topidx_t
+test_cut_faces (p4est_connectivity_t * conn, int num_pieces)
+{
+  int                 face;
+  p4est_topidx_t      jt, nt, cut = 0;
+
+  for (jt = 0; jt < conn->num_trees; ++jt) {
+    for (face = 0; face < P4EST_FACES; ++face) {
+      nt = conn->tree_to_tree[P4EST_FACES * jt + face];
+      if (((long long) jt * num_pieces) / conn->num_trees !=
+          ((long long) nt * num_pieces) / conn->num_trees) {
+        ++cut;
+      }
+    }
+  }
+  return cut;
+}
+
+/** Sort a shuffled connectivity and check that locality improves. */
+static void
+test_sort (p4est_connectivity_t * (*create) (void), const char *which,
+           int is_morton)
+{
+  int                 order;
+  size_t              zz;
+  char               *seen;
+  const char         *name[3] = { "Morton", "Hilbert", "RCM" };
+  p4est_topidx_t      cut_shuffled, cut_sorted;
+  sc_array_t         *newid;
+  p4est_connectivity_t *conn, *original;
+
+  original = create ();
+  newid = sc_array_new (sizeof (size_t));
+  for (order = P4EST_CONN_ORDER_MORTON; order <= P4EST_CONN_ORDER_RCM;
+       ++order) {
+    conn = create ();
+    test_shuffle_trees (conn, 1234567);
+    cut_shuffled = test_cut_faces (conn, 4);
+
+    p4est_connectivity_sort_trees (conn, (p4est_connectivity_order_t) order,
+                                   P4EST_CONNECT_FULL, newid);
+    SC_CHECK_ABORTF (p4est_connectivity_is_valid (conn),
+                     "Invalid connectivity %s after %s order", which,
+                     name[order]);
+
+    /* newid is a permutation */
+    SC_CHECK_ABORT (newid->elem_count == (size_t) conn->num_trees,
+                    "Size of newid");
+    seen = P4EST_ALLOC_ZERO (char, conn->num_trees);
+    for (zz = 0; zz < newid->elem_count; ++zz) {
+      seen[*(size_t *) sc_array_index (newid, zz)] = 1;
+    }
+    for (zz = 0; zz < newid->elem_count; ++zz) {
+      SC_CHECK_ABORT (seen[zz], "Permutation newid");
+    }
+    P4EST_FREE (seen);
+
+    cut_sorted = test_cut_faces (conn, 4);
+    SC_GLOBAL_INFOF ("Connectivity %s %s order cuts %lld of %lld faces\n",
+                     which, name[order], (long long) cut_sorted,
+                     (long long) cut_shuffled);
+    SC_CHECK_ABORTF (cut_sorted < cut_shuffled,
+                     "No locality for %s order of %s", name[order], which);
+
+    /* the Morton order of a power-of-two brick is the original one */
+    if (is_morton && order == P4EST_CONN_ORDER_MORTON) {
+      SC_CHECK_ABORTF (p4est_connectivity_is_equal (conn, original),
+                       "Morton order of %s differs", which);
+    }
+    p4est_connectivity_destroy (conn);
+  }
+  sc_array_destroy (newid);
+  p4est_connectivity_destroy (original);
+}
+
+#ifndef P4_TO_P8
+
+static p4est_connectivity_t *
+test_brick (void)
+{
+  return p4est_connectivity_new_brick (16, 16, 0, 0);
+}
+
+static p4est_connectivity_t *
+test_brick_periodic (void)
+{
+  return p4est_connectivity_new_brick (20, 11, 1, 0);
+}
+
+#else
+
+static p8est_connectivity_t *
+test_brick (void)
+{
+  return p8est_connectivity_new_brick (8, 8, 8, 0, 0, 0);
+}
+
+static p8est_connectivity_t *
+test_brick_periodic (void)
+{
+  return p8est_connectivity_new_brick (9, 7, 5, 1, 0, 1);
+}
+
+#endif
+
+int
+main (int argc, char *argv[])
+{
+  int                 mpiret;
+
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  sc_init (sc_MPI_COMM_WORLD, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+  test_sort (test_brick, "brick", 1);
+  test_sort (test_brick_periodic, "periodic brick", 0);
+
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+  return 0;
+}
@@ -0,0 +1,158 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef P4_TO_P8
+#include <p4est_cost.h>
+#include <p4est_extended.h>
+#else
+#include <p8est_cost.h>
+#include <p8est_extended.h>
+#endif
+
+#ifndef P4_TO_P8
+static const int    refine_level = 6;
+#else
+static const int    refine_level = 4;
+#endif
+
+/* the simulated time of a quadrant in each class */
+static const double class_cost[2] = { 1.e-6, 5.e-6 };
+
+/* the forest's user pointer, which the callbacks must always see */
+static int          user_tag;
+
+static int
+refine_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+           p4est_quadrant_t * quadrant)
+{
+  return (int) quadrant->level < refine_level &&
+    (quadrant->level < 2 || quadrant->x < P4EST_ROOT_LEN / 4);
+}
+
+/* quadrants in the first tree are expensive */
+static int
+class_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+          p4est_quadrant_t * quadrant)
+{
+  SC_CHECK_ABORT (p4est->user_pointer == &user_tag, "Class user pointer");
+  return which_tree == 0;
+}
+
+/* record a simulated measurement for every local quadrant */
+static void
+measure (p4est_t * p4est, p4est_cost_t * cost)
+{
+  size_t              zz;
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      p4est_cost_add (cost, p4est, jt, q, class_cost[class_fn (p4est, jt, q)]
+                      * (1. + (double) q->level / refine_level));
+    }
+  }
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 l, c;
+  unsigned            crc;
+  double              expected, before, after;
+  sc_MPI_Comm         mpicomm;
+  p4est_t            *p4est;
+  p4est_connectivity_t *connectivity;
+  p4est_cost_t       *cost;
+  p4est_gloidx_t      shipped;
+
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+#ifndef P4_TO_P8
+  connectivity = p4est_connectivity_new_brick (3, 1, 0, 0);
+#else
+  connectivity = p8est_connectivity_new_brick (3, 1, 1, 0, 0, 0);
+#endif
+  p4est = p4est_new_ext (mpicomm, connectivity, 0, 0, 1, 0, NULL,
+                         &user_tag);
+  p4est_refine (p4est, 1, refine_fn, NULL);
+  p4est_partition (p4est, 0, NULL);
+  crc = p4est_checksum (p4est);
+
+  /* the model reproduces the mean of each sampled level and class */
+  cost = p4est_cost_new (2, class_fn);
+  measure (p4est, cost);
+  p4est_cost_fit (cost, mpicomm);
+  for (l = 0; l <= refine_level; ++l) {
+    for (c = 0; c < 2; ++c) {
+      expected = class_cost[c] * (1. + (double) l / refine_level);
+      SC_CHECK_ABORT (fabs (cost->model[l * 2 + c] - expected) <=
+                      1e-12 * expected || cost->counts[l * 2 + c] == 0.,
+                      "Cost model");
+    }
+  }
+
+  /* a partition by the model reduces the predicted imbalance */
+  before = p4est_cost_imbalance (cost, p4est);
+  shipped = p4est_partition_auto (p4est, cost, 1.01, 0);
+  SC_CHECK_ABORT (cost->imbalance == before, "Cost imbalance");
+  SC_CHECK_ABORT (p4est->user_pointer == &user_tag, "Cost user pointer");
+  SC_CHECK_ABORT (crc == p4est_checksum (p4est), "Cost checksum");
+  after = p4est_cost_imbalance (cost, p4est);
+  if (p4est->mpisize > 1) {
+    SC_CHECK_ABORT (shipped > 0 && after < before, "Cost partition");
+  }
+
+  /* nothing happens below the threshold */
+  shipped = p4est_partition_auto (p4est, cost, after, 0);
+  SC_CHECK_ABORT (shipped == 0, "Cost threshold");
+
+  /* the samples go away but the model stays until the next fit */
+  expected = cost->model[refine_level * 2 + 1];
+  p4est_cost_reset (cost);
+  SC_CHECK_ABORT (cost->counts[refine_level * 2 + 1] == 0. &&
+                  cost->model[refine_level * 2 + 1] == expected,
+                  "Cost reset");
+  p4est_cost_fit (cost, mpicomm);
+  SC_CHECK_ABORT (cost->model[0] == 1., "Cost fit without samples");
+
+  p4est_cost_destroy (cost);
+  p4est_destroy (p4est);
+  p4est_connectivity_destroy (connectivity);
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
@@ -24,12 +24,16 @@
 
 #ifndef P4_TO_P8
 #include <p4est_bits.h>
+#include <p4est_extended.h>
 #include <p4est_ghost.h>
 #include <p4est_lnodes.h>
+#include <p4est_mesh.h>
 #else
 #include <p8est_bits.h>
+#include <p8est_extended.h>
 #include <p8est_ghost.h>
 #include <p8est_lnodes.h>
+#include <p8est_mesh.h>
 #endif
 
 #ifndef P4_TO_P8
@@ -374,6 +378,497 @@ test_exchange_D (p4est_t * p4est, p4est_ghost_t * ghost)
   P4EST_FREE (ghost_struct_data);
 }
 
+static void
+test_exchange_E (p4est_t * p4est, p4est_ghost_t * ghost)
+{
+  const int           num_rounds = 3;
+  int                 round;
+  size_t              zz;
+  p4est_gloidx_t      gnum;
+  p4est_quadrant_t   *q;
+  p4est_tree_t       *tree;
+  void              **mirror_data;
+  test_exchange_t    *mirror_struct_data;
+  test_exchange_t    *ghost_struct_data, *ghost_plan_data, *e;
+  p4est_ghost_plan_t *plan;
+
+  /* Test E: a persistent plan matches the custom exchange in every round */
+
+  mirror_struct_data =
+    P4EST_ALLOC (test_exchange_t, ghost->mirrors.elem_count);
+  mirror_data = P4EST_ALLOC (void *, ghost->mirrors.elem_count);
+  ghost_struct_data = P4EST_ALLOC (test_exchange_t, ghost->ghosts.elem_count);
+  ghost_plan_data = P4EST_ALLOC (test_exchange_t, ghost->ghosts.elem_count);
+  plan = p4est_ghost_plan_new (p4est, ghost, sizeof (test_exchange_t),
+                               ghost_plan_data);
+  for (round = 0; round < num_rounds; ++round) {
+    for (zz = 0; zz < ghost->mirrors.elem_count; ++zz) {
+      q = p4est_quadrant_array_index (&ghost->mirrors, zz);
+      gnum = p4est->global_first_quadrant[p4est->mpirank] +
+        (p4est_gloidx_t) q->p.piggy3.local_num;
+      mirror_data[zz] = e = mirror_struct_data + zz;
+      memset (e, 0, sizeof (test_exchange_t));
+      e->gi = gnum;
+      e->ll = (long) gnum + round;
+      e->magic = TEST_EXCHANGE_MAGIC;
+    }
+    p4est_ghost_exchange_custom (p4est, ghost, sizeof (test_exchange_t),
+                                 mirror_data, ghost_struct_data);
+    p4est_ghost_plan_exchange (plan, mirror_data);
+    SC_CHECK_ABORT (!memcmp (ghost_struct_data, ghost_plan_data,
+                             ghost->ghosts.elem_count *
+                             sizeof (test_exchange_t)),
+                    "Ghost exchange mismatch E1");
+  }
+  p4est_ghost_plan_destroy (plan);
+  P4EST_FREE (mirror_data);
+  P4EST_FREE (mirror_struct_data);
+
+  /* the plan sends the quadrant user data if no mirror data is given */
+  p4est_reset_data (p4est, sizeof (test_exchange_t), NULL, NULL);
+  plan = p4est_ghost_plan_new (p4est, ghost, sizeof (test_exchange_t),
+                               ghost_plan_data);
+  for (round = 0; round < num_rounds; ++round) {
+    for (zz = 0; zz < ghost->mirrors.elem_count; ++zz) {
+      q = p4est_quadrant_array_index (&ghost->mirrors, zz);
+      tree = p4est_tree_array_index (p4est->trees, q->p.piggy3.which_tree);
+      q = p4est_quadrant_array_index (&tree->quadrants, (size_t)
+                                      (q->p.piggy3.local_num -
+                                       tree->quadrants_offset));
+      e = (test_exchange_t *) q->p.user_data;
+      memset (e, 0, sizeof (test_exchange_t));
+      e->gi = (p4est_gloidx_t) zz;
+      e->ll = (long) zz * num_rounds + round;
+      e->magic = TEST_EXCHANGE_MAGIC;
+    }
+    p4est_ghost_exchange_data (p4est, ghost, ghost_struct_data);
+    p4est_ghost_plan_begin (plan, NULL);
+    p4est_ghost_plan_end (plan);
+    SC_CHECK_ABORT (!memcmp (ghost_struct_data, ghost_plan_data,
+                             ghost->ghosts.elem_count *
+                             sizeof (test_exchange_t)),
+                    "Ghost exchange mismatch E2");
+  }
+  p4est_ghost_plan_destroy (plan);
+  P4EST_FREE (ghost_struct_data);
+  P4EST_FREE (ghost_plan_data);
+}
+
+static void
+test_exchange_F (p4est_t * p4est, p4est_ghost_t * ghost)
+{
+  const p4est_locidx_t nl = p4est->local_num_quadrants;
+  const p4est_locidx_t ng = (p4est_locidx_t) ghost->ghosts.elem_count;
+  int                 p;
+  size_t              mirror_offsets[2], ghost_offsets[2];
+  size_t              aos_offsets[2], aos_sizes[2];
+  size_t              soa_sizes[2] = { sizeof (double), sizeof (double) };
+  p4est_locidx_t      li, gexcl, gincl, gl;
+  p4est_gloidx_t      gnum;
+  p4est_quadrant_t   *q;
+  double             *mirror_values, *ghost_values;
+  test_exchange_t    *mirror_structs, *ghost_structs;
+  p4est_ghost_layout_t mirror_layout, ghost_layout;
+  p4est_ghost_plan_t *plan;
+
+  /* Test F: exchange fields directly between user arrays */
+
+  /* two fields in struct-of-arrays storage */
+  mirror_values = P4EST_ALLOC (double, 2 * nl);
+  ghost_values = P4EST_ALLOC (double, 2 * ng);
+  gnum = p4est->global_first_quadrant[p4est->mpirank];
+  for (li = 0; li < nl; ++li) {
+    mirror_values[li] = (double) (gnum + li);
+    mirror_values[nl + li] = -(double) (gnum + li);
+  }
+  mirror_offsets[0] = ghost_offsets[0] = 0;
+  mirror_offsets[1] = nl * sizeof (double);
+  ghost_offsets[1] = ng * sizeof (double);
+  mirror_layout.base = mirror_values;
+  mirror_layout.stride = sizeof (double);
+  mirror_layout.num_fields = 2;
+  mirror_layout.field_offsets = mirror_offsets;
+  mirror_layout.field_sizes = soa_sizes;
+  ghost_layout = mirror_layout;
+  ghost_layout.base = ghost_values;
+  ghost_layout.field_offsets = ghost_offsets;
+  plan = p4est_ghost_plan_new_layout (p4est, ghost, &mirror_layout,
+                                      &ghost_layout);
+  p4est_ghost_plan_exchange (plan, NULL);
+  p4est_ghost_plan_destroy (plan);
+
+  /* two of three struct members in array-of-structs storage */
+  mirror_structs = P4EST_ALLOC (test_exchange_t, nl);
+  ghost_structs = P4EST_ALLOC (test_exchange_t, ng);
+  for (li = 0; li < nl; ++li) {
+    mirror_structs[li].gi = gnum + li;
+    mirror_structs[li].ll = -1;
+    mirror_structs[li].magic = TEST_EXCHANGE_MAGIC;
+  }
+  for (gl = 0; gl < ng; ++gl) {
+    ghost_structs[gl].ll = gl;
+  }
+  aos_offsets[0] = offsetof (test_exchange_t, gi);
+  aos_offsets[1] = offsetof (test_exchange_t, magic);
+  aos_sizes[0] = sizeof (p4est_gloidx_t);
+  aos_sizes[1] = sizeof (double);
+  mirror_layout.base = mirror_structs;
+  mirror_layout.stride = sizeof (test_exchange_t);
+  mirror_layout.field_offsets = aos_offsets;
+  mirror_layout.field_sizes = aos_sizes;
+  ghost_layout = mirror_layout;
+  ghost_layout.base = ghost_structs;
+  plan = p4est_ghost_plan_new_layout (p4est, ghost, &mirror_layout,
+                                      &ghost_layout);
+  p4est_ghost_plan_exchange (plan, NULL);
+  p4est_ghost_plan_destroy (plan);
+
+  gexcl = 0;
+  for (p = 0; p < p4est->mpisize; ++p) {
+    gincl = ghost->proc_offsets[p + 1];
+    gnum = p4est->global_first_quadrant[p];
+    for (gl = gexcl; gl < gincl; ++gl) {
+      q = p4est_quadrant_array_index (&ghost->ghosts, gl);
+      SC_CHECK_ABORT ((double) (gnum + q->p.piggy3.local_num) ==
+                      ghost_values[gl], "Ghost exchange mismatch F1");
+      SC_CHECK_ABORT (-(double) (gnum + q->p.piggy3.local_num) ==
+                      ghost_values[ng + gl], "Ghost exchange mismatch F2");
+      SC_CHECK_ABORT (gnum + (p4est_gloidx_t) q->p.piggy3.local_num ==
+                      ghost_structs[gl].gi, "Ghost exchange mismatch F3");
+      SC_CHECK_ABORT (ghost_structs[gl].ll == (long long) gl,
+                      "Ghost exchange mismatch F4");
+      SC_CHECK_ABORT (ghost_structs[gl].magic == TEST_EXCHANGE_MAGIC,
+                      "Ghost exchange mismatch F5");
+    }
+    gexcl = gincl;
+  }
+  P4EST_ASSERT (gexcl == ng);
+
+  P4EST_FREE (mirror_values);
+  P4EST_FREE (ghost_values);
+  P4EST_FREE (mirror_structs);
+  P4EST_FREE (ghost_structs);
+}
+
+static void
+test_exchange_G (p4est_t * p4est, p4est_ghost_t * ghost)
+{
+  const int           exchange_minlevel = 1;
+  const int           exchange_maxlevel = refine_level - 1;
+  const size_t        num_mirrors = ghost->mirrors.elem_count;
+  const size_t        num_ghosts = ghost->ghosts.elem_count;
+  int                 mpiret;
+  int                 p, num_peers;
+  size_t              zz;
+  unsigned long       bytes[2], bytes_sum[2];
+  p4est_gloidx_t      gnum;
+  p4est_quadrant_t   *q;
+  p4est_ghost_field_t fields[3];
+  p4est_inspect_t     inspect;
+  void              **mirror_structs, **mirror_doubles;
+  test_exchange_t    *mirror_struct_data, *ghost_structs, *ghost_custom;
+  double             *mirror_double_data, *ghost_doubles, *ghost_levels;
+
+  /* Test G: batch fields with their own sizes and level ranges */
+
+  mirror_struct_data = P4EST_ALLOC (test_exchange_t, num_mirrors);
+  mirror_double_data = P4EST_ALLOC (double, num_mirrors);
+  mirror_structs = P4EST_ALLOC (void *, num_mirrors);
+  mirror_doubles = P4EST_ALLOC (void *, num_mirrors);
+  for (zz = 0; zz < num_mirrors; ++zz) {
+    q = p4est_quadrant_array_index (&ghost->mirrors, zz);
+    gnum = p4est->global_first_quadrant[p4est->mpirank] +
+      (p4est_gloidx_t) q->p.piggy3.local_num;
+    mirror_structs[zz] = mirror_struct_data + zz;
+    mirror_struct_data[zz].gi = gnum;
+    mirror_struct_data[zz].ll = (long) gnum;
+    mirror_struct_data[zz].magic = TEST_EXCHANGE_MAGIC;
+    mirror_doubles[zz] = mirror_double_data + zz;
+    mirror_double_data[zz] = (double) gnum + .5;
+  }
+
+  /* the batch is compared to separate custom exchanges */
+  ghost_structs = P4EST_ALLOC (test_exchange_t, num_ghosts);
+  ghost_custom = P4EST_ALLOC (test_exchange_t, num_ghosts);
+  ghost_doubles = P4EST_ALLOC_ZERO (double, num_ghosts);
+  ghost_levels = P4EST_ALLOC_ZERO (double, num_ghosts);
+  p4est_ghost_exchange_custom (p4est, ghost, sizeof (test_exchange_t),
+                               mirror_structs, ghost_custom);
+  p4est_ghost_exchange_custom_levels (p4est, ghost, exchange_minlevel,
+                                      exchange_maxlevel, sizeof (double),
+                                      mirror_doubles, ghost_levels);
+
+  fields[0].data_size = sizeof (test_exchange_t);
+  fields[0].minlevel = 0;
+  fields[0].maxlevel = P4EST_QMAXLEVEL;
+  fields[0].mirror_data = mirror_structs;
+  fields[0].ghost_data = ghost_structs;
+  fields[1].data_size = 0;
+  fields[1].minlevel = 0;
+  fields[1].maxlevel = P4EST_QMAXLEVEL;
+  fields[1].mirror_data = NULL;
+  fields[1].ghost_data = NULL;
+  fields[2].data_size = sizeof (double);
+  fields[2].minlevel = exchange_minlevel;
+  fields[2].maxlevel = exchange_maxlevel;
+  fields[2].mirror_data = mirror_doubles;
+  fields[2].ghost_data = ghost_doubles;
+
+  memset (&inspect, 0, sizeof (p4est_inspect_t));
+  p4est->inspect = &inspect;
+  p4est_ghost_exchange_fields (p4est, ghost, 3, fields);
+  p4est->inspect = NULL;
+
+  SC_CHECK_ABORT (!memcmp (ghost_structs, ghost_custom,
+                           num_ghosts * sizeof (test_exchange_t)),
+                  "Ghost exchange mismatch G1");
+  SC_CHECK_ABORT (!memcmp (ghost_doubles, ghost_levels,
+                           num_ghosts * sizeof (double)),
+                  "Ghost exchange mismatch G2");
+
+  /* there is at most one message per peer and all bytes arrive */
+  for (num_peers = 0, p = 0; p < p4est->mpisize; ++p) {
+    if (ghost->mirror_proc_offsets[p + 1] > ghost->mirror_proc_offsets[p]) {
+      ++num_peers;
+    }
+  }
+  SC_CHECK_ABORT (inspect.ghost_fields_sends == (size_t) num_peers,
+                  "Ghost exchange messages G3");
+  bytes[0] = (unsigned long) inspect.ghost_fields_bytes_sent;
+  bytes[1] = (unsigned long) inspect.ghost_fields_bytes_received;
+  mpiret = sc_MPI_Allreduce (bytes, bytes_sum, 2, sc_MPI_UNSIGNED_LONG,
+                             sc_MPI_SUM, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (bytes_sum[0] == bytes_sum[1], "Ghost exchange bytes G4");
+
+  P4EST_FREE (mirror_struct_data);
+  P4EST_FREE (mirror_double_data);
+  P4EST_FREE (mirror_structs);
+  P4EST_FREE (mirror_doubles);
+  P4EST_FREE (ghost_structs);
+  P4EST_FREE (ghost_custom);
+  P4EST_FREE (ghost_doubles);
+  P4EST_FREE (ghost_levels);
+}
+
+static void
+test_faces_pack (p4est_t * p4est, const p4est_quadrant_t * mirror, int face,
+                 void *slice)
+{
+  test_exchange_t    *e = (test_exchange_t *) slice;
+
+  e->gi = p4est->global_first_quadrant[p4est->mpirank] +
+    (p4est_gloidx_t) mirror->p.piggy3.local_num;
+  e->ll = face;
+  e->magic = TEST_EXCHANGE_MAGIC;
+}
+
+static void
+test_exchange_H (p4est_t * p4est, p4est_ghost_t * ghost)
+{
+  const size_t        num_ghosts = ghost->ghosts.elem_count;
+  int                 mpiret;
+  int                 p, f;
+  int                 nface, nrank;
+  long                counts[2], counts_sum[2];
+  p4est_locidx_t      gexcl, gincl, gl;
+  p4est_locidx_t      nquad;
+  p4est_gloidx_t      gnum;
+  p4est_topidx_t      t;
+  p4est_quadrant_t   *q;
+  p4est_tree_t       *tree;
+  p4est_mesh_t       *mesh;
+  p4est_mesh_face_neighbor_t mfn;
+  p4est_ghost_faces_t *faces;
+  test_exchange_t    *ghost_face_data, *e;
+
+  /* Test H: exchange only the faces between processes */
+
+  mesh = p4est_mesh_new (p4est, ghost, P4EST_CONNECT_FACE);
+  faces = p4est_ghost_faces_new (p4est, ghost, mesh);
+  ghost_face_data =
+    P4EST_ALLOC_ZERO (test_exchange_t, P4EST_FACES * num_ghosts);
+  p4est_ghost_faces_exchange (faces, sizeof (test_exchange_t),
+                              test_faces_pack, ghost_face_data);
+
+  /* every flagged face carries its quadrant's number and face */
+  gexcl = 0;
+  for (p = 0; p < p4est->mpisize; ++p) {
+    gincl = ghost->proc_offsets[p + 1];
+    gnum = p4est->global_first_quadrant[p];
+    for (gl = gexcl; gl < gincl; ++gl) {
+      q = p4est_quadrant_array_index (&ghost->ghosts, gl);
+      for (f = 0; f < P4EST_FACES; ++f) {
+        e = ghost_face_data + P4EST_FACES * gl + f;
+        if (faces->ghost_faces[gl] & (1 << f)) {
+          SC_CHECK_ABORT (gnum + (p4est_gloidx_t) q->p.piggy3.local_num ==
+                          e->gi && e->ll == f &&
+                          e->magic == TEST_EXCHANGE_MAGIC,
+                          "Ghost exchange mismatch H1");
+        }
+        else {
+          SC_CHECK_ABORT (e->magic == 0., "Ghost exchange mismatch H2");
+        }
+      }
+    }
+    gexcl = gincl;
+  }
+
+  /* every ghost seen across a face of a local quadrant is flagged */
+  for (t = p4est->first_local_tree; t <= p4est->last_local_tree; ++t) {
+    tree = p4est_tree_array_index (p4est->trees, t);
+    for (gl = 0; gl < (p4est_locidx_t) tree->quadrants.elem_count; ++gl) {
+      p4est_mesh_face_neighbor_init2 (&mfn, p4est, ghost, mesh, t, gl);
+      while (p4est_mesh_face_neighbor_next (&mfn, NULL, &nquad, &nface,
+                                            &nrank) != NULL) {
+        if (nrank != p4est->mpirank) {
+          nface = (nface + P4EST_HALF * P4EST_FACES) % P4EST_FACES;
+          SC_CHECK_ABORT (faces->ghost_faces[nquad] & (1 << nface),
+                          "Ghost exchange faces H3");
+        }
+      }
+    }
+  }
+
+  /* all faces sent are received */
+  counts[0] = (long) faces->send_offsets[p4est->mpisize];
+  counts[1] = (long) faces->recv_offsets[p4est->mpisize];
+  mpiret = sc_MPI_Allreduce (counts, counts_sum, 2, sc_MPI_LONG,
+                             sc_MPI_SUM, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (counts_sum[0] == counts_sum[1], "Ghost exchange faces H4");
+
+  P4EST_FREE (ghost_face_data);
+  p4est_ghost_faces_destroy (faces);
+  p4est_mesh_destroy (mesh);
+}
+
+static int
+update_refine_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+                  p4est_quadrant_t * quadrant)
+{
+  return quadrant->level < refine_level &&
+    (p4est_quadrant_child_id (quadrant) + (int) which_tree) % 5 == 0;
+}
+
+static int
+update_coarsen_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+                   p4est_quadrant_t * quadrants[])
+{
+  p4est_quadrant_t    parent;
+
+  if (quadrants[0]->level <= 2) {
+    return 0;
+  }
+  p4est_quadrant_parent (quadrants[0], &parent);
+  return (p4est_quadrant_child_id (&parent) + (int) which_tree) % 3 == 0;
+}
+
+static void
+update_replace_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+                   int num_outgoing, p4est_quadrant_t * outgoing[],
+                   int num_incoming, p4est_quadrant_t * incoming[])
+{
+  int                 i;
+  sc_array_t         *changed = (sc_array_t *) p4est->user_pointer;
+  p4est_quadrant_t   *q;
+
+  for (i = 0; i < num_incoming; ++i) {
+    q = p4est_quadrant_array_push_copy (changed, incoming[i]);
+    q->p.piggy3.which_tree = which_tree;
+  }
+}
+
+static void
+test_ghost_compare (p4est_t * p4est, p4est_ghost_t * ghost)
+{
+  size_t              zz;
+  p4est_ghost_t      *fresh;
+  p4est_quadrant_t   *q, *r;
+
+  fresh = p4est_ghost_new (p4est, ghost->btype);
+  SC_CHECK_ABORT (p4est_ghost_checksum (p4est, ghost) ==
+                  p4est_ghost_checksum (p4est, fresh), "Update checksum");
+
+  SC_CHECK_ABORT (ghost->ghosts.elem_count == fresh->ghosts.elem_count,
+                  "Update ghost count");
+  for (zz = 0; zz < ghost->ghosts.elem_count; ++zz) {
+    q = p4est_quadrant_array_index (&ghost->ghosts, zz);
+    r = p4est_quadrant_array_index (&fresh->ghosts, zz);
+    SC_CHECK_ABORT (p4est_quadrant_is_equal_piggy (q, r) &&
+                    q->p.piggy3.local_num == r->p.piggy3.local_num,
+                    "Update ghost");
+  }
+  SC_CHECK_ABORT (ghost->mirrors.elem_count == fresh->mirrors.elem_count,
+                  "Update mirror count");
+  for (zz = 0; zz < ghost->mirrors.elem_count; ++zz) {
+    q = p4est_quadrant_array_index (&ghost->mirrors, zz);
+    r = p4est_quadrant_array_index (&fresh->mirrors, zz);
+    SC_CHECK_ABORT (p4est_quadrant_is_equal_piggy (q, r) &&
+                    q->p.piggy3.local_num == r->p.piggy3.local_num,
+                    "Update mirror");
+  }
+  SC_CHECK_ABORT (!memcmp (ghost->tree_offsets, fresh->tree_offsets,
+                           (ghost->num_trees + 1) * sizeof (p4est_locidx_t))
+                  && !memcmp (ghost->proc_offsets, fresh->proc_offsets,
+                              (ghost->mpisize + 1) *
+                              sizeof (p4est_locidx_t))
+                  && !memcmp (ghost->mirror_tree_offsets,
+                              fresh->mirror_tree_offsets,
+                              (ghost->num_trees + 1) *
+                              sizeof (p4est_locidx_t))
+                  && !memcmp (ghost->mirror_proc_offsets,
+                              fresh->mirror_proc_offsets,
+                              (ghost->mpisize + 1) *
+                              sizeof (p4est_locidx_t))
+                  && !memcmp (ghost->mirror_proc_mirrors,
+                              fresh->mirror_proc_mirrors,
+                              ghost->mirror_proc_offsets[ghost->mpisize] *
+                              sizeof (p4est_locidx_t)), "Update offsets");
+
+  p4est_ghost_destroy (fresh);
+}
+
+static void
+test_ghost_update (p4est_t * p4est)
+{
+  int                 i;
+  void               *user_pointer = p4est->user_pointer;
+  sc_array_t          changed;
+  p4est_ghost_t      *ghost[2];
+
+  p4est_balance (p4est, P4EST_CONNECT_FULL, NULL);
+  ghost[0] = p4est_ghost_new (p4est, P4EST_CONNECT_FULL);
+  ghost[1] = p4est_ghost_new (p4est, P4EST_CONNECT_FACE);
+
+  sc_array_init (&changed, sizeof (p4est_quadrant_t));
+  p4est->user_pointer = &changed;
+
+  /* refine a subset of quadrants and balance */
+  p4est_refine_ext (p4est, 1, -1, update_refine_fn, NULL,
+                    update_replace_fn);
+  p4est_balance_ext (p4est, P4EST_CONNECT_FULL, NULL, update_replace_fn);
+  for (i = 0; i < 2; ++i) {
+    p4est_ghost_update (p4est, ghost[i], &changed);
+    test_ghost_compare (p4est, ghost[i]);
+  }
+  sc_array_truncate (&changed);
+
+  /* coarsen a subset of families and balance */
+  p4est_coarsen_ext (p4est, 0, 0, update_coarsen_fn, NULL,
+                     update_replace_fn);
+  p4est_balance_ext (p4est, P4EST_CONNECT_FULL, NULL, update_replace_fn);
+  for (i = 0; i < 2; ++i) {
+    p4est_ghost_update (p4est, ghost[i], &changed);
+    test_ghost_compare (p4est, ghost[i]);
+  }
+
+  sc_array_reset (&changed);
+  p4est->user_pointer = user_pointer;
+  p4est_ghost_destroy (ghost[0]);
+  p4est_ghost_destroy (ghost[1]);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -383,6 +878,10 @@ main (int argc, char **argv)
   p4est_connectivity_t *conn;
   p4est_ghost_t      *ghost;
   p4est_ghost_exchange_t *exc;
+  p4est_ghost_t      *ghost_expand;
+  p4est_ghost_plan_t *plan;
+  test_exchange_t    *ghost_data;
+  size_t              num_ghosts, num_mirrors;
   int                 num_cycles = 2;
   int                 i;
   p4est_lnodes_t     *lnodes;
@@ -421,6 +920,10 @@ main (int argc, char **argv)
   test_exchange_B (p4est, ghost);
   test_exchange_C (p4est, ghost);
   test_exchange_D (p4est, ghost);
+  test_exchange_E (p4est, ghost);
+  test_exchange_F (p4est, ghost);
+  test_exchange_G (p4est, ghost);
+  test_exchange_H (p4est, ghost);
 
   for (i = 0; i < num_cycles; i++) {
     /* expand and test that the ghost layer can still exchange data properly
@@ -430,6 +933,9 @@ main (int argc, char **argv)
     test_exchange_B (p4est, ghost);
     test_exchange_C (p4est, ghost);
     test_exchange_D (p4est, ghost);
+    test_exchange_E (p4est, ghost);
+    test_exchange_F (p4est, ghost);
+    test_exchange_G (p4est, ghost);
   }
 
   p4est_ghost_destroy (ghost);
@@ -444,6 +950,9 @@ main (int argc, char **argv)
   test_exchange_B (p4est, ghost);
   test_exchange_C (p4est, ghost);
   test_exchange_D (p4est, ghost);
+  test_exchange_E (p4est, ghost);
+  test_exchange_F (p4est, ghost);
+  test_exchange_G (p4est, ghost);
 
   for (i = 0; i < num_cycles; i++) {
     /* expand and test that the ghost layer can still exchange data properly
@@ -454,9 +963,46 @@ main (int argc, char **argv)
     test_exchange_B (p4est, ghost);
     test_exchange_C (p4est, ghost);
     test_exchange_D (p4est, ghost);
+    test_exchange_E (p4est, ghost);
+    test_exchange_F (p4est, ghost);
+    test_exchange_G (p4est, ghost);
     test_exchange_end (exc);
   }
 
+  /* a persistent plan is invalidated by growing its ghost layer */
+  p4est_reset_data (p4est, sizeof (test_exchange_t), NULL, NULL);
+  ghost_expand = p4est_ghost_new (p4est, P4EST_CONNECT_FULL);
+  num_ghosts = ghost_expand->ghosts.elem_count;
+  num_mirrors = ghost_expand->mirrors.elem_count;
+  ghost_data = P4EST_ALLOC (test_exchange_t, num_ghosts);
+  plan = p4est_ghost_plan_new (p4est, ghost_expand,
+                               sizeof (test_exchange_t), ghost_data);
+  SC_CHECK_ABORT (p4est_ghost_plan_is_valid (plan), "Ghost plan valid");
+  p4est_ghost_plan_exchange (plan, NULL);
+  p4est_ghost_expand (p4est, ghost_expand);
+  SC_CHECK_ABORT (p4est_ghost_plan_is_valid (plan) ==
+                  (ghost_expand->ghosts.elem_count == num_ghosts &&
+                   ghost_expand->mirrors.elem_count == num_mirrors),
+                  "Ghost plan invalid after expansion");
+  p4est_ghost_plan_destroy (plan);
+  P4EST_FREE (ghost_data);
+
+  /* a persistent plan is invalidated by refinement */
+  num_ghosts = ghost_expand->ghosts.elem_count;
+  ghost_data = P4EST_ALLOC (test_exchange_t, num_ghosts);
+  plan = p4est_ghost_plan_new (p4est, ghost_expand,
+                               sizeof (test_exchange_t), ghost_data);
+  SC_CHECK_ABORT (p4est_ghost_plan_is_valid (plan), "Ghost plan valid");
+  p4est_ghost_plan_exchange (plan, NULL);
+  p4est_refine (p4est, 0, refine_fn, NULL);
+  SC_CHECK_ABORT (!p4est_ghost_plan_is_valid (plan), "Ghost plan invalid");
+  p4est_ghost_plan_destroy (plan);
+  P4EST_FREE (ghost_data);
+  p4est_ghost_destroy (ghost_expand);
+
+  /* an updated ghost layer equals a new one */
+  test_ghost_update (p4est);
+
   /* clean up */
   p4est_lnodes_destroy (lnodes);
   p4est_ghost_destroy (ghost);
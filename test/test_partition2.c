@@ -81,6 +81,13 @@ refine_fn (p4est_t * p4est, p4est_topidx_t which_tree,
   return 1;
 }
 
+static int
+coarsen_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+            p4est_quadrant_t * quadrants[])
+{
+  return quadrants[0]->level > 4;
+}
+
 static int
 weight_one (p4est_t * p4est, p4est_topidx_t which_tree,
             p4est_quadrant_t * quadrant)
@@ -99,6 +106,30 @@ weight_once (p4est_t * p4est, p4est_topidx_t which_tree,
   return 0;
 }
 
+static int
+weight_level (p4est_t * p4est, p4est_topidx_t which_tree,
+              p4est_quadrant_t * quadrant)
+{
+  return 1 + (int) quadrant->level + (int) (which_tree % 3);
+}
+
+static void
+weights_one (p4est_t * p4est, p4est_topidx_t which_tree,
+             p4est_quadrant_t * quadrant, int *weights)
+{
+  weights[0] = 1;
+}
+
+static void
+weights_two (p4est_t * p4est, p4est_topidx_t which_tree,
+             p4est_quadrant_t * quadrant, int *weights)
+{
+  weights[0] = 1;
+  if (which_tree == 0 && quadrant->x < P4EST_QUADRANT_LEN (1)) {
+    weights[1] = 3 + quadrant->level;
+  }
+}
+
 static int
 traverse_fn (p4est_t * p4est, p4est_topidx_t which_tree,
              p4est_quadrant_t * quadrant, int pfirst, int plast, void *point)
@@ -415,6 +446,368 @@ test_partition_circle (sc_MPI_Comm mpicomm,
   p4est_destroy (p4est);
 }
 
+/* a partition plan moves the cuts only as far as the tolerance requires */
+static void
+test_partition_plan (p4est_t * p4est, unsigned crc, int have_zlib,
+                     p4est_gloidx_t * pertree1, p4est_gloidx_t * pertree2)
+{
+  int                 p;
+  uint64_t            bytes;
+  p4est_gloidx_t      planned, shipped, shipped_exact;
+  p4est_locidx_t     *counts;
+  p4est_t            *copy;
+  test_transfer_t    *tt;
+
+  counts = P4EST_ALLOC (p4est_locidx_t, p4est->mpisize);
+
+  /* zero tolerance plans the same cuts as the weighted partition */
+  copy = p4est_copy (p4est, 1);
+  p4est_partition (copy, 0, NULL);
+  shipped_exact = p4est_partition_ext (copy, 0, weight_level);
+  p4est_partition (p4est, 0, NULL);
+  planned = p4est_partition_plan (p4est, weight_level, 0., counts, &bytes);
+  SC_CHECK_ABORT (bytes == (uint64_t) planned *
+                  (sizeof (p4est_quadrant_t) + p4est->data_size),
+                  "Plan bytes");
+  tt = test_transfer_pre (p4est);
+  shipped = p4est_partition_given (p4est, counts);
+  test_transfer_post (tt, p4est);
+  test_pertree (p4est, pertree1, pertree2);
+  SC_CHECK_ABORT (crc == test_checksum (p4est, have_zlib),
+                  "bad checksum after planned partition");
+  SC_CHECK_ABORT (planned == shipped && shipped == shipped_exact,
+                  "Plan shipped");
+  for (p = 0; p <= p4est->mpisize; ++p) {
+    SC_CHECK_ABORT (p4est->global_first_quadrant[p] ==
+                    copy->global_first_quadrant[p], "Plan exact");
+  }
+  p4est_destroy (copy);
+
+  /* executing a plan makes the next plan empty */
+  planned = p4est_partition_plan (p4est, weight_level, 0., counts, NULL);
+  SC_CHECK_ABORT (planned == 0, "Plan repeated");
+
+  /* a tolerance ships no more than the exact cuts */
+  p4est_partition (p4est, 0, NULL);
+  planned = p4est_partition_plan (p4est, weight_level, .25, counts, NULL);
+  SC_CHECK_ABORT (planned <= shipped_exact, "Plan tolerance");
+  shipped = p4est_partition_given (p4est, counts);
+  SC_CHECK_ABORT (planned == shipped, "Plan tolerance shipped");
+  planned = p4est_partition_plan (p4est, weight_level, .25, counts, NULL);
+  SC_CHECK_ABORT (planned == 0, "Plan tolerance repeated");
+
+  P4EST_FREE (counts);
+}
+
+/* partition by compute nodes and count the bytes sent within nodes */
+static void
+test_partition_node (p4est_t * p4est, unsigned crc, int have_zlib,
+                     p4est_gloidx_t * pertree1, p4est_gloidx_t * pertree2)
+{
+#ifdef P4EST_ENABLE_MPICOMMSHARED
+  int                 mpiret;
+  int                 k, p, ppn, num_nodes;
+  int                *node_first;
+  unsigned long       bytes[3], sums[3];
+  p4est_gloidx_t      shipped, shipped_exact, planned;
+  p4est_locidx_t     *counts;
+  p4est_inspect_t     inspect, inspect_flat;
+  sc_MPI_Comm         mpicomm;
+  p4est_t            *node, *flat;
+
+  /* group the processes into nodes of two if possible */
+  ppn = p4est->mpisize % 2 == 0 ? 2 : 1;
+  mpiret = sc_MPI_Comm_dup (p4est->mpicomm, &mpicomm);
+  SC_CHECK_MPI (mpiret);
+  sc_mpi_comm_attach_node_comms (mpicomm, ppn);
+  node = p4est_copy (p4est, 1);
+  p4est_comm_parallel_env_replace (node, mpicomm);
+  memset (&inspect, 0, sizeof (inspect));
+  node->inspect = &inspect;
+
+  node_first = P4EST_ALLOC (int, node->mpisize + 1);
+  num_nodes = p4est_comm_node_first (node, node_first);
+  SC_CHECK_ABORT (num_nodes == node->mpisize / ppn, "Node count");
+  for (k = 0; k <= num_nodes; ++k) {
+    SC_CHECK_ABORT (node_first[k] == k * ppn, "Node first");
+  }
+  for (p = 0; p < node->mpisize; ++p) {
+    SC_CHECK_ABORT (p4est_comm_is_intranode (node, p) ==
+                    (p / ppn == node->mpirank / ppn), "Node member");
+  }
+  P4EST_FREE (node_first);
+
+  /* zero tolerance yields the weighted partition */
+  p4est_partition (node, 0, NULL);
+  flat = p4est_copy (node, 1);
+  memset (&inspect_flat, 0, sizeof (inspect_flat));
+  flat->inspect = &inspect_flat;
+  shipped_exact = p4est_partition_ext (flat, 0, weight_level);
+  shipped = p4est_partition_node (node, 0, weight_level, 0.);
+  SC_CHECK_ABORT (shipped == shipped_exact, "Node shipped");
+  for (p = 0; p <= node->mpisize; ++p) {
+    SC_CHECK_ABORT (node->global_first_quadrant[p] ==
+                    flat->global_first_quadrant[p], "Node exact");
+  }
+  test_pertree (node, pertree1, pertree2);
+  SC_CHECK_ABORT (crc == test_checksum (node, have_zlib),
+                  "bad checksum after partition by nodes");
+
+  /* all quadrants sent are counted within or between nodes */
+  bytes[0] = (unsigned long) inspect.partition_bytes_intranode;
+  bytes[1] = (unsigned long) inspect.partition_bytes_internode;
+  bytes[2] = (unsigned long) inspect_flat.partition_bytes_internode;
+  mpiret = sc_MPI_Allreduce (bytes, sums, 3, sc_MPI_UNSIGNED_LONG,
+                             sc_MPI_SUM, node->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (sums[0] + sums[1] >= (unsigned long) shipped *
+                  (sizeof (p4est_quadrant_t) + node->data_size),
+                  "Node bytes");
+  SC_CHECK_ABORT (ppn > 1 || sums[0] == 0, "Node bytes intranode");
+
+  /* a tolerance ships no more between nodes than the exact cuts */
+  p4est_partition (node, 0, NULL);
+  p4est_partition (flat, 0, NULL);
+  counts = P4EST_ALLOC (p4est_locidx_t, node->mpisize);
+  planned = p4est_partition_plan (node, weight_level, .25, counts, NULL);
+  P4EST_FREE (counts);
+  shipped_exact = p4est_partition_ext (flat, 0, weight_level);
+  shipped = p4est_partition_node (node, 0, weight_level, .25);
+  SC_CHECK_ABORT (ppn > 1 || shipped == planned, "Node plan");
+  bytes[0] = (unsigned long) inspect.partition_bytes_intranode;
+  bytes[1] = (unsigned long) inspect.partition_bytes_internode;
+  bytes[2] = (unsigned long) inspect_flat.partition_bytes_internode;
+  mpiret = sc_MPI_Allreduce (bytes, sums, 3, sc_MPI_UNSIGNED_LONG,
+                             sc_MPI_SUM, node->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (sums[1] <= sums[2], "Node bytes tolerance");
+  test_pertree (node, pertree1, pertree2);
+  SC_CHECK_ABORT (crc == test_checksum (node, have_zlib),
+                  "bad checksum after partition by nodes with tolerance");
+
+  /* the partition by nodes is stable */
+  shipped = p4est_partition_node (node, 0, weight_level, .25);
+  SC_CHECK_ABORT (shipped == 0, "Node repeated");
+
+  p4est_destroy (flat);
+  p4est_destroy (node);
+  mpiret = sc_MPI_Comm_free (&mpicomm);
+  SC_CHECK_MPI (mpiret);
+#endif
+}
+
+/* a non-blocking partition matches the blocking one */
+static void
+test_partition_begin (p4est_t * p4est, unsigned crc, int have_zlib,
+                      p4est_gloidx_t * pertree1, p4est_gloidx_t * pertree2)
+{
+  int                 p, round;
+  const int           rank = p4est->mpirank;
+  p4est_locidx_t      li, num_src, num_dest;
+  p4est_gloidx_t      shipped, shipped_exact;
+  p4est_gloidx_t     *src_data, *dest_data;
+  p4est_t            *copy;
+  p4est_partition_context_t *pc;
+
+  /* compare with a blocking partition of a copy */
+  p4est_partition (p4est, 0, NULL);
+  copy = p4est_copy (p4est, 1);
+  shipped_exact = p4est_partition_ext (copy, 0, weight_level);
+
+  /* the second round finds nothing to ship */
+  for (round = 0; round < 2; ++round) {
+    num_src = p4est->local_num_quadrants;
+    src_data = P4EST_ALLOC (p4est_gloidx_t, num_src);
+    for (li = 0; li < num_src; ++li) {
+      src_data[li] = p4est->global_first_quadrant[rank] + li;
+    }
+
+    /* transfer the global quadrant numbers along with the partition */
+    pc = p4est_partition_begin (p4est, 0, weight_level);
+    for (p = 0; p <= p4est->mpisize; ++p) {
+      SC_CHECK_ABORT (pc->src_gfq[p] == p4est->global_first_quadrant[p],
+                      "Begin source");
+      SC_CHECK_ABORT (pc->dest_gfq[p] == copy->global_first_quadrant[p],
+                      "Begin destination");
+    }
+    num_dest = (p4est_locidx_t) (pc->dest_gfq[rank + 1] -
+                                 pc->dest_gfq[rank]);
+    dest_data = P4EST_ALLOC (p4est_gloidx_t, num_dest);
+    p4est_partition_transfer_fixed (pc, 0, dest_data, src_data,
+                                    sizeof (p4est_gloidx_t));
+    SC_CHECK_ABORT (pc->global_shipped == (round ? 0 : shipped_exact),
+                    "Begin shipped");
+    shipped = p4est_partition_end (pc);
+    SC_CHECK_ABORT (shipped == (round ? 0 : shipped_exact), "End shipped");
+
+    test_pertree (p4est, pertree1, pertree2);
+    SC_CHECK_ABORT (crc == test_checksum (p4est, have_zlib),
+                    "bad checksum after partition begin and end");
+    SC_CHECK_ABORT (num_dest == p4est->local_num_quadrants, "End count");
+    for (li = 0; li < num_dest; ++li) {
+      SC_CHECK_ABORT (dest_data[li] ==
+                      p4est->global_first_quadrant[rank] + li, "End data");
+    }
+    P4EST_FREE (src_data);
+    P4EST_FREE (dest_data);
+  }
+  p4est_destroy (copy);
+}
+
+static void
+test_partition_shared (p4est_t * p4est)
+{
+#if defined P4EST_ENABLE_MPIWINSHARED && defined P4EST_ENABLE_MPICOMMSHARED
+  int                 mpiret;
+  int                 ppn, is_shared;
+  size_t              bytes[4];
+  sc_MPI_Comm         mpicomm;
+  p4est_connectivity_t *conn;
+  p4est_t            *shared, *priv, *copy;
+
+  /* allow node-shared memory on nodes of two processes if possible */
+  ppn = p4est->mpisize % 2 == 0 ? 2 : 1;
+  mpiret = sc_MPI_Comm_dup (p4est->mpicomm, &mpicomm);
+  SC_CHECK_MPI (mpiret);
+  sc_mpi_comm_attach_node_comms (mpicomm, ppn);
+  p4est_shared_set_enabled (mpicomm, 1);
+  SC_CHECK_ABORT (p4est_shared_is_enabled (mpicomm), "Shared enabled");
+  SC_CHECK_ABORT (!p4est_shared_is_enabled (p4est->mpicomm),
+                  "Shared disabled");
+  is_shared = p4est->mpisize > 1;
+
+  /* the same forest is created in shared and in private memory */
+#ifdef P4_TO_P8
+  conn = p8est_connectivity_new_twocubes ();
+#else
+  conn = p4est_connectivity_new_corner ();
+#endif
+  shared = p4est_new_ext (mpicomm, conn, 15, 0, 0,
+                          sizeof (user_data_t), init_fn, NULL);
+  priv = p4est_new_ext (p4est->mpicomm, p4est->connectivity, 15, 0, 0,
+                        sizeof (user_data_t), init_fn, NULL);
+  SC_CHECK_ABORT ((conn->shared != NULL) == is_shared, "Shared conn");
+  SC_CHECK_ABORT ((shared->shared != NULL) == is_shared, "Shared new");
+  SC_CHECK_ABORT (priv->shared == NULL, "Shared private");
+  SC_CHECK_ABORT (p4est_connectivity_is_equal (conn, p4est->connectivity),
+                  "Shared conn equal");
+  SC_CHECK_ABORT (p4est_is_equal (shared, priv, 1), "Shared equal new");
+
+  /* the node-shared partition arrays follow all changes of the mesh */
+  p4est_refine (shared, 1, refine_fn, init_fn);
+  p4est_refine (priv, 1, refine_fn, init_fn);
+  p4est_partition (shared, 0, weight_level);
+  p4est_partition (priv, 0, weight_level);
+  p4est_balance (shared, P4EST_CONNECT_FULL, init_fn);
+  p4est_balance (priv, P4EST_CONNECT_FULL, init_fn);
+  p4est_partition (shared, 1, NULL);
+  p4est_partition (priv, 1, NULL);
+  SC_CHECK_ABORT (p4est_is_valid (shared), "Shared valid");
+  SC_CHECK_ABORT (p4est_is_equal (shared, priv, 1), "Shared equal adapt");
+
+  /* a copy gets its own node-shared arrays */
+  copy = p4est_copy (shared, 1);
+  SC_CHECK_ABORT ((copy->shared != NULL) == is_shared, "Shared copy");
+  SC_CHECK_ABORT (!is_shared ||
+                  copy->global_first_quadrant !=
+                  shared->global_first_quadrant, "Shared copy array");
+  p4est_coarsen (copy, 0, coarsen_fn, init_fn);
+  p4est_coarsen (priv, 0, coarsen_fn, init_fn);
+  SC_CHECK_ABORT (p4est_is_equal (copy, priv, 1), "Shared equal copy");
+
+  /* the node-shared arrays are counted by the first process of a node */
+  bytes[0] = p4est_memory_used (copy);
+  bytes[2] = p4est_connectivity_memory_used (conn);
+  bytes[3] = p4est_connectivity_memory_used (p4est->connectivity);
+
+  /* moving the arrays back into private memory keeps the contents */
+  p4est_comm_unshare (copy);
+  SC_CHECK_ABORT (copy->shared == NULL, "Shared unshare");
+  SC_CHECK_ABORT (p4est_is_equal (copy, priv, 1), "Shared equal unshare");
+  bytes[1] = p4est_memory_used (copy);
+  if (ppn > 1 && copy->mpirank % ppn > 0) {
+    SC_CHECK_ABORT (bytes[0] < bytes[1], "Shared forest memory");
+    SC_CHECK_ABORT (bytes[2] < bytes[3], "Shared conn memory");
+  }
+
+  p4est_destroy (copy);
+  p4est_destroy (priv);
+  p4est_destroy (shared);
+  p4est_connectivity_destroy (conn);
+  mpiret = sc_MPI_Comm_free (&mpicomm);
+  SC_CHECK_MPI (mpiret);
+#endif
+}
+
+/* partition by several weights and verify the reported imbalance */
+static void
+test_partition_multi (p4est_t * p4est, unsigned crc, int have_zlib,
+                      p4est_gloidx_t * pertree1, p4est_gloidx_t * pertree2)
+{
+  int                 mpiret;
+  int                 c, p;
+  int                 weights[2];
+  size_t              qz;
+  long long           local[2], maxw[2], sumw[2];
+  double              imbalance[2], ratio;
+  p4est_topidx_t      t;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *quad;
+  p4est_t            *copy;
+  test_transfer_t    *tt;
+
+  /* a single unit weight reproduces the uniform partition */
+  copy = p4est_copy (p4est, 1);
+  p4est_partition (copy, 0, NULL);
+  tt = test_transfer_pre (p4est);
+  p4est_partition_multi (p4est, 0, 1, weights_one, imbalance);
+  test_transfer_post (tt, p4est);
+  test_pertree (p4est, pertree1, pertree2);
+  SC_CHECK_ABORT (crc == test_checksum (p4est, have_zlib),
+                  "bad checksum after multi-constraint partition 1");
+  for (p = 0; p <= p4est->mpisize; ++p) {
+    SC_CHECK_ABORT (p4est->global_first_quadrant[p] ==
+                    copy->global_first_quadrant[p], "Multi uniform");
+  }
+  SC_CHECK_ABORT (imbalance[0] >= 1., "Multi imbalance 1");
+  p4est_destroy (copy);
+
+  /* the second weight is concentrated in a part of the domain */
+  tt = test_transfer_pre (p4est);
+  p4est_partition_multi (p4est, 1, 2, weights_two, imbalance);
+  test_transfer_post (tt, p4est);
+  test_pertree (p4est, pertree1, pertree2);
+  SC_CHECK_ABORT (crc == test_checksum (p4est, have_zlib),
+                  "bad checksum after multi-constraint partition 2");
+
+  /* recompute the imbalance from the new partition */
+  local[0] = local[1] = 0;
+  for (t = p4est->first_local_tree; t <= p4est->last_local_tree; ++t) {
+    tree = p4est_tree_array_index (p4est->trees, t);
+    for (qz = 0; qz < tree->quadrants.elem_count; ++qz) {
+      quad = p4est_quadrant_array_index (&tree->quadrants, qz);
+      weights[0] = weights[1] = 0;
+      weights_two (p4est, t, quad, weights);
+      for (c = 0; c < 2; ++c) {
+        local[c] += weights[c];
+      }
+    }
+  }
+  mpiret = sc_MPI_Allreduce (local, maxw, 2, sc_MPI_LONG_LONG_INT,
+                             sc_MPI_MAX, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Allreduce (local, sumw, 2, sc_MPI_LONG_LONG_INT,
+                             sc_MPI_SUM, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  for (c = 0; c < 2; ++c) {
+    ratio = sumw[c] > 0 ?
+      (double) maxw[c] * p4est->mpisize / (double) sumw[c] : 1.;
+    SC_CHECK_ABORT (imbalance[c] >= 1., "Multi imbalance 2");
+    SC_CHECK_ABORT (fabs (imbalance[c] - ratio) <= 1e-12 * ratio,
+                    "Multi imbalance mismatch");
+  }
+}
+
 int
 main (int argc, char **argv)
 {
@@ -566,6 +959,21 @@ main (int argc, char **argv)
   SC_CHECK_ABORT (crc == test_checksum (copy, have_zlib),
                   "bad checksum after unevenly weighted partition 3");
 
+  /* plan partitions that limit the movement of the cuts */
+  test_partition_plan (copy, crc, have_zlib, pertree1, pertree2);
+
+  /* partition first among compute nodes and then within */
+  test_partition_node (copy, crc, have_zlib, pertree1, pertree2);
+
+  /* overlap the partition with a transfer of quadrant data */
+  test_partition_begin (copy, crc, have_zlib, pertree1, pertree2);
+
+  /* keep the partition and connectivity once per compute node */
+  test_partition_shared (copy);
+
+  /* do partitions with more than one weight per quadrant */
+  test_partition_multi (copy, crc, have_zlib, pertree1, pertree2);
+
   /* check user data content */
   for (t = copy->first_local_tree; t <= copy->last_local_tree; ++t) {
     tree = p4est_tree_array_index (copy->trees, t);
@@ -26,10 +26,12 @@
 #include <p4est_algorithms.h>
 #include <p4est_bits.h>
 #include <p4est_extended.h>
+#include <p4est_search.h>
 #else
 #include <p8est_algorithms.h>
 #include <p8est_bits.h>
 #include <p8est_extended.h>
+#include <p8est_search.h>
 #endif
 
 /* we reuse a few static functions from this file for 3D */
@@ -136,6 +138,77 @@ check_coordinates (const p4est_quadrant_t * q)
   }
 }
 
+/* sort a shuffled array of quadrants, face neighbors outside the root and
+   duplicates by radix sort and verify it against the comparison sort */
+static void
+check_array_sort (sc_array_t * quadrants)
+{
+  size_t              iz, jz;
+  ssize_t            *res;
+  sc_rand_state_t     state = 1;
+  sc_array_t         *a1, *a2, *results;
+  p4est_quadrant_t   *p, *q, temp;
+
+  a1 = sc_array_new (sizeof (p4est_quadrant_t));
+  for (iz = 0; iz < quadrants->elem_count; ++iz) {
+    q = p4est_quadrant_array_index (quadrants, iz);
+    p = p4est_quadrant_array_push (a1);
+    *p = *q;
+    p->p.which_tree = (p4est_topidx_t) (iz % 3);
+    p = p4est_quadrant_array_push (a1);
+    p4est_quadrant_face_neighbor (q, (int) (iz % P4EST_FACES), p);
+    p->p.which_tree = (p4est_topidx_t) (iz % 5);
+  }
+  for (iz = a1->elem_count; iz > 1; --iz) {
+    jz = (size_t) (sc_rand (&state) * iz);
+    p = p4est_quadrant_array_index (a1, iz - 1);
+    q = p4est_quadrant_array_index (a1, jz);
+    temp = *p;
+    *p = *q;
+    *q = temp;
+  }
+  a2 = sc_array_new (sizeof (p4est_quadrant_t));
+
+  sc_array_copy (a2, a1);
+  sc_array_sort (a2, p4est_quadrant_compare_piggy);
+  p4est_quadrant_array_sort_piggy (a1);
+  for (iz = 0; iz < a1->elem_count; ++iz) {
+    SC_CHECK_ABORT (!p4est_quadrant_compare_piggy
+                    (sc_array_index (a1, iz), sc_array_index (a2, iz)),
+                    "array_sort_piggy");
+  }
+
+  sc_array_copy (a2, a1);
+  sc_array_sort (a2, p4est_quadrant_compare);
+  p4est_quadrant_array_sort (a1);
+  for (iz = 0; iz < a1->elem_count; ++iz) {
+    SC_CHECK_ABORT (!p4est_quadrant_compare
+                    (sc_array_index (a1, iz), sc_array_index (a2, iz)),
+                    "array_sort");
+  }
+
+  /* the sorted input quadrants serve as queries */
+  results = sc_array_new (sizeof (ssize_t));
+  p4est_find_lower_bounds (a1, quadrants, results);
+  for (iz = 0; iz < quadrants->elem_count; ++iz) {
+    q = p4est_quadrant_array_index (quadrants, iz);
+    res = (ssize_t *) sc_array_index (results, iz);
+    SC_CHECK_ABORT (*res == p4est_find_lower_bound (a1, q, 0),
+                    "find_lower_bounds");
+  }
+  p4est_find_higher_bounds (a1, quadrants, results);
+  for (iz = 0; iz < quadrants->elem_count; ++iz) {
+    q = p4est_quadrant_array_index (quadrants, iz);
+    res = (ssize_t *) sc_array_index (results, iz);
+    SC_CHECK_ABORT (*res == p4est_find_higher_bound (a1, q, 0),
+                    "find_higher_bounds");
+  }
+
+  sc_array_destroy (results);
+  sc_array_destroy (a1);
+  sc_array_destroy (a2);
+}
+
 #ifndef P4_TO_P8
 
 /* code compiled exclusively for 2D begins here */
@@ -253,6 +326,8 @@ main (int argc, char **argv)
   t2 = p4est_tree_array_index (p4est2->trees, 0);
   SC_CHECK_ABORT (p4est_tree_is_sorted (t1), "is_sorted");
   SC_CHECK_ABORT (p4est_tree_is_sorted (t2), "is_sorted");
+  check_array_sort (&t1->quadrants);
+  check_array_sort (&t2->quadrants);
 
   /* run a bunch of cross-tests */
   p = NULL;
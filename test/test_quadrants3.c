@@ -157,6 +157,8 @@ main (int argc, char **argv)
   t2 = p4est_tree_array_index (p4est2->trees, 0);
   SC_CHECK_ABORT (p4est_tree_is_sorted (t1), "is_sorted");
   SC_CHECK_ABORT (p4est_tree_is_sorted (t2), "is_sorted");
+  check_array_sort (&t1->quadrants);
+  check_array_sort (&t2->quadrants);
 
   /* run a bunch of cross-tests */
   p = NULL;
@@ -42,12 +42,44 @@ static int          refine_level = 5;
 static int          refine_level = 3;
 #endif
 
+/* one callback invocation recorded through the user pointer */
+typedef struct test_callback
+{
+  int                 kind;
+  p4est_topidx_t      which_tree;
+  p4est_quadrant_t    quadrant;
+}
+test_callback_t;
+
+static void
+record_callback (p4est_t * p4est, int kind, p4est_topidx_t which_tree,
+                 p4est_quadrant_t * quadrant)
+{
+  test_callback_t    *tc;
+
+  if (p4est->user_pointer != NULL) {
+    tc = (test_callback_t *) sc_array_push ((sc_array_t *)
+                                            p4est->user_pointer);
+    tc->kind = kind;
+    tc->which_tree = which_tree;
+    P4EST_QUADRANT_INIT (&tc->quadrant);
+    tc->quadrant.x = quadrant->x;
+    tc->quadrant.y = quadrant->y;
+#ifdef P4_TO_P8
+    tc->quadrant.z = quadrant->z;
+#endif
+    tc->quadrant.level = quadrant->level;
+  }
+}
+
 static int
 refine_fn (p4est_t * p4est, p4est_topidx_t which_tree,
            p4est_quadrant_t * quadrant)
 {
   int                 cid;
 
+  record_callback (p4est, 0, which_tree, quadrant);
+
   if (which_tree == 2 || which_tree == 3) {
     return 0;
   }
@@ -80,6 +112,13 @@ refine_fn (p4est_t * p4est, p4est_topidx_t which_tree,
   return 1;
 }
 
+static int
+refine_uniform (p4est_t * p4est, p4est_topidx_t which_tree,
+                p4est_quadrant_t * quadrant)
+{
+  return (int) quadrant->level < refine_level;
+}
+
 static int
 coarsen_fn (p4est_t * p4est, p4est_topidx_t which_tree,
             p4est_quadrant_t * q[])
@@ -108,6 +147,7 @@ replace_fn (p4est_t * p4est, p4est_topidx_t which_tree,
     p = incoming[0];
     fam = outgoing;
   }
+  record_callback (p4est, 1, which_tree, p);
 
   SC_CHECK_ABORT (p4est_quadrant_is_familypv (fam),
                   P4EST_STRING "_replace_t family is not a family");
@@ -121,8 +161,13 @@ main (int argc, char **argv)
 {
   int                 mpirank, mpisize;
   int                 mpiret;
+  int                 mode;
+  size_t              zz;
+  sc_array_t         *serial_log, *stacked_log;
+  test_callback_t    *tc1, *tc2;
   sc_MPI_Comm         mpicomm;
-  p4est_t            *p4est;
+  p4est_t            *p4est, *serial, *stacked;
+  p4est_inspect_t    *inspect;
   p4est_connectivity_t *connectivity;
 
   mpiret = sc_MPI_Init (&argc, &argv);
@@ -143,6 +188,51 @@ main (int argc, char **argv)
   connectivity = p4est_connectivity_new_star ();
 #endif
   p4est = p4est_new_ext (mpicomm, connectivity, 15, 0, 0, 1, NULL, NULL);
+
+  /* stack and threaded refinement must produce the same forest as the
+     default refinement, and the stack on one thread calls the callbacks
+     in the same order */
+  inspect = P4EST_ALLOC_ZERO (p4est_inspect_t, 1);
+  inspect->use_refine_stack = 1;
+  serial_log = sc_array_new (sizeof (test_callback_t));
+  stacked_log = sc_array_new (sizeof (test_callback_t));
+  for (mode = 0; mode < 4; ++mode) {
+    inspect->refine_num_threads = (mode & 2) ? 3 : 1;
+    serial = p4est_copy (p4est, 1);
+    stacked = p4est_copy (p4est, 1);
+    stacked->inspect = inspect;
+    p4est_refine (serial, 1, refine_uniform, NULL);
+    p4est_refine (stacked, 1, refine_uniform, NULL);
+    if (!(mode & 2)) {
+      serial->user_pointer = serial_log;
+      stacked->user_pointer = stacked_log;
+    }
+    p4est_refine_ext (serial, mode & 1, -1, refine_fn, NULL,
+                      replace_fn);
+    p4est_refine_ext (stacked, mode & 1, -1, refine_fn, NULL,
+                      replace_fn);
+    SC_CHECK_ABORT (p4est_checksum (serial) == p4est_checksum (stacked),
+                    "Stack refine");
+    SC_CHECK_ABORT (serial_log->elem_count == stacked_log->elem_count,
+                    "Stack refine callback count");
+    for (zz = 0; zz < serial_log->elem_count; ++zz) {
+      tc1 = (test_callback_t *) sc_array_index (serial_log, zz);
+      tc2 = (test_callback_t *) sc_array_index (stacked_log, zz);
+      SC_CHECK_ABORT (tc1->kind == tc2->kind &&
+                      tc1->which_tree == tc2->which_tree &&
+                      p4est_quadrant_is_equal (&tc1->quadrant,
+                                               &tc2->quadrant),
+                      "Stack refine callback order");
+    }
+    sc_array_reset (serial_log);
+    sc_array_reset (stacked_log);
+    p4est_destroy (serial);
+    p4est_destroy (stacked);
+  }
+  sc_array_destroy (serial_log);
+  sc_array_destroy (stacked_log);
+  P4EST_FREE (inspect);
+
   p4est_refine_ext (p4est, 1, P4EST_QMAXLEVEL, refine_fn, NULL, replace_fn);
   p4est_coarsen_ext (p4est, 1, 0, coarsen_fn, NULL, replace_fn);
   p4est_balance_ext (p4est, P4EST_CONNECT_FULL, NULL, replace_fn);
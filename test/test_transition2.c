@@ -0,0 +1,223 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef P4_TO_P8
+#include <p4est_bits.h>
+#include <p4est_extended.h>
+#include <p4est_transition.h>
+#else
+#include <p8est_bits.h>
+#include <p8est_extended.h>
+#include <p8est_transition.h>
+#endif
+
+#ifndef P4_TO_P8
+static const int    refine_level = 6;
+#else
+static const int    refine_level = 4;
+#endif
+static int          kernel_count;
+
+static int
+refine_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+           p4est_quadrant_t * quadrant)
+{
+  if ((int) quadrant->level >= refine_level - (int) (which_tree % 3)) {
+    return 0;
+  }
+  return p4est_quadrant_child_id (quadrant) != 1 &&
+    (quadrant->x < P4EST_ROOT_LEN / 2 || quadrant->level < 2);
+}
+
+static int
+coarsen_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+            p4est_quadrant_t * q[])
+{
+  return q[0]->level > 1 && q[0]->y >= P4EST_ROOT_LEN / 4;
+}
+
+/* the projected data is the quadrant itself */
+static void
+refine_kernel (size_t num_parents, size_t data_size,
+               const void *parents, void *children, void *user)
+{
+  size_t              zz;
+  const p4est_quadrant_t *p = (const p4est_quadrant_t *) parents;
+  p4est_quadrant_t   *c = (p4est_quadrant_t *) children;
+
+  SC_CHECK_ABORT (data_size == sizeof (p4est_quadrant_t), "Kernel size");
+  ++kernel_count;
+  for (zz = 0; zz < num_parents; ++zz) {
+    p4est_quadrant_childrenv (p + zz, c + P4EST_CHILDREN * zz);
+  }
+}
+
+static void
+coarsen_kernel (size_t num_parents, size_t data_size,
+                const void *children, void *parents, void *user)
+{
+  size_t              zz;
+  const p4est_quadrant_t *c = (const p4est_quadrant_t *) children;
+  p4est_quadrant_t   *p = (p4est_quadrant_t *) parents;
+
+  SC_CHECK_ABORT (data_size == sizeof (p4est_quadrant_t), "Kernel size");
+  ++kernel_count;
+  for (zz = 0; zz < num_parents; ++zz) {
+    SC_CHECK_ABORT (p4est_quadrant_is_familyv (c + P4EST_CHILDREN * zz),
+                    "Kernel family");
+    p4est_quadrant_parent (c + P4EST_CHILDREN * zz, p + zz);
+  }
+}
+
+static sc_array_t  *
+local_quadrants (p4est_t * p4est)
+{
+  size_t              zz;
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree;
+  sc_array_t         *quads;
+
+  quads = sc_array_new (sizeof (p4est_quadrant_t));
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      *(p4est_quadrant_t *) sc_array_push (quads) =
+        *p4est_quadrant_array_index (&tree->quadrants, zz);
+    }
+  }
+  return quads;
+}
+
+/* project the quadrants themselves and compare with the adapted forest */
+static void
+check_transition (p4est_t * p4est, p4est_transition_t * transition,
+                  sc_array_t * old_quads)
+{
+  size_t              zz;
+  p4est_locidx_t      old_index, new_index;
+  p4est_quadrant_t   *a, *b;
+  p4est_transition_range_t *r;
+  sc_array_t         *new_quads, *projected;
+
+  SC_CHECK_ABORT (transition->num_old == (p4est_locidx_t)
+                  old_quads->elem_count, "Transition old count");
+  SC_CHECK_ABORT (transition->num_new == p4est->local_num_quadrants,
+                  "Transition new count");
+
+  /* the ranges cover both index sets contiguously */
+  old_index = new_index = 0;
+  for (zz = 0; zz < transition->ranges->elem_count; ++zz) {
+    r = (p4est_transition_range_t *) sc_array_index (transition->ranges, zz);
+    SC_CHECK_ABORT (r->old_index == old_index && r->new_index == new_index,
+                    "Transition range order");
+    SC_CHECK_ABORT ((r->type == P4EST_TRANSITION_KEEP) ==
+                    (r->num_old == r->num_new), "Transition range type");
+    old_index += r->num_old;
+    new_index += r->num_new;
+  }
+  SC_CHECK_ABORT (old_index == transition->num_old &&
+                  new_index == transition->num_new, "Transition range end");
+
+  new_quads = local_quadrants (p4est);
+  projected = sc_array_new_size (sizeof (p4est_quadrant_t),
+                                 new_quads->elem_count);
+  kernel_count = 0;
+  p4est_transition_project (transition, sizeof (p4est_quadrant_t),
+                            old_quads->array, projected->array,
+                            refine_kernel, coarsen_kernel, NULL);
+  for (zz = 0; zz < new_quads->elem_count; ++zz) {
+    a = p4est_quadrant_array_index (new_quads, zz);
+    b = p4est_quadrant_array_index (projected, zz);
+    SC_CHECK_ABORT (p4est_quadrant_is_equal (a, b), "Transition project");
+  }
+  P4EST_VERBOSEF ("Projected with %d kernel calls over %llu ranges\n",
+                  kernel_count,
+                  (unsigned long long) transition->ranges->elem_count);
+
+  sc_array_destroy (new_quads);
+  sc_array_destroy (projected);
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  sc_MPI_Comm         mpicomm;
+  p4est_t            *p4est;
+  p4est_connectivity_t *connectivity;
+  p4est_transition_t *transition;
+  sc_array_t         *old_quads;
+
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+#ifndef P4_TO_P8
+  connectivity = p4est_connectivity_new_star ();
+#else
+  connectivity = p8est_connectivity_new_rotcubes ();
+#endif
+  p4est = p4est_new_ext (mpicomm, connectivity, 0, 2, 1, 0, NULL, NULL);
+
+  /* refine and coarsen by one level each */
+  old_quads = local_quadrants (p4est);
+  transition = p4est_transition_new (p4est);
+  p4est_refine (p4est, 0, refine_fn, NULL);
+  p4est_coarsen (p4est, 0, coarsen_fn, NULL);
+  p4est_transition_complete (transition, p4est);
+  check_transition (p4est, transition, old_quads);
+  p4est_transition_destroy (transition);
+  sc_array_destroy (old_quads);
+
+  /* refine and coarsen by multiple levels including balance */
+  old_quads = local_quadrants (p4est);
+  transition = p4est_transition_new (p4est);
+  p4est_refine (p4est, 1, refine_fn, NULL);
+  p4est_balance (p4est, P4EST_CONNECT_FULL, NULL);
+  p4est_transition_complete (transition, p4est);
+  check_transition (p4est, transition, old_quads);
+  p4est_transition_destroy (transition);
+  sc_array_destroy (old_quads);
+
+  old_quads = local_quadrants (p4est);
+  transition = p4est_transition_new (p4est);
+  p4est_coarsen (p4est, 1, coarsen_fn, NULL);
+  p4est_refine (p4est, 0, refine_fn, NULL);
+  p4est_transition_complete (transition, p4est);
+  check_transition (p4est, transition, old_quads);
+  p4est_transition_destroy (transition);
+  sc_array_destroy (old_quads);
+
+  p4est_destroy (p4est);
+  p4est_connectivity_destroy (connectivity);
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}